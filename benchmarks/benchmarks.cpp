@@ -0,0 +1,598 @@
+/**
+ * Benchmark suite for matrixgen's generators and utility kernels.
+ *
+ * The suite sweeps grid sizes, boundary conditions, thread counts and the
+ * number of source matrices. Every measurement runs in a child process of its
+ * own such that the reported peak resident set size belongs to that
+ * measurement alone. Results are written to stdout as JSON lines, one object
+ * per measurement:
+ *
+ * ****************************************************************************
+ *   {"benchmark":"adjmat","grid":64,"stencil":"7p","bc":"periodic",
+ *    "threads":4,"matrices":1,"nnz":1835008,"seconds":0.0913,
+ *    "nnz_per_second":2.01e+07,"bytes_per_nnz":12.1,"peak_rss_kib":80412}
+ * ****************************************************************************
+ *
+ * `seconds` is the fastest of all repetitions. For the utility kernels `nnz`
+ * is the number of processed elements and `bytes_per_nnz` is zero.
+ *
+ * Usage:
+ *
+ *   benchmarks [--sizes 16,32,64] [--threads 1,2,4] [--matrices 2,8]
+ *              [--repetitions 3] [--filter <substring>]
+ */
+#include <matrixgen/core>
+
+#include <Eigen/Sparse>
+
+#include <tbb/global_control.h>
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+using Scalar_t = double;
+using Index_t = int;
+using Matrix_t = Eigen::SparseMatrix<Scalar_t, Eigen::RowMajor, Index_t>;
+using Grid_t = std::array<Index_t, 3>;
+
+/* Parameters of a single measurement. */
+struct Params {
+  std::string benchmark;
+  Index_t grid = 0;
+  std::string bc = "dirichlet";
+  int threads = 1;
+  int matrices = 1;
+  int repetitions = 3;
+  std::string stencil = "7p";
+};
+
+/* Result of a single measurement. */
+struct Sample {
+  Eigen::Index nnz = 0;
+  double bytes = 0;
+  double seconds = std::numeric_limits<double>::infinity();
+};
+
+/* Returns the fastest wall time of `repetitions` calls to `fn`. */
+template <typename Fn_t>
+double
+min_seconds(int repetitions, Fn_t fn) {
+  auto best = std::numeric_limits<double>::infinity();
+  for(auto rep = 0; rep < repetitions; ++rep) {
+    const auto start = std::chrono::steady_clock::now();
+    fn();
+    const auto stop = std::chrono::steady_clock::now();
+    best = std::min(best, std::chrono::duration<double>(stop - start).count());
+  }
+  return best;
+}
+
+/* Bytes occupied by a sparse matrix's index and value arrays. */
+template <typename SparseMatrix_t>
+double
+storage_bytes(const SparseMatrix_t& matrix) {
+  using S = typename SparseMatrix_t::Scalar;
+  using I = typename SparseMatrix_t::StorageIndex;
+  auto bytes = static_cast<double>(matrix.outerSize() + 1) * sizeof(I) +
+               static_cast<double>(matrix.nonZeros()) * (sizeof(I) + sizeof(S));
+  if(!matrix.isCompressed()) {
+    bytes += static_cast<double>(matrix.outerSize()) * sizeof(I);
+  }
+  return bytes;
+}
+
+/* Measures an owning generator `generate()` returning a sparse matrix. */
+template <typename Generate_t>
+Sample
+measure_matrix(const Params& params, Generate_t generate) {
+  auto sample = Sample {};
+  sample.seconds = min_seconds(params.repetitions, [&]() {
+    const auto matrix = generate();
+    sample.nnz = matrix.nonZeros();
+    sample.bytes = storage_bytes(matrix);
+  });
+  return sample;
+}
+
+/* Measures a kernel `run()` processing `numOfElements` elements. */
+template <typename Run_t>
+Sample
+measure_kernel(const Params& params, Eigen::Index numOfElements, Run_t run) {
+  auto sample = Sample {numOfElements, 0, 0};
+  sample.seconds = min_seconds(params.repetitions, run);
+  return sample;
+}
+
+/* Baseline operator on the benchmark grid. */
+Matrix_t
+baseline(const Params& params, uint64_t seed = 1) {
+  const auto grid = Grid_t {params.grid, params.grid, params.grid};
+  if(params.bc == "periodic") {
+    return matrixgen::adjmat<Matrix_t>(grid,
+        matrixgen::stencil7p<matrixgen::BC::PERIODIC>(), matrixgen::randweight(seed));
+  }
+  return matrixgen::adjmat<Matrix_t>(grid, matrixgen::stencil7p(), matrixgen::randweight(seed));
+}
+
+std::vector<Matrix_t>
+baselines(const Params& params) {
+  auto result = std::vector<Matrix_t> {};
+  for(auto ii = 0; ii < params.matrices; ++ii) {
+    result.push_back(baseline(params, ii + 1));
+  }
+  return result;
+}
+
+Sample
+bench_adjmat(const Params& params) {
+  const auto grid = Grid_t {params.grid, params.grid, params.grid};
+  return measure_matrix(params, [&]() {
+    if(params.bc == "periodic") {
+      return matrixgen::adjmat<Matrix_t>(grid,
+          matrixgen::stencil7p<matrixgen::BC::PERIODIC>(), matrixgen::sinusoid_mul_bias(1.0, 2.0, 3.0));
+    }
+    return matrixgen::adjmat<Matrix_t>(grid, matrixgen::stencil7p(), matrixgen::sinusoid_mul_bias(1.0, 2.0, 3.0));
+  });
+}
+
+/* Measures `adjmat` into caller-provided CSR arrays with the adjacency function of `params.bc`. */
+template <
+  typename DirichletAdjFn_t,
+  typename PeriodicAdjFn_t,
+  typename WeightFn_t
+    >
+Sample
+measure_adjmat_csr(const Params& params, DirichletAdjFn_t dirichlet, PeriodicAdjFn_t periodic, WeightFn_t weightfn) {
+  using Target_t = matrixgen::CsrTarget<Scalar_t, Index_t>;
+  const auto grid = Grid_t {params.grid, params.grid, params.grid};
+  auto generate = [&](const Target_t& target) {
+    if(params.bc == "periodic") {
+      return matrixgen::adjmat(target, grid, periodic, weightfn);
+    }
+    return matrixgen::adjmat(target, grid, dirichlet, weightfn);
+  };
+
+  const auto capacity = generate(Target_t {});
+  auto outerIndex = std::vector<Index_t>(capacity.outerIndexSize);
+  auto innerIndex = std::vector<Index_t>(capacity.nonZeros);
+  auto values = std::vector<Scalar_t>(capacity.nonZeros);
+  const auto bytes = static_cast<double>(outerIndex.size() + innerIndex.size()) * sizeof(Index_t) +
+                     static_cast<double>(values.size()) * sizeof(Scalar_t);
+
+  auto sample = measure_kernel(params, capacity.nonZeros, [&]() {
+    generate(Target_t {outerIndex, innerIndex, values});
+  });
+  sample.bytes = bytes;
+  return sample;
+}
+
+Sample
+bench_adjmat_csr(const Params& params) {
+  return measure_adjmat_csr(params, matrixgen::stencil7p(), matrixgen::stencil7p<matrixgen::BC::PERIODIC>(),
+      matrixgen::sinusoid_mul_bias(1.0, 2.0, 3.0));
+}
+
+Sample
+bench_adjmat_csr_27p(const Params& params) {
+  return measure_adjmat_csr(params, matrixgen::stencil27p(), matrixgen::stencil27p<matrixgen::BC::PERIODIC>(),
+      matrixgen::sinusoid_mul_bias(1.0, 2.0, 3.0));
+}
+
+/* Gaussian kernel matrix over all neighbors within a radius of 3 (123 per inner node). */
+Sample
+bench_adjmat_csr_radius(const Params& params) {
+  return measure_adjmat_csr(params, matrixgen::stencil_radius(3.0), matrixgen::stencil_radius<matrixgen::BC::PERIODIC>(3.0),
+      matrixgen::radial_weight(3.0, matrixgen::gaussian_kernel(1.5)));
+}
+
+Sample
+bench_adjmat_first_touch(const Params& params) {
+  const auto grid = Grid_t {params.grid, params.grid, params.grid};
+  auto partition = matrixgen::RowPartition {};
+  return measure_matrix(params, [&]() {
+    if(params.bc == "periodic") {
+      return matrixgen::adjmat_first_touch<Matrix_t>(grid, matrixgen::stencil7p<matrixgen::BC::PERIODIC>(),
+          matrixgen::sinusoid_mul_bias(1.0, 2.0, 3.0), partition, params.threads);
+    }
+    return matrixgen::adjmat_first_touch<Matrix_t>(grid, matrixgen::stencil7p(),
+        matrixgen::sinusoid_mul_bias(1.0, 2.0, 3.0), partition, params.threads);
+  });
+}
+
+/* Red-black ordered 7p operator, generated in its colored order. */
+Sample
+bench_adjmat_multicolor(const Params& params) {
+  const auto grid = Grid_t {params.grid, params.grid, params.grid};
+  return measure_matrix(params, [&]() {
+    if(params.bc == "periodic") {
+      return matrixgen::adjmat_multicolor<Matrix_t>(grid, matrixgen::stencil7p<matrixgen::BC::PERIODIC>(),
+          matrixgen::sinusoid_mul_bias(1.0, 2.0, 3.0)).matrix;
+    }
+    return matrixgen::adjmat_multicolor<Matrix_t>(grid, matrixgen::stencil7p(),
+        matrixgen::sinusoid_mul_bias(1.0, 2.0, 3.0)).matrix;
+  });
+}
+
+/* Greedy coloring and reordering of a perturbed operator. */
+Sample
+bench_multicolor(const Params& params) {
+  const auto matrix = baseline(params);
+  auto rows = std::vector<Index_t> {};
+  for(Index_t row = 0; row < matrix.rows(); row += 10) {
+    rows.push_back(row);
+  }
+  const auto perturbed = matrixgen::perturb(matrix, rows.begin(), rows.end(), 3);
+  return measure_matrix(params, [&]() {
+    return matrixgen::multicolor(perturbed).matrix;
+  });
+}
+
+/* Reverse Cuthill-McKee reordering of a perturbed operator. */
+Sample
+bench_rcm(const Params& params) {
+  const auto matrix = baseline(params);
+  auto rows = std::vector<Index_t> {};
+  for(Index_t row = 0; row < matrix.rows(); row += 10) {
+    rows.push_back(row);
+  }
+  const auto perturbed = matrixgen::perturb(matrix, rows.begin(), rows.end(), 3);
+  return measure_matrix(params, [&]() {
+    return matrixgen::reverse_cuthill_mckee(perturbed).matrix;
+  });
+}
+
+/* SpMV along a row partition with one part per thread. */
+Sample
+measure_spmv(const Params& params, const Matrix_t& matrix, const matrixgen::RowPartition& partition) {
+  const auto x = Eigen::VectorXd::Ones(matrix.cols()).eval();
+  auto y = Eigen::VectorXd(matrix.rows());
+  auto sample = measure_kernel(params, matrix.nonZeros(), [&]() {
+    matrixgen::for_each_part(partition, [&](int, Eigen::Index first, Eigen::Index last) {
+      y.segment(first, last - first) = matrix.middleRows(first, last - first) * x;
+    });
+  });
+  sample.bytes = storage_bytes(matrix);
+  return sample;
+}
+
+/* SpMV on a matrix whose pages were touched by the generating thread. */
+Sample
+bench_spmv(const Params& params) {
+  const auto matrix = baseline(params);
+  return measure_spmv(params, matrix, matrixgen::balanced_row_partition(matrix, params.threads));
+}
+
+/* SpMV on a matrix placed by first touch along the SpMV's partition. */
+Sample
+bench_spmv_first_touch(const Params& params) {
+  auto partition = matrixgen::RowPartition {};
+  const auto matrix = matrixgen::first_touch_copy(baseline(params), partition, params.threads);
+  return measure_spmv(params, matrix, partition);
+}
+
+/* 1D Laplacians of the benchmark grid's dimensions, the factors of the 7p Laplacian. */
+std::vector<Matrix_t>
+laplacian_factors(const Params& params) {
+  const auto laplacian = [](std::array<Index_t, 1> coords, std::array<Index_t, 1> neighborCoords) {
+    return coords == neighborCoords ? 2.0 : -1.0;
+  };
+  const auto factor = matrixgen::adjmat<Matrix_t>(std::array {params.grid}, matrixgen::stencil3p(), laplacian);
+  return std::vector<Matrix_t>(3, factor);
+}
+
+/* The 7p Laplacian as the Kronecker sum of its 1D factors. */
+Sample
+bench_kron_sum(const Params& params) {
+  const auto factors = laplacian_factors(params);
+  return measure_matrix(params, [&]() {
+    return matrixgen::kron_sum(factors.begin(), factors.end());
+  });
+}
+
+/* Matrix-free SpMV with the 7p Laplacian given by its 1D factors. */
+Sample
+bench_spmv_kron(const Params& params) {
+  const auto factors = laplacian_factors(params);
+  const auto op = matrixgen::KroneckerOperator(factors.begin(), factors.end(), matrixgen::Kronecker::SUM);
+  const auto x = Eigen::VectorXd::Ones(op.cols()).eval();
+  auto y = Eigen::VectorXd(op.rows());
+  const auto nonZeros = op.to_matrix().nonZeros();
+  return measure_kernel(params, nonZeros, [&]() {
+    op.apply(x, y);
+  });
+}
+
+Sample
+bench_create_coo(const Params& params) {
+  const auto matrix = baseline(params);
+  auto rows = std::vector<Index_t> {};
+  auto cols = std::vector<Index_t> {};
+  auto vals = std::vector<Scalar_t> {};
+  for(Eigen::Index row = 0; row < matrix.outerSize(); ++row) {
+    for(Matrix_t::InnerIterator it(matrix, row); it; ++it) {
+      rows.push_back(static_cast<Index_t>(it.row()));
+      cols.push_back(static_cast<Index_t>(it.col()));
+      vals.push_back(it.value());
+    }
+  }
+  return measure_matrix(params, [&]() {
+    return matrixgen::create_coo<Matrix_t>(matrix.rows(), matrix.cols(),
+        rows.begin(), rows.end(), cols.begin(), vals.begin());
+  });
+}
+
+Sample
+bench_create_stream(const Params& params) {
+  // Banded row-major value stream of a square matrix with 8 * grid rows.
+  const auto size = Eigen::Index {8} * params.grid;
+  auto stream = std::vector<Scalar_t>(size * size, 0.0);
+  for(Eigen::Index row = 0; row < size; ++row) {
+    for(auto col = std::max<Eigen::Index>(0, row - 3); col < std::min(size, row + 4); ++col) {
+      stream[row * size + col] = 1.0 + static_cast<Scalar_t>(col);
+    }
+  }
+  return measure_matrix(params, [&]() {
+    return matrixgen::create<Matrix_t>(size, size, stream.begin(), stream.end());
+  });
+}
+
+Sample
+bench_assemble(const Params& params) {
+  const auto matrices = baselines(params);
+  auto indices = std::vector<int>(matrices.front().rows());
+  auto generator = std::mt19937_64(7);
+  std::generate(indices.begin(), indices.end(), [&]() {
+    return static_cast<int>(generator() % matrices.size());
+  });
+  return measure_matrix(params, [&]() {
+    return matrixgen::assemble(matrices.begin(), matrices.end(), indices.begin(), indices.end());
+  });
+}
+
+Sample
+bench_interleave(const Params& params) {
+  const auto matrices = baselines(params);
+  const auto proportions = std::vector<double>(matrices.size(), 1.0);
+  return measure_matrix(params, [&]() {
+    return matrixgen::interleave(matrices.begin(), matrices.end(),
+        proportions.begin(), proportions.end(), 1, 42);
+  });
+}
+
+Sample
+bench_interleave_workspace(const Params& params) {
+  const auto matrices = baselines(params);
+  const auto proportions = std::vector<double>(matrices.size(), 1.0);
+  auto workspace = matrixgen::Workspace {};
+  auto matrix = Matrix_t {};
+  auto seed = int64_t {42};
+  auto sample = measure_kernel(params, matrices.front().nonZeros(), [&]() {
+    workspace.interleave(matrix, matrices.begin(), matrices.end(),
+        proportions.begin(), proportions.end(), 1, seed++);
+  });
+  sample.nnz = matrix.nonZeros();
+  sample.bytes = storage_bytes(matrix);
+  return sample;
+}
+
+Sample
+bench_perturb(const Params& params) {
+  const auto matrix = baseline(params);
+  auto rows = std::vector<Index_t> {};
+  for(Index_t row = 0; row < matrix.rows(); row += 10) {
+    rows.push_back(row);
+  }
+  return measure_matrix(params, [&]() {
+    return matrixgen::perturb(matrix, rows.begin(), rows.end(), 3);
+  });
+}
+
+Sample
+bench_perturb_rowlengths(const Params& params) {
+  const auto matrix = baseline(params);
+  return measure_matrix(params, [&]() {
+    return matrixgen::perturb_rowlengths(matrix, matrixgen::bimodal_rowlengths(4, 64, 0.05), 3);
+  });
+}
+
+Sample
+bench_central_moving_sum(const Params& params) {
+  const auto size = static_cast<Eigen::Index>(params.grid) * params.grid * params.grid;
+  auto input = std::vector<int64_t>(size);
+  std::iota(input.begin(), input.end(), 0);
+  auto output = std::vector<int64_t>(size);
+  return measure_kernel(params, size, [&]() {
+    matrixgen::central_moving_sum(input.cbegin(), input.cend(), output.begin(), 16);
+  });
+}
+
+Sample
+bench_closed_loop_moving_mean(const Params& params) {
+  const auto size = static_cast<Eigen::Index>(params.grid) * params.grid * params.grid;
+  auto input = std::vector<double>(size);
+  auto generator = std::mt19937_64(11);
+  auto distribution = std::uniform_real_distribution<double>(0.0, 1.0);
+  std::generate(input.begin(), input.end(), [&]() { return distribution(generator); });
+  auto output = std::vector<double>(size);
+  return measure_kernel(params, size, [&]() {
+    matrixgen::closed_loop_moving_mean(input.cbegin(), input.cend(), output.begin(), 0.0, 1.0, 16);
+  });
+}
+
+Sample
+bench_darts_sampling(const Params& params) {
+  const auto size = static_cast<Eigen::Index>(params.grid) * params.grid * params.grid;
+  const auto quotas = std::vector<double>(std::max(params.matrices, 2), 1.0);
+  auto bullets = std::vector<double>(size);
+  auto generator = std::mt19937_64(13);
+  auto distribution = std::uniform_real_distribution<double>(0.0, 1.0);
+  std::generate(bullets.begin(), bullets.end(), [&]() { return distribution(generator); });
+  auto output = std::vector<std::ptrdiff_t>(size);
+  return measure_kernel(params, size, [&]() {
+    matrixgen::darts_sampling(quotas.cbegin(), quotas.cend(),
+        bullets.cbegin(), bullets.cend(), output.begin());
+  });
+}
+
+/* A benchmark and the parameters it is swept over. */
+struct Benchmark {
+  std::string name;
+  Sample (*run)(const Params&);
+  bool sweepBC;
+  bool sweepMatrices;
+  std::string stencil = "7p";
+};
+
+const auto BENCHMARKS = std::vector<Benchmark> {
+  {"adjmat", bench_adjmat, true, false},
+  {"adjmat_csr", bench_adjmat_csr, true, false},
+  {"adjmat_csr_27p", bench_adjmat_csr_27p, true, false, "27p"},
+  {"adjmat_csr_radius", bench_adjmat_csr_radius, true, false, "r3"},
+  {"adjmat_first_touch", bench_adjmat_first_touch, true, false},
+  {"adjmat_multicolor", bench_adjmat_multicolor, true, false},
+  {"spmv", bench_spmv, false, false},
+  {"spmv_first_touch", bench_spmv_first_touch, false, false},
+  {"kron_sum", bench_kron_sum, false, false},
+  {"spmv_kron", bench_spmv_kron, false, false},
+  {"create_coo", bench_create_coo, false, false},
+  {"create_stream", bench_create_stream, false, false},
+  {"assemble", bench_assemble, false, true},
+  {"interleave", bench_interleave, false, true},
+  {"interleave_workspace", bench_interleave_workspace, false, true},
+  {"perturb", bench_perturb, false, false},
+  {"perturb_rowlengths", bench_perturb_rowlengths, false, false},
+  {"multicolor", bench_multicolor, false, false},
+  {"rcm", bench_rcm, false, false},
+  {"central_moving_sum", bench_central_moving_sum, false, false},
+  {"closed_loop_moving_mean", bench_closed_loop_moving_mean, false, false},
+  {"darts_sampling", bench_darts_sampling, false, true},
+};
+
+std::string
+to_json(const Params& params, const Sample& sample, long peakRssKib) {
+  auto out = std::ostringstream {};
+  out << "{\"benchmark\":\"" << params.benchmark << "\""
+      << ",\"grid\":" << params.grid
+      << ",\"stencil\":\"" << params.stencil << "\""
+      << ",\"bc\":\"" << params.bc << "\""
+      << ",\"threads\":" << params.threads
+      << ",\"matrices\":" << params.matrices
+      << ",\"nnz\":" << sample.nnz
+      << ",\"seconds\":" << sample.seconds
+      << ",\"nnz_per_second\":" << static_cast<double>(sample.nnz) / sample.seconds
+      << ",\"bytes_per_nnz\":" << (sample.nnz > 0 ? sample.bytes / static_cast<double>(sample.nnz) : 0.0)
+      << ",\"peak_rss_kib\":" << peakRssKib
+      << "}\n";
+  return out.str();
+}
+
+/* Runs a measurement in a child process and prints its result. */
+void
+run_isolated(const Benchmark& benchmark, const Params& params) {
+
+  std::fflush(stdout);
+  const auto pid = ::fork();
+  if(pid < 0) {
+    std::perror("fork");
+    std::exit(EXIT_FAILURE);
+  }
+  if(pid == 0) {
+    auto control = tbb::global_control(tbb::global_control::max_allowed_parallelism, params.threads);
+    const auto sample = benchmark.run(params);
+    auto usage = rusage {};
+    ::getrusage(RUSAGE_SELF, &usage);
+    const auto line = to_json(params, sample, usage.ru_maxrss);
+    std::fwrite(line.data(), 1, line.size(), stdout);
+    std::fflush(stdout);
+    ::_exit(EXIT_SUCCESS);
+  }
+
+  auto status = 0;
+  ::waitpid(pid, &status, 0);
+  if(!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS) {
+    std::printf("{\"benchmark\":\"%s\",\"grid\":%d,\"bc\":\"%s\",\"threads\":%d,\"matrices\":%d,\"error\":true}\n",
+        params.benchmark.c_str(), params.grid, params.bc.c_str(), params.threads, params.matrices);
+  }
+}
+
+std::vector<int>
+parse_list(const std::string& arg) {
+  auto result = std::vector<int> {};
+  auto stream = std::istringstream(arg);
+  for(std::string item; std::getline(stream, item, ',');) {
+    result.push_back(std::stoi(item));
+  }
+  return result;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+
+  const auto hardwareThreads = static_cast<int>(std::max(1U, std::thread::hardware_concurrency()));
+  auto sizes = std::vector {16, 32, 64};
+  auto threads = std::vector {1, hardwareThreads};
+  auto matrixCounts = std::vector {2, 8};
+  auto repetitions = 3;
+  auto filter = std::string {};
+
+  for(auto ii = 1; ii + 1 < argc; ii += 2) {
+    const auto option = std::string(argv[ii]);
+    const auto value = std::string(argv[ii + 1]);
+    if(option == "--sizes") {
+      sizes = parse_list(value);
+    }
+    else if(option == "--threads") {
+      threads = parse_list(value);
+    }
+    else if(option == "--matrices") {
+      matrixCounts = parse_list(value);
+    }
+    else if(option == "--repetitions") {
+      repetitions = std::stoi(value);
+    }
+    else if(option == "--filter") {
+      filter = value;
+    }
+    else {
+      std::cerr << "Unknown option '" << option << "'\n";
+      return EXIT_FAILURE;
+    }
+  }
+
+  for(const auto& benchmark : BENCHMARKS) {
+    if(benchmark.name.find(filter) == std::string::npos) {
+      continue;
+    }
+    const auto bcs = benchmark.sweepBC ? std::vector<std::string> {"dirichlet", "periodic"}
+                                       : std::vector<std::string> {"dirichlet"};
+    const auto counts = benchmark.sweepMatrices ? matrixCounts : std::vector {1};
+    for(const auto size : sizes) {
+      for(const auto& bc : bcs) {
+        for(const auto count : counts) {
+          for(const auto numThreads : threads) {
+            run_isolated(benchmark, Params {benchmark.name, size, bc, numThreads, count, repetitions, benchmark.stencil});
+          }
+        }
+      }
+    }
+  }
+}
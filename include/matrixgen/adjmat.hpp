@@ -1,14 +1,41 @@
 #pragma once
 
+#include <algorithm>
 #include <array>
 #include <iostream>
+#include <memory_resource>
+#include <optional>
 #include <type_traits>
+#include <utility>
+#include <vector>
 
 #include <Eigen/Sparse>
 
 #include <gsl/gsl-lite.hpp>
 
+#include <tbb/enumerable_thread_specific.h>
+
+#include <matrixgen/execution.hpp>
+#include <matrixgen/memory.hpp>
 #include <matrixgen/presets.hpp>
+#include <matrixgen/stats.hpp>
+#include <matrixgen/target.hpp>
+
+namespace matrixgen
+{
+
+/**
+ * MatrixEntry
+ *
+ * Position (row, column) of a matrix entry as passed to weight functions of
+ * the signature `(MatrixEntry, coords, neighborCoords)`. Weight functions
+ * taking a `std::array<int, 2>` instead are accepted on grids of any rank
+ * but two, where their signature is that of the geometric weight functions
+ * `(coords, neighborCoords, gridDimensions)`.
+ */
+struct MatrixEntry : std::array<int, 2> {};
+
+} // namespace matrixgen
 
 namespace matrixgen::implementation
 {
@@ -19,36 +46,133 @@ using DiscreteCoords2d_t = std::array<Index_t, 2>;
 template <typename Index_t = int>
 using Coords3d_t = std::array<Index_t, 3>;
 
+/**
+ * Rank, index type and extents of a grid given either by its dimensions,
+ * `Coords_t<Index_t, RANK>`, or by `StaticExtents`.
+ */
+template <typename Grid_t>
+struct GridTraits;
+
+template <
+  typename GridIndex_t,
+  std::size_t GRID_RANK
+    >
+struct GridTraits<Coords_t<GridIndex_t, GRID_RANK>>
+{
+  using Index_t = GridIndex_t;
+  static constexpr std::size_t RANK = GRID_RANK;
+
+  static
+  const Coords_t<Index_t, RANK>&
+  dimensions(const Coords_t<Index_t, RANK>& grid) { return grid; }
+};
+
+} // namespace matrixgen::implementation
+
+namespace matrixgen
+{
+
+/**
+ * matrixgen::StaticExtents
+ *
+ * Extents of a grid known at compile time, e.g. `StaticExtents<256, 256> {}`
+ * for a 2D grid of 256 x 256 nodes. Passed to `adjmat` in place of the
+ * grid's dimensions, the generator's index arithmetic folds to constants,
+ * i.e. to shifts for powers of two. Adjacency and weight functions receive
+ * `DIMENSIONS` as the grid's dimensions.
+ */
+template <auto... EXTENTS>
+struct StaticExtents
+{
+  using Index_t = std::common_type_t<decltype(EXTENTS)...>;
+  static constexpr std::size_t RANK = sizeof...(EXTENTS);
+  static constexpr Coords_t<Index_t, RANK> DIMENSIONS {{static_cast<Index_t>(EXTENTS)...}};
+
+  static_assert(RANK > 0, "Grids have at least one dimension.");
+  static_assert(((EXTENTS > 0) && ...), "Extents must be positive.");
+};
+
+} // namespace matrixgen
+
+namespace matrixgen::implementation
+{
+
+template <auto... EXTENTS>
+struct GridTraits<StaticExtents<EXTENTS...>>
+{
+  using Extents_t = StaticExtents<EXTENTS...>;
+  using Index_t = typename Extents_t::Index_t;
+  static constexpr std::size_t RANK = Extents_t::RANK;
+
+  static constexpr
+  const Coords_t<Index_t, RANK>&
+  dimensions(const Extents_t&) { return Extents_t::DIMENSIONS; }
+};
+
+/* The dimensions of `grid`, see `GridTraits`. */
+template <typename Grid_t>
+decltype(auto)
+grid_dimensions(const Grid_t& grid) {
+  return GridTraits<Grid_t>::dimensions(grid);
+}
+
+/* The number of nodes of a grid of dimensions `gridDimensions`. */
+template <typename Index_t, std::size_t RANK>
+Eigen::Index
+num_of_nodes(const Coords_t<Index_t, RANK>& gridDimensions) {
+  auto result = Eigen::Index {1};
+  for(auto dim = std::size_t {0}; dim < RANK; ++dim) {
+    result *= gridDimensions[dim];
+  }
+  return result;
+}
+
 /**
  * Return a node's index within its grid. Indexing is always performed in
  * x-then-y-then-z direction. Indices start at 0.
  *
  * Used as a helper within `get_matrix_entry_coordinates`.
  */
-template <typename Index_t = int>
+template <typename Index_t = int, std::size_t RANK = 3>
 Index_t
 get_node_index(
-  const Coords3d_t<Index_t>& nodeCoords,
-  const Coords3d_t<Index_t>& gridDimensions) {
-
-  Expects ( nodeCoords[0] >= 0                );
-  Expects ( nodeCoords[1] >= 0                );
-  Expects ( nodeCoords[2] >= 0                );
-  Expects ( nodeCoords[0] < gridDimensions[0] );
-  Expects ( nodeCoords[1] < gridDimensions[1] );
-  Expects ( nodeCoords[2] < gridDimensions[2] );
+  const Coords_t<Index_t, RANK>& nodeCoords,
+  const Coords_t<Index_t, RANK>& gridDimensions) {
 
-  // TODO: Reduce multiplications by factorization
-  const auto index = nodeCoords[0] +
-                     nodeCoords[1] * gridDimensions[0] +
-                     nodeCoords[2] * gridDimensions[0] * gridDimensions[1];
+  // Horner's scheme, starting at the slowest dimension.
+  auto index = Index_t {0};
+  for(auto dim = RANK; dim-- > 0;) {
+    Expects ( nodeCoords[dim] >= 0                  );
+    Expects ( nodeCoords[dim] < gridDimensions[dim] );
+    index = index * gridDimensions[dim] + nodeCoords[dim];
+  }
 
   Ensures ( index >= 0 );
-  Ensures ( index < gridDimensions[0] * gridDimensions[1] * gridDimensions[2] );
 
   return index;
 }
 
+/**
+ * Inverse of `get_node_index`. Returns the coordinates of the node with
+ * index `index` within its grid.
+ */
+template <typename Index_t = int, std::size_t RANK = 3>
+Coords_t<Index_t, RANK>
+get_node_coords(
+  Eigen::Index index,
+  const Coords_t<Index_t, RANK>& gridDimensions) {
+
+  Expects ( index >= 0 );
+
+  auto coords = Coords_t<Index_t, RANK> {};
+  for(auto dim = std::size_t {0}; dim + 1 < RANK; ++dim) {
+    coords[dim] = static_cast<Index_t>(index % gridDimensions[dim]);
+    index /= gridDimensions[dim];
+  }
+  coords[RANK - 1] = static_cast<Index_t>(index);
+  return coords;
+}
+
 /**
  * Given a node at `coords` and its neighbor at `neighborCoords` return the
  * corresponding adjacency matrix's non-zero's position as (row, column).
@@ -57,25 +181,12 @@ get_node_index(
  * connection between a node with index `n` and its neighbor with index `m`
  * will produce a non-zero matrix entry at (n, m).
  */
-template <typename Index_t = int>
+template <typename Index_t = int, std::size_t RANK = 3>
 std::array<Index_t, 2>
 get_matrix_entry_coordinates(
-  const Coords3d_t<Index_t>& coords,
-  const Coords3d_t<Index_t>& neighborCoords,
-  const Coords3d_t<Index_t>& gridDimensions) {
-
-  Expects ( coords[0] >= 0                        );
-  Expects ( coords[1] >= 0                        );
-  Expects ( coords[2] >= 0                        );
-  Expects ( coords[0] < gridDimensions[0]         );
-  Expects ( coords[1] < gridDimensions[1]         );
-  Expects ( coords[2] < gridDimensions[2]         );
-  Expects ( neighborCoords[0] >= 0                );
-  Expects ( neighborCoords[1] >= 0                );
-  Expects ( neighborCoords[2] >= 0                );
-  Expects ( neighborCoords[0] < gridDimensions[0] );
-  Expects ( neighborCoords[1] < gridDimensions[1] );
-  Expects ( neighborCoords[2] < gridDimensions[2] );
+  const Coords_t<Index_t, RANK>& coords,
+  const Coords_t<Index_t, RANK>& neighborCoords,
+  const Coords_t<Index_t, RANK>& gridDimensions) {
 
   const Index_t ii = get_node_index(coords, gridDimensions);
   const Index_t jj = get_node_index(neighborCoords, gridDimensions);
@@ -83,6 +194,220 @@ get_matrix_entry_coordinates(
   return {{ii, jj}};
 }
 
+/**
+ * Dispatch the correct adjacency function's implementation depending on its
+ * signature and return the node's range of offsets.
+ */
+template <
+  typename OffsetRange_t,
+  typename AdjFn_t,
+  typename Index_t,
+  std::size_t RANK
+    >
+OffsetRange_t
+evaluate_adjfn(
+    AdjFn_t& adjfn,
+    const Coords_t<Index_t, RANK>& coords,
+    const Coords_t<Index_t, RANK>& gridDimensions) {
+
+  if constexpr (std::is_invocable_r<OffsetRange_t, AdjFn_t, Coords_t<Index_t, RANK>>()) {
+    return adjfn(coords);
+  }
+  else if constexpr (std::is_invocable_r<OffsetRange_t, AdjFn_t, Coords_t<Index_t, RANK>, Coords_t<Index_t, RANK>>()) {
+    return adjfn(coords, gridDimensions);
+  }
+  else {
+    static_assert(!std::is_same<Index_t, Index_t>(),
+        "Adjacency function has invalid signature");
+  }
+}
+
+/**
+ * True if the weight function takes the position of the matrix entry and
+ * the coordinates of the node and its neighbor. On 2D grids a weight
+ * function accepting three coordinates is geometric, see `MatrixEntry`.
+ */
+template <
+  typename WeightFn_t,
+  typename Index_t,
+  std::size_t RANK
+    >
+constexpr bool IS_ENTRY_WEIGHTFN =
+  std::is_invocable<WeightFn_t, MatrixEntry, Coords_t<Index_t, RANK>, Coords_t<Index_t, RANK>>() &&
+  (RANK != 2 || !std::is_invocable<WeightFn_t, Coords_t<Index_t, RANK>, Coords_t<Index_t, RANK>, Coords_t<Index_t, RANK>>());
+
+/**
+ * Select the correct implementation depending on the weight-function's
+ * signature and return the value of the matrix entry (ii, jj) connecting the
+ * node at `coords` with its neighbor at `neighborCoords`.
+ */
+template <
+  typename Scalar_t,
+  typename WeightFn_t,
+  typename Index_t,
+  std::size_t RANK
+    >
+Scalar_t
+evaluate_weightfn(
+    WeightFn_t& weightfn,
+    Index_t ii,
+    Index_t jj,
+    const Coords_t<Index_t, RANK>& coords,
+    const Coords_t<Index_t, RANK>& neighborCoords,
+    const Coords_t<Index_t, RANK>& gridDimensions) {
+
+  // A. WeightFn takes no arguments (e.g. constant weights)
+  if constexpr (std::is_invocable_r<Scalar_t, WeightFn_t>()) {
+    return static_cast<Scalar_t>(weightfn());
+  }
+  // B. WeighFn computes values from the matrix element's positions
+  //    (row, column).
+  else if constexpr (std::is_invocable_r<Scalar_t, WeightFn_t, std::array<int, 2>>()) {
+    return static_cast<Scalar_t>(weightfn({{ii, jj}}));
+  }
+  // C. WeightFn computes values from the geometric position of the
+  //    and its neighbor node.
+  else if constexpr (std::is_invocable_r<
+                      Scalar_t,
+                      WeightFn_t,
+                      Coords_t<Index_t, RANK>,
+                      Coords_t<Index_t, RANK>
+                     >()) {
+    return static_cast<Scalar_t>(weightfn(coords, neighborCoords));
+  }
+  // D. WeightFn computes values from the matrix element's position
+  //    and geometric positions of the node and its neighbor.
+  else if constexpr (IS_ENTRY_WEIGHTFN<WeightFn_t, Index_t, RANK>) {
+    return static_cast<Scalar_t>(weightfn(
+        MatrixEntry {{static_cast<int>(ii), static_cast<int>(jj)}}, coords, neighborCoords));
+  }
+  // Same as (C) with an additional parameter for the grid's dimensions.
+  // Used for generic weightfns such as the sinusoids. On 2D grids (D) must
+  // take a `MatrixEntry` to be told apart from this signature.
+  else if constexpr (std::is_invocable_r<
+                      Scalar_t,
+                      WeightFn_t,
+                      Coords_t<Index_t, RANK>,
+                      Coords_t<Index_t, RANK>,
+                      Coords_t<Index_t, RANK>
+                       >()) {
+    return static_cast<Scalar_t>(weightfn(coords, neighborCoords, gridDimensions));
+  }
+  // E. WeightFn had too much to drink again.
+  else {
+    static_assert(
+      // TODO: Is there a non-hacky solution to this? Something like
+      //       std::abort_compilation("Error: ... ");
+      !std::is_same<Scalar_t, Scalar_t>(),
+      "Function computing the weights has incompatible signature.");
+  }
+}
+
+/**
+ * Row-wise generation of an adjacency matrix. Computes the nonzeros of the
+ * row belonging to a single node, sorted by column with duplicate entries
+ * summed up, just as `setFromTriplets` would. Used to write adjacency
+ * matrices directly into compressed row storage.
+ */
+template <
+  typename Scalar_t,
+  typename AdjFn_t,
+  typename WeightFn_t,
+  typename Index_t,
+  typename OffsetRange_t
+    >
+struct AdjmatRows
+{
+  /**
+   * Returns the number of distinct columns in row `row` of the grid `grid`,
+   * see `GridTraits`. `columns` is scratch space.
+   */
+  template <typename Grid_t>
+  static
+  Index_t
+  count(
+      Eigen::Index row,
+      const Grid_t& grid,
+      AdjFn_t& adjfn,
+      std::vector<Index_t>& columns) {
+
+    const auto& gridDimensions = grid_dimensions(grid);
+    const auto myCoords = get_node_coords(row, gridDimensions);
+    const auto offsetRange = evaluate_adjfn<OffsetRange_t>(adjfn, myCoords, gridDimensions);
+    columns.clear();
+    for(auto offsetIt = offsetRange.first; offsetIt != offsetRange.second; ++offsetIt){
+      columns.push_back(get_node_index(myCoords + *offsetIt, gridDimensions));
+    }
+    std::sort(columns.begin(), columns.end());
+    return static_cast<Index_t>(std::distance(columns.begin(), std::unique(columns.begin(), columns.end())));
+  }
+
+  /**
+   * Writes the `count` nonzeros of row `row`. The weight function is called
+   * once per offset in the adjacency function's order. `entries` is scratch
+   * space.
+   */
+  template <
+    typename OutIndex_t,
+    typename Grid_t
+      >
+  static
+  void
+  fill(
+      Eigen::Index row,
+      OutIndex_t* innerFirst,
+      Scalar_t* valueFirst,
+      Index_t count,
+      const Grid_t& grid,
+      AdjFn_t& adjfn,
+      WeightFn_t& weightfn,
+      std::vector<std::pair<Index_t, Scalar_t>>& entries) {
+
+    const auto& gridDimensions = grid_dimensions(grid);
+    const auto myCoords = get_node_coords(row, gridDimensions);
+    const auto ii = static_cast<Index_t>(row);
+    const auto offsetRange = evaluate_adjfn<OffsetRange_t>(adjfn, myCoords, gridDimensions);
+    entries.clear();
+    for(auto offsetIt = offsetRange.first; offsetIt != offsetRange.second; ++offsetIt){
+      const auto neighborCoords = myCoords + *offsetIt;
+      const auto jj = get_node_index(neighborCoords, gridDimensions);
+      entries.emplace_back(jj, evaluate_weightfn<Scalar_t>(weightfn, ii, jj, myCoords, neighborCoords, gridDimensions));
+    }
+    write_merged(entries, innerFirst, valueFirst, count);
+  }
+
+  /**
+   * Writes the `count` distinct columns of `entries` in ascending order,
+   * summing the values of equal columns in their order in `entries`.
+   */
+  template <typename OutIndex_t>
+  static
+  void
+  write_merged(
+      std::vector<std::pair<Index_t, Scalar_t>>& entries,
+      OutIndex_t* innerFirst,
+      Scalar_t* valueFirst,
+      Index_t count) {
+
+    std::stable_sort(entries.begin(), entries.end(),
+        [](const auto& a, const auto& b) { return a.first < b.first; });
+
+    auto out = Index_t {-1};
+    for(const auto& [jj, value] : entries) {
+      if(out >= 0 && innerFirst[out] == static_cast<OutIndex_t>(jj)) {
+        valueFirst[out] += value;
+      }
+      else {
+        ++out;
+        innerFirst[out] = static_cast<OutIndex_t>(jj);
+        valueFirst[out] = value;
+      }
+    }
+
+    Ensures( out + 1 == count );
+  }
+};
+
 template <
   typename OutMatrix_t,
   typename AdjFn_t,
@@ -127,17 +452,24 @@ struct Adjmat<
    * Returns an Eigen::SparseMatrix whose template parameters may be freely
    * chosen according to the signature of this function template.
    */
+  template <
+    typename Grid_t,
+    typename Stats_t
+      >
   static
   Matrix_t
   invoke(
-    const Coords3d_t<Index_t> gridDimensions,
+    const Grid_t& grid,
     AdjFn_t adjfn,
-    WeightFn_t weightfn) {
+    WeightFn_t weightfn,
+    Stats_t& stats,
+    std::pmr::memory_resource* resource) {
+
+    constexpr auto RANK = GridTraits<Grid_t>::RANK;
+    const auto& gridDimensions = grid_dimensions(grid);
 
     // The adjacency matrix is a square matrix. Store its height.
-    const auto matrixHeight = gridDimensions[0] *
-                              gridDimensions[1] *
-                              gridDimensions[2];
+    const auto matrixHeight = static_cast<Index_t>(num_of_nodes(gridDimensions));
 
     /*
      * Insert elements according to the adjfn. Traverse the grid in
@@ -146,7 +478,7 @@ struct Adjmat<
      * We use initialization via Triplets as described here:
      * http://eigen.tuxfamily.org/dox/group__TutorialSparse.html#TutorialSparseFilling
      */
-    auto triplets = std::vector<Eigen::Triplet<Scalar_t>> {};
+    auto triplets = std::pmr::vector<Eigen::Triplet<Scalar_t>>(resource);
     // TODO: As the adj. pattern is now dynamically computed for each node there's
     //       no such thing as a static size of the stencil for me to assume here.
     //       Hence I removed the call to `triplets.reserve()` and use dynamic
@@ -156,100 +488,48 @@ struct Adjmat<
     // const auto upperLimToCountOfNnz = matrixHeight * std::size(adjfn);
     // triplets.reserve(upperLimToCountOfNnz);
 
-    for(auto zz = 0; zz < gridDimensions[2]; ++zz){
-      for(auto yy = 0; yy < gridDimensions[1]; ++yy){
-        for(auto xx = 0; xx < gridDimensions[0]; ++xx){
-
-          /**
-           * For each neighboring node, if it's inside the grid compute the entry's
-           * coordinates (i,j) and store it away as triplet.
-           */
-          // Dispatch the correct adjacency function's implementation
-          const auto myCoords = Coords3d_t<Index_t> {xx, yy, zz};
-          auto offsetRange = OffsetRange_t {};
-          if constexpr (std::is_invocable_r<OffsetRange_t, AdjFn_t, Coords3d_t<Index_t>>()) {
-            offsetRange = adjfn(myCoords);
-          }
-          else if constexpr (std::is_invocable_r<OffsetRange_t, AdjFn_t, Coords3d_t<Index_t>, Coords3d_t<Index_t>>()) {
-            offsetRange = adjfn(myCoords, gridDimensions);
-          }
-          else {
-            static_assert(!std::is_same<Scalar_t, Scalar_t>(),
-                "Adjacency function has invalid signature");
-          }
-          for(auto offsetIt = offsetRange.first; offsetIt != offsetRange.second; ++offsetIt){
-
-            const auto neighborCoords = Coords3d_t<Index_t> {
-              myCoords[0] + (*offsetIt)[0],
-              myCoords[1] + (*offsetIt)[1],
-              myCoords[2] + (*offsetIt)[2]
-            };
-
-            const auto [ii, jj] = implementation::get_matrix_entry_coordinates(
-              myCoords,
-              neighborCoords,
-              gridDimensions
-            );
-
-            /**
-             * Select the correct implementation depending on the
-             * weight-function's signature.
-             */
-            Scalar_t value;
-
-            // A. WeightFn takes no arguments (e.g. constant weights)
-            if constexpr (std::is_invocable_r<Scalar_t, WeightFn_t>()) {
-              value = static_cast<Scalar_t>(weightfn());
-            }
-            // B. WeighFn computes values from the matrix element's positions
-            //    (row, column).
-            else if constexpr (std::is_invocable_r<Scalar_t, WeightFn_t, std::array<int, 2>>()) {
-              value = static_cast<Scalar_t>(weightfn({{ii, jj}}));
-            }
-            // C. WeightFn computes values from the geometric position of the
-            //    and its neighbor node.
-            else if constexpr (std::is_invocable_r<
-                                Scalar_t,
-                                WeightFn_t,
-                                Coords3d_t<int>,
-                                Coords3d_t<int>
-                               >()) {
-              value = static_cast<Scalar_t>(weightfn(myCoords, neighborCoords));
-            }
-            // D. WeightFn computes values from the matrix element's position
-            //    and geometric positions of the node and its neighbor.
-            else if constexpr (std::is_invocable_r<
-                                Scalar_t,
-                                WeightFn_t,
-                                DiscreteCoords2d_t<int>,
-                                Coords3d_t<int>,
-                                Coords3d_t<int>
-                                 >()) {
-              value = static_cast<Scalar_t>(weightfn({{ii, jj}}, myCoords, neighborCoords));
-            }
-            // Same as (C) with an additional parameter for the grid's dimensions.
-            // Used for generic weightfns such as the sinusoids.
-            else if constexpr (std::is_invocable_r<
-                                Scalar_t,
-                                WeightFn_t,
-                                Coords3d_t<int32_t>,
-                                Coords3d_t<int32_t>,
-                                Coords3d_t<int32_t>
-                                 >()) {
-              value = static_cast<Scalar_t>(weightfn(myCoords, neighborCoords, gridDimensions));
-            }
-            // E. WeightFn had too much to drink again.
-            else {
-              static_assert(
-                // TODO: Is there a non-hacky solution to this? Something like
-                //       std::abort_compilation("Error: ... ");
-                !std::is_same<Scalar_t, Scalar_t>(),
-                "Function computing the weights has incompatible signature.");
-            }
-            triplets.push_back(Eigen::Triplet<Scalar_t>{ii, jj, value});
+    auto tripletsPhase = std::optional<ScopedPhase<Stats_t>>(std::in_place, stats, "adjmat.triplets");
+    auto myCoords = Coords_t<Index_t, RANK> {};
+    for(auto node = Index_t {0}; node < matrixHeight; ++node) {
+
+      /**
+       * For each neighboring node, if it's inside the grid compute the entry's
+       * coordinates (i,j) and store it away as triplet.
+       */
+      const auto offsetRange = evaluate_adjfn<OffsetRange_t>(adjfn, myCoords, gridDimensions);
+      for(auto offsetIt = offsetRange.first; offsetIt != offsetRange.second; ++offsetIt){
+
+        auto neighborCoords = Coords_t<Index_t, RANK> {};
+        for(auto dim = std::size_t {0}; dim < RANK; ++dim) {
+          neighborCoords[dim] = myCoords[dim] + (*offsetIt)[dim];
+        }
+
+        const auto [ii, jj] = implementation::get_matrix_entry_coordinates(
+          myCoords,
+          neighborCoords,
+          gridDimensions
+        );
+
+        const auto value = evaluate_weightfn<Scalar_t>(
+            weightfn, ii, jj, myCoords, neighborCoords, gridDimensions);
+        if constexpr (STATS_ENABLED<Stats_t>) {
+          if(triplets.size() == triplets.capacity()) {
+            stats.add_allocation(std::max<std::size_t>(1, 2 * triplets.capacity()) * sizeof(Eigen::Triplet<Scalar_t>));
           }
         }
+        triplets.push_back(Eigen::Triplet<Scalar_t>{ii, jj, value});
       }
+
+      // Advance to the next node in x-then-y-then-z order.
+      for(auto dim = std::size_t {0}; dim < RANK && ++myCoords[dim] == gridDimensions[dim]; ++dim) {
+        myCoords[dim] = 0;
+      }
+    }
+    tripletsPhase.reset();
+    if constexpr (STATS_ENABLED<Stats_t>) {
+      stats.add_adjfn_calls(matrixHeight);
+      stats.add_weightfn_calls(triplets.size());
+      stats.add_work(matrixHeight);
     }
 
     /**
@@ -260,37 +540,294 @@ struct Adjmat<
      * offsets (e.g. Neumann which mirrors any offset outside the grid ad the 
      * grid boundary). All is well.
      */
+    [[maybe_unused]] const auto phase = ScopedPhase(stats, "adjmat.setFromTriplets");
     auto result = Eigen::SparseMatrix<Scalar_t, ALIGNMENT, Index_t>(matrixHeight, matrixHeight);
     // TODO: What about makeCompressed()? Is it required when we construct via triplets?
     result.setFromTriplets(triplets.begin(), triplets.end());
+    if constexpr (STATS_ENABLED<Stats_t>) {
+      stats.add_duplicates_merged(triplets.size() - result.nonZeros());
+      stats.add_allocation((matrixHeight + 1) * sizeof(Index_t) +
+                           result.nonZeros() * (sizeof(Index_t) + sizeof(Scalar_t)));
+    }
+    return result;
+  }
+};
+
+/**
+ * The adjacency function's offset range type, determined lazily for either
+ * of the two supported signatures. See the comment in the `adjmat`
+ * dispatcher.
+ */
+template <
+  typename AdjFn_t,
+  typename Index_t,
+  std::size_t RANK = 3,
+  typename = void
+    >
+struct OffsetRangeOf {
+  using type = typename std::invoke_result<AdjFn_t, Coords_t<Index_t, RANK>>::type;
+};
+
+template <
+  typename AdjFn_t,
+  typename Index_t,
+  std::size_t RANK
+    >
+struct OffsetRangeOf<
+  AdjFn_t,
+  Index_t,
+  RANK,
+  std::enable_if_t<std::is_invocable<AdjFn_t, Coords_t<Index_t, RANK>, Coords_t<Index_t, RANK>>::value>
+    > {
+  using type = typename std::invoke_result<AdjFn_t, Coords_t<Index_t, RANK>, Coords_t<Index_t, RANK>>::type;
+};
+
+/**
+ * True if the weight function can be called through a const reference, i.e.
+ * it is not a mutable lambda (e.g. `randweight`) whose results depend on the
+ * order of calls. Such weight functions may be evaluated concurrently.
+ */
+template <
+  typename WeightFn_t,
+  typename Index_t,
+  std::size_t RANK = 3
+    >
+constexpr bool IS_CONST_WEIGHTFN =
+  std::is_invocable<const WeightFn_t&>() ||
+  std::is_invocable<const WeightFn_t&, std::array<int, 2>>() ||
+  std::is_invocable<const WeightFn_t&, Coords_t<Index_t, RANK>, Coords_t<Index_t, RANK>>() ||
+  std::is_invocable<const WeightFn_t&, MatrixEntry, Coords_t<Index_t, RANK>, Coords_t<Index_t, RANK>>() ||
+  std::is_invocable<const WeightFn_t&, Coords_t<Index_t, RANK>, Coords_t<Index_t, RANK>, Coords_t<Index_t, RANK>>();
+
+/**
+ * Per-thread state of the row-wise generation of adjacency matrices: copies
+ * of the functors, scratch space and counts of the functors' calls.
+ */
+template <
+  typename Scalar_t,
+  typename AdjFn_t,
+  typename WeightFn_t,
+  typename Index_t
+    >
+struct AdjmatLocal
+{
+  AdjFn_t adjfn;
+  WeightFn_t weightfn;
+  std::vector<Index_t> columns;
+  std::vector<std::pair<Index_t, Scalar_t>> entries;
+  uint64_t adjfnCalls = 0;
+  uint64_t weightfnCalls = 0;
+  uint64_t duplicatesMerged = 0;
+};
+
+/**
+ * Adds the counts of the functors' calls and merged duplicates of the
+ * per-thread states `locals`, see `AdjmatLocal`, to `stats`.
+ */
+template <
+  typename Locals_t,
+  typename Stats_t
+    >
+void
+report_adjmat_calls(const Locals_t& locals, Stats_t& stats) {
+
+  if constexpr (STATS_ENABLED<Stats_t>) {
+    for(const auto& local : locals) {
+      stats.add_adjfn_calls(local.adjfnCalls);
+      stats.add_weightfn_calls(local.weightfnCalls);
+      stats.add_duplicates_merged(local.duplicatesMerged);
+    }
+  }
+}
+
+/**
+ * Generator of the rows of the adjacency matrix of the grid `grid`, see
+ * `GridTraits`, for the two-pass constructions of `fill_compressed`,
+ * `write_csr` and the like: `count(row)` returns the number of nonzeros of
+ * a row and `fill(row, innerFirst, valueFirst, count)` writes them, using
+ * the calling thread's `AdjmatLocal`.
+ *
+ * Rows may be filled concurrently if `PARALLEL_FILL`. Otherwise the weight
+ * function is a mutable lambda (e.g. `randweight`) and is evaluated on a
+ * single instance, so rows must be filled in order to reproduce `adjmat`'s
+ * values.
+ */
+template <
+  typename Scalar_t,
+  typename AdjFn_t,
+  typename WeightFn_t,
+  typename Grid_t
+    >
+class AdjmatRowGenerator
+{
+public:
+  using Index_t = typename GridTraits<Grid_t>::Index_t;
+  static constexpr auto RANK = GridTraits<Grid_t>::RANK;
+  using OffsetRange_t = typename OffsetRangeOf<AdjFn_t, Index_t, RANK>::type;
+  using Rows_t = AdjmatRows<Scalar_t, AdjFn_t, WeightFn_t, Index_t, OffsetRange_t>;
+  using Local_t = AdjmatLocal<Scalar_t, AdjFn_t, WeightFn_t, Index_t>;
+
+  static constexpr bool PARALLEL_FILL = IS_CONST_WEIGHTFN<WeightFn_t, Index_t, RANK>;
+
+  AdjmatRowGenerator(const Grid_t& grid, const AdjFn_t& adjfn, const WeightFn_t& weightfn)
+    : grid_(grid), weightfn_(weightfn), locals_(Local_t {adjfn, weightfn, {}, {}}) {}
+
+  const Grid_t& grid() const { return grid_; }
+
+  /* The calling thread's copies of the functors and scratch space. */
+  Local_t& local() { return locals_.local(); }
+
+  Index_t
+  count(Eigen::Index row) {
+
+    auto& local = locals_.local();
+    ++local.adjfnCalls;
+    return Rows_t::count(row, grid_, local.adjfn, local.columns);
+  }
+
+  template <
+    typename OutIndex_t,
+    typename Count_t
+      >
+  void
+  fill(Eigen::Index row, OutIndex_t* innerFirst, Scalar_t* valueFirst, Count_t count) {
+
+    auto& local = locals_.local();
+    auto& weightfn = PARALLEL_FILL ? local.weightfn : weightfn_;
+    Rows_t::fill(row, innerFirst, valueFirst, static_cast<Index_t>(count),
+                 grid_, local.adjfn, weightfn, local.entries);
+    ++local.adjfnCalls;
+    local.weightfnCalls += local.entries.size();
+    local.duplicatesMerged += local.entries.size() - static_cast<std::size_t>(count);
+  }
+
+  /* Adds the counts of the functors' calls and merged duplicates to `stats`. */
+  template <typename Stats_t>
+  void
+  report(Stats_t& stats) const { report_adjmat_calls(locals_, stats); }
+
+private:
+  Grid_t grid_;
+  WeightFn_t weightfn_; // the single instance of mutable weight functions
+  tbb::enumerable_thread_specific<Local_t> locals_;
+};
+
+/**
+ * Implementation of `adjmat` for caller-provided CSR arrays.
+ */
+template <
+  typename Scalar_t,
+  typename TargetIndex_t,
+  typename AdjFn_t,
+  typename WeightFn_t,
+  typename Grid_t
+    >
+struct AdjmatCsr
+{
+  template <typename Stats_t>
+  static
+  CsrCapacity
+  invoke(
+      const CsrTarget<Scalar_t, TargetIndex_t>& target,
+      const Grid_t& grid,
+      AdjFn_t adjfn,
+      WeightFn_t weightfn,
+      Stats_t& stats) {
+
+    using Generator_t = AdjmatRowGenerator<Scalar_t, AdjFn_t, WeightFn_t, Grid_t>;
+
+    const auto matrixHeight = num_of_nodes(grid_dimensions(grid));
+    auto generator = Generator_t(grid, adjfn, weightfn);
+    const auto capacity = write_csr(target, matrixHeight,
+        [&](Eigen::Index row) { return generator.count(row); },
+        [&](Eigen::Index row, TargetIndex_t* innerFirst, Scalar_t* valueFirst, TargetIndex_t count) {
+          generator.fill(row, innerFirst, valueFirst, count);
+        },
+        Generator_t::PARALLEL_FILL,
+        stats);
+    generator.report(stats);
+    return capacity;
+  }
+};
+
+/**
+ * Implementation of `adjmat_with_pattern`. The rows' sizes are read off the
+ * pattern, so only the fill pass of `fill_compressed` does any work.
+ */
+template <
+  typename Scalar_t,
+  int ALIGNMENT,
+  typename StorageIndex_t,
+  typename AdjFn_t,
+  typename WeightFn_t,
+  typename Grid_t
+    >
+struct AdjmatWithPattern
+{
+  using Matrix_t = Eigen::SparseMatrix<Scalar_t, ALIGNMENT, StorageIndex_t>;
+  using Generator_t = AdjmatRowGenerator<Scalar_t, AdjFn_t, WeightFn_t, Grid_t>;
+
+  template <typename Stats_t>
+  static
+  Matrix_t
+  invoke(
+      const Matrix_t& pattern,
+      const Grid_t& grid,
+      AdjFn_t adjfn,
+      WeightFn_t weightfn,
+      Stats_t& stats) {
+
+    static_assert(ALIGNMENT == Eigen::RowMajor, "Patterns require row-major matrices.");
+    static_assert(Generator_t::PARALLEL_FILL,
+        "Patterns require weight functions without mutable state.");
+
+    const auto matrixHeight = num_of_nodes(grid_dimensions(grid));
+
+    Expects( pattern.isCompressed() );
+    Expects( pattern.rows() == matrixHeight && pattern.cols() == matrixHeight );
+
+    const StorageIndex_t* outerIndex = pattern.outerIndexPtr();
+    auto generator = Generator_t(grid, adjfn, weightfn);
+    auto result = Matrix_t {};
+    fill_compressed(result, matrixHeight, matrixHeight,
+        [outerIndex](Eigen::Index row) { return outerIndex[row + 1] - outerIndex[row]; },
+        [&](Eigen::Index row, StorageIndex_t* innerFirst, Scalar_t* valueFirst, StorageIndex_t count) {
+          generator.fill(row, innerFirst, valueFirst, count);
+        },
+        stats);
+    generator.report(stats);
     return result;
   }
 };
 
 } // namespace matrixgen::implementation
 
-namespace matrixgen
+namespace matrixgen::implementation
 {
 
 /**
  * Dispatcher for `adjmat` (workaround for a function template partial
- * specialization). See above implementation for details.
+ * specialization) on the grid `grid`, see `GridTraits`.
  */
 template <
-  typename OutMatrix_t = Eigen::SparseMatrix<double, Eigen::RowMajor>,
-  typename AdjFn_t = void,
-  typename WeightFn_t = void,
-  typename Index_t = int
+  typename OutMatrix_t,
+  typename Grid_t,
+  typename AdjFn_t,
+  typename WeightFn_t,
+  typename Stats_t
     >
 OutMatrix_t
-adjmat(
-    const implementation::Coords3d_t<Index_t>& gridDimensions,
-    AdjFn_t adjfn,
-    WeightFn_t weightfn) {
+dispatch_adjmat(
+    const Grid_t& grid,
+    AdjFn_t& adjfn,
+    WeightFn_t& weightfn,
+    Stats_t& stats,
+    std::pmr::memory_resource* resource) {
 
-  if constexpr (std::is_invocable<AdjFn_t,
-      implementation::Coords3d_t<Index_t>,
-      implementation::Coords3d_t<Index_t>>()) {
+  using Index_t = typename GridTraits<Grid_t>::Index_t;
+  using GridCoords_t = Coords_t<Index_t, GridTraits<Grid_t>::RANK>;
+
+  if constexpr (std::is_invocable<AdjFn_t, GridCoords_t, GridCoords_t>()) {
 
       // I have to pass the adjacency function's return type as a template type
       // parameter to the specialization to avoid code duplication when
@@ -307,29 +844,310 @@ adjmat(
       // substituted. Otherwise the expression might be used right inside
       // the specialization to determine the return type where it's actually
       // needed. Damn you TMP.
-      using OffsetRange_t = typename std::invoke_result<
-                                      AdjFn_t,
-                                      implementation::Coords3d_t<Index_t>,
-                                      implementation::Coords3d_t<Index_t>
-                                        >::type;
-      return implementation::Adjmat<OutMatrix_t, AdjFn_t, WeightFn_t, Index_t, OffsetRange_t>::
-              invoke(gridDimensions, adjfn, weightfn);
-  } else if constexpr (std::is_invocable<
-                        AdjFn_t,
-                        implementation::Coords3d_t<Index_t>
-                          >()) {
-      using OffsetRange_t = typename std::invoke_result<
-                              AdjFn_t,
-                              implementation::Coords3d_t<Index_t>
-                                >::type;
-      return implementation::Adjmat<OutMatrix_t, AdjFn_t, WeightFn_t, Index_t, OffsetRange_t>::
-              invoke(gridDimensions, adjfn, weightfn);
+      using OffsetRange_t = typename std::invoke_result<AdjFn_t, GridCoords_t, GridCoords_t>::type;
+      return Adjmat<OutMatrix_t, AdjFn_t, WeightFn_t, Index_t, OffsetRange_t>::
+              invoke(grid, adjfn, weightfn, stats, resource);
+  } else if constexpr (std::is_invocable<AdjFn_t, GridCoords_t>()) {
+      using OffsetRange_t = typename std::invoke_result<AdjFn_t, GridCoords_t>::type;
+      return Adjmat<OutMatrix_t, AdjFn_t, WeightFn_t, Index_t, OffsetRange_t>::
+              invoke(grid, adjfn, weightfn, stats, resource);
   } else {
       static_assert(!std::is_same<Index_t, Index_t>(),
           "Invalid adjacency function");
   }
 }
 
+/**
+ * Compressed adjacency matrix built by the parallel two-pass construction of
+ * `fill_compressed`; column-major matrices are converted from the row-major
+ * one. Weight functions which are mutable lambdas (e.g. `randweight`) fall
+ * back to the sequential `dispatch_adjmat` to reproduce its values. Only
+ * the fallback allocates from `resource`, for its triplets.
+ */
+template <
+  typename OutMatrix_t,
+  typename Grid_t,
+  typename AdjFn_t,
+  typename WeightFn_t,
+  typename Stats_t = NoStats
+    >
+OutMatrix_t
+adjmat_compressed(
+    const Grid_t& grid,
+    AdjFn_t adjfn,
+    WeightFn_t weightfn,
+    Stats_t&& stats = Stats_t {},
+    std::pmr::memory_resource* resource = std::pmr::get_default_resource()) {
+
+  using Scalar_t = typename OutMatrix_t::Scalar;
+  using StorageIndex_t = typename OutMatrix_t::StorageIndex;
+  using RowMajor_t = Eigen::SparseMatrix<Scalar_t, Eigen::RowMajor, StorageIndex_t>;
+  using Generator_t = AdjmatRowGenerator<Scalar_t, AdjFn_t, WeightFn_t, Grid_t>;
+
+  if constexpr (!Generator_t::PARALLEL_FILL) {
+    auto result = dispatch_adjmat<OutMatrix_t>(grid, adjfn, weightfn, stats, resource);
+    result.makeCompressed();
+    return result;
+  }
+  else {
+    const auto matrixHeight = num_of_nodes(grid_dimensions(grid));
+    auto generator = Generator_t(grid, adjfn, weightfn);
+    auto result = RowMajor_t {};
+    fill_compressed(result, matrixHeight, matrixHeight,
+        [&](Eigen::Index row) { return generator.count(row); },
+        [&](Eigen::Index row, StorageIndex_t* innerFirst, Scalar_t* valueFirst, StorageIndex_t count) {
+          generator.fill(row, innerFirst, valueFirst, count);
+        },
+        stats);
+    generator.report(stats);
+    if constexpr (OutMatrix_t::IsRowMajor) {
+      return result;
+    }
+    else {
+      return OutMatrix_t(result);
+    }
+  }
+}
+
+} // namespace matrixgen::implementation
+
+namespace matrixgen
+{
+
+/**
+ * matrixgen::adjmat()
+ *
+ * Generates the adjacency matrix of a grid of rank `RANK` (1, 2, 3, 4, ...)
+ * with dimensions `gridDimensions`. See above implementation for details.
+ * Adjacency and weight functions receive coordinates of the grid's rank;
+ * the presets of 'presets.hpp' are three-dimensional unless stated
+ * otherwise.
+ *
+ * An optional `GenerationStats` sink receives the times of the phases
+ * 'adjmat.triplets' and 'adjmat.setFromTriplets', the number of adjacency and
+ * weight function calls, merged duplicates and the triplet buffer's growth.
+ * The triplet buffer is allocated from `resource`, see 'memory.hpp'. The
+ * overloads taking an `ExecutionContext` report and allocate differently,
+ * see there.
+ */
+template <
+  typename OutMatrix_t = Eigen::SparseMatrix<double, Eigen::RowMajor>,
+  typename AdjFn_t = void,
+  typename WeightFn_t = void,
+  typename Index_t = int,
+  typename Stats_t = NoStats,
+  std::size_t RANK = 3
+    >
+OutMatrix_t
+adjmat(
+    const Coords_t<Index_t, RANK>& gridDimensions,
+    AdjFn_t adjfn,
+    WeightFn_t weightfn,
+    Stats_t&& stats = Stats_t {},
+    std::pmr::memory_resource* resource = std::pmr::get_default_resource()) {
+
+  return implementation::dispatch_adjmat<OutMatrix_t>(gridDimensions, adjfn, weightfn, stats, resource);
+}
+
+/**
+ * As above for a grid whose extents are known at compile time, see
+ * `StaticExtents`.
+ */
+template <
+  typename OutMatrix_t = Eigen::SparseMatrix<double, Eigen::RowMajor>,
+  typename AdjFn_t = void,
+  typename WeightFn_t = void,
+  typename Stats_t = NoStats,
+  auto EXTENT,
+  auto... EXTENTS
+    >
+OutMatrix_t
+adjmat(
+    StaticExtents<EXTENT, EXTENTS...> extents,
+    AdjFn_t adjfn,
+    WeightFn_t weightfn,
+    Stats_t&& stats = Stats_t {},
+    std::pmr::memory_resource* resource = std::pmr::get_default_resource()) {
+
+  return implementation::dispatch_adjmat<OutMatrix_t>(extents, adjfn, weightfn, stats, resource);
+}
+
+/**
+ * As above, but writes the row-major adjacency matrix into the
+ * caller-provided CSR arrays of `target` instead of returning an
+ * `Eigen::SparseMatrix`. Returns the required capacities; see `CsrTarget` and
+ * `CsrCapacity` in 'target.hpp'.
+ *
+ * Rows are counted in parallel and filled in parallel, too, unless the
+ * weight function is a mutable lambda (e.g. `randweight`) in which case rows
+ * are filled in order to reproduce the values of the owning overload. The
+ * adjacency function is copied per thread and must only use its state as
+ * scratch space.
+ */
+template <
+  typename Scalar_t,
+  typename TargetIndex_t,
+  typename AdjFn_t,
+  typename WeightFn_t,
+  typename Index_t = int,
+  typename Stats_t = NoStats,
+  std::size_t RANK = 3
+    >
+CsrCapacity
+adjmat(
+    const CsrTarget<Scalar_t, TargetIndex_t>& target,
+    const Coords_t<Index_t, RANK>& gridDimensions,
+    AdjFn_t adjfn,
+    WeightFn_t weightfn,
+    Stats_t&& stats = Stats_t {}) {
+
+  using Grid_t = Coords_t<Index_t, RANK>;
+  return implementation::AdjmatCsr<Scalar_t, TargetIndex_t, AdjFn_t, WeightFn_t, Grid_t>::
+          invoke(target, gridDimensions, adjfn, weightfn, stats);
+}
+
+template <
+  typename Scalar_t,
+  typename TargetIndex_t,
+  typename AdjFn_t,
+  typename WeightFn_t,
+  typename Stats_t = NoStats,
+  auto EXTENT,
+  auto... EXTENTS
+    >
+CsrCapacity
+adjmat(
+    const CsrTarget<Scalar_t, TargetIndex_t>& target,
+    StaticExtents<EXTENT, EXTENTS...> extents,
+    AdjFn_t adjfn,
+    WeightFn_t weightfn,
+    Stats_t&& stats = Stats_t {}) {
+
+  using Grid_t = StaticExtents<EXTENT, EXTENTS...>;
+  return implementation::AdjmatCsr<Scalar_t, TargetIndex_t, AdjFn_t, WeightFn_t, Grid_t>::
+          invoke(target, extents, adjfn, weightfn, stats);
+}
+
+/**
+ * adjmat_with_pattern
+ *
+ * Same as `adjmat(gridDimensions, adjfn, weightfn)` for a row-major matrix
+ * whose sparsity pattern is already known: `pattern` must be a compressed
+ * adjacency matrix of the same grid and adjacency function, e.g. generated
+ * with `constweight`. Only the values are computed, in parallel. Used to
+ * generate families of matrices which differ in their weights only.
+ *
+ * The weight function must not be a mutable lambda (e.g. `randweight`).
+ */
+template <
+  typename Scalar_t,
+  int ALIGNMENT,
+  typename StorageIndex_t,
+  typename AdjFn_t,
+  typename WeightFn_t,
+  typename Index_t = int,
+  typename Stats_t = NoStats,
+  std::size_t RANK = 3
+    >
+Eigen::SparseMatrix<Scalar_t, ALIGNMENT, StorageIndex_t>
+adjmat_with_pattern(
+    const Eigen::SparseMatrix<Scalar_t, ALIGNMENT, StorageIndex_t>& pattern,
+    const Coords_t<Index_t, RANK>& gridDimensions,
+    AdjFn_t adjfn,
+    WeightFn_t weightfn,
+    Stats_t&& stats = Stats_t {}) {
+
+  using Grid_t = Coords_t<Index_t, RANK>;
+  return implementation::AdjmatWithPattern<Scalar_t, ALIGNMENT, StorageIndex_t, AdjFn_t, WeightFn_t, Grid_t>::
+          invoke(pattern, gridDimensions, adjfn, weightfn, stats);
+}
+
+template <
+  typename Scalar_t,
+  int ALIGNMENT,
+  typename StorageIndex_t,
+  typename AdjFn_t,
+  typename WeightFn_t,
+  typename Stats_t = NoStats,
+  auto EXTENT,
+  auto... EXTENTS
+    >
+Eigen::SparseMatrix<Scalar_t, ALIGNMENT, StorageIndex_t>
+adjmat_with_pattern(
+    const Eigen::SparseMatrix<Scalar_t, ALIGNMENT, StorageIndex_t>& pattern,
+    StaticExtents<EXTENT, EXTENTS...> extents,
+    AdjFn_t adjfn,
+    WeightFn_t weightfn,
+    Stats_t&& stats = Stats_t {}) {
+
+  using Grid_t = StaticExtents<EXTENT, EXTENTS...>;
+  return implementation::AdjmatWithPattern<Scalar_t, ALIGNMENT, StorageIndex_t, AdjFn_t, WeightFn_t, Grid_t>::
+          invoke(pattern, extents, adjfn, weightfn, stats);
+}
+
+/**
+ * Overloads of `adjmat` executed under `context`, see 'execution.hpp'. The
+ * remaining arguments are those of the overloads above.
+ *
+ * The owning overloads use the parallel two-pass construction of the CSR
+ * overload instead of triplets, so that rows are generated by the
+ * context's threads. `stats` receives the phases 'rows.count', 'rows.scan'
+ * and 'rows.fill' of `fill_compressed`, the output's allocation and the
+ * counts of calls and merged duplicates. There is no triplet buffer, so
+ * `resource` is not used.
+ *
+ * Weight functions which are mutable lambdas (e.g. `randweight`) take the
+ * sequential triplet path of the overloads above instead, which reports
+ * the 'adjmat.*' phases and allocates its triplets from `resource`.
+ */
+template <
+  typename OutMatrix_t = Eigen::SparseMatrix<double, Eigen::RowMajor>,
+  typename Index_t = int,
+  std::size_t RANK = 3,
+  typename... Args_t
+    >
+OutMatrix_t
+adjmat(
+    const ExecutionContext& context,
+    const Coords_t<Index_t, RANK>& gridDimensions,
+    Args_t&&... args) {
+
+  return context.execute([&]() {
+    return implementation::adjmat_compressed<OutMatrix_t>(gridDimensions, std::forward<Args_t>(args)...);
+  });
+}
+
+template <
+  typename OutMatrix_t = Eigen::SparseMatrix<double, Eigen::RowMajor>,
+  auto EXTENT,
+  auto... EXTENTS,
+  typename... Args_t
+    >
+OutMatrix_t
+adjmat(
+    const ExecutionContext& context,
+    StaticExtents<EXTENT, EXTENTS...> extents,
+    Args_t&&... args) {
+
+  return context.execute([&]() {
+    return implementation::adjmat_compressed<OutMatrix_t>(extents, std::forward<Args_t>(args)...);
+  });
+}
+
+template <
+  typename Scalar_t,
+  typename TargetIndex_t,
+  typename... Args_t
+    >
+CsrCapacity
+adjmat(
+    const ExecutionContext& context,
+    const CsrTarget<Scalar_t, TargetIndex_t>& target,
+    Args_t&&... args) {
+
+  return context.execute([&]() { return adjmat(target, std::forward<Args_t>(args)...); });
+}
+
 } // namespace matrixgen
 
 // TODO: Implement mechanism to insert square matrices with adjmat (port from asc-matrixgen)
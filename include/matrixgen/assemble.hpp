@@ -1,5 +1,8 @@
 #pragma once
 
+#include <matrixgen/execution.hpp>
+#include <matrixgen/stats.hpp>
+#include <matrixgen/target.hpp>
 #include <matrixgen/utility.hpp>
 
 #include <algorithm>
@@ -35,26 +38,36 @@ struct Assemble<Eigen::SparseMatrix<Scalar_t, ALIGNMENT, Index_t>, InMatrixIter_
 
   using OutMatrix_t = Eigen::SparseMatrix<Scalar_t, ALIGNMENT, Index_t>;
 
+  template <typename Stats_t>
   static
   OutMatrix_t
   invoke(
       InMatrixIter_t matrixFirst,
       InMatrixIter_t matrixLast,
       IndexIter_t indexFirst,
-      IndexIter_t indexLast) {
+      IndexIter_t indexLast,
+      Stats_t& stats) {
+
+    static_assert(IS_RANDOM_ACCESS<InMatrixIter_t> && IS_RANDOM_ACCESS<IndexIter_t>,
+        "Outers are copied in parallel and require random-access iterators.");
 
     const auto numOfMatrices = std::distance(matrixFirst, matrixLast);
     const auto numOfIndices = std::distance(indexFirst, indexLast);
 
+    // Indices may be unsigned; compare them as the matrices' distance type.
+    using Distance_t = typename std::iterator_traits<InMatrixIter_t>::difference_type;
     Expects( std::all_of(indexFirst, indexLast,
-                [numOfMatrices](auto idx) { return (0 <= idx && idx < numOfMatrices);}) );
+                [numOfMatrices](auto idx) {
+                  const auto index = static_cast<Distance_t>(idx);
+                  return (0 <= index && index < numOfMatrices);
+                }) );
 
     if(numOfMatrices == 0) {
       return OutMatrix_t {};
     }
 
     // Output matrix's outer size is equal to the number of indices.
-    const auto targetMatrixOuterSize = std::distance(indexFirst, indexLast);
+    const auto targetMatrixOuterSize = numOfIndices;
 
     // Infer target matrix's inner size from the source matrices' maximum inner
     // size
@@ -63,47 +76,84 @@ struct Assemble<Eigen::SparseMatrix<Scalar_t, ALIGNMENT, Index_t>, InMatrixIter_
           return a.innerSize() < b.innerSize();});
     const auto targetMatrixInnerSize = whichMatrix.innerSize();
 
-    // Construct a vector of the number of nonzeros for each outer in the
-    // output matrix. Used to allocate memory later.
-    auto nonzerosInOuter = std::vector<uint32_t>(targetMatrixOuterSize);
-    for(auto ii = 0; ii < numOfIndices; ++ii) {
-      const auto pMatrix = std::next(matrixFirst, *std::next(indexFirst, ii));
-      nonzerosInOuter[ii] = num_of_nnz_in_outer(*pMatrix, ii);
-    }
-
-    // Allocate storage space for target matrix.
+    // Copy outers from source matrices into the target matrix's compressed
+    // storage as contiguous segments, in parallel.
+    auto source = [&](Eigen::Index ii) { return std::next(matrixFirst, *std::next(indexFirst, ii)); };
     OutMatrix_t result;
-    if constexpr(ALIGNMENT == Eigen::RowMajor) {
-      result.resize(targetMatrixOuterSize, targetMatrixInnerSize);
-    }
-    else {
-      result.resize(targetMatrixInnerSize, targetMatrixOuterSize);
-    }
-    result.reserve(nonzerosInOuter);
-
-    // Copy outers from source matrices into target matrix.
-    // TODO: Improve the implementation. We're just copying segments of memory
-    //       from the source matrices into the output matrix. No need for so
-    //       many loops and calls to insert.
-    for(auto ii = 0; ii < targetMatrixOuterSize; ++ii) {
-      const auto pMatrix = std::next(matrixFirst, *std::next(indexFirst, ii));
-      const auto innerIndexStart = *std::next(pMatrix->outerIndexPtr(), ii);
-      const auto innerIndexSize = nonzerosInOuter[ii];
-      for(auto jj = 0; jj < innerIndexSize; ++jj) {
-        const auto val = *std::next(pMatrix->valuePtr(), innerIndexStart + jj);
-        Index_t innerIndex = *std::next(pMatrix->innerIndexPtr(), innerIndexStart + jj);
-        if constexpr(ALIGNMENT == Eigen::RowMajor) {
-          result.insert(ii, innerIndex) = val;
-        }
-        else {
-          result.insert(innerIndex, ii) = val;
-        }
-      }
-    };
+    fill_compressed(result,
+        ALIGNMENT == Eigen::RowMajor ? targetMatrixOuterSize : targetMatrixInnerSize,
+        ALIGNMENT == Eigen::RowMajor ? targetMatrixInnerSize : targetMatrixOuterSize,
+        [&](Eigen::Index ii) {
+          return num_of_nnz_in_outer(*source(ii), ii);
+        },
+        [&](Eigen::Index ii, Index_t* innerFirst, Scalar_t* valueFirst, Index_t count) {
+          const auto pMatrix = source(ii);
+          const auto innerIndexStart = *std::next(pMatrix->outerIndexPtr(), ii);
+          std::copy_n(std::next(pMatrix->innerIndexPtr(), innerIndexStart), count, innerFirst);
+          std::copy_n(std::next(pMatrix->valuePtr(), innerIndexStart), count, valueFirst);
+        },
+        stats);
     return result;
   }
 };
 
+/**
+ * Implementation of `assemble` for caller-provided CSR arrays. The source
+ * matrices must be row-major. Rows are copied in parallel as contiguous
+ * segments of the source matrices' inner index and value arrays.
+ */
+template <
+  typename Scalar_t,
+  typename TargetIndex_t,
+  typename InMatrixIter_t,
+  typename IndexIter_t
+    >
+struct AssembleCsr
+{
+  template <typename Stats_t>
+  static
+  CsrCapacity
+  invoke(
+      const CsrTarget<Scalar_t, TargetIndex_t>& target,
+      InMatrixIter_t matrixFirst,
+      InMatrixIter_t matrixLast,
+      IndexIter_t indexFirst,
+      IndexIter_t indexLast,
+      Stats_t& stats) {
+
+    using InMatrix_t = typename std::iterator_traits<InMatrixIter_t>::value_type;
+    static_assert(InMatrix_t::IsRowMajor, "CSR targets require row-major source matrices.");
+    static_assert(std::is_same<typename InMatrix_t::Scalar, Scalar_t>(),
+        "Target scalar type must match the source matrices' scalar type.");
+
+    const auto numOfMatrices = std::distance(matrixFirst, matrixLast);
+    const auto numOfIndices = std::distance(indexFirst, indexLast);
+
+    // Indices may be unsigned; compare them as the matrices' distance type.
+    using Distance_t = typename std::iterator_traits<InMatrixIter_t>::difference_type;
+    Expects( std::all_of(indexFirst, indexLast,
+                [numOfMatrices](auto idx) {
+                  const auto index = static_cast<Distance_t>(idx);
+                  return (0 <= index && index < numOfMatrices);
+                }) );
+
+    auto source = [&](Eigen::Index ii) { return std::next(matrixFirst, *std::next(indexFirst, ii)); };
+
+    return write_csr(target, numOfMatrices == 0 ? 0 : numOfIndices,
+        [&](Eigen::Index ii) {
+          return num_of_nnz_in_outer(*source(ii), ii);
+        },
+        [&](Eigen::Index ii, TargetIndex_t* innerFirst, Scalar_t* valueFirst, TargetIndex_t count) {
+          const auto pMatrix = source(ii);
+          const auto innerIndexStart = *std::next(pMatrix->outerIndexPtr(), ii);
+          std::copy_n(std::next(pMatrix->innerIndexPtr(), innerIndexStart), count, innerFirst);
+          std::copy_n(std::next(pMatrix->valuePtr(), innerIndexStart), count, valueFirst);
+        },
+        true,
+        stats);
+  }
+};
+
 } /* asc::matrixgen::implementation */
 
 namespace matrixgen
@@ -118,7 +168,7 @@ namespace matrixgen
  *  is equal to the k-th row (column) of the input matrix pointed by the k-th
  *  index.
  *
- *  The returned matrix is uncompressed. Its height (width) is the total
+ *  The returned matrix is compressed. Its height (width) is the total
  *  number of indices, whereas its width (height) is equal to the input
  *  matrices' maximum width (height). Rows (columns) which were drawn from
  *  a matrix whose width (height) is less than the resulting matrix's width
@@ -141,18 +191,25 @@ namespace matrixgen
  *      (b31, b32,   0)
  *  C = (a41, a42, a43)
  *      (a51, a52, a53)
+ *
+ *  The source matrices must be compressed and the iterators random-access,
+ *  as the outers are copied in parallel by `fill_compressed`. An optional
+ *  `GenerationStats` sink receives the phases of `fill_compressed` and the
+ *  output's allocation.
  */
 template <
   typename InMatrixIter_t,
   typename OutMatrix_t = typename std::iterator_traits<InMatrixIter_t>::value_type,
-  typename IndexIter_t = void
+  typename IndexIter_t = void,
+  typename Stats_t = NoStats
     >
 OutMatrix_t
 assemble(
     InMatrixIter_t matFirst, // range over matrices
     InMatrixIter_t matLast,
     IndexIter_t indexFirst,   // range over indices
-    IndexIter_t indexLast) {
+    IndexIter_t indexLast,
+    Stats_t&& stats = Stats_t {}) {
 
   using InMatrix_t = typename std::iterator_traits<InMatrixIter_t>::value_type;
   static_assert(std::is_same<OutMatrix_t, InMatrix_t>(),
@@ -160,7 +217,44 @@ assemble(
       "type must match output type.");
 
   return implementation::Assemble<OutMatrix_t, InMatrixIter_t, IndexIter_t>::
-          invoke(matFirst, matLast, indexFirst, indexLast);
+          invoke(matFirst, matLast, indexFirst, indexLast, stats);
+}
+
+/**
+ * As above, but writes the assembled row-major matrix into the
+ * caller-provided CSR arrays of `target`. The source matrices must be
+ * row-major and the iterators random-access. Returns the required
+ * capacities; see `CsrTarget` and `CsrCapacity` in 'target.hpp'.
+ */
+template <
+  typename Scalar_t,
+  typename TargetIndex_t,
+  typename InMatrixIter_t,
+  typename IndexIter_t,
+  typename Stats_t = NoStats
+    >
+CsrCapacity
+assemble(
+    const CsrTarget<Scalar_t, TargetIndex_t>& target,
+    InMatrixIter_t matFirst,
+    InMatrixIter_t matLast,
+    IndexIter_t indexFirst,
+    IndexIter_t indexLast,
+    Stats_t&& stats = Stats_t {}) {
+
+  return implementation::AssembleCsr<Scalar_t, TargetIndex_t, InMatrixIter_t, IndexIter_t>::
+          invoke(target, matFirst, matLast, indexFirst, indexLast, stats);
+}
+
+/**
+ * Overload of both of the above executed under `context`, see
+ * 'execution.hpp'.
+ */
+template <typename... Args_t>
+decltype(auto)
+assemble(const ExecutionContext& context, Args_t&&... args) {
+
+  return context.execute([&]() { return assemble(std::forward<Args_t>(args)...); });
 }
 
 } // namespace matrixgen
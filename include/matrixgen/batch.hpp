@@ -0,0 +1,269 @@
+/**
+ * Batch generation of families of matrices on a TBB flow graph.
+ */
+#pragma once
+
+#include <matrixgen/adjmat.hpp>
+#include <matrixgen/presets.hpp>
+#include <matrixgen/stats.hpp>
+
+#include <Eigen/Sparse>
+
+#include <gsl/gsl-lite.hpp>
+
+#include <tbb/flow_graph.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <compare>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace matrixgen
+{
+
+/**
+ * BatchInputs
+ *
+ * The results of the specs a batch spec depends on, in the order given to
+ * `Batch::add`. Iterating over the inputs yields the matrices themselves,
+ * so they can be passed to `assemble` and `interleave` directly.
+ */
+template <
+  typename Matrix_t
+    >
+class BatchInputs {
+public:
+  class const_iterator {
+  public:
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type = Matrix_t;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const Matrix_t*;
+    using reference = const Matrix_t&;
+
+    const_iterator() = default;
+    explicit const_iterator(const Matrix_t* const* it) : it_(it) {}
+
+    reference operator*() const { return **it_; }
+    pointer operator->() const { return *it_; }
+    reference operator[](difference_type n) const { return *it_[n]; }
+
+    const_iterator& operator++() { ++it_; return *this; }
+    const_iterator& operator--() { --it_; return *this; }
+    const_iterator operator++(int) { return const_iterator(it_++); }
+    const_iterator operator--(int) { return const_iterator(it_--); }
+    const_iterator& operator+=(difference_type n) { it_ += n; return *this; }
+    const_iterator& operator-=(difference_type n) { it_ -= n; return *this; }
+    friend const_iterator operator+(const_iterator it, difference_type n) { return it += n; }
+    friend const_iterator operator+(difference_type n, const_iterator it) { return it += n; }
+    friend const_iterator operator-(const_iterator it, difference_type n) { return it -= n; }
+    friend difference_type operator-(const_iterator a, const_iterator b) { return a.it_ - b.it_; }
+
+    bool operator==(const const_iterator&) const = default;
+    auto operator<=>(const const_iterator&) const = default;
+
+  private:
+    const Matrix_t* const* it_ = nullptr;
+  };
+
+  explicit BatchInputs(std::vector<const Matrix_t*> matrices) : matrices_(std::move(matrices)) {}
+
+  std::size_t size() const { return matrices_.size(); }
+  const Matrix_t& operator[](std::size_t ii) const { return *matrices_[ii]; }
+  const_iterator begin() const { return const_iterator(matrices_.data()); }
+  const_iterator end() const { return const_iterator(matrices_.data() + matrices_.size()); }
+
+private:
+  std::vector<const Matrix_t*> matrices_;
+};
+
+/**
+ * Batch
+ *
+ * A set of generation specs executed concurrently on a TBB flow graph.
+ *
+ * A spec is a function returning a `Matrix_t`. Specs may depend on the
+ * results of other specs, e.g. a sweep of `interleave` calls over the same
+ * source matrices or a sweep of weight functions over a common sparsity
+ * pattern (see `adjmat_with_pattern`). Every result is computed once and
+ * shared by all specs depending on it. Specs run as soon as their inputs are
+ * available; the generators' own parallel loops run nested inside them, so
+ * small and large specs together keep all cores busy.
+ *
+ * `run(consume)` passes every delivered result to `consume(handle, matrix)`
+ * as soon as it has been computed, in order of completion. `consume` is
+ * called by one thread at a time. Results are released once they have been
+ * consumed and all dependent specs are done. Exceptions thrown by specs or by
+ * `consume` cancel the batch and are rethrown by `run`.
+ *
+ * ****************************************************************************
+ *   auto batch = matrixgen::Batch<Matrix_t> {};
+ *   const auto a = batch.add([&]() { return matrixgen::adjmat<Matrix_t>(grid, adjfn, w1); }, false);
+ *   const auto b = batch.add([&]() { return matrixgen::adjmat<Matrix_t>(grid, adjfn, w2); }, false);
+ *   for(auto seed : seeds) {
+ *     batch.add({a, b}, [=](const auto& inputs) {
+ *       return matrixgen::interleave(inputs.begin(), inputs.end(), props.begin(), props.end(), 4, seed);
+ *     });
+ *   }
+ *   batch.run([](auto handle, const auto& matrix) { ... });
+ * ****************************************************************************
+ */
+template <
+  typename Matrix_t = Eigen::SparseMatrix<double, Eigen::RowMajor>
+    >
+class Batch {
+public:
+  using Handle = std::size_t;
+  using Inputs = BatchInputs<Matrix_t>;
+
+  /**
+   * Adds a spec without inputs. `generate()` returns the spec's matrix. If
+   * `deliver` is not set the result is only used as an input of other specs.
+   */
+  template <typename Generate_t>
+  Handle
+  add(Generate_t generate, bool deliver = true) {
+
+    return add({}, [generate = std::move(generate)](const Inputs&) mutable { return generate(); }, deliver);
+  }
+
+  /**
+   * Adds a spec depending on the results of the specs `inputs`, which must
+   * have been added before. `generate(inputs)` is passed a `BatchInputs`.
+   */
+  template <typename Generate_t>
+  Handle
+  add(std::vector<Handle> inputs, Generate_t generate, bool deliver = true) {
+
+    Expects( std::all_of(inputs.begin(), inputs.end(), [this](Handle h) { return h < specs_.size(); }) );
+
+    for(const auto input : inputs) {
+      ++specs_[input].numOfUses;
+    }
+    specs_.push_back(Spec {std::move(inputs), std::function<Matrix_t(const Inputs&)>(std::move(generate)),
+                           deliver, static_cast<std::size_t>(deliver)});
+    return specs_.size() - 1;
+  }
+
+  std::size_t size() const { return specs_.size(); }
+
+  /**
+   * Executes all specs and passes the delivered results to `consume`.
+   */
+  template <typename Consume_t>
+  void
+  run(Consume_t consume) {
+
+    namespace flow = tbb::flow;
+
+    auto graph = flow::graph {};
+    auto results = std::vector<std::shared_ptr<const Matrix_t>>(specs_.size());
+    auto uses = std::vector<std::atomic<std::size_t>>(specs_.size());
+    for(std::size_t ii = 0; ii < specs_.size(); ++ii) {
+      uses[ii] = specs_[ii].numOfUses;
+    }
+    auto release = [&](Handle h) {
+      if(--uses[h] == 0) {
+        results[h].reset();
+      }
+    };
+
+    auto deliver = flow::function_node<Handle>(graph, flow::serial, [&](Handle h) {
+      consume(h, *results[h]);
+      release(h);
+    });
+
+    auto nodes = std::vector<std::unique_ptr<flow::continue_node<flow::continue_msg>>> {};
+    nodes.reserve(specs_.size());
+    auto sources = std::vector<flow::continue_node<flow::continue_msg>*> {};
+    for(Handle h = 0; h < specs_.size(); ++h) {
+      nodes.push_back(std::make_unique<flow::continue_node<flow::continue_msg>>(graph, [&, h](flow::continue_msg) {
+        const auto& spec = specs_[h];
+        auto inputs = std::vector<const Matrix_t*> {};
+        for(const auto input : spec.inputs) {
+          inputs.push_back(results[input].get());
+        }
+        auto result = spec.generate(Inputs(std::move(inputs)));
+        if(spec.numOfUses > 0) {
+          results[h] = std::make_shared<const Matrix_t>(std::move(result));
+        }
+        for(const auto input : spec.inputs) {
+          release(input);
+        }
+        if(spec.deliver) {
+          deliver.try_put(h);
+        }
+        return flow::continue_msg {};
+      }));
+      for(const auto input : specs_[h].inputs) {
+        flow::make_edge(*nodes[input], *nodes[h]);
+      }
+      if(specs_[h].inputs.empty()) {
+        sources.push_back(nodes[h].get());
+      }
+    }
+
+    for(auto* source : sources) {
+      source->try_put(flow::continue_msg {});
+    }
+    graph.wait_for_all();
+  }
+
+private:
+  struct Spec {
+    std::vector<Handle> inputs;
+    std::function<Matrix_t(const Inputs&)> generate;
+    bool deliver;
+    std::size_t numOfUses; // dependent specs plus delivery
+  };
+
+  std::vector<Spec> specs_;
+};
+
+/**
+ * structured_grid_sinusoidal_sweep
+ *
+ * Generates `structured_grid_sinusoidal(gridDimensions, adjfn, nx, ny, nz)`
+ * for every frequency triple {nx, ny, nz} of `frequencies` as a `Batch`. The
+ * sparsity pattern is computed once and shared by all matrices. Passes each
+ * matrix to `consume(index, matrix)` as soon as it is complete, where `index`
+ * is the position of its frequencies.
+ */
+template <
+  typename AdjFn_t,
+  int ALIGNMENT = Eigen::RowMajor,
+  typename Scalar_t = double,
+  typename Index_t = int,
+  typename Consume_t = void
+    >
+void
+structured_grid_sinusoidal_sweep(
+    const Coords3d_t<Index_t>& gridDimensions,
+    AdjFn_t adjfn,
+    const std::vector<std::array<Scalar_t, 3>>& frequencies,
+    Consume_t consume) {
+
+  using Matrix_t = Eigen::SparseMatrix<Scalar_t, ALIGNMENT, Index_t>;
+
+  auto batch = Batch<Matrix_t> {};
+  const auto pattern = batch.add([&]() {
+    return adjmat<Matrix_t>(gridDimensions, adjfn, constweight(Scalar_t {1}));
+  }, false);
+  for(const auto& [nx, ny, nz] : frequencies) {
+    batch.add({pattern}, [&, nx = nx, ny = ny, nz = nz](const auto& inputs) {
+      auto stats = NoStats {};
+      auto matrix = adjmat_with_pattern(inputs[0], gridDimensions, adjfn, sinusoid_add_bias(nx, ny, nz));
+      implementation::make_diagonally_dominant(matrix, stats);
+      return matrix;
+    });
+  }
+  batch.run([&](auto handle, const Matrix_t& matrix) { consume(handle - 1, matrix); });
+}
+
+} // namespace matrixgen
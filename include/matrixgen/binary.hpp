@@ -0,0 +1,388 @@
+/**
+ * Versioned binary container format for compressed sparse matrices, with a
+ * memory-mapped zero-copy reader.
+ *
+ * File layout
+ * ~~~~~~~~~~~
+ * [0, 4096)                  `BinaryHeader`, zero-padded
+ * [outerOffset, ...)         outer index array (outerSize + 1 entries)
+ * [innerOffset, ...)         inner index array (nnz entries)
+ * [valueOffset, ...)         value array (nnz entries)
+ *
+ * Every array starts at a multiple of `BINARY_ALIGNMENT` bytes. The arrays
+ * are stored in the machine's native byte order, which is recorded in the
+ * header and checked on load.
+ */
+#pragma once
+
+#include <matrixgen/trace.hpp>
+
+#include <Eigen/Sparse>
+
+#include <gsl/gsl-lite.hpp>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace matrixgen
+{
+
+constexpr uint64_t BINARY_ALIGNMENT = 4096;
+constexpr uint32_t BINARY_VERSION = 1;
+constexpr char BINARY_MAGIC[8] = {'M', 'G', 'E', 'N', 'C', 'S', 'R', '\0'};
+constexpr uint32_t BINARY_ENDIAN_TAG = 0x01020304;
+
+/**
+ * BinaryHeader
+ *
+ * Header of the binary container format. All offsets are in bytes from the
+ * beginning of the file.
+ */
+struct BinaryHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t endianTag;
+  uint32_t indexWidth;     // sizeof(Index_t)
+  uint32_t scalarWidth;    // sizeof(Scalar_t)
+  uint32_t scalarIsFloat;  // 1 if Scalar_t is a floating-point type
+  uint32_t rowMajor;       // 1 if the storage order is row-major
+  int64_t rows;
+  int64_t cols;
+  int64_t nonZeros;
+  int64_t outerSize;
+  uint64_t outerOffset;
+  uint64_t innerOffset;
+  uint64_t valueOffset;
+  uint64_t fileSize;
+};
+
+static_assert(std::is_trivially_copyable<BinaryHeader>());
+static_assert(sizeof(BinaryHeader) <= BINARY_ALIGNMENT);
+
+} // namespace matrixgen
+
+namespace matrixgen::implementation
+{
+
+inline
+uint64_t
+align_up(uint64_t offset) {
+
+  return (offset + BINARY_ALIGNMENT - 1) / BINARY_ALIGNMENT * BINARY_ALIGNMENT;
+}
+
+/**
+ * Builds the header for a matrix of the given type and size.
+ */
+template <
+  typename Scalar_t,
+  int ALIGNMENT,
+  typename Index_t
+    >
+BinaryHeader
+make_binary_header(Eigen::Index rows, Eigen::Index cols, Eigen::Index nnz) {
+
+  auto header = BinaryHeader {};
+  std::copy(std::begin(BINARY_MAGIC), std::end(BINARY_MAGIC), std::begin(header.magic));
+  header.version = BINARY_VERSION;
+  header.endianTag = BINARY_ENDIAN_TAG;
+  header.indexWidth = sizeof(Index_t);
+  header.scalarWidth = sizeof(Scalar_t);
+  header.scalarIsFloat = std::is_floating_point<Scalar_t>() ? 1 : 0;
+  header.rowMajor = ALIGNMENT == Eigen::RowMajor ? 1 : 0;
+  header.rows = rows;
+  header.cols = cols;
+  header.nonZeros = nnz;
+  header.outerSize = ALIGNMENT == Eigen::RowMajor ? rows : cols;
+  header.outerOffset = BINARY_ALIGNMENT;
+  header.innerOffset = align_up(header.outerOffset + (header.outerSize + 1) * sizeof(Index_t));
+  header.valueOffset = align_up(header.innerOffset + nnz * sizeof(Index_t));
+  header.fileSize = header.valueOffset + nnz * sizeof(Scalar_t);
+  return header;
+}
+
+/**
+ * Writes the header and the three arrays of a compressed matrix to `path`.
+ */
+template <
+  typename Scalar_t,
+  int ALIGNMENT,
+  typename Index_t
+    >
+void
+write_binary_arrays(
+    const std::string& path,
+    Eigen::Index rows,
+    Eigen::Index cols,
+    const Index_t* outerIndex,
+    const Index_t* innerIndex,
+    const Scalar_t* values) {
+
+  const auto outerSize = ALIGNMENT == Eigen::RowMajor ? rows : cols;
+  const auto nnz = static_cast<Eigen::Index>(outerIndex[outerSize] - outerIndex[0]);
+  const auto header = make_binary_header<Scalar_t, ALIGNMENT, Index_t>(rows, cols, nnz);
+  const auto trace = TraceScope("write_binary", 0, nnz);
+
+  auto file = std::ofstream(path, std::ios::binary | std::ios::trunc);
+  if (!file) {
+    throw std::runtime_error("matrixgen: cannot open '" + path + "' for writing");
+  }
+
+  auto write_at = [&file](uint64_t offset, const void* data, uint64_t bytes) {
+    static const auto zeros = std::vector<char>(BINARY_ALIGNMENT, 0);
+    const auto pos = static_cast<uint64_t>(file.tellp());
+    file.write(zeros.data(), static_cast<std::streamsize>(offset - pos)); // padding
+    file.write(static_cast<const char*>(data), static_cast<std::streamsize>(bytes));
+  };
+
+  write_at(0, &header, sizeof(header));
+  if (outerIndex[0] == 0) {
+    write_at(header.outerOffset, outerIndex, (outerSize + 1) * sizeof(Index_t));
+  }
+  else { // e.g. a `Map` onto a sub-range of some larger arrays
+    auto rebased = std::vector<Index_t>(outerIndex, outerIndex + outerSize + 1);
+    std::for_each(rebased.begin(), rebased.end(), [base = outerIndex[0]](auto& x) { x -= base; });
+    write_at(header.outerOffset, rebased.data(), rebased.size() * sizeof(Index_t));
+  }
+  write_at(header.innerOffset, innerIndex + outerIndex[0], nnz * sizeof(Index_t));
+  write_at(header.valueOffset, values + outerIndex[0], nnz * sizeof(Scalar_t));
+
+  if (!file.flush()) {
+    throw std::runtime_error("matrixgen: failed writing '" + path + "'");
+  }
+}
+
+/**
+ * Read-only memory mapping of a whole file. Move-only; the mapping is
+ * released on destruction.
+ */
+class MappedFile {
+public:
+  MappedFile() = default;
+
+  explicit MappedFile(const std::string& path) {
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      throw std::system_error(errno, std::generic_category(), "matrixgen: cannot open '" + path + "'");
+    }
+    struct stat status {};
+    if (::fstat(fd, &status) != 0) {
+      ::close(fd);
+      throw std::system_error(errno, std::generic_category(), "matrixgen: cannot stat '" + path + "'");
+    }
+    length_ = static_cast<std::size_t>(status.st_size);
+    if (length_ > 0) {
+      address_ = ::mmap(nullptr, length_, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    const auto error = errno;
+    ::close(fd); // the mapping keeps the file referenced
+    if (address_ == MAP_FAILED) {
+      address_ = nullptr;
+      throw std::system_error(error, std::generic_category(), "matrixgen: cannot map '" + path + "'");
+    }
+  }
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  MappedFile(MappedFile&& other) noexcept
+    : address_(std::exchange(other.address_, nullptr)),
+      length_(std::exchange(other.length_, 0)) {}
+
+  MappedFile& operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+      release();
+      address_ = std::exchange(other.address_, nullptr);
+      length_ = std::exchange(other.length_, 0);
+    }
+    return *this;
+  }
+
+  ~MappedFile() { release(); }
+
+  const char* data() const { return static_cast<const char*>(address_); }
+  std::size_t size() const { return length_; }
+
+private:
+  void release() {
+    if (address_ != nullptr) {
+      ::munmap(address_, length_);
+      address_ = nullptr;
+    }
+  }
+
+  void* address_ = nullptr;
+  std::size_t length_ = 0;
+};
+
+} // namespace matrixgen::implementation
+
+namespace matrixgen
+{
+
+/**
+ * MappedMatrix
+ *
+ * Owns a read-only memory mapping of a binary matrix file and exposes it as
+ * an `Eigen::Map` without parsing or copying. Pages are loaded lazily by the
+ * operating system on first access. Move-only; the mapping is released on
+ * destruction, which invalidates any maps obtained from `map()`.
+ */
+template <
+  typename Scalar_t = double,
+  int ALIGNMENT = Eigen::RowMajor,
+  typename Index_t = int
+    >
+class MappedMatrix {
+public:
+  using Matrix_t = Eigen::SparseMatrix<Scalar_t, ALIGNMENT, Index_t>;
+  using Map_t = Eigen::Map<const Matrix_t>;
+
+  MappedMatrix() = default;
+
+  MappedMatrix(implementation::MappedFile file, const BinaryHeader& header)
+    : file_(std::move(file)), header_(header) {}
+
+  const BinaryHeader& header() const { return header_; }
+
+  Map_t map() const {
+    Expects( file_.data() != nullptr );
+    const char* base = file_.data();
+    return Map_t(header_.rows, header_.cols, header_.nonZeros,
+        reinterpret_cast<const Index_t*>(base + header_.outerOffset),
+        reinterpret_cast<const Index_t*>(base + header_.innerOffset),
+        reinterpret_cast<const Scalar_t*>(base + header_.valueOffset));
+  }
+
+private:
+  implementation::MappedFile file_;
+  BinaryHeader header_ {};
+};
+
+/**
+ * write_binary
+ *
+ * Writes a sparse matrix to `path` in the binary container format.
+ * Uncompressed matrices are compressed on a temporary copy.
+ */
+template <
+  typename Scalar_t,
+  int ALIGNMENT,
+  typename Index_t
+    >
+void
+write_binary(
+    const std::string& path,
+    const Eigen::SparseMatrix<Scalar_t, ALIGNMENT, Index_t>& matrix) {
+
+  if (!matrix.isCompressed()) {
+    auto compressed = matrix;
+    compressed.makeCompressed();
+    write_binary(path, compressed);
+    return;
+  }
+  implementation::write_binary_arrays<Scalar_t, ALIGNMENT, Index_t>(path,
+      matrix.rows(), matrix.cols(), matrix.outerIndexPtr(), matrix.innerIndexPtr(), matrix.valuePtr());
+}
+
+/**
+ * As above for maps, e.g. those returned by `as_map` and `MappedMatrix::map`.
+ */
+template <
+  typename Matrix_t,
+  int MAP_OPTIONS,
+  typename Stride_t
+    >
+void
+write_binary(
+    const std::string& path,
+    const Eigen::Map<Matrix_t, MAP_OPTIONS, Stride_t>& matrix) {
+
+  using Plain_t = std::remove_const_t<Matrix_t>;
+  using Scalar_t = typename Plain_t::Scalar;
+  using Index_t = typename Plain_t::StorageIndex;
+  constexpr int ALIGNMENT = Plain_t::IsRowMajor ? Eigen::RowMajor : Eigen::ColMajor;
+
+  Expects( matrix.isCompressed() );
+  implementation::write_binary_arrays<Scalar_t, ALIGNMENT, Index_t>(path,
+      matrix.rows(), matrix.cols(), matrix.outerIndexPtr(), matrix.innerIndexPtr(), matrix.valuePtr());
+}
+
+/**
+ * read_binary_header
+ *
+ * Reads and validates the header of a binary matrix file.
+ */
+inline
+BinaryHeader
+read_binary_header(const std::string& path) {
+
+  auto file = std::ifstream(path, std::ios::binary);
+  auto header = BinaryHeader {};
+  if (!file.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+    throw std::runtime_error("matrixgen: cannot read header of '" + path + "'");
+  }
+  if (!std::equal(std::begin(BINARY_MAGIC), std::end(BINARY_MAGIC), std::begin(header.magic))) {
+    throw std::runtime_error("matrixgen: '" + path + "' is not a matrixgen binary matrix");
+  }
+  if (header.version != BINARY_VERSION) {
+    throw std::runtime_error("matrixgen: unsupported format version in '" + path + "'");
+  }
+  if (header.endianTag != BINARY_ENDIAN_TAG) {
+    throw std::runtime_error("matrixgen: byte order of '" + path + "' does not match this machine");
+  }
+  return header;
+}
+
+/**
+ * map_binary
+ *
+ * Memory-maps a binary matrix file written by `write_binary` and returns a
+ * `MappedMatrix` providing a zero-copy `Eigen::Map`. Throws if the file's
+ * scalar type, index type or storage order do not match the requested ones.
+ *
+ * ****************************************************************************
+ *   matrixgen::write_binary("A.bin", matrix);
+ *   const auto mapped = matrixgen::map_binary<double, Eigen::RowMajor, int>("A.bin");
+ *   Eigen::VectorXd y = mapped.map() * x;
+ * ****************************************************************************
+ */
+template <
+  typename Scalar_t = double,
+  int ALIGNMENT = Eigen::RowMajor,
+  typename Index_t = int
+    >
+MappedMatrix<Scalar_t, ALIGNMENT, Index_t>
+map_binary(const std::string& path) {
+
+  const auto trace = implementation::TraceScope("map_binary");
+  const auto header = read_binary_header(path);
+  if (header.indexWidth != sizeof(Index_t) ||
+      header.scalarWidth != sizeof(Scalar_t) ||
+      header.scalarIsFloat != (std::is_floating_point<Scalar_t>() ? 1U : 0U) ||
+      header.rowMajor != (ALIGNMENT == Eigen::RowMajor ? 1U : 0U)) {
+    throw std::runtime_error("matrixgen: matrix type of '" + path + "' does not match the requested type");
+  }
+
+  auto file = implementation::MappedFile(path);
+  if (file.size() < header.fileSize) {
+    throw std::runtime_error("matrixgen: '" + path + "' is truncated");
+  }
+  return MappedMatrix<Scalar_t, ALIGNMENT, Index_t>(std::move(file), header);
+}
+
+} // namespace matrixgen
@@ -0,0 +1,497 @@
+/**
+ * Opt-in content-addressed on-disk cache for generated matrices.
+ *
+ * Matrices are stored in the binary container format (see 'binary.hpp')
+ * under a file name derived from a stable hash of everything that determines
+ * the generated matrix: the operation, its parameters and the output matrix
+ * type. Cache hits are served through memory-mapped loads.
+ */
+#pragma once
+
+#include <matrixgen/binary.hpp>
+#include <matrixgen/execution.hpp>
+#include <matrixgen/interleave.hpp>
+#include <matrixgen/perturb.hpp>
+#include <matrixgen/presets.hpp>
+#include <matrixgen/utility.hpp>
+
+#include <Eigen/Sparse>
+
+#include <gsl/gsl-lite.hpp>
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <optional>
+#include <random>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace matrixgen
+{
+
+/**
+ * Version of the generators' output, part of every `CacheKey`. Increment it
+ * with changes to a generator which change the matrices it returns for the
+ * same parameters, so that stale cache entries are no longer hit.
+ */
+constexpr uint32_t GENERATOR_VERSION = 1;
+
+} // namespace matrixgen
+
+namespace matrixgen::implementation
+{
+
+// Bytes hashed per parallel task. Fixed, such that hashes do not depend on
+// the number of threads.
+constexpr std::size_t HASH_CHUNK_BYTES = std::size_t {1} << 20U;
+
+/**
+ * Hashes a contiguous range of bytes using four independent multiply-mix
+ * lanes over 8-byte words.
+ */
+inline
+uint64_t
+hash_bytes(const void* data, std::size_t size, uint64_t seed) {
+
+  const auto* bytes = static_cast<const unsigned char*>(data);
+  auto lanes = std::array<uint64_t, 4> {
+    mix_seed(seed, 0), mix_seed(seed, 1), mix_seed(seed, 2), mix_seed(seed, 3)};
+
+  std::size_t pos = 0;
+  for(; pos + 32 <= size; pos += 32) {
+    for(std::size_t lane = 0; lane < 4; ++lane) {
+      uint64_t word = 0;
+      std::memcpy(&word, bytes + pos + 8 * lane, 8);
+      lanes[lane] = mix_seed(lanes[lane] ^ word, lane);
+    }
+  }
+  uint64_t tail = 0;
+  std::memcpy(&tail, bytes + pos, std::min<std::size_t>(size - pos, 8));
+  auto h = mix_seed(tail ^ size, size - pos);
+  for(std::size_t rest = pos + 8; rest < size; rest += 8) {
+    uint64_t word = 0;
+    std::memcpy(&word, bytes + rest, std::min<std::size_t>(size - rest, 8));
+    h = mix_seed(h ^ word, rest);
+  }
+  for(const auto lane : lanes) {
+    h = mix_seed(h ^ lane, seed);
+  }
+  return h;
+}
+
+/**
+ * As `hash_bytes`, for large arrays. Fixed-size chunks are hashed in
+ * parallel and their hashes are combined in order.
+ */
+inline
+uint64_t
+hash_bytes_parallel(const void* data, std::size_t size, uint64_t seed) {
+
+  const auto numChunks = (size + HASH_CHUNK_BYTES - 1) / HASH_CHUNK_BYTES;
+  if(numChunks <= 1) {
+    return hash_bytes(data, size, seed);
+  }
+
+  const auto* bytes = static_cast<const unsigned char*>(data);
+  auto chunkHashes = std::vector<uint64_t>(numChunks);
+  parallel_for_blocks(0, static_cast<Eigen::Index>(numChunks),
+    [&](const auto& range) {
+      for(auto chunk = static_cast<std::size_t>(range.begin()); chunk != static_cast<std::size_t>(range.end()); ++chunk) {
+        const auto offset = chunk * HASH_CHUNK_BYTES;
+        chunkHashes[chunk] = hash_bytes(bytes + offset, std::min(HASH_CHUNK_BYTES, size - offset), seed + chunk);
+      }
+    });
+  return hash_bytes(chunkHashes.data(), chunkHashes.size() * sizeof(uint64_t), seed);
+}
+
+} // namespace matrixgen::implementation
+
+namespace matrixgen
+{
+
+/**
+ * Fingerprint
+ *
+ * Structural and value hashes of a sparse matrix. Matrices with equal
+ * dimensions, storage order, index and scalar types, sparsity pattern and
+ * values have equal fingerprints.
+ */
+struct Fingerprint {
+  uint64_t structure = 0;
+  uint64_t values = 0;
+
+  bool operator==(const Fingerprint&) const = default;
+};
+
+/**
+ * fingerprint
+ *
+ * Computes the `Fingerprint` of a compressed sparse matrix, or a map onto
+ * one, by hashing its dimensions and raw arrays in parallel.
+ */
+template <
+  typename Matrix_t
+    >
+Fingerprint
+fingerprint(const Matrix_t& matrix) {
+
+  Expects( matrix.isCompressed() );
+
+  using Scalar_t = std::remove_const_t<typename Matrix_t::Scalar>;
+  using Index_t = std::remove_const_t<typename Matrix_t::StorageIndex>;
+
+  const auto outerSize = static_cast<std::size_t>(matrix.outerSize());
+  const auto base = static_cast<std::size_t>(matrix.outerIndexPtr()[0]);
+  const auto nnz = static_cast<std::size_t>(matrix.outerIndexPtr()[outerSize]) - base;
+  const auto shape = std::array<int64_t, 5> {
+    matrix.rows(), matrix.cols(), static_cast<int64_t>(nnz),
+    Matrix_t::IsRowMajor ? 1 : 0, static_cast<int64_t>(sizeof(Index_t))};
+
+  // Outer indices are hashed relative to the first one (see `write_binary`).
+  auto outer = matrix.outerIndexPtr();
+  auto outerHash = uint64_t {0};
+  if(base == 0) {
+    outerHash = implementation::hash_bytes_parallel(outer, (outerSize + 1) * sizeof(Index_t), 1);
+  }
+  else {
+    auto rebased = std::vector<Index_t>(outer, outer + outerSize + 1);
+    std::for_each(rebased.begin(), rebased.end(), [base](auto& x) { x -= static_cast<Index_t>(base); });
+    outerHash = implementation::hash_bytes_parallel(rebased.data(), rebased.size() * sizeof(Index_t), 1);
+  }
+
+  const auto parts = std::array<uint64_t, 3> {
+    implementation::hash_bytes(shape.data(), sizeof(shape), 0),
+    outerHash,
+    implementation::hash_bytes_parallel(matrix.innerIndexPtr() + base, nnz * sizeof(Index_t), 2)};
+
+  return Fingerprint {
+    implementation::hash_bytes(parts.data(), sizeof(parts), 3),
+    implementation::hash_bytes_parallel(matrix.valuePtr() + base, nnz * sizeof(Scalar_t), 4)};
+}
+
+} // namespace matrixgen
+
+namespace matrixgen::implementation
+{
+
+/**
+ * The fingerprint of a sparse matrix, which is copied and compressed only
+ * if it is not compressed already.
+ */
+template <typename Matrix_t>
+Fingerprint
+fingerprint_of_any(const Matrix_t& matrix) {
+
+  if(matrix.isCompressed()) {
+    return fingerprint(matrix);
+  }
+  auto compressed = matrix;
+  compressed.makeCompressed();
+  return fingerprint(compressed);
+}
+
+} // namespace matrixgen::implementation
+
+namespace matrixgen
+{
+
+/**
+ * CacheKey
+ *
+ * Stable 128-bit hash of an operation and its parameters. Parameters are
+ * appended with `add` in a fixed order; arithmetic values, enums, arrays and
+ * vectors thereof, strings and fingerprints are supported. Values are hashed
+ * in their native byte representation, thus keys are stable across runs on
+ * the same platform.
+ *
+ * Keys include the binary format's version, `GENERATOR_VERSION` and the
+ * operation's `version`, which callers increment with changes to their own
+ * generators.
+ *
+ * ****************************************************************************
+ *   auto key = matrixgen::CacheKey("my_operator", 2);
+ *   key.add(gridDimensions).add(seed).add_matrix_type<Matrix_t>();
+ * ****************************************************************************
+ */
+class CacheKey {
+public:
+  explicit CacheKey(std::string_view operation, uint32_t version = 0) {
+    add(BINARY_VERSION).add(GENERATOR_VERSION).add(operation).add(version);
+  }
+
+  template <typename T>
+  CacheKey& add(const T& value) {
+    if constexpr (std::is_arithmetic<T>() || std::is_enum<T>()) {
+      absorb(&value, sizeof(T));
+    }
+    else if constexpr (std::is_convertible<const T&, std::string_view>()) {
+      const auto view = std::string_view(value);
+      add(view.size());
+      absorb(view.data(), view.size());
+    }
+    else if constexpr (std::is_same<T, Fingerprint>()) {
+      add(value.structure).add(value.values);
+    }
+    else {
+      add(std::size(value));
+      for(const auto& elem : value) {
+        add(elem);
+      }
+    }
+    return *this;
+  }
+
+  /**
+   * Adds the scalar type, index type and storage order of `Matrix_t`.
+   */
+  template <typename Matrix_t>
+  CacheKey& add_matrix_type() {
+    using Scalar_t = typename Matrix_t::Scalar;
+    return add(sizeof(Scalar_t))
+          .add(std::is_floating_point<Scalar_t>::value)
+          .add(std::is_signed<Scalar_t>::value)
+          .add(sizeof(typename Matrix_t::StorageIndex))
+          .add(static_cast<bool>(Matrix_t::IsRowMajor));
+  }
+
+  std::string hex() const {
+    constexpr char DIGITS[] = "0123456789abcdef";
+    auto out = std::string(32, '0');
+    for(std::size_t ii = 0; ii < 16; ++ii) {
+      const auto word = ii < 8 ? hash_[0] : hash_[1];
+      const auto byte = (word >> (8U * (7 - ii % 8))) & 0xFFU;
+      out[2 * ii] = DIGITS[byte >> 4U];
+      out[2 * ii + 1] = DIGITS[byte & 0xFU];
+    }
+    return out;
+  }
+
+private:
+  void absorb(const void* data, std::size_t size) {
+    hash_[0] = implementation::hash_bytes(data, size, hash_[0]);
+    hash_[1] = implementation::hash_bytes(data, size, hash_[1] ^ 0x5bd1e995U);
+  }
+
+  std::array<uint64_t, 2> hash_ {0x243F6A8885A308D3ULL, 0x13198A2E03707344ULL};
+};
+
+/**
+ * GenerationCache
+ *
+ * Directory of cached matrices. `get_or_generate` returns the memory-mapped
+ * matrix stored under a key, or calls the generator, stores its result and
+ * maps that. Entries are written to a temporary file and renamed into place,
+ * thus several processes may share a cache directory. Each entry is
+ * accompanied by its `Fingerprint`; with `verify` set every hit is checked
+ * against it and regenerated on mismatch.
+ */
+class GenerationCache {
+public:
+  explicit GenerationCache(std::filesystem::path directory, bool verify = false)
+    : directory_(std::move(directory)), verify_(verify) {
+    std::filesystem::create_directories(directory_);
+  }
+
+  /**
+   * Returns a cache in the directory named by the environment variable
+   * `variable` if it is set and non-empty, and no cache otherwise.
+   */
+  static
+  std::optional<GenerationCache>
+  from_environment(const char* variable = "MATRIXGEN_CACHE_DIR") {
+    const char* value = std::getenv(variable);
+    if(value == nullptr || *value == '\0') {
+      return std::nullopt;
+    }
+    return GenerationCache(value);
+  }
+
+  std::filesystem::path path_of(const CacheKey& key) const {
+    return directory_ / (key.hex() + ".bin");
+  }
+
+  template <
+    typename Matrix_t,
+    typename Generate_t
+      >
+  auto
+  get_or_generate(const CacheKey& key, Generate_t generate) {
+
+    using Scalar_t = typename Matrix_t::Scalar;
+    using Index_t = typename Matrix_t::StorageIndex;
+    constexpr int ALIGNMENT = Matrix_t::IsRowMajor ? Eigen::RowMajor : Eigen::ColMajor;
+
+    const auto path = path_of(key);
+    auto fpPath = path;
+    fpPath.replace_extension(".fp");
+
+    if(std::filesystem::exists(path)) {
+      try {
+        auto mapped = map_binary<Scalar_t, ALIGNMENT, Index_t>(path.string());
+        if(!verify_ || fingerprint(mapped.map()) == read_fingerprint(fpPath)) {
+          return mapped;
+        }
+      }
+      catch(const std::exception&) { // NOLINT(bugprone-empty-catch): corrupt entries are regenerated
+      }
+    }
+
+    Matrix_t matrix = generate();
+    matrix.makeCompressed();
+    const auto fp = fingerprint(matrix);
+
+    // Write the fingerprint first, such that an entry's presence implies
+    // that of its fingerprint.
+    const auto tmpSuffix = ".tmp." + std::to_string(::getpid()) + "." + std::to_string(std::random_device {}());
+    auto fpTmp = fpPath;
+    fpTmp += tmpSuffix;
+    std::ofstream(fpTmp) << fp.structure << ' ' << fp.values << '\n';
+    std::filesystem::rename(fpTmp, fpPath);
+
+    auto binTmp = path;
+    binTmp += tmpSuffix;
+    write_binary(binTmp.string(), matrix);
+    std::filesystem::rename(binTmp, path);
+
+    return map_binary<Scalar_t, ALIGNMENT, Index_t>(path.string());
+  }
+
+private:
+  static
+  Fingerprint
+  read_fingerprint(const std::filesystem::path& path) {
+    auto fp = Fingerprint {};
+    auto file = std::ifstream(path);
+    if(!(file >> fp.structure >> fp.values)) {
+      throw std::runtime_error("matrixgen: cannot read fingerprint '" + path.string() + "'");
+    }
+    return fp;
+  }
+
+  std::filesystem::path directory_;
+  bool verify_;
+};
+
+/**
+ * cached_structured_grid_sinusoidal
+ *
+ * `structured_grid_sinusoidal` using the symmetric 7p stencil with boundary
+ * conditions XBC, YBC and ZBC, served from `cache`.
+ */
+template <
+  auto XBC = BC::DIRICHLET,
+  auto YBC = BC::DIRICHLET,
+  auto ZBC = BC::DIRICHLET,
+  int ALIGNMENT = Eigen::RowMajor,
+  typename Scalar_t = double,
+  typename Index_t = int
+    >
+MappedMatrix<Scalar_t, ALIGNMENT, Index_t>
+cached_structured_grid_sinusoidal(
+    GenerationCache& cache,
+    const Coords3d_t<Index_t>& gridDimensions,
+    Scalar_t nx,
+    Scalar_t ny,
+    Scalar_t nz) {
+
+  using Matrix_t = Eigen::SparseMatrix<Scalar_t, ALIGNMENT, Index_t>;
+  auto key = CacheKey("structured_grid_sinusoidal");
+  key.add(std::string_view("stencil7p")).add(XBC).add(YBC).add(ZBC)
+     .add(gridDimensions).add(nx).add(ny).add(nz)
+     .template add_matrix_type<Matrix_t>();
+
+  return cache.get_or_generate<Matrix_t>(key, [&]() {
+    return structured_grid_sinusoidal<decltype(stencil7p<XBC, YBC, ZBC, Index_t>()), ALIGNMENT, Scalar_t, Index_t>(
+        gridDimensions, stencil7p<XBC, YBC, ZBC, Index_t>(), nx, ny, nz);
+  });
+}
+
+/**
+ * cached_interleave
+ *
+ * `interleave` served from `cache`. The source matrices are identified by
+ * their fingerprints.
+ */
+template <
+  typename InMatrixIter_t,
+  typename PropIter_t
+    >
+auto
+cached_interleave(
+    GenerationCache& cache,
+    InMatrixIter_t matrixFirst,
+    InMatrixIter_t matrixLast,
+    PropIter_t propFirst,
+    PropIter_t propLast,
+    int32_t coupling = 0,
+    int64_t seed = 42) {
+
+  using Matrix_t = typename std::iterator_traits<InMatrixIter_t>::value_type;
+  auto key = CacheKey("interleave");
+  key.add(std::distance(matrixFirst, matrixLast));
+  for(auto it = matrixFirst; it != matrixLast; ++it) {
+    key.add(implementation::fingerprint_of_any(*it));
+  }
+  for(auto it = propFirst; it != propLast; ++it) {
+    key.add(static_cast<double>(*it));
+  }
+  key.add(coupling).add(seed).template add_matrix_type<Matrix_t>();
+
+  return cache.get_or_generate<Matrix_t>(key, [&]() {
+    return interleave(matrixFirst, matrixLast, propFirst, propLast, coupling, seed);
+  });
+}
+
+/**
+ * cached_perturb
+ *
+ * `perturb` served from `cache`. The source matrix is identified by its
+ * fingerprint.
+ */
+template <
+  typename Scalar_t,
+  int ALIGNMENT,
+  typename Index_t,
+  typename InputIter_t
+    >
+MappedMatrix<Scalar_t, ALIGNMENT, Index_t>
+cached_perturb(
+    GenerationCache& cache,
+    const Eigen::SparseMatrix<Scalar_t, ALIGNMENT, Index_t>& matrix,
+    InputIter_t outerIndicesFirst,
+    InputIter_t outerIndicesLast,
+    uint64_t seed) {
+
+  using Matrix_t = Eigen::SparseMatrix<Scalar_t, ALIGNMENT, Index_t>;
+
+  // `perturb` requires a compressed matrix; copy only if need be.
+  auto copy = std::optional<Matrix_t> {};
+  if(!matrix.isCompressed()) {
+    copy.emplace(matrix);
+    copy->makeCompressed();
+  }
+  const auto& compressed = copy ? *copy : matrix;
+
+  auto key = CacheKey("perturb");
+  key.add(fingerprint(compressed));
+  for(auto it = outerIndicesFirst; it != outerIndicesLast; ++it) {
+    key.add(static_cast<int64_t>(*it));
+  }
+  key.add(seed).template add_matrix_type<Matrix_t>();
+
+  return cache.get_or_generate<Matrix_t>(key, [&]() {
+    return perturb(compressed, outerIndicesFirst, outerIndicesLast, seed);
+  });
+}
+
+} // namespace matrixgen
@@ -0,0 +1,293 @@
+/**
+ * Variable-coefficient weight functions reading cell coefficients from
+ * memory-mapped files.
+ *
+ * File layout
+ * ~~~~~~~~~~~
+ * [0, byteOffset)            ignored, e.g. the header of a simulation output
+ * [byteOffset, ...)          `COMPONENTS` coefficients of type `FieldScalar_t`
+ *                            per node, nodes in x-then-y-then-z order
+ *
+ * A field has a single component (scalar coefficients) or one component per
+ * dimension of the grid (diagonal tensor coefficients, e.g. the
+ * permeabilities Kx, Ky and Kz). The coefficients are stored in the
+ * machine's native byte order and are never copied: pages are loaded lazily
+ * by the operating system on first access and shared by all copies of the
+ * field and its weight functions.
+ *
+ * ****************************************************************************
+ *   const auto grid = std::array {256, 256, 256};
+ *   const auto field = matrixgen::map_coefficient_field<float>("perm.raw", grid);
+ *   const auto matrix = matrixgen::adjmat(grid, matrixgen::stencil7p(),
+ *     matrixgen::coefficient_weight<matrixgen::Averaging::HARMONIC>(field));
+ * ****************************************************************************
+ */
+#pragma once
+
+#include <matrixgen/adjmat.hpp>
+#include <matrixgen/binary.hpp>
+#include <matrixgen/utility.hpp>
+
+#include <Eigen/Core>
+
+#include <gsl/gsl-lite.hpp>
+
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace matrixgen
+{
+
+/**
+ * Averaging of the coefficients of two nodes into the weight of the face
+ * between them. Harmonic averaging is the usual choice for conductivities
+ * and permeabilities, as it keeps the flux continuous across jumps.
+ */
+enum class Averaging {
+  ARITHMETIC,
+  GEOMETRIC,
+  HARMONIC
+};
+
+} // namespace matrixgen
+
+namespace matrixgen::implementation
+{
+
+/* The average of `a` and `b`; harmonic averages involving a zero are zero. */
+template <
+  Averaging AVERAGING,
+  typename Scalar_t
+    >
+Scalar_t
+average(Scalar_t a, Scalar_t b) {
+
+  if constexpr (AVERAGING == Averaging::ARITHMETIC) {
+    return (a + b) / 2;
+  }
+  else if constexpr (AVERAGING == Averaging::GEOMETRIC) {
+    return std::sqrt(a * b);
+  }
+  else {
+    return a + b != 0 ? 2 * a * b / (a + b) : Scalar_t {0};
+  }
+}
+
+} // namespace matrixgen::implementation
+
+namespace matrixgen
+{
+
+/**
+ * CoefficientField
+ *
+ * Read-only view of a memory-mapped coefficient field on a grid of
+ * dimensions `grid_dimensions()`, see 'coefficients.hpp'. Copies share the
+ * mapping, which is released with the last copy.
+ */
+template <
+  typename FieldScalar_t = double,
+  std::size_t COMPONENTS = 1,
+  typename Index_t = int,
+  std::size_t RANK = 3
+    >
+class CoefficientField {
+public:
+  static_assert(COMPONENTS == 1 || COMPONENTS == RANK,
+      "Coefficient fields are scalar or have one component per dimension.");
+
+  CoefficientField() = default;
+
+  CoefficientField(
+      std::shared_ptr<const implementation::MappedFile> file,
+      uint64_t byteOffset,
+      const Coords_t<Index_t, RANK>& gridDimensions)
+    : file_(std::move(file)),
+      data_(reinterpret_cast<const FieldScalar_t*>(file_->data() + byteOffset)),
+      gridDimensions_(gridDimensions) {}
+
+  const Coords_t<Index_t, RANK>& grid_dimensions() const { return gridDimensions_; }
+
+  /* The coefficient `component` of the node of index `node`. */
+  FieldScalar_t
+  operator()(Eigen::Index node, std::size_t component = 0) const {
+    return data_[node * static_cast<Eigen::Index>(COMPONENTS) + static_cast<Eigen::Index>(component)];
+  }
+
+  /**
+   * Batched evaluation: writes the weights of the faces between the nodes
+   * [first, last) and their successors along dimension `dim` to `out`, i.e.
+   * `out[i]` is the weight of the face between the nodes `first + i` and
+   * `first + i + stride`, where `stride` is the distance of neighbors along
+   * `dim`. Tensor fields contribute their component `dim`.
+   *
+   * The weights are computed over contiguous arrays, which Eigen vectorizes
+   * for scalar fields. Entries of nodes on the upper boundary of `dim` are
+   * computed from the nodes which follow in memory and are meaningless.
+   *
+   * This is for callers which assemble the matrix themselves, e.g. finite
+   * volume codes filling their own arrays. No generator calls it: `adjmat`
+   * with `coefficient_weight` evaluates the average once per entry.
+   */
+  template <
+    Averaging AVERAGING,
+    typename Scalar_t
+      >
+  void
+  face_weights(std::size_t dim, Eigen::Index first, Eigen::Index last, Scalar_t* out) const {
+
+    Expects( dim < RANK );
+
+    auto stride = Eigen::Index {1};
+    for(auto dd = std::size_t {0}; dd < dim; ++dd) {
+      stride *= gridDimensions_[dd];
+    }
+
+    Expects( 0 <= first && first <= last );
+    Expects( last + stride <= implementation::num_of_nodes(gridDimensions_) );
+
+    using InStride_t = Eigen::InnerStride<Eigen::Dynamic>;
+    using In_t = Eigen::Map<const Eigen::Array<FieldScalar_t, Eigen::Dynamic, 1>, 0, InStride_t>;
+    const auto component = COMPONENTS == 1 ? Eigen::Index {0} : static_cast<Eigen::Index>(dim);
+    const auto count = last - first;
+    const auto a = In_t(data_ + first * COMPONENTS + component, count, InStride_t(COMPONENTS)).template cast<Scalar_t>();
+    const auto b = In_t(data_ + (first + stride) * COMPONENTS + component, count, InStride_t(COMPONENTS)).template cast<Scalar_t>();
+    auto result = Eigen::Map<Eigen::Array<Scalar_t, Eigen::Dynamic, 1>>(out, count);
+
+    if constexpr (AVERAGING == Averaging::ARITHMETIC) {
+      result = (a + b) / 2;
+    }
+    else if constexpr (AVERAGING == Averaging::GEOMETRIC) {
+      result = (a * b).sqrt();
+    }
+    else {
+      result = (a + b != Scalar_t {0}).select(2 * a * b / (a + b), Scalar_t {0});
+    }
+  }
+
+private:
+  std::shared_ptr<const implementation::MappedFile> file_;
+  const FieldScalar_t* data_ = nullptr;
+  Coords_t<Index_t, RANK> gridDimensions_ {};
+};
+
+/**
+ * map_coefficient_field
+ *
+ * Memory-maps the coefficient field of the grid `gridDimensions` stored in
+ * `path` at `byteOffset`, see 'coefficients.hpp'. Throws if the file is too
+ * small for the grid.
+ */
+template <
+  typename FieldScalar_t = double,
+  std::size_t COMPONENTS = 1,
+  typename Index_t = int,
+  std::size_t RANK = 3
+    >
+CoefficientField<FieldScalar_t, COMPONENTS, Index_t, RANK>
+map_coefficient_field(
+    const std::string& path,
+    const Coords_t<Index_t, RANK>& gridDimensions,
+    uint64_t byteOffset = 0) {
+
+  Expects( byteOffset % alignof(FieldScalar_t) == 0 );
+
+  const auto trace = implementation::TraceScope("map_coefficient_field");
+  auto file = std::make_shared<const implementation::MappedFile>(path);
+  const auto required = byteOffset +
+      static_cast<uint64_t>(implementation::num_of_nodes(gridDimensions)) * COMPONENTS * sizeof(FieldScalar_t);
+  if (file->size() < required) {
+    throw std::runtime_error("matrixgen: '" + path + "' is too small for the coefficient field");
+  }
+  return CoefficientField<FieldScalar_t, COMPONENTS, Index_t, RANK>(std::move(file), byteOffset, gridDimensions);
+}
+
+} // namespace matrixgen
+
+namespace matrixgen::implementation
+{
+
+/**
+ * Function object of `coefficient_weight`. The grid's dimensions are taken
+ * from the field, so the weight function takes the coordinates of the node
+ * and its neighbor only.
+ */
+template <
+  Averaging AVERAGING,
+  typename Scalar_t,
+  typename FieldScalar_t,
+  std::size_t COMPONENTS,
+  typename Index_t,
+  std::size_t RANK
+    >
+struct CoefficientWeight
+{
+  CoefficientField<FieldScalar_t, COMPONENTS, Index_t, RANK> field;
+
+  Scalar_t operator()(
+      const Coords_t<Index_t, RANK>& coords,
+      const Coords_t<Index_t, RANK>& neighborCoords) const {
+
+    const auto& gridDimensions = field.grid_dimensions();
+    const auto node = get_node_index(coords, gridDimensions);
+    const auto neighbor = get_node_index(neighborCoords, gridDimensions);
+    if constexpr (COMPONENTS == 1) {
+      return average<AVERAGING>(static_cast<Scalar_t>(field(node)), static_cast<Scalar_t>(field(neighbor)));
+    }
+    else {
+      auto sum = Scalar_t {0};
+      auto count = 0;
+      for(auto dim = std::size_t {0}; dim < RANK; ++dim) {
+        if(coords[dim] != neighborCoords[dim]) {
+          sum += average<AVERAGING>(static_cast<Scalar_t>(field(node, dim)), static_cast<Scalar_t>(field(neighbor, dim)));
+          ++count;
+        }
+      }
+      if(count == 0) { // the node itself
+        for(auto dim = std::size_t {0}; dim < RANK; ++dim) {
+          sum += static_cast<Scalar_t>(field(node, dim));
+        }
+        return sum / RANK;
+      }
+      return sum / count;
+    }
+  }
+};
+
+} // namespace matrixgen::implementation
+
+namespace matrixgen
+{
+
+/**
+ * matrixgen::coefficient_weight()
+ *
+ * Weight function averaging the coefficients of a node and its neighbor by
+ * `AVERAGING`. The weight of a node with itself is its coefficient. For
+ * tensor fields the face between neighbors along dimension `d` uses the
+ * components `d`; offsets along several dimensions (e.g. the diagonals of
+ * the 27p stencil) take the mean of the faces' weights, and the node itself
+ * the mean of its components.
+ *
+ * Use with grids of the field's dimensions only. The weights are averaged
+ * one entry at a time; see `CoefficientField::face_weights` for batched
+ * evaluation.
+ */
+template <
+  Averaging AVERAGING = Averaging::HARMONIC,
+  typename Scalar_t = double,
+  typename FieldScalar_t = double,
+  std::size_t COMPONENTS = 1,
+  typename Index_t = int,
+  std::size_t RANK = 3
+    >
+auto coefficient_weight(const CoefficientField<FieldScalar_t, COMPONENTS, Index_t, RANK>& field) {
+
+  return implementation::CoefficientWeight<AVERAGING, Scalar_t, FieldScalar_t, COMPONENTS, Index_t, RANK> {field};
+}
+
+} // namespace matrixgen
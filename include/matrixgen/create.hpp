@@ -4,8 +4,14 @@
 #include <Eigen/Sparse>
 #include <gsl/gsl-lite.hpp>
 
+#include <matrixgen/utility.hpp>
+
+#include <algorithm>
+#include <atomic>
 #include <initializer_list>
+#include <iterator>
 #include <utility>
+#include <vector>
 
 namespace matrixgen::implementation {
 
@@ -33,25 +39,142 @@ struct Create<Eigen::Matrix<EigenScalar_t, ROWS, COLS, OPTIONS, MAXROWS, MAXCOLS
 
   static
   Matrix_t
-  create(uint32_t numRows, uint32_t numCols, InputIter_t first, InputIter_t last) {
+  create(Eigen::Index numRows, Eigen::Index numCols, InputIter_t first, InputIter_t last) {
 
-    Expects( numRows * numCols == std::distance(first, last) );
+    Expects( numRows >= 0 && numCols >= 0 );
 
     auto denseMat = Matrix_t(numRows, numCols);
-    for(uint32_t row = 0; row < numRows; ++row) {
-      for(uint32_t col = 0; col < numCols; ++col) {
-         denseMat(row, col) = static_cast<EigenScalar_t>(*std::next(first, row * numCols + col));
+    for(Eigen::Index row = 0; row < numRows; ++row) {
+      for(Eigen::Index col = 0; col < numCols; ++col, ++first) {
+        Expects( first != last );
+        denseMat(row, col) = static_cast<EigenScalar_t>(*first);
       }
     }
+
+    Ensures( first == last );
     return denseMat;
   }
 };
 
+/**
+ * Builds a compressed sparse matrix from coordinate (COO) input. Used by
+ * 'matrixgen::create_coo' and by 'matrixgen::create' for col-major matrices.
+ *
+ * The entries are bucketed by outer index in parallel (counting sort using
+ * atomic counters), each outer is then sorted by inner index and duplicate
+ * entries are summed up in their input order, as done by `setFromTriplets`,
+ * so that the result does not depend on the order of the concurrent
+ * scatter. Requires O(nnz) temporary memory and no dense intermediate.
+ */
+template <
+  typename Matrix_t,
+  typename RowIter_t,
+  typename ColIter_t,
+  typename ValueIter_t
+    >
+Matrix_t
+create_compressed_from_coo(
+    Eigen::Index numRows,
+    Eigen::Index numCols,
+    RowIter_t rowFirst,
+    RowIter_t rowLast,
+    ColIter_t colFirst,
+    ValueIter_t valueFirst) {
+
+  using Scalar_t = typename Matrix_t::Scalar;
+  using Index_t = typename Matrix_t::StorageIndex;
+  constexpr bool IS_ROW_MAJOR = Matrix_t::IsRowMajor;
+
+  const auto nnz = static_cast<Eigen::Index>(std::distance(rowFirst, rowLast));
+  const auto outerSize = IS_ROW_MAJOR ? numRows : numCols;
+  auto outer_of = [&](Eigen::Index k) -> Eigen::Index {
+    return IS_ROW_MAJOR ? rowFirst[k] : colFirst[k];
+  };
+  auto inner_of = [&](Eigen::Index k) -> Index_t {
+    return static_cast<Index_t>(IS_ROW_MAJOR ? colFirst[k] : rowFirst[k]);
+  };
+
+  // (1) Count entries per outer.
+  auto offsets = std::vector<Eigen::Index>(outerSize + 1, 0);
+  parallel_for_blocks(0, nnz,
+    [&](const auto& range) {
+      for(auto k = range.begin(); k != range.end(); ++k) {
+        Expects( 0 <= rowFirst[k] && rowFirst[k] < numRows );
+        Expects( 0 <= colFirst[k] && colFirst[k] < numCols );
+        std::atomic_ref<Eigen::Index>(offsets[outer_of(k) + 1]).fetch_add(1, std::memory_order_relaxed);
+      }
+    });
+  parallel_inclusive_scan(offsets.begin(), offsets.end());
+
+  // (2) Scatter the entries' input positions into their outer's bucket. The
+  //     order within a bucket depends on the threads' interleaving.
+  auto cursor = std::vector<Eigen::Index>(offsets.begin(), std::prev(offsets.end()));
+  auto bucketSource = std::vector<Eigen::Index>(nnz);
+  parallel_for_blocks(0, nnz,
+    [&](const auto& range) {
+      for(auto k = range.begin(); k != range.end(); ++k) {
+        const auto pos = std::atomic_ref<Eigen::Index>(cursor[outer_of(k)]).fetch_add(1, std::memory_order_relaxed);
+        bucketSource[pos] = k;
+      }
+    });
+
+  // (3) Sort each bucket by inner index and input position, and sum up
+  //     duplicates. The deduplicated size of every outer is stored in
+  //     `cursor`.
+  auto bucketInner = std::vector<Index_t>(nnz);
+  auto bucketValue = std::vector<Scalar_t>(nnz);
+  parallel_for_blocks(0, outerSize,
+    [&](const auto& range) {
+      auto perm = std::vector<Eigen::Index>{};
+      auto inner = std::vector<Index_t>{};
+      auto value = std::vector<Scalar_t>{};
+      for(auto outer = range.begin(); outer != range.end(); ++outer) {
+        const auto first = offsets[outer];
+        const auto size = offsets[outer + 1] - first;
+        perm.assign(std::next(bucketSource.cbegin(), first), std::next(bucketSource.cbegin(), first + size));
+        std::sort(perm.begin(), perm.end(), [&](auto a, auto b) {
+          return std::pair(inner_of(a), a) < std::pair(inner_of(b), b);
+        });
+        inner.clear();
+        value.clear();
+        for(auto k : perm) {
+          if(!inner.empty() && inner.back() == inner_of(k)) {
+            value.back() += static_cast<Scalar_t>(valueFirst[k]);
+          }
+          else {
+            inner.push_back(inner_of(k));
+            value.push_back(static_cast<Scalar_t>(valueFirst[k]));
+          }
+        }
+        std::copy(inner.begin(), inner.end(), std::next(bucketInner.begin(), first));
+        std::copy(value.begin(), value.end(), std::next(bucketValue.begin(), first));
+        cursor[outer] = static_cast<Eigen::Index>(inner.size());
+      }
+    });
+
+  // (4) Compact the buckets into the compressed output.
+  Matrix_t result;
+  fill_compressed(result, numRows, numCols,
+      [&](Eigen::Index outer) { return cursor[outer]; },
+      [&](Eigen::Index outer, Index_t* innerFirst, Scalar_t* valueFirst, Index_t count) {
+        std::copy_n(std::next(bucketInner.cbegin(), offsets[outer]), count, innerFirst);
+        std::copy_n(std::next(bucketValue.cbegin(), offsets[outer]), count, valueFirst);
+      });
+  return result;
+}
+
 /**
  * Implementation of 'matrixgen::create' for 'Eigen::SparseMatrix' objects.
  *
- * NOTE: Returned sparse matrices are not compressed. Call method
- *       'makeCompressed' on the object to compress it.
+ * Reads the row-major element stream in a single pass, skipping zeros. Only
+ * single increments are performed on the input iterator, thus plain input
+ * iterators (e.g. `std::istream_iterator`) are supported.
+ *
+ * Row-major matrices are appended to directly in their compressed storage.
+ * Col-major matrices collect the nonzeros' coordinates during the pass and
+ * are built via 'create_compressed_from_coo'. Memory is O(nnz) in both cases.
+ *
+ * NOTE: Returned sparse matrices are compressed.
  */
 template <
   typename EigenScalar_t,
@@ -65,27 +188,48 @@ struct Create<Eigen::SparseMatrix<EigenScalar_t, ALIGNMENT, EigenIndex_t>, Input
 
   static
   Matrix_t
-  create(uint32_t numRows, uint32_t numCols, InputIter_t first, InputIter_t last) {
-
-    Expects( numRows * numCols == std::distance(first, last) );
-
-    // Create a dense matrix, feed it the values and from it create a sparse
-    // view. This is a bogus implementation suitable for small matrices only.
-    // If performance ever becomes an issue here's why.
-    auto denseMat = Eigen::Matrix<
-        EigenScalar_t,
-        Eigen::Dynamic,
-        Eigen::Dynamic,
-        ALIGNMENT>(numRows, numCols);
-
-    for(uint32_t row = 0; row < numRows; ++row) {
-      for(uint32_t col = 0; col < numCols; ++col) {
-         denseMat(row, col) = static_cast<EigenScalar_t>(*(std::next(first, row * numCols + col)));
+  create(Eigen::Index numRows, Eigen::Index numCols, InputIter_t first, InputIter_t last) {
+
+    Expects( numRows >= 0 && numCols >= 0 );
+
+    if constexpr (ALIGNMENT == Eigen::RowMajor) {
+      auto result = Matrix_t(numRows, numCols);
+      auto outerIndex = result.outerIndexPtr();
+      for(Eigen::Index row = 0; row < numRows; ++row) {
+        outerIndex[row] = static_cast<EigenIndex_t>(result.data().size());
+        for(Eigen::Index col = 0; col < numCols; ++col, ++first) {
+          Expects( first != last );
+          const auto value = static_cast<EigenScalar_t>(*first);
+          if(value != EigenScalar_t(0)) {
+            result.data().append(value, col);
+          }
+        }
       }
+      outerIndex[numRows] = static_cast<EigenIndex_t>(result.data().size());
+
+      Ensures( first == last );
+      return result;
     }
+    else {
+      auto rows = std::vector<EigenIndex_t>{};
+      auto cols = std::vector<EigenIndex_t>{};
+      auto values = std::vector<EigenScalar_t>{};
+      for(Eigen::Index row = 0; row < numRows; ++row) {
+        for(Eigen::Index col = 0; col < numCols; ++col, ++first) {
+          Expects( first != last );
+          const auto value = static_cast<EigenScalar_t>(*first);
+          if(value != EigenScalar_t(0)) {
+            rows.push_back(static_cast<EigenIndex_t>(row));
+            cols.push_back(static_cast<EigenIndex_t>(col));
+            values.push_back(value);
+          }
+        }
+      }
 
-    Matrix_t outmatrix = denseMat.sparseView();
-    return outmatrix;
+      Ensures( first == last );
+      return create_compressed_from_coo<Matrix_t>(numRows, numCols,
+          rows.cbegin(), rows.cend(), cols.cbegin(), values.cbegin());
+    }
   }
 };
 
@@ -122,8 +266,8 @@ template <
   typename ListElem_t
     >
 OutMatrix_t create(
-    uint32_t numRows,
-    uint32_t numCols,
+    Eigen::Index numRows,
+    Eigen::Index numCols,
     std::initializer_list<ListElem_t> list) {
 
   using Iter_t = typename std::initializer_list<ListElem_t>::const_iterator;
@@ -138,12 +282,47 @@ template <
   typename InputIter_t
     >
 OutMatrix_t create(
-    uint32_t numRows,
-    uint32_t numCols,
+    Eigen::Index numRows,
+    Eigen::Index numCols,
     InputIter_t first,
     InputIter_t last) {
 
   return implementation::Create<OutMatrix_t, InputIter_t>::create(numRows, numCols, first, last);
 }
 
+/**
+ * Create a compressed sparse matrix from coordinate (COO) format input given
+ * as the range of row indices [rowFirst, rowLast) and the ranges of column
+ * indices and values of equal length beginning at `colFirst` and
+ * `valueFirst`, respectively. Entries may appear in any order; duplicate
+ * entries are summed up. The iterators must be random-access, as the input
+ * is processed in parallel.
+ *
+ * ****************************************************************************
+ *   const auto rows   = std::vector {0, 2, 1, 2};
+ *   const auto cols   = std::vector {0, 0, 1, 0};
+ *   const auto values = std::vector {1.0, 2.0, 3.0, 4.0};
+ *   auto myMatrix = matrixgen::create_coo<Eigen::SparseMatrix<double>>(3, 2,
+ *       rows.begin(), rows.end(), cols.begin(), values.begin());
+ *   // myMatrix = (1, 0; 0, 3; 6, 0)
+ * ****************************************************************************
+ */
+template <
+  typename OutMatrix_t,
+  typename RowIter_t,
+  typename ColIter_t,
+  typename ValueIter_t
+    >
+OutMatrix_t create_coo(
+    Eigen::Index numRows,
+    Eigen::Index numCols,
+    RowIter_t rowFirst,
+    RowIter_t rowLast,
+    ColIter_t colFirst,
+    ValueIter_t valueFirst) {
+
+  return implementation::create_compressed_from_coo<OutMatrix_t>(
+      numRows, numCols, rowFirst, rowLast, colFirst, valueFirst);
+}
+
 } // namespace matrixgen::implementation
@@ -0,0 +1,308 @@
+/**
+ * Control over where and how the generators' parallel loops run.
+ */
+#pragma once
+
+#include <Eigen/Core>
+
+#include <gsl/gsl-lite.hpp>
+
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <tbb/parallel_for_each.h>
+#include <tbb/parallel_pipeline.h>
+#include <tbb/parallel_reduce.h>
+#include <tbb/task_arena.h>
+
+#include <execution>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <numeric>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace matrixgen
+{
+
+/**
+ * ExecutionContext
+ *
+ * Selects how the parallel loops of a generator call are executed:
+ *
+ *   - `ExecutionContext {}` runs them in the caller's current task arena
+ *     (the default of every entry point),
+ *   - `sequential()` runs everything on the calling thread,
+ *   - `threads(n)` runs them in an arena of `n` threads owned by the context,
+ *   - `arena(a)` runs them in the existing `tbb::task_arena` `a`, which must
+ *     outlive the context.
+ *
+ * `with_grain_size(g)` sets the minimum number of rows (elements) per task
+ * for all loops; 0 leaves the choice to TBB.
+ *
+ * The entry points accept a context as their first argument:
+ *
+ * ****************************************************************************
+ *   auto arena = tbb::task_arena(8);
+ *   const auto context = matrixgen::ExecutionContext::arena(arena).with_grain_size(1024);
+ *   auto matrix = matrixgen::adjmat(context, grid, adjfn, weightfn);
+ * ****************************************************************************
+ *
+ * Arbitrary code, e.g. a sequence of generator calls, is run under a context
+ * by `context.execute(fn)`.
+ */
+class ExecutionContext {
+public:
+  ExecutionContext() = default;
+
+  static
+  ExecutionContext
+  sequential() {
+    auto context = ExecutionContext {};
+    context.sequential_ = true;
+    return context;
+  }
+
+  static
+  ExecutionContext
+  threads(int numOfThreads) {
+
+    Expects( numOfThreads > 0 );
+
+    auto context = ExecutionContext {};
+    context.arena_ = std::make_shared<tbb::task_arena>(numOfThreads);
+    return context;
+  }
+
+  static
+  ExecutionContext
+  arena(tbb::task_arena& arena) {
+    auto context = ExecutionContext {};
+    context.arena_ = std::shared_ptr<tbb::task_arena>(&arena, [](tbb::task_arena*) {});
+    return context;
+  }
+
+  ExecutionContext
+  with_grain_size(Eigen::Index grainSize) const {
+
+    Expects( grainSize >= 0 );
+
+    auto context = *this;
+    context.grainSize_ = grainSize;
+    return context;
+  }
+
+  bool is_sequential() const { return sequential_; }
+  Eigen::Index grain_size() const { return grainSize_; }
+
+  /**
+   * Returns `fn()`, executed under this context: inside its arena, if any,
+   * and with this context governing the generators' loops.
+   */
+  template <typename Fn_t>
+  decltype(auto)
+  execute(Fn_t&& fn) const;
+
+private:
+  bool sequential_ = false;
+  Eigen::Index grainSize_ = 0;
+  std::shared_ptr<tbb::task_arena> arena_;
+};
+
+} // namespace matrixgen
+
+namespace matrixgen::implementation
+{
+
+/* The context of the innermost `ExecutionContext::execute` on this thread. */
+inline
+const ExecutionContext*&
+current_execution_context() {
+  thread_local const ExecutionContext* context = nullptr;
+  return context;
+}
+
+inline
+const ExecutionContext&
+current_execution() {
+  static const auto DEFAULT = ExecutionContext {};
+  const auto* context = current_execution_context();
+  return context != nullptr ? *context : DEFAULT;
+}
+
+/* Makes `context` the current context until destruction. */
+class ExecutionScope {
+public:
+  explicit ExecutionScope(const ExecutionContext& context)
+    : previous_(current_execution_context()) {
+    current_execution_context() = &context;
+  }
+
+  ExecutionScope(const ExecutionScope&) = delete;
+  ExecutionScope& operator=(const ExecutionScope&) = delete;
+
+  ~ExecutionScope() { current_execution_context() = previous_; }
+
+private:
+  const ExecutionContext* previous_;
+};
+
+inline
+tbb::blocked_range<Eigen::Index>
+blocked_range(Eigen::Index first, Eigen::Index last) {
+  const auto grainSize = current_execution().grain_size();
+  return tbb::blocked_range<Eigen::Index>(first, last, grainSize > 0 ? static_cast<std::size_t>(grainSize) : 1);
+}
+
+/* Whether `Iter_t` can be advanced in constant time, as parallel loops require. */
+template <typename Iter_t>
+constexpr bool IS_RANDOM_ACCESS = std::is_base_of<
+  std::random_access_iterator_tag, typename std::iterator_traits<Iter_t>::iterator_category>();
+
+/**
+ * Calls `body(range)` for blocks of [first, last) according to the current
+ * execution context: in parallel, or once for the whole range if the context
+ * is sequential.
+ */
+template <typename Body_t>
+void
+parallel_for_blocks(Eigen::Index first, Eigen::Index last, const Body_t& body) {
+
+  if(current_execution().is_sequential()) {
+    body(tbb::blocked_range<Eigen::Index>(first, last));
+  }
+  else {
+    tbb::parallel_for(blocked_range(first, last), body);
+  }
+}
+
+/**
+ * Returns the sum of `body(range, init)` over blocks of [first, last), see
+ * `parallel_for_blocks`.
+ */
+template <
+  typename Value_t,
+  typename Body_t
+    >
+Value_t
+parallel_sum_blocks(Eigen::Index first, Eigen::Index last, Value_t init, const Body_t& body) {
+
+  if(current_execution().is_sequential()) {
+    return body(tbb::blocked_range<Eigen::Index>(first, last), init);
+  }
+  return tbb::parallel_reduce(blocked_range(first, last), init, body, std::plus<>{});
+}
+
+/* In-place inclusive scan of [first, last) under the current context. */
+template <typename RandAccIter_t>
+void
+parallel_inclusive_scan(RandAccIter_t first, RandAccIter_t last) {
+
+  if(current_execution().is_sequential()) {
+    std::inclusive_scan(std::execution::seq, first, last, first);
+  }
+  else {
+    std::inclusive_scan(std::execution::par, first, last, first);
+  }
+}
+
+/* The number of threads available under the current context. */
+inline
+int
+current_concurrency() {
+  return current_execution().is_sequential() ? 1 : tbb::this_task_arena::max_concurrency();
+}
+
+/**
+ * Calls `sink(transform(item))` for the items returned by `source()` until
+ * it returns nothing. `source` and `sink` are called in order, `transform`
+ * on up to `maxTokens` items concurrently unless `parallelTransform` is
+ * unset. Under a sequential context all of them run on the calling thread.
+ */
+template <
+  typename Source_t,
+  typename Transform_t,
+  typename Sink_t
+    >
+void
+ordered_pipeline(
+    std::size_t maxTokens,
+    Source_t&& source,
+    Transform_t&& transform,
+    Sink_t&& sink,
+    bool parallelTransform = true) {
+
+  using Item_t = typename std::invoke_result_t<Source_t&>::value_type;
+  using Output_t = std::invoke_result_t<Transform_t&, Item_t>;
+
+  if(current_execution().is_sequential()) {
+    while(auto item = source()) {
+      sink(transform(std::move(*item)));
+    }
+    return;
+  }
+  tbb::parallel_pipeline(maxTokens,
+    tbb::make_filter<void, Item_t>(tbb::filter_mode::serial_in_order,
+      [&](tbb::flow_control& fc) -> Item_t {
+        auto item = source();
+        if(!item) {
+          fc.stop();
+          return {};
+        }
+        return std::move(*item);
+      }) &
+    tbb::make_filter<Item_t, Output_t>(
+      parallelTransform ? tbb::filter_mode::parallel : tbb::filter_mode::serial_in_order,
+      [&](Item_t item) { return transform(std::move(item)); }) &
+    tbb::make_filter<Output_t, void>(tbb::filter_mode::serial_in_order,
+      [&](Output_t output) { sink(std::move(output)); }));
+}
+
+/**
+ * Calls `body(item, add)` for the items of `items` and for those passed to
+ * `add(item)` by these calls: in parallel, or last in first out on the
+ * calling thread if the current context is sequential.
+ */
+template <
+  typename Item_t,
+  typename Body_t
+    >
+void
+parallel_worklist(std::vector<Item_t> items, const Body_t& body) {
+
+  if(current_execution().is_sequential()) {
+    while(!items.empty()) {
+      const auto item = items.back();
+      items.pop_back();
+      body(item, [&](const Item_t& next) { items.push_back(next); });
+    }
+    return;
+  }
+  tbb::parallel_for_each(items.begin(), items.end(),
+    [&](const Item_t& item, tbb::feeder<Item_t>& feeder) {
+      body(item, [&](const Item_t& next) { feeder.add(next); });
+    });
+}
+
+} // namespace matrixgen::implementation
+
+namespace matrixgen
+{
+
+template <typename Fn_t>
+decltype(auto)
+ExecutionContext::execute(Fn_t&& fn) const {
+
+  auto run = [this, &fn]() -> decltype(auto) {
+    const auto scope = implementation::ExecutionScope(*this);
+    return fn();
+  };
+  if(arena_) {
+    return arena_->execute(run);
+  }
+  return run();
+}
+
+} // namespace matrixgen
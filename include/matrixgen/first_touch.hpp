@@ -0,0 +1,330 @@
+/**
+ * NUMA-aware placement of generated matrices by first touch.
+ *
+ * Linux places a page on the NUMA node of the thread which first writes to
+ * it. The generators below allocate the inner index and value arrays of
+ * their output uninitialized and fill them along a `RowPartition`, one part
+ * per thread. A kernel which later processes the matrix along the same
+ * partition with `for_each_part` (e.g. SpMV) then finds each part's pages on
+ * its own node.
+ *
+ * ****************************************************************************
+ *   auto partition = matrixgen::RowPartition {};
+ *   const auto matrix = matrixgen::adjmat_first_touch(grid, adjfn, weightfn, partition);
+ *   matrixgen::for_each_part(partition, [&](int part, Eigen::Index first, Eigen::Index last) {
+ *     y.segment(first, last - first) = matrix.middleRows(first, last - first) * x;
+ *   });
+ * ****************************************************************************
+ *
+ * Parts are mapped to the threads of the current task arena by
+ * `tbb::static_partitioner`, which assigns the same part to the same arena
+ * slot on every call. The mapping survives between calls as long as the
+ * arena's worker threads stay on their nodes, e.g. if they are pinned. The
+ * outer index array is zeroed by Eigen on the calling thread and is not
+ * redistributed.
+ */
+#pragma once
+
+#include <matrixgen/adjmat.hpp>
+#include <matrixgen/execution.hpp>
+#include <matrixgen/stats.hpp>
+#include <matrixgen/utility.hpp>
+
+#include <Eigen/Sparse>
+
+#include <gsl/gsl-lite.hpp>
+
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <tbb/partitioner.h>
+#include <tbb/task_arena.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+namespace matrixgen
+{
+
+/**
+ * RowPartition
+ *
+ * Contiguous blocks of rows: part `p` spans the rows
+ * [boundaries[p], boundaries[p + 1]).
+ */
+struct RowPartition {
+  std::vector<Eigen::Index> boundaries;
+
+  int parts() const { return boundaries.empty() ? 0 : static_cast<int>(boundaries.size()) - 1; }
+  Eigen::Index first(int part) const { return boundaries[part]; }
+  Eigen::Index last(int part) const { return boundaries[part + 1]; }
+};
+
+/**
+ * balanced_row_partition
+ *
+ * Splits the `outerSize` rows described by the row pointers `outerIndex`
+ * into `parts` blocks of about equal SpMV cost, counted as the number of
+ * nonzeros plus one per row.
+ */
+template <
+  typename Index_t
+    >
+RowPartition
+balanced_row_partition(const Index_t* outerIndex, Eigen::Index outerSize, int parts) {
+
+  Expects( parts > 0 );
+  Expects( outerSize >= 0 );
+
+  auto cost = [outerIndex](Eigen::Index rows) { return static_cast<Eigen::Index>(outerIndex[rows]) + rows; };
+  const auto total = cost(outerSize);
+
+  auto result = RowPartition {std::vector<Eigen::Index>(parts + 1, outerSize)};
+  result.boundaries.front() = 0;
+  for(auto part = 1; part < parts; ++part) {
+    // First row whose preceding rows cost at least the part's share.
+    const auto share = total * part / parts;
+    auto lo = result.boundaries[part - 1];
+    auto hi = outerSize;
+    while(lo < hi) {
+      const auto mid = lo + (hi - lo) / 2;
+      if(cost(mid) < share) {
+        lo = mid + 1;
+      }
+      else {
+        hi = mid;
+      }
+    }
+    result.boundaries[part] = lo;
+  }
+
+  Ensures( std::is_sorted(result.boundaries.begin(), result.boundaries.end()) );
+  return result;
+}
+
+/**
+ * As above for the rows of the compressed row-major matrix `matrix`.
+ */
+template <
+  typename Scalar_t,
+  int ALIGNMENT,
+  typename Index_t
+    >
+RowPartition
+balanced_row_partition(const Eigen::SparseMatrix<Scalar_t, ALIGNMENT, Index_t>& matrix, int parts) {
+
+  static_assert(ALIGNMENT == Eigen::RowMajor, "Row partitions require row-major matrices.");
+  Expects( matrix.isCompressed() );
+
+  return balanced_row_partition(matrix.outerIndexPtr(), matrix.outerSize(), parts);
+}
+
+/**
+ * for_each_part
+ *
+ * Calls `fn(part, first, last)` for every part of `partition`, each part on
+ * its own thread of the current task arena. Repeated calls with partitions of
+ * the same number of parts run each part on the same arena slot. Runs the
+ * parts in order on the calling thread under a sequential execution context.
+ */
+template <typename Fn_t>
+void
+for_each_part(const RowPartition& partition, Fn_t fn) {
+
+  const auto parts = partition.parts();
+  if(implementation::current_execution().is_sequential()) {
+    for(auto part = 0; part < parts; ++part) {
+      fn(part, partition.first(part), partition.last(part));
+    }
+    return;
+  }
+  tbb::parallel_for(tbb::blocked_range<int>(0, parts, 1),
+    [&](const auto& range) {
+      for(auto part = range.begin(); part != range.end(); ++part) {
+        fn(part, partition.first(part), partition.last(part));
+      }
+    },
+    tbb::static_partitioner {});
+}
+
+/**
+ * fill_compressed_first_touch
+ *
+ * Same as `fill_compressed` for row-major matrices, but fills the rows along
+ * a balanced partition into `parts` blocks (by default one per thread of the
+ * current arena), so that each block's pages are first touched by the
+ * thread which owns the block. Returns the partition.
+ */
+template <
+  typename Scalar_t,
+  int ALIGNMENT,
+  typename Index_t,
+  typename SizeFn_t,
+  typename FillFn_t,
+  typename Stats_t = NoStats
+    >
+RowPartition
+fill_compressed_first_touch(
+    Eigen::SparseMatrix<Scalar_t, ALIGNMENT, Index_t>& result,
+    Eigen::Index rows,
+    Eigen::Index cols,
+    SizeFn_t sizeFn,
+    FillFn_t fillFn,
+    int parts = 0,
+    Stats_t&& stats = Stats_t {}) {
+
+  static_assert(ALIGNMENT == Eigen::RowMajor, "Row partitions require row-major matrices.");
+
+  count_compressed(result, rows, cols, sizeFn, stats);
+  auto partition = balanced_row_partition(result, parts > 0 ? parts : tbb::this_task_arena::max_concurrency());
+
+  const Index_t* outerIndex = result.outerIndexPtr();
+  Index_t* innerIndex = result.innerIndexPtr();
+  Scalar_t* values = result.valuePtr();
+  [[maybe_unused]] const auto phase = implementation::ScopedPhase(stats, "rows.fill");
+  for_each_part(partition, [&](int, Eigen::Index first, Eigen::Index last) {
+    const auto trace = implementation::TraceScope("rows.fill.block", first, last);
+    for(auto row = first; row != last; ++row) {
+      const auto offset = outerIndex[row];
+      fillFn(row, innerIndex + offset, values + offset, outerIndex[row + 1] - offset);
+    }
+    if constexpr (implementation::STATS_ENABLED<Stats_t>) {
+      stats.add_work(outerIndex[last] - outerIndex[first]);
+    }
+  });
+  return partition;
+}
+
+} // namespace matrixgen
+
+namespace matrixgen::implementation
+{
+
+/**
+ * Implementation of `adjmat_first_touch`.
+ */
+template <
+  typename OutMatrix_t,
+  typename AdjFn_t,
+  typename WeightFn_t,
+  typename Index_t
+    >
+struct AdjmatFirstTouch
+{
+  using Scalar_t = typename OutMatrix_t::Scalar;
+  using StorageIndex_t = typename OutMatrix_t::StorageIndex;
+  using Generator_t = AdjmatRowGenerator<Scalar_t, AdjFn_t, WeightFn_t, Coords3d_t<Index_t>>;
+
+  template <typename Stats_t>
+  static
+  OutMatrix_t
+  invoke(
+      const Coords3d_t<Index_t>& gridDimensions,
+      AdjFn_t adjfn,
+      WeightFn_t weightfn,
+      RowPartition& partition,
+      int parts,
+      Stats_t& stats) {
+
+    static_assert(Generator_t::PARALLEL_FILL,
+        "First-touch generation requires weight functions without mutable state.");
+
+    const auto matrixHeight = static_cast<Eigen::Index>(gridDimensions[0]) *
+                              gridDimensions[1] *
+                              gridDimensions[2];
+
+    auto generator = Generator_t(gridDimensions, adjfn, weightfn);
+    auto result = OutMatrix_t {};
+    partition = fill_compressed_first_touch(result, matrixHeight, matrixHeight,
+        [&](Eigen::Index row) { return generator.count(row); },
+        [&](Eigen::Index row, StorageIndex_t* innerFirst, Scalar_t* valueFirst, StorageIndex_t count) {
+          generator.fill(row, innerFirst, valueFirst, count);
+        },
+        parts,
+        stats);
+    generator.report(stats);
+    return result;
+  }
+};
+
+} // namespace matrixgen::implementation
+
+namespace matrixgen
+{
+
+/**
+ * adjmat_first_touch
+ *
+ * Same as `adjmat(gridDimensions, adjfn, weightfn)` for a row-major matrix,
+ * but places the matrix's nonzeros by first touch along a balanced row
+ * partition into `parts` blocks, which is stored in `partition`. By default
+ * there is one part per thread of the current task arena. Pass `partition`
+ * to `for_each_part` to process the matrix with the same mapping of rows to
+ * threads.
+ *
+ * The weight function must not be a mutable lambda (e.g. `randweight`).
+ */
+template <
+  typename OutMatrix_t = Eigen::SparseMatrix<double, Eigen::RowMajor>,
+  typename AdjFn_t = void,
+  typename WeightFn_t = void,
+  typename Index_t = int,
+  typename Stats_t = NoStats
+    >
+OutMatrix_t
+adjmat_first_touch(
+    const implementation::Coords3d_t<Index_t>& gridDimensions,
+    AdjFn_t adjfn,
+    WeightFn_t weightfn,
+    RowPartition& partition,
+    int parts = 0,
+    Stats_t&& stats = Stats_t {}) {
+
+  static_assert(OutMatrix_t::IsRowMajor, "Row partitions require row-major matrices.");
+
+  return implementation::AdjmatFirstTouch<OutMatrix_t, AdjFn_t, WeightFn_t, Index_t>::
+          invoke(gridDimensions, adjfn, weightfn, partition, parts, stats);
+}
+
+/**
+ * first_touch_copy
+ *
+ * Returns a compressed copy of the row-major matrix `matrix` placed by first
+ * touch along a balanced row partition into `parts` blocks, which is stored
+ * in `partition`. Places the results of generators without a first-touch
+ * mode of their own (e.g. `interleave`) at the cost of one copy.
+ */
+template <
+  typename Scalar_t,
+  int ALIGNMENT,
+  typename Index_t,
+  typename Stats_t = NoStats
+    >
+Eigen::SparseMatrix<Scalar_t, ALIGNMENT, Index_t>
+first_touch_copy(
+    const Eigen::SparseMatrix<Scalar_t, ALIGNMENT, Index_t>& matrix,
+    RowPartition& partition,
+    int parts = 0,
+    Stats_t&& stats = Stats_t {}) {
+
+  const Index_t* outerIndex = matrix.outerIndexPtr();
+  const Index_t* innerNonZeros = matrix.innerNonZeroPtr();
+  const Index_t* innerIndex = matrix.innerIndexPtr();
+  const Scalar_t* values = matrix.valuePtr();
+
+  auto result = Eigen::SparseMatrix<Scalar_t, ALIGNMENT, Index_t> {};
+  partition = fill_compressed_first_touch(result, matrix.rows(), matrix.cols(),
+      [=](Eigen::Index row) {
+        return innerNonZeros != nullptr ? innerNonZeros[row] : outerIndex[row + 1] - outerIndex[row];
+      },
+      [=](Eigen::Index row, Index_t* innerFirst, Scalar_t* valueFirst, Index_t count) {
+        std::copy_n(innerIndex + outerIndex[row], count, innerFirst);
+        std::copy_n(values + outerIndex[row], count, valueFirst);
+      },
+      parts,
+      stats);
+  return result;
+}
+
+} // namespace matrixgen
@@ -0,0 +1,201 @@
+/**
+ * Explicit instantiations of the generators for common configurations.
+ *
+ * The optional target `Matrixgen::matrixgen_compiled` (CMake option
+ * `BUILD_LIBRARY`) compiles the functions below once, with the options in
+ * `MATRIXGEN_LIBRARY_COMPILE_OPTIONS`, and defines
+ * `MATRIXGEN_EXTERN_TEMPLATES` for its dependents. `<matrixgen/core>` then
+ * declares the instantiations `extern`, so that translation units calling
+ * them do not instantiate and compile them again. Calls with other
+ * configurations are instantiated as usual.
+ *
+ * The configurations are the products of
+ *
+ *   - scalars `double` and `float`,
+ *   - `Eigen::RowMajor` and `Eigen::ColMajor` matrices,
+ *   - storage indices `int` and `int64_t`,
+ *
+ * with, for `adjmat`, `stencil7p` and `stencil27p` under every combination of
+ * Dirichlet, Neumann and periodic boundary conditions and the weight
+ * functions `constweight`, `randweight` and `sinusoid_*`, as well as
+ * `assemble` and `interleave` over `std::vector`s of matrices. `perturb` and
+ * `structured_grid_sinusoidal` (`int` indices only) are instantiated for
+ * row-major matrices, which they are limited to. Only calls without a
+ * statistics sink and with the default memory resource match.
+ */
+#pragma once
+
+#include <matrixgen/adjmat.hpp>
+#include <matrixgen/assemble.hpp>
+#include <matrixgen/interleave.hpp>
+#include <matrixgen/perturb.hpp>
+#include <matrixgen/presets.hpp>
+#include <matrixgen/stats.hpp>
+
+#include <Eigen/Sparse>
+
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+
+namespace matrixgen::instantiations
+{
+
+template <typename Scalar_t, int ALIGNMENT, typename Index_t>
+using Matrix_t = Eigen::SparseMatrix<Scalar_t, ALIGNMENT, Index_t>;
+
+template <typename Scalar_t, int ALIGNMENT, typename Index_t>
+using MatrixIter_t = typename std::vector<Matrix_t<Scalar_t, ALIGNMENT, Index_t>>::const_iterator;
+
+template <typename Scalar_t, int ALIGNMENT, typename Index_t>
+using MutableMatrixIter_t = typename std::vector<Matrix_t<Scalar_t, ALIGNMENT, Index_t>>::iterator;
+
+using IndexIter_t = std::vector<int>::const_iterator;
+using PropIter_t = std::vector<double>::const_iterator;
+
+template <auto XBC, auto YBC, auto ZBC>
+using Stencil7p_t = decltype(stencil7p<XBC, YBC, ZBC>());
+
+template <auto XBC, auto YBC, auto ZBC>
+using Stencil27p_t = decltype(stencil27p<XBC, YBC, ZBC>());
+
+template <typename Scalar_t> using ConstWeight_t = decltype(constweight<Scalar_t>());
+template <typename Scalar_t> using RandWeight_t = decltype(randweight<Scalar_t>());
+template <typename Scalar_t> using SinusoidAdd_t = decltype(sinusoid_add<Scalar_t>(0, 0, 0));
+template <typename Scalar_t> using SinusoidAddBias_t = decltype(sinusoid_add_bias<Scalar_t>(0, 0, 0));
+template <typename Scalar_t> using SinusoidMul_t = decltype(sinusoid_mul<Scalar_t>(0, 0, 0));
+template <typename Scalar_t> using SinusoidMulBias_t = decltype(sinusoid_mul_bias<Scalar_t>(0, 0, 0));
+
+} // namespace matrixgen::instantiations
+
+/* `PREFIX` is empty for instantiation definitions and `extern` for declarations. */
+#define MATRIXGEN_INSTANTIATE_ADJMAT(PREFIX, SCALAR, ALIGNMENT, INDEX, STENCIL, XBC, YBC, ZBC, WEIGHT) \
+  PREFIX template ::matrixgen::instantiations::Matrix_t<SCALAR, ALIGNMENT, INDEX>                      \
+  matrixgen::adjmat<                                                                                   \
+      ::matrixgen::instantiations::Matrix_t<SCALAR, ALIGNMENT, INDEX>,                                 \
+      ::matrixgen::instantiations::STENCIL<XBC, YBC, ZBC>,                                             \
+      ::matrixgen::instantiations::WEIGHT<SCALAR>,                                                     \
+      int,                                                                                             \
+      ::matrixgen::NoStats>(                                                                           \
+    const ::matrixgen::implementation::Coords3d_t<int>&,                                               \
+    ::matrixgen::instantiations::STENCIL<XBC, YBC, ZBC>,                                               \
+    ::matrixgen::instantiations::WEIGHT<SCALAR>,                                                       \
+    ::matrixgen::NoStats&&,                                                                            \
+    std::pmr::memory_resource*);
+
+#define MATRIXGEN_INSTANTIATE_ADJMAT_WEIGHTS(PREFIX, SCALAR, ALIGNMENT, INDEX, STENCIL, XBC, YBC, ZBC) \
+  MATRIXGEN_INSTANTIATE_ADJMAT(PREFIX, SCALAR, ALIGNMENT, INDEX, STENCIL, XBC, YBC, ZBC, ConstWeight_t) \
+  MATRIXGEN_INSTANTIATE_ADJMAT(PREFIX, SCALAR, ALIGNMENT, INDEX, STENCIL, XBC, YBC, ZBC, RandWeight_t) \
+  MATRIXGEN_INSTANTIATE_ADJMAT(PREFIX, SCALAR, ALIGNMENT, INDEX, STENCIL, XBC, YBC, ZBC, SinusoidAdd_t) \
+  MATRIXGEN_INSTANTIATE_ADJMAT(PREFIX, SCALAR, ALIGNMENT, INDEX, STENCIL, XBC, YBC, ZBC, SinusoidAddBias_t) \
+  MATRIXGEN_INSTANTIATE_ADJMAT(PREFIX, SCALAR, ALIGNMENT, INDEX, STENCIL, XBC, YBC, ZBC, SinusoidMul_t) \
+  MATRIXGEN_INSTANTIATE_ADJMAT(PREFIX, SCALAR, ALIGNMENT, INDEX, STENCIL, XBC, YBC, ZBC, SinusoidMulBias_t)
+
+#define MATRIXGEN_INSTANTIATE_STRUCTURED_GRID_SINUSOIDAL(PREFIX, SCALAR, ALIGNMENT, XBC, YBC, ZBC)     \
+  PREFIX template ::matrixgen::instantiations::Matrix_t<SCALAR, ALIGNMENT, int>                        \
+  matrixgen::structured_grid_sinusoidal<                                                               \
+      ::matrixgen::instantiations::Stencil7p_t<XBC, YBC, ZBC>,                                         \
+      ALIGNMENT,                                                                                       \
+      SCALAR,                                                                                          \
+      int,                                                                                             \
+      ::matrixgen::NoStats>(                                                                           \
+    const ::matrixgen::implementation::Coords3d_t<int>&,                                               \
+    ::matrixgen::instantiations::Stencil7p_t<XBC, YBC, ZBC>,                                           \
+    SCALAR, SCALAR, SCALAR,                                                                            \
+    ::matrixgen::NoStats&&);
+
+/* Expands `MACRO(PREFIX, ARGS..., XBC, YBC, ZBC)` for every combination of boundary conditions. */
+#define MATRIXGEN_FOR_EACH_BC(MACRO, ...)                                                              \
+  MACRO(__VA_ARGS__, ::matrixgen::BC::DIRICHLET, ::matrixgen::BC::DIRICHLET, ::matrixgen::BC::DIRICHLET) \
+  MACRO(__VA_ARGS__, ::matrixgen::BC::DIRICHLET, ::matrixgen::BC::DIRICHLET, ::matrixgen::BC::NEUMANN) \
+  MACRO(__VA_ARGS__, ::matrixgen::BC::DIRICHLET, ::matrixgen::BC::DIRICHLET, ::matrixgen::BC::PERIODIC) \
+  MACRO(__VA_ARGS__, ::matrixgen::BC::DIRICHLET, ::matrixgen::BC::NEUMANN,   ::matrixgen::BC::DIRICHLET) \
+  MACRO(__VA_ARGS__, ::matrixgen::BC::DIRICHLET, ::matrixgen::BC::NEUMANN,   ::matrixgen::BC::NEUMANN) \
+  MACRO(__VA_ARGS__, ::matrixgen::BC::DIRICHLET, ::matrixgen::BC::NEUMANN,   ::matrixgen::BC::PERIODIC) \
+  MACRO(__VA_ARGS__, ::matrixgen::BC::DIRICHLET, ::matrixgen::BC::PERIODIC,  ::matrixgen::BC::DIRICHLET) \
+  MACRO(__VA_ARGS__, ::matrixgen::BC::DIRICHLET, ::matrixgen::BC::PERIODIC,  ::matrixgen::BC::NEUMANN) \
+  MACRO(__VA_ARGS__, ::matrixgen::BC::DIRICHLET, ::matrixgen::BC::PERIODIC,  ::matrixgen::BC::PERIODIC) \
+  MACRO(__VA_ARGS__, ::matrixgen::BC::NEUMANN,   ::matrixgen::BC::DIRICHLET, ::matrixgen::BC::DIRICHLET) \
+  MACRO(__VA_ARGS__, ::matrixgen::BC::NEUMANN,   ::matrixgen::BC::DIRICHLET, ::matrixgen::BC::NEUMANN) \
+  MACRO(__VA_ARGS__, ::matrixgen::BC::NEUMANN,   ::matrixgen::BC::DIRICHLET, ::matrixgen::BC::PERIODIC) \
+  MACRO(__VA_ARGS__, ::matrixgen::BC::NEUMANN,   ::matrixgen::BC::NEUMANN,   ::matrixgen::BC::DIRICHLET) \
+  MACRO(__VA_ARGS__, ::matrixgen::BC::NEUMANN,   ::matrixgen::BC::NEUMANN,   ::matrixgen::BC::NEUMANN) \
+  MACRO(__VA_ARGS__, ::matrixgen::BC::NEUMANN,   ::matrixgen::BC::NEUMANN,   ::matrixgen::BC::PERIODIC) \
+  MACRO(__VA_ARGS__, ::matrixgen::BC::NEUMANN,   ::matrixgen::BC::PERIODIC,  ::matrixgen::BC::DIRICHLET) \
+  MACRO(__VA_ARGS__, ::matrixgen::BC::NEUMANN,   ::matrixgen::BC::PERIODIC,  ::matrixgen::BC::NEUMANN) \
+  MACRO(__VA_ARGS__, ::matrixgen::BC::NEUMANN,   ::matrixgen::BC::PERIODIC,  ::matrixgen::BC::PERIODIC) \
+  MACRO(__VA_ARGS__, ::matrixgen::BC::PERIODIC,  ::matrixgen::BC::DIRICHLET, ::matrixgen::BC::DIRICHLET) \
+  MACRO(__VA_ARGS__, ::matrixgen::BC::PERIODIC,  ::matrixgen::BC::DIRICHLET, ::matrixgen::BC::NEUMANN) \
+  MACRO(__VA_ARGS__, ::matrixgen::BC::PERIODIC,  ::matrixgen::BC::DIRICHLET, ::matrixgen::BC::PERIODIC) \
+  MACRO(__VA_ARGS__, ::matrixgen::BC::PERIODIC,  ::matrixgen::BC::NEUMANN,   ::matrixgen::BC::DIRICHLET) \
+  MACRO(__VA_ARGS__, ::matrixgen::BC::PERIODIC,  ::matrixgen::BC::NEUMANN,   ::matrixgen::BC::NEUMANN) \
+  MACRO(__VA_ARGS__, ::matrixgen::BC::PERIODIC,  ::matrixgen::BC::NEUMANN,   ::matrixgen::BC::PERIODIC) \
+  MACRO(__VA_ARGS__, ::matrixgen::BC::PERIODIC,  ::matrixgen::BC::PERIODIC,  ::matrixgen::BC::DIRICHLET) \
+  MACRO(__VA_ARGS__, ::matrixgen::BC::PERIODIC,  ::matrixgen::BC::PERIODIC,  ::matrixgen::BC::NEUMANN) \
+  MACRO(__VA_ARGS__, ::matrixgen::BC::PERIODIC,  ::matrixgen::BC::PERIODIC,  ::matrixgen::BC::PERIODIC)
+
+#define MATRIXGEN_INSTANTIATE_ASSEMBLE(PREFIX, SCALAR, ALIGNMENT, INDEX, MATRIXITER)                   \
+  PREFIX template ::matrixgen::instantiations::Matrix_t<SCALAR, ALIGNMENT, INDEX>                      \
+  matrixgen::assemble<                                                                                 \
+      ::matrixgen::instantiations::MATRIXITER<SCALAR, ALIGNMENT, INDEX>,                               \
+      ::matrixgen::instantiations::Matrix_t<SCALAR, ALIGNMENT, INDEX>,                                 \
+      ::matrixgen::instantiations::IndexIter_t,                                                        \
+      ::matrixgen::NoStats>(                                                                           \
+    ::matrixgen::instantiations::MATRIXITER<SCALAR, ALIGNMENT, INDEX>,                                 \
+    ::matrixgen::instantiations::MATRIXITER<SCALAR, ALIGNMENT, INDEX>,                                 \
+    ::matrixgen::instantiations::IndexIter_t,                                                          \
+    ::matrixgen::instantiations::IndexIter_t,                                                          \
+    ::matrixgen::NoStats&&);                                                                           \
+  PREFIX template ::matrixgen::instantiations::Matrix_t<SCALAR, ALIGNMENT, INDEX>                      \
+  matrixgen::interleave<                                                                               \
+      ::matrixgen::instantiations::MATRIXITER<SCALAR, ALIGNMENT, INDEX>,                               \
+      ::matrixgen::instantiations::Matrix_t<SCALAR, ALIGNMENT, INDEX>,                                 \
+      ::matrixgen::instantiations::PropIter_t,                                                         \
+      ::matrixgen::NoStats>(                                                                           \
+    ::matrixgen::instantiations::MATRIXITER<SCALAR, ALIGNMENT, INDEX>,                                 \
+    ::matrixgen::instantiations::MATRIXITER<SCALAR, ALIGNMENT, INDEX>,                                 \
+    ::matrixgen::instantiations::PropIter_t,                                                           \
+    ::matrixgen::instantiations::PropIter_t,                                                           \
+    int32_t,                                                                                           \
+    int64_t,                                                                                           \
+    ::matrixgen::NoStats&&,                                                                            \
+    std::pmr::memory_resource*);
+
+#define MATRIXGEN_INSTANTIATE_PERTURB(PREFIX, SCALAR, ALIGNMENT, INDEX)                                \
+  PREFIX template ::matrixgen::instantiations::Matrix_t<SCALAR, ALIGNMENT, INDEX>                      \
+  matrixgen::perturb<                                                                                  \
+      ::matrixgen::instantiations::Matrix_t<SCALAR, ALIGNMENT, INDEX>,                                 \
+      ::matrixgen::instantiations::IndexIter_t,                                                        \
+      ::matrixgen::NoStats>(                                                                           \
+    const ::matrixgen::instantiations::Matrix_t<SCALAR, ALIGNMENT, INDEX>&,                            \
+    ::matrixgen::instantiations::IndexIter_t,                                                          \
+    ::matrixgen::instantiations::IndexIter_t,                                                          \
+    uint64_t,                                                                                          \
+    ::matrixgen::NoStats&&,                                                                            \
+    std::pmr::memory_resource*);
+
+/* All instantiations of one scalar type and storage order. */
+#define MATRIXGEN_INSTANTIATE_LAYOUT(PREFIX, SCALAR, ALIGNMENT)                                        \
+  MATRIXGEN_FOR_EACH_BC(MATRIXGEN_INSTANTIATE_ADJMAT_WEIGHTS, PREFIX, SCALAR, ALIGNMENT, int, Stencil7p_t) \
+  MATRIXGEN_FOR_EACH_BC(MATRIXGEN_INSTANTIATE_ADJMAT_WEIGHTS, PREFIX, SCALAR, ALIGNMENT, int64_t, Stencil7p_t) \
+  MATRIXGEN_FOR_EACH_BC(MATRIXGEN_INSTANTIATE_ADJMAT_WEIGHTS, PREFIX, SCALAR, ALIGNMENT, int, Stencil27p_t) \
+  MATRIXGEN_FOR_EACH_BC(MATRIXGEN_INSTANTIATE_ADJMAT_WEIGHTS, PREFIX, SCALAR, ALIGNMENT, int64_t, Stencil27p_t) \
+  MATRIXGEN_INSTANTIATE_ASSEMBLE(PREFIX, SCALAR, ALIGNMENT, int, MatrixIter_t)                         \
+  MATRIXGEN_INSTANTIATE_ASSEMBLE(PREFIX, SCALAR, ALIGNMENT, int, MutableMatrixIter_t)                  \
+  MATRIXGEN_INSTANTIATE_ASSEMBLE(PREFIX, SCALAR, ALIGNMENT, int64_t, MatrixIter_t)                     \
+  MATRIXGEN_INSTANTIATE_ASSEMBLE(PREFIX, SCALAR, ALIGNMENT, int64_t, MutableMatrixIter_t)
+
+/* Instantiations of the generators which support row-major matrices only. */
+#define MATRIXGEN_INSTANTIATE_ROW_MAJOR(PREFIX, SCALAR)                                                \
+  MATRIXGEN_INSTANTIATE_PERTURB(PREFIX, SCALAR, Eigen::RowMajor, int)                                  \
+  MATRIXGEN_INSTANTIATE_PERTURB(PREFIX, SCALAR, Eigen::RowMajor, int64_t)                              \
+  MATRIXGEN_FOR_EACH_BC(MATRIXGEN_INSTANTIATE_STRUCTURED_GRID_SINUSOIDAL, PREFIX, SCALAR, Eigen::RowMajor)
+
+#if defined(MATRIXGEN_EXTERN_TEMPLATES)
+MATRIXGEN_INSTANTIATE_LAYOUT(extern, double, Eigen::RowMajor)
+MATRIXGEN_INSTANTIATE_LAYOUT(extern, double, Eigen::ColMajor)
+MATRIXGEN_INSTANTIATE_LAYOUT(extern, float, Eigen::RowMajor)
+MATRIXGEN_INSTANTIATE_LAYOUT(extern, float, Eigen::ColMajor)
+MATRIXGEN_INSTANTIATE_ROW_MAJOR(extern, double)
+MATRIXGEN_INSTANTIATE_ROW_MAJOR(extern, float)
+#endif
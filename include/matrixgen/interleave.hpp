@@ -1,8 +1,11 @@
 #pragma once
 
 #include <matrixgen/assemble.hpp>
+#include <matrixgen/execution.hpp>
 
 #include <iterator>
+#include <memory_resource>
+#include <optional>
 #include <random>
 
 #include <Eigen/Sparse>
@@ -11,6 +14,55 @@
 
 namespace matrixgen::implementation {
 
+/**
+ * Generates the outer indices used by `interleave`: the `k`-th entry is the
+ * index of the matrix which the output's `k`-th outer is drawn from. The
+ * indices and all scratch space are allocated from `resource`.
+ */
+template <
+  typename InMatrixIter_t,
+  typename PropIter_t
+    >
+std::pmr::vector<std::size_t>
+interleave_indices(
+    InMatrixIter_t matFirst,
+    InMatrixIter_t matLast,
+    PropIter_t propFirst,
+    PropIter_t propLast,
+    int32_t coupling,
+    int64_t seed,
+    std::pmr::memory_resource* resource = std::pmr::get_default_resource()) {
+
+  const auto numOfMatrices = std::distance(matFirst, matLast);
+  const auto numOfProportions = std::distance(propFirst, propLast);
+
+  // Require one proportion per matrix and that all matrices have the same outer size.
+  Expects( numOfMatrices > 0);
+  Expects( numOfMatrices == numOfProportions );
+  Expects( std::all_of(matFirst, matLast, [&matFirst](const auto& mat) {return matFirst->outerSize() == mat.outerSize();}) );
+
+  std::size_t outerSize = matFirst->outerSize();
+
+  // Generate random uniformly distributed numbers in [0, 1]
+  std::default_random_engine generator(seed);
+  std::uniform_real_distribution<double> distribution(0, 1);
+  auto runif = std::pmr::vector<double>(outerSize, resource);
+  std::transform(runif.begin(), runif.end(), runif.begin(), // TODO: Replace by `std::generate`
+    [&runif, &distribution, &generator](double)
+    {
+      return distribution(generator);
+    }
+  );
+
+  // Apply closed-loop moving mean to runifs
+  closed_loop_moving_mean(runif.begin(), runif.end(), runif.begin(), 0, 1, coupling, resource);
+
+  // Generate indices from runifs and proportions
+  auto indices = std::pmr::vector<std::size_t>(outerSize, resource);
+  darts_sampling(propFirst, propLast, runif.begin(), runif.end(), indices.begin(), resource);
+  return indices;
+}
+
 template <
   typename OutMatrix_t,
   typename InMatrixIter_t,
@@ -33,6 +85,7 @@ struct Interleave<Eigen::SparseMatrix<Scalar_t, ALIGNMENT, Index_t>, InMatrixIte
 
   using OutMatrix_t = Eigen::SparseMatrix<Scalar_t, ALIGNMENT, Index_t>;
 
+  template <typename Stats_t>
   static
   OutMatrix_t
   invoke(
@@ -41,51 +94,37 @@ struct Interleave<Eigen::SparseMatrix<Scalar_t, ALIGNMENT, Index_t>, InMatrixIte
       PropIter_t propFirst,
       PropIter_t propLast,
       int32_t coupling,
-      int64_t seed) {
-
-  const auto numOfMatrices = std::distance(matFirst, matLast);
-  const auto numOfProportions = std::distance(propFirst, propLast);
-
-  // Require one proportion per matrix and that all matrices have the same outer size.
-  Expects( numOfMatrices > 0);
-  Expects( numOfMatrices == numOfProportions );
-  Expects( std::all_of(matFirst, matLast, [&matFirst](auto mat) {return matFirst->outerSize() == mat.outerSize();}) );
-
-  std::size_t outerSize = matFirst->outerSize();
+      int64_t seed,
+      Stats_t& stats,
+      std::pmr::memory_resource* resource) {
 
   //
   // (1) Generate indices
   //
-  // Generate random uniformly distributed numbers in [0, 1]
-  std::default_random_engine generator(seed);
-  std::uniform_real_distribution<double> distribution(0, 1);
-  std::vector<double> runif(outerSize);
-  std::transform(runif.begin(), runif.end(), runif.begin(), // TODO: Replace by `std::generate`
-    [&runif, &distribution, &generator](double)
-    {
-      return distribution(generator);
-    }
-  );
-
-  // Apply closed-loop moving mean to runifs
-  closed_loop_moving_mean(runif.begin(), runif.end(), runif.begin(), 0, 1, coupling);
-
-  // Generate indices from runifs and proportions
-  std::vector<std::size_t> indices(outerSize);
-  darts_sampling(propFirst, propLast, runif.begin(), runif.end(), indices.begin());
+  auto indicesPhase = std::optional<ScopedPhase<Stats_t>>(std::in_place, stats, "interleave.indices");
+  const auto indices = interleave_indices(matFirst, matLast, propFirst, propLast, coupling, seed, resource);
+  indicesPhase.reset();
 
   // (2) Contruct matrix from indexed rows
-  return assemble(matFirst, matLast, indices.cbegin(), indices.cend());
+  return assemble(matFirst, matLast, indices.cbegin(), indices.cend(), stats);
 }
 };
 }
 
 namespace matrixgen {
 
+/**
+ * Interleaves the outers of the matrices [matrixFirst, matrixLast): each
+ * outer of the result is drawn from one of the matrices with probability
+ * given by the proportions [propFirst, propLast), and `coupling` smooths
+ * the draws over neighboring outers. The drawn indices and their scratch
+ * space are allocated from `resource`, see 'memory.hpp'.
+ */
 template <
   typename InMatrixIter_t,
   typename OutMatrix_t = typename std::iterator_traits<InMatrixIter_t>::value_type,
-  typename PropIter_t = void
+  typename PropIter_t = void,
+  typename Stats_t = NoStats
     >
 typename std::iterator_traits<InMatrixIter_t>::value_type
 interleave(
@@ -94,7 +133,9 @@ interleave(
     PropIter_t propFirst,
     PropIter_t propLast,
     int32_t coupling = 0,
-    int64_t seed = 42) {
+    int64_t seed = 42,
+    Stats_t&& stats = Stats_t {},
+    std::pmr::memory_resource* resource = std::pmr::get_default_resource()) {
 
   using InMatrix_t = typename std::iterator_traits<InMatrixIter_t>::value_type;
   static_assert(std::is_same<OutMatrix_t, InMatrix_t>(),
@@ -102,6 +143,50 @@ interleave(
       "type must match output type.");
 
   return implementation::Interleave<OutMatrix_t, InMatrixIter_t, PropIter_t>::
-          invoke(matrixFirst, matrixLast, propFirst, propLast, coupling, seed);
+          invoke(matrixFirst, matrixLast, propFirst, propLast, coupling, seed, stats, resource);
+}
+
+/**
+ * As above, but writes the interleaved row-major matrix into the
+ * caller-provided CSR arrays of `target`. Returns the required capacities;
+ * see `CsrTarget` and `CsrCapacity` in 'target.hpp'. The drawn indices are
+ * allocated from `resource`.
+ */
+template <
+  typename Scalar_t,
+  typename TargetIndex_t,
+  typename InMatrixIter_t,
+  typename PropIter_t,
+  typename Stats_t = NoStats
+    >
+CsrCapacity
+interleave(
+    const CsrTarget<Scalar_t, TargetIndex_t>& target,
+    InMatrixIter_t matrixFirst,
+    InMatrixIter_t matrixLast,
+    PropIter_t propFirst,
+    PropIter_t propLast,
+    int32_t coupling = 0,
+    int64_t seed = 42,
+    Stats_t&& stats = Stats_t {},
+    std::pmr::memory_resource* resource = std::pmr::get_default_resource()) {
+
+  auto indicesPhase = std::optional<implementation::ScopedPhase<std::remove_reference_t<Stats_t>>>(
+      std::in_place, stats, "interleave.indices");
+  const auto indices = implementation::interleave_indices(
+      matrixFirst, matrixLast, propFirst, propLast, coupling, seed, resource);
+  indicesPhase.reset();
+  return assemble(target, matrixFirst, matrixLast, indices.cbegin(), indices.cend(), stats);
+}
+
+/**
+ * Overload of both of the above executed under `context`, see
+ * 'execution.hpp'.
+ */
+template <typename... Args_t>
+decltype(auto)
+interleave(const ExecutionContext& context, Args_t&&... args) {
+
+  return context.execute([&]() { return interleave(std::forward<Args_t>(args)...); });
 }
 } // namespace matrixgen
@@ -0,0 +1,572 @@
+/**
+ * Kronecker products and sums of sparse matrices.
+ *
+ * Operators with separable structure are Kronecker sums of small
+ * one-dimensional matrices; e.g. the constant-coefficient 7p Laplacian on a
+ * box of nx x ny x nz nodes is
+ *
+ *   Tz (+) Ty (+) Tx = Tz x Iy x Ix + Iz x Ty x Ix + Iz x Iy x Tx
+ *
+ * with the 1D Laplacians T of the dimensions, the last factor varying
+ * fastest as the x-coordinate of `get_node_index`. `kron` and `kron_sum`
+ * build such matrices directly in compressed storage from their factors,
+ * `KroneckerOperator` applies them without materializing them.
+ *
+ * ****************************************************************************
+ *   const auto tx = matrixgen::adjmat(std::array {nx}, matrixgen::stencil3p(), weightfn);
+ *   ...
+ *   const auto factors = std::array {tz, ty, tx};
+ *   const auto laplacian = matrixgen::kron_sum(factors.begin(), factors.end());
+ *   const auto op = matrixgen::KroneckerOperator(factors.begin(), factors.end(),
+ *     matrixgen::Kronecker::SUM);
+ *   const Eigen::VectorXd y = op * x; // equals laplacian * x
+ * ****************************************************************************
+ */
+#pragma once
+
+#include <matrixgen/execution.hpp>
+#include <matrixgen/stats.hpp>
+#include <matrixgen/utility.hpp>
+
+#include <Eigen/Sparse>
+
+#include <gsl/gsl-lite.hpp>
+
+#include <tbb/enumerable_thread_specific.h>
+
+#include <algorithm>
+#include <iterator>
+#include <vector>
+
+namespace matrixgen
+{
+
+/**
+ * Kronecker
+ *
+ * Combination of the factors `A_0, ..., A_{k-1}`:
+ *
+ *   - `PRODUCT`: `A_0 x A_1 x ... x A_{k-1}`,
+ *   - `SUM`: the sum over all `i` of the products of `A_i` and identities in
+ *     place of the other factors. The factors must be square.
+ */
+enum class Kronecker {
+  PRODUCT,
+  SUM
+};
+
+} // namespace matrixgen
+
+namespace matrixgen::implementation
+{
+
+/**
+ * Outer-wise access to the Kronecker product or sum of compressed factors
+ * without materializing it. The outer `o` of the result is composed of the
+ * factors' outers `o_i` as `o = sum_i o_i * outerStride_i`, the last factor
+ * varying fastest; its inners likewise. The factors are referenced, not
+ * copied.
+ */
+template <typename Matrix_t>
+struct KroneckerFactors
+{
+  using Scalar_t = typename Matrix_t::Scalar;
+  using StorageIndex_t = typename Matrix_t::StorageIndex;
+
+  struct Factor {
+    const StorageIndex_t* outerIndex;
+    const StorageIndex_t* innerIndex;
+    const Scalar_t* values;
+    Eigen::Index outerSize;
+    Eigen::Index innerSize;
+    Eigen::Index outerStride;
+    Eigen::Index innerStride;
+    std::vector<StorageIndex_t> diagonals; // first entry of each outer not below the diagonal (sums only)
+  };
+
+  /* Per-thread buffers of the factors' outers and read positions. */
+  struct Scratch {
+    std::vector<Eigen::Index> outers;
+    std::vector<Eigen::Index> positions;
+  };
+
+  Kronecker kronecker = Kronecker::PRODUCT;
+  std::vector<Factor> factors;
+  Eigen::Index outerSize = 1;
+  Eigen::Index innerSize = 1;
+
+  static
+  KroneckerFactors
+  make(const std::vector<const Matrix_t*>& matrices, Kronecker kronecker) {
+
+    Expects( !matrices.empty() );
+
+    auto result = KroneckerFactors {kronecker, std::vector<Factor>(matrices.size())};
+    for(auto ii = matrices.size(); ii-- > 0;) {
+      const auto& matrix = *matrices[ii];
+
+      Expects( matrix.isCompressed() );
+      Expects( kronecker == Kronecker::PRODUCT || matrix.rows() == matrix.cols() );
+
+      auto& factor = result.factors[ii];
+      factor.outerIndex = matrix.outerIndexPtr();
+      factor.innerIndex = matrix.innerIndexPtr();
+      factor.values = matrix.valuePtr();
+      factor.outerSize = matrix.outerSize();
+      factor.innerSize = matrix.innerSize();
+      factor.outerStride = result.outerSize;
+      factor.innerStride = result.innerSize;
+      result.outerSize *= factor.outerSize;
+      result.innerSize *= factor.innerSize;
+      if(kronecker == Kronecker::SUM) {
+        factor.diagonals.resize(factor.outerSize);
+        for(auto outer = Eigen::Index {0}; outer < factor.outerSize; ++outer) {
+          factor.diagonals[outer] = static_cast<StorageIndex_t>(std::lower_bound(
+              factor.innerIndex + factor.outerIndex[outer], factor.innerIndex + factor.outerIndex[outer + 1],
+              static_cast<StorageIndex_t>(outer)) - factor.innerIndex);
+        }
+      }
+    }
+    return result;
+  }
+
+  template <typename InMatrixIter_t>
+  static
+  KroneckerFactors
+  make(InMatrixIter_t matFirst, InMatrixIter_t matLast, Kronecker kronecker) {
+
+    auto matrices = std::vector<const Matrix_t*> {};
+    for(auto it = matFirst; it != matLast; ++it) {
+      matrices.push_back(&*it);
+    }
+    return make(matrices, kronecker);
+  }
+
+  Eigen::Index rows() const { return Matrix_t::IsRowMajor ? outerSize : innerSize; }
+  Eigen::Index cols() const { return Matrix_t::IsRowMajor ? innerSize : outerSize; }
+
+  Scratch
+  make_scratch() const {
+    return Scratch {std::vector<Eigen::Index>(factors.size()), std::vector<Eigen::Index>(factors.size())};
+  }
+
+  /**
+   * Writes the factors' outers composing `outer` to `scratch.outers`. The
+   * functions below expect them to be set for the outer they are given.
+   */
+  void
+  split(Eigen::Index outer, Scratch& scratch) const {
+    for(auto ii = std::size_t {0}; ii < factors.size(); ++ii) {
+      scratch.outers[ii] = outer / factors[ii].outerStride;
+      outer %= factors[ii].outerStride;
+    }
+  }
+
+  /* Advances `scratch.outers` to the next outer without divisions. */
+  void
+  advance(Scratch& scratch) const {
+    for(auto ii = factors.size(); ii-- > 0 && ++scratch.outers[ii] == factors[ii].outerSize;) {
+      scratch.outers[ii] = 0;
+    }
+  }
+
+  /* The number of nonzeros of the outer given by `scratch.outers`. */
+  Eigen::Index
+  size(Scratch& scratch) const {
+
+    if(kronecker == Kronecker::PRODUCT) {
+      auto size = Eigen::Index {1};
+      for(auto ii = std::size_t {0}; ii < factors.size(); ++ii) {
+        const auto& factor = factors[ii];
+        size *= factor.outerIndex[scratch.outers[ii] + 1] - factor.outerIndex[scratch.outers[ii]];
+      }
+      return size;
+    }
+
+    auto size = Eigen::Index {0};
+    auto diagonal = false;
+    for(auto ii = std::size_t {0}; ii < factors.size(); ++ii) {
+      const auto& factor = factors[ii];
+      const auto factorOuter = scratch.outers[ii];
+      const auto pos = factor.diagonals[factorOuter];
+      const auto hasDiagonal = pos != factor.outerIndex[factorOuter + 1] && factor.innerIndex[pos] == factorOuter;
+      size += factor.outerIndex[factorOuter + 1] - factor.outerIndex[factorOuter] - (hasDiagonal ? 1 : 0);
+      diagonal = diagonal || hasDiagonal;
+    }
+    return size + (diagonal ? 1 : 0);
+  }
+
+  /**
+   * Calls `fn(inner, value)` for the nonzeros of the outer given by
+   * `scratch.outers` of the Kronecker product in ascending inner order: an odometer over the
+   * factors' entries, the last factor fastest.
+   */
+  template <typename Fn_t>
+  void
+  for_each_product_entry(Scratch& scratch, Fn_t&& fn) const {
+
+    const auto numOfFactors = factors.size();
+    for(auto ii = std::size_t {0}; ii < numOfFactors; ++ii) {
+      const auto& factor = factors[ii];
+      scratch.positions[ii] = factor.outerIndex[scratch.outers[ii]];
+      if(scratch.positions[ii] == factor.outerIndex[scratch.outers[ii] + 1]) {
+        return;
+      }
+    }
+
+    while(true) {
+      auto inner = Eigen::Index {0};
+      auto value = Scalar_t {1};
+      for(auto ii = std::size_t {0}; ii < numOfFactors; ++ii) {
+        const auto& factor = factors[ii];
+        inner += factor.innerIndex[scratch.positions[ii]] * factor.innerStride;
+        value *= factor.values[scratch.positions[ii]];
+      }
+      fn(inner, value);
+
+      auto ii = numOfFactors;
+      for(; ii > 0; --ii) {
+        const auto& factor = factors[ii - 1];
+        if(++scratch.positions[ii - 1] != factor.outerIndex[scratch.outers[ii - 1] + 1]) {
+          break;
+        }
+        scratch.positions[ii - 1] = factor.outerIndex[scratch.outers[ii - 1]];
+      }
+      if(ii == 0) {
+        return;
+      }
+    }
+  }
+
+  /**
+   * Calls `fn(inner, value)` for the nonzeros of the outer `outer` of the
+   * Kronecker sum in ascending inner order. The entries of factor `i` are
+   * offset from the diagonal by multiples of `outerStride_i`, which exceeds
+   * the reach of all faster factors. Hence the entries below the diagonal
+   * come in the order of the factors, then the sum of the factors'
+   * diagonals, then the entries above the diagonal in reverse order of the
+   * factors.
+   */
+  template <typename Fn_t>
+  void
+  for_each_sum_entry(Eigen::Index outer, Scratch& scratch, Fn_t&& fn) const {
+
+    const auto numOfFactors = factors.size();
+    auto diagonal = false;
+    auto diagonalValue = Scalar_t {0};
+    for(auto ii = std::size_t {0}; ii < numOfFactors; ++ii) {
+      const auto& factor = factors[ii];
+      const auto factorOuter = scratch.outers[ii];
+      auto pos = static_cast<Eigen::Index>(factor.outerIndex[factorOuter]);
+      for(; pos != factor.diagonals[factorOuter]; ++pos) {
+        fn(outer + (factor.innerIndex[pos] - factorOuter) * factor.outerStride, factor.values[pos]);
+      }
+      if(pos != factor.outerIndex[factorOuter + 1] && factor.innerIndex[pos] == factorOuter) {
+        diagonal = true;
+        diagonalValue += factor.values[pos++];
+      }
+      scratch.positions[ii] = pos;
+    }
+    if(diagonal) {
+      fn(outer, diagonalValue);
+    }
+    for(auto ii = numOfFactors; ii-- > 0;) {
+      const auto& factor = factors[ii];
+      const auto factorOuter = scratch.outers[ii];
+      for(auto pos = scratch.positions[ii]; pos != factor.outerIndex[factorOuter + 1]; ++pos) {
+        fn(outer + (factor.innerIndex[pos] - factorOuter) * factor.outerStride, factor.values[pos]);
+      }
+    }
+  }
+
+  /* Calls one of the above, see `kronecker`. */
+  template <typename Fn_t>
+  void
+  for_each_entry(Eigen::Index outer, Scratch& scratch, Fn_t&& fn) const {
+
+    if(kronecker == Kronecker::PRODUCT) {
+      for_each_product_entry(scratch, fn);
+    }
+    else {
+      for_each_sum_entry(outer, scratch, fn);
+    }
+  }
+};
+
+/**
+ * Materializes the Kronecker product or sum of `factors` by the parallel
+ * two-pass construction of `fill_compressed`.
+ */
+template <
+  typename Matrix_t,
+  typename Stats_t
+    >
+Matrix_t
+kronecker_matrix(const KroneckerFactors<Matrix_t>& factors, Stats_t& stats) {
+
+  using Scalar_t = typename Matrix_t::Scalar;
+  using StorageIndex_t = typename Matrix_t::StorageIndex;
+
+  auto scratches = tbb::enumerable_thread_specific<typename KroneckerFactors<Matrix_t>::Scratch>(
+      [&factors]() { return factors.make_scratch(); });
+  auto result = Matrix_t {};
+  fill_compressed(result, factors.rows(), factors.cols(),
+      [&](Eigen::Index outer) {
+        auto& scratch = scratches.local();
+        factors.split(outer, scratch);
+        return factors.size(scratch);
+      },
+      [&](Eigen::Index outer, StorageIndex_t* innerFirst, Scalar_t* valueFirst, StorageIndex_t) {
+        auto& scratch = scratches.local();
+        factors.split(outer, scratch);
+        factors.for_each_entry(outer, scratch, [&](Eigen::Index inner, Scalar_t value) {
+          *innerFirst++ = static_cast<StorageIndex_t>(inner);
+          *valueFirst++ = value;
+        });
+      },
+      stats);
+  return result;
+}
+
+} // namespace matrixgen::implementation
+
+namespace matrixgen
+{
+
+/**
+ * kron
+ *
+ * Returns the Kronecker product of the compressed matrices [matFirst,
+ * matLast) in compressed storage. Every outer of the result is enumerated
+ * from the factors' outers and written in place; neither triplets nor
+ * intermediate products are formed.
+ *
+ * The phases of `fill_compressed` are reported to `stats`.
+ */
+template <
+  typename InMatrixIter_t,
+  typename OutMatrix_t = typename std::iterator_traits<InMatrixIter_t>::value_type,
+  typename Stats_t = NoStats
+    >
+typename std::iterator_traits<InMatrixIter_t>::value_type
+kron(
+    InMatrixIter_t matFirst,
+    InMatrixIter_t matLast,
+    Stats_t&& stats = Stats_t {}) {
+
+  using InMatrix_t = typename std::iterator_traits<InMatrixIter_t>::value_type;
+  static_assert(std::is_same<OutMatrix_t, InMatrix_t>(),
+      "`kron` does not support converting between matrix types. Input type "
+      "must match output type.");
+
+  const auto factors = implementation::KroneckerFactors<InMatrix_t>::make(matFirst, matLast, Kronecker::PRODUCT);
+  return implementation::kronecker_matrix(factors, stats);
+}
+
+
+/**
+ * As above for the two factors `a` and `b`.
+ */
+template <
+  typename Scalar_t,
+  int ALIGNMENT,
+  typename Index_t,
+  typename Stats_t = NoStats
+    >
+Eigen::SparseMatrix<Scalar_t, ALIGNMENT, Index_t>
+kron(
+    const Eigen::SparseMatrix<Scalar_t, ALIGNMENT, Index_t>& a,
+    const Eigen::SparseMatrix<Scalar_t, ALIGNMENT, Index_t>& b,
+    Stats_t&& stats = Stats_t {}) {
+
+  using Matrix_t = Eigen::SparseMatrix<Scalar_t, ALIGNMENT, Index_t>;
+  const auto factors = implementation::KroneckerFactors<Matrix_t>::make({&a, &b}, Kronecker::PRODUCT);
+  return implementation::kronecker_matrix(factors, stats);
+}
+
+/**
+ * kron_sum
+ *
+ * Returns the Kronecker sum of the square compressed matrices [matFirst,
+ * matLast) in compressed storage, see `Kronecker`. Every outer of the result
+ * is merged from the factors' outers and written in place.
+ *
+ * The phases of `fill_compressed` are reported to `stats`.
+ */
+template <
+  typename InMatrixIter_t,
+  typename OutMatrix_t = typename std::iterator_traits<InMatrixIter_t>::value_type,
+  typename Stats_t = NoStats
+    >
+typename std::iterator_traits<InMatrixIter_t>::value_type
+kron_sum(
+    InMatrixIter_t matFirst,
+    InMatrixIter_t matLast,
+    Stats_t&& stats = Stats_t {}) {
+
+  using InMatrix_t = typename std::iterator_traits<InMatrixIter_t>::value_type;
+  static_assert(std::is_same<OutMatrix_t, InMatrix_t>(),
+      "`kron_sum` does not support converting between matrix types. Input "
+      "type must match output type.");
+
+  const auto factors = implementation::KroneckerFactors<InMatrix_t>::make(matFirst, matLast, Kronecker::SUM);
+  return implementation::kronecker_matrix(factors, stats);
+}
+
+/**
+ * As above for the two factors `a` and `b`.
+ */
+template <
+  typename Scalar_t,
+  int ALIGNMENT,
+  typename Index_t,
+  typename Stats_t = NoStats
+    >
+Eigen::SparseMatrix<Scalar_t, ALIGNMENT, Index_t>
+kron_sum(
+    const Eigen::SparseMatrix<Scalar_t, ALIGNMENT, Index_t>& a,
+    const Eigen::SparseMatrix<Scalar_t, ALIGNMENT, Index_t>& b,
+    Stats_t&& stats = Stats_t {}) {
+
+  using Matrix_t = Eigen::SparseMatrix<Scalar_t, ALIGNMENT, Index_t>;
+  const auto factors = implementation::KroneckerFactors<Matrix_t>::make({&a, &b}, Kronecker::SUM);
+  return implementation::kronecker_matrix(factors, stats);
+}
+
+/**
+ * Overloads of the above executed under `context`, see 'execution.hpp'.
+ */
+template <typename... Args_t>
+decltype(auto)
+kron(const ExecutionContext& context, Args_t&&... args) {
+
+  return context.execute([&]() { return kron(std::forward<Args_t>(args)...); });
+}
+
+template <typename... Args_t>
+decltype(auto)
+kron_sum(const ExecutionContext& context, Args_t&&... args) {
+
+  return context.execute([&]() { return kron_sum(std::forward<Args_t>(args)...); });
+}
+
+/**
+ * KroneckerOperator
+ *
+ * Matrix-free Kronecker product or sum of row-major factors. The operator
+ * keeps copies of its factors, which are usually small, and computes every
+ * row of a product with a vector from the factors' rows on the fly: a row
+ * costs as many multiply-adds as it has nonzeros, but no matrix storage is
+ * streamed from memory.
+ */
+template <typename Matrix_t>
+class KroneckerOperator {
+public:
+  static_assert(Matrix_t::IsRowMajor, "Matrix-free Kronecker operators require row-major factors.");
+
+  using Scalar_t = typename Matrix_t::Scalar;
+  using Vector_t = Eigen::Matrix<Scalar_t, Eigen::Dynamic, 1>;
+
+  template <typename InMatrixIter_t>
+  KroneckerOperator(
+      InMatrixIter_t matFirst,
+      InMatrixIter_t matLast,
+      Kronecker kronecker = Kronecker::PRODUCT)
+    : factors_(matFirst, matLast),
+      kronecker_(kronecker) {
+
+    Expects( !factors_.empty() );
+
+    for(auto& factor : factors_) {
+      factor.makeCompressed();
+      Expects( kronecker == Kronecker::PRODUCT || factor.rows() == factor.cols() );
+    }
+  }
+
+  Eigen::Index
+  rows() const {
+    auto rows = Eigen::Index {1};
+    for(const auto& factor : factors_) {
+      rows *= factor.rows();
+    }
+    return rows;
+  }
+
+  Eigen::Index
+  cols() const {
+    auto cols = Eigen::Index {1};
+    for(const auto& factor : factors_) {
+      cols *= factor.cols();
+    }
+    return cols;
+  }
+
+  Kronecker kronecker() const { return kronecker_; }
+  const std::vector<Matrix_t>& factors() const { return factors_; }
+
+  /* Computes `y = A * x` in parallel over blocks of rows. */
+  void
+  apply(const Eigen::Ref<const Vector_t>& x, Eigen::Ref<Vector_t> y) const {
+
+    const auto factors = layout();
+
+    Expects( x.size() == factors.cols() );
+    Expects( y.size() == factors.rows() );
+
+    auto scratches = tbb::enumerable_thread_specific<typename implementation::KroneckerFactors<Matrix_t>::Scratch>(
+        [&factors]() { return factors.make_scratch(); });
+    implementation::parallel_for_blocks(0, factors.rows(),
+      [&](const auto& range) {
+        auto& scratch = scratches.local();
+        factors.split(range.begin(), scratch);
+        for(auto row = range.begin(); row != range.end(); ++row) {
+          auto sum = Scalar_t {0};
+          factors.for_each_entry(row, scratch, [&](Eigen::Index col, Scalar_t value) {
+            sum += value * x[col];
+          });
+          y[row] = sum;
+          factors.advance(scratch);
+        }
+      });
+  }
+
+  Vector_t
+  operator*(const Eigen::Ref<const Vector_t>& x) const {
+
+    auto y = Vector_t(rows());
+    apply(x, y);
+    return y;
+  }
+
+  /* The materialized operator, see `kron` and `kron_sum`. */
+  template <typename Stats_t = NoStats>
+  Matrix_t
+  to_matrix(Stats_t&& stats = Stats_t {}) const {
+
+    return implementation::kronecker_matrix(layout(), stats);
+  }
+
+private:
+  implementation::KroneckerFactors<Matrix_t>
+  layout() const {
+
+    auto factors = std::vector<const Matrix_t*> {};
+    for(const auto& factor : factors_) {
+      factors.push_back(&factor);
+    }
+    return implementation::KroneckerFactors<Matrix_t>::make(factors, kronecker_);
+  }
+
+  std::vector<Matrix_t> factors_;
+  Kronecker kronecker_ = Kronecker::PRODUCT;
+};
+
+template <typename InMatrixIter_t>
+KroneckerOperator(InMatrixIter_t, InMatrixIter_t)
+  -> KroneckerOperator<typename std::iterator_traits<InMatrixIter_t>::value_type>;
+
+template <typename InMatrixIter_t>
+KroneckerOperator(InMatrixIter_t, InMatrixIter_t, Kronecker)
+  -> KroneckerOperator<typename std::iterator_traits<InMatrixIter_t>::value_type>;
+
+} // namespace matrixgen
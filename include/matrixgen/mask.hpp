@@ -0,0 +1,331 @@
+/**
+ * Adjacency matrices of masked domains: boxes with holes, obstacles and
+ * inactive cells.
+ *
+ * A mask selects the active nodes of a grid, either as a predicate over the
+ * nodes' coordinates or as a container indexed by the nodes' indices (e.g. a
+ * `std::vector<uint8_t>` in x-then-y-then-z order). Only active nodes are
+ * degrees of freedom: `compact_numbering` numbers them consecutively in grid
+ * order, and `adjmat_masked` generates the matrix over this numbering such
+ * that inactive nodes get neither rows nor columns.
+ *
+ * ****************************************************************************
+ *   // A 64^3 box with a spherical obstacle in its center.
+ *   const auto grid = std::array {64, 64, 64};
+ *   const auto fluid = [](const std::array<int, 3>& c) {
+ *     return (c[0] - 32) * (c[0] - 32) + (c[1] - 32) * (c[1] - 32) + (c[2] - 32) * (c[2] - 32) > 100;
+ *   };
+ *   const auto matrix = matrixgen::adjmat_masked<Matrix_t, BC::NEUMANN>(
+ *     grid, fluid, matrixgen::stencil7p(), matrixgen::constweight(1.0));
+ * ****************************************************************************
+ */
+#pragma once
+
+#include <matrixgen/adjmat.hpp>
+#include <matrixgen/execution.hpp>
+#include <matrixgen/stats.hpp>
+#include <matrixgen/utility.hpp>
+
+#include <Eigen/Sparse>
+
+#include <gsl/gsl-lite.hpp>
+
+#include <tbb/enumerable_thread_specific.h>
+
+#include <algorithm>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace matrixgen
+{
+
+/**
+ * CompactNumbering
+ *
+ * Consecutive numbering of the active nodes of a grid. `rowOfNode[node]` is
+ * the matrix row (and column) of the node of index `node`, or -1 if the node
+ * is inactive; `nodeOfRow` is its inverse.
+ */
+template <typename Index_t = int>
+struct CompactNumbering {
+  std::vector<Index_t> rowOfNode;
+  std::vector<Index_t> nodeOfRow;
+
+  Eigen::Index rows() const { return static_cast<Eigen::Index>(nodeOfRow.size()); }
+  bool is_active(Eigen::Index node) const { return rowOfNode[node] >= 0; }
+};
+
+} // namespace matrixgen
+
+namespace matrixgen::implementation
+{
+
+/* True if the node `node` at `coords` is selected by `mask`, see 'mask.hpp'. */
+template <
+  typename Mask_t,
+  typename Index_t,
+  std::size_t RANK
+    >
+bool
+is_active_node(
+    const Mask_t& mask,
+    Eigen::Index node,
+    const Coords_t<Index_t, RANK>& coords) {
+
+  if constexpr (std::is_invocable_r<bool, const Mask_t&, Coords_t<Index_t, RANK>>()) {
+    return mask(coords);
+  }
+  else {
+    return static_cast<bool>(mask[node]);
+  }
+}
+
+} // namespace matrixgen::implementation
+
+namespace matrixgen
+{
+
+/**
+ * compact_numbering
+ *
+ * Numbers the nodes of the grid `gridDimensions` selected by `mask` in grid
+ * order. The mask is evaluated once per node in parallel; the rows are
+ * assigned by a parallel prefix sum over the active flags.
+ */
+template <
+  typename Index_t,
+  std::size_t RANK,
+  typename Mask_t
+    >
+CompactNumbering<Index_t>
+compact_numbering(
+    const Coords_t<Index_t, RANK>& gridDimensions,
+    const Mask_t& mask) {
+
+  const auto numOfNodes = implementation::num_of_nodes(gridDimensions);
+  auto activeCount = std::vector<Index_t>(numOfNodes);
+  implementation::parallel_for_blocks(0, numOfNodes,
+    [&](const auto& range) {
+      auto coords = implementation::get_node_coords(range.begin(), gridDimensions);
+      for(auto node = range.begin(); node != range.end(); ++node) {
+        activeCount[node] = implementation::is_active_node(mask, node, coords) ? 1 : 0;
+        for(auto dim = std::size_t {0}; dim < RANK && ++coords[dim] == gridDimensions[dim]; ++dim) {
+          coords[dim] = 0;
+        }
+      }
+    });
+  implementation::parallel_inclusive_scan(activeCount.begin(), activeCount.end());
+
+  auto numbering = CompactNumbering<Index_t> {};
+  numbering.rowOfNode.resize(numOfNodes);
+  numbering.nodeOfRow.resize(numOfNodes == 0 ? 0 : activeCount.back());
+  implementation::parallel_for_blocks(0, numOfNodes,
+    [&](const auto& range) {
+      for(auto node = range.begin(); node != range.end(); ++node) {
+        const auto row = node == 0 ? Index_t {0} : activeCount[node - 1];
+        if(activeCount[node] != row) {
+          numbering.rowOfNode[node] = row;
+          numbering.nodeOfRow[row] = static_cast<Index_t>(node);
+        }
+        else {
+          numbering.rowOfNode[node] = -1;
+        }
+      }
+    });
+  return numbering;
+}
+
+} // namespace matrixgen
+
+namespace matrixgen::implementation
+{
+
+/**
+ * Implementation of `adjmat_masked`. Rows are generated as in `AdjmatRows`,
+ * with the columns renumbered by the compact numbering. Neighbors which are
+ * inactive are dropped (`HOLE_BC == BC::DIRICHLET`) or mirrored at the node
+ * (`HOLE_BC == BC::NEUMANN`), i.e. the offset `o` becomes `-o`. Mirrored
+ * neighbors which are inactive or outside the grid are dropped.
+ */
+template <
+  typename OutMatrix_t,
+  typename AdjFn_t,
+  typename WeightFn_t,
+  typename Index_t,
+  std::size_t RANK,
+  auto HOLE_BC
+    >
+struct AdjmatMasked
+{
+  using Scalar_t = typename OutMatrix_t::Scalar;
+  using StorageIndex_t = typename OutMatrix_t::StorageIndex;
+  using OffsetRange_t = typename OffsetRangeOf<AdjFn_t, Index_t, RANK>::type;
+  using NodeCoords_t = Coords_t<Index_t, RANK>;
+
+  static_assert(std::is_same<decltype(HOLE_BC), BC>());
+  static_assert(HOLE_BC == BC::DIRICHLET || HOLE_BC == BC::NEUMANN,
+      "Holes support Dirichlet and Neumann boundary conditions only.");
+
+  using Rows_t = AdjmatRows<Scalar_t, AdjFn_t, WeightFn_t, Index_t, OffsetRange_t>;
+
+  // The shared per-thread state plus the active neighbors of a row.
+  struct Local : AdjmatLocal<Scalar_t, AdjFn_t, WeightFn_t, Index_t> {
+    std::vector<std::pair<Index_t, NodeCoords_t>> neighbors;
+  };
+
+  /**
+   * Collects the columns and coordinates of the active neighbors of the node
+   * of row `row` into `local.neighbors`, in the adjacency function's order.
+   */
+  static
+  NodeCoords_t
+  neighbors_of(
+      Eigen::Index row,
+      const NodeCoords_t& gridDimensions,
+      const CompactNumbering<Index_t>& numbering,
+      Local& local) {
+
+    const auto myCoords = get_node_coords(numbering.nodeOfRow[row], gridDimensions);
+    ++local.adjfnCalls;
+    const auto offsetRange = evaluate_adjfn<OffsetRange_t>(local.adjfn, myCoords, gridDimensions);
+    local.neighbors.clear();
+    for(auto offsetIt = offsetRange.first; offsetIt != offsetRange.second; ++offsetIt){
+      auto neighborCoords = myCoords + *offsetIt;
+      auto column = numbering.rowOfNode[get_node_index(neighborCoords, gridDimensions)];
+      if constexpr (HOLE_BC == BC::NEUMANN) {
+        if(column < 0) {
+          neighborCoords = myCoords - *offsetIt;
+          column = is_inside_grid<Index_t>(neighborCoords, gridDimensions) ?
+                     numbering.rowOfNode[get_node_index(neighborCoords, gridDimensions)] : -1;
+        }
+      }
+      if(column >= 0) {
+        local.neighbors.emplace_back(column, neighborCoords);
+      }
+    }
+    return myCoords;
+  }
+
+  template <typename Stats_t>
+  static
+  OutMatrix_t
+  invoke(
+      const NodeCoords_t& gridDimensions,
+      const CompactNumbering<Index_t>& numbering,
+      AdjFn_t adjfn,
+      WeightFn_t weightfn,
+      Stats_t& stats) {
+
+    static_assert(OutMatrix_t::IsRowMajor, "Masked domains require row-major matrices.");
+    static_assert(IS_CONST_WEIGHTFN<WeightFn_t, Index_t, RANK>,
+        "Masked domains require weight functions without mutable state.");
+
+    Expects( static_cast<Eigen::Index>(numbering.rowOfNode.size()) == num_of_nodes(gridDimensions) );
+
+    const auto matrixHeight = numbering.rows();
+    auto locals = tbb::enumerable_thread_specific<Local>(Local {{adjfn, weightfn, {}, {}}, {}});
+    auto result = OutMatrix_t {};
+    fill_compressed(result, matrixHeight, matrixHeight,
+        [&](Eigen::Index row) {
+          auto& local = locals.local();
+          neighbors_of(row, gridDimensions, numbering, local);
+          local.columns.clear();
+          for(const auto& neighbor : local.neighbors) {
+            local.columns.push_back(neighbor.first);
+          }
+          std::sort(local.columns.begin(), local.columns.end());
+          return std::distance(local.columns.begin(), std::unique(local.columns.begin(), local.columns.end()));
+        },
+        [&](Eigen::Index row, StorageIndex_t* innerFirst, Scalar_t* valueFirst, StorageIndex_t count) {
+          auto& local = locals.local();
+          const auto myCoords = neighbors_of(row, gridDimensions, numbering, local);
+          const auto ii = static_cast<Index_t>(row);
+          local.entries.clear();
+          for(const auto& [jj, neighborCoords] : local.neighbors) {
+            local.entries.emplace_back(jj, evaluate_weightfn<Scalar_t>(
+                local.weightfn, ii, jj, myCoords, neighborCoords, gridDimensions));
+          }
+          Rows_t::write_merged(local.entries, innerFirst, valueFirst, static_cast<Index_t>(count));
+          local.weightfnCalls += local.entries.size();
+          local.duplicatesMerged += local.entries.size() - static_cast<std::size_t>(count);
+        },
+        stats);
+    report_adjmat_calls(locals, stats);
+    return result;
+  }
+};
+
+} // namespace matrixgen::implementation
+
+namespace matrixgen
+{
+
+/**
+ * adjmat_masked
+ *
+ * Same as `adjmat(gridDimensions, adjfn, weightfn)` for a row-major matrix
+ * over the active nodes of `numbering` only, see `compact_numbering`. Row
+ * and column indices passed to the weight function are those of the compact
+ * numbering. Neighbors in inactive nodes are treated according to
+ * `HOLE_BC`:
+ *
+ *   - `BC::DIRICHLET` drops them,
+ *   - `BC::NEUMANN` mirrors them at the node, such that a hole at +1 becomes
+ *     the neighbor at -1, if that one is active.
+ *
+ * The adjacency function's own boundary conditions apply at the faces of the
+ * box. The weight function must not be a mutable lambda (e.g. `randweight`).
+ */
+template <
+  typename OutMatrix_t = Eigen::SparseMatrix<double, Eigen::RowMajor>,
+  auto HOLE_BC = BC::DIRICHLET,
+  typename AdjFn_t = void,
+  typename WeightFn_t = void,
+  typename Index_t = int,
+  std::size_t RANK = 3,
+  typename Stats_t = NoStats
+    >
+OutMatrix_t
+adjmat_masked(
+    const Coords_t<Index_t, RANK>& gridDimensions,
+    const CompactNumbering<Index_t>& numbering,
+    AdjFn_t adjfn,
+    WeightFn_t weightfn,
+    Stats_t&& stats = Stats_t {}) {
+
+  return implementation::AdjmatMasked<OutMatrix_t, AdjFn_t, WeightFn_t, Index_t, RANK, HOLE_BC>::
+          invoke(gridDimensions, numbering, adjfn, weightfn, stats);
+}
+
+/**
+ * As above for the nodes selected by `mask`, a predicate over the nodes'
+ * coordinates or a container indexed by the nodes' indices. Use the
+ * overload above to generate several matrices on the same domain.
+ */
+template <
+  typename OutMatrix_t = Eigen::SparseMatrix<double, Eigen::RowMajor>,
+  auto HOLE_BC = BC::DIRICHLET,
+  typename Mask_t = void,
+  typename AdjFn_t = void,
+  typename WeightFn_t = void,
+  typename Index_t = int,
+  std::size_t RANK = 3,
+  typename Stats_t = NoStats
+    >
+OutMatrix_t
+adjmat_masked(
+    const Coords_t<Index_t, RANK>& gridDimensions,
+    const Mask_t& mask,
+    AdjFn_t adjfn,
+    WeightFn_t weightfn,
+    Stats_t&& stats = Stats_t {}) {
+
+  const auto numbering = [&]() {
+    [[maybe_unused]] const auto phase = implementation::ScopedPhase(stats, "mask.numbering");
+    return compact_numbering(gridDimensions, mask);
+  }();
+  return adjmat_masked<OutMatrix_t, HOLE_BC>(gridDimensions, numbering, adjfn, weightfn, stats);
+}
+
+} // namespace matrixgen
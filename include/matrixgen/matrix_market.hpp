@@ -0,0 +1,454 @@
+/**
+ * Parallel reader and writer for the Matrix Market exchange format
+ * (coordinate format, real / integer / pattern fields, general / symmetric /
+ * skew-symmetric matrices).
+ *
+ * Both directions bypass iostream formatting: entries are formatted with
+ * `std::to_chars` and parsed with `std::from_chars` in parallel chunks, while
+ * the file itself is written in large sequential blocks or read through a
+ * memory mapping.
+ */
+#pragma once
+
+#include <matrixgen/binary.hpp>
+#include <matrixgen/create.hpp>
+#include <matrixgen/execution.hpp>
+#include <matrixgen/trace.hpp>
+
+#include <Eigen/Sparse>
+
+#include <gsl/gsl-lite.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstring>
+#include <fstream>
+#include <numeric>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace matrixgen::implementation
+{
+
+// Approximate number of nonzeros formatted per parallel chunk.
+constexpr Eigen::Index MTX_CHUNK_NNZ = 1 << 16;
+
+// Width reserved for the number of nonzeros in the size line such that it
+// can be patched once all blocks have been written.
+constexpr std::size_t MTX_NNZ_FIELD_WIDTH = 20;
+
+/**
+ * Formats the nonzeros of the outers [outerBegin, outerEnd) of a compressed
+ * matrix as 1-based Matrix Market coordinate lines into `buffer`. The
+ * entries' row (column) indices are shifted by `rowOffset` (`colOffset`).
+ */
+template <
+  bool IS_ROW_MAJOR,
+  typename Scalar_t,
+  typename Index_t
+    >
+void
+format_mtx_entries(
+    std::vector<char>& buffer,
+    const Index_t* outerIndex,
+    const Index_t* innerIndex,
+    const Scalar_t* values,
+    Eigen::Index outerBegin,
+    Eigen::Index outerEnd,
+    Eigen::Index rowOffset,
+    Eigen::Index colOffset) {
+
+  // Two 20-digit integers, a value of at most 32 characters, two separators
+  // and a newline.
+  constexpr std::size_t MAX_LINE = 20 + 1 + 20 + 1 + 32 + 1;
+  const auto nnz = static_cast<std::size_t>(outerIndex[outerEnd] - outerIndex[outerBegin]);
+  buffer.resize(nnz * MAX_LINE);
+
+  char* out = buffer.data();
+  char* const end = buffer.data() + buffer.size();
+  for(auto outer = outerBegin; outer < outerEnd; ++outer) {
+    for(auto k = outerIndex[outer]; k < outerIndex[outer + 1]; ++k) {
+      const auto row = (IS_ROW_MAJOR ? outer : innerIndex[k]) + rowOffset + 1;
+      const auto col = (IS_ROW_MAJOR ? innerIndex[k] : outer) + colOffset + 1;
+      out = std::to_chars(out, end, row).ptr;
+      *out++ = ' ';
+      out = std::to_chars(out, end, col).ptr;
+      *out++ = ' ';
+      out = std::to_chars(out, end, values[k]).ptr;
+      *out++ = '\n';
+    }
+  }
+  buffer.resize(out - buffer.data());
+}
+
+/**
+ * Splits `text` into at most `numChunks` pieces which begin and end at line
+ * boundaries. Returns the pieces' begin offsets followed by `text.size()`.
+ */
+inline
+std::vector<std::size_t>
+split_at_lines(std::string_view text, std::size_t numChunks) {
+
+  auto bounds = std::vector<std::size_t> {0};
+  for(std::size_t ii = 1; ii < numChunks; ++ii) {
+    auto pos = std::max(text.size() * ii / numChunks, bounds.back());
+    pos = text.find('\n', pos);
+    if(pos == std::string_view::npos) {
+      break;
+    }
+    if(pos + 1 > bounds.back()) {
+      bounds.push_back(pos + 1);
+    }
+  }
+  bounds.push_back(text.size());
+  return bounds;
+}
+
+/**
+ * Returns true if the line [first, last) contains nothing but whitespace.
+ */
+inline
+bool
+is_blank(const char* first, const char* last) {
+
+  return std::all_of(first, last, [](char c) { return c == ' ' || c == '\t' || c == '\r'; });
+}
+
+inline
+const char*
+skip_blanks(const char* first, const char* last) {
+
+  while(first != last && (*first == ' ' || *first == '\t' || *first == '+')) {
+    ++first;
+  }
+  return first;
+}
+
+/**
+ * Parses one number from [first, last), skipping leading blanks. Throws on
+ * malformed input.
+ */
+template <typename Number_t>
+const char*
+parse_number(const char* first, const char* last, Number_t& number) {
+
+  first = skip_blanks(first, last);
+  const auto [ptr, ec] = std::from_chars(first, last, number);
+  if(ec != std::errc {}) {
+    throw std::runtime_error("matrixgen: malformed Matrix Market entry '" + std::string(first, last) + "'");
+  }
+  return ptr;
+}
+
+struct MtxBanner {
+  bool pattern = false;
+  bool symmetric = false;
+  bool skew = false;
+};
+
+/**
+ * Parses the `%%MatrixMarket` banner line.
+ */
+inline
+MtxBanner
+parse_mtx_banner(std::string_view line) {
+
+  auto lower = std::string(line);
+  std::transform(lower.begin(), lower.end(), lower.begin(), [](unsigned char c) { return std::tolower(c); });
+
+  if(lower.rfind("%%matrixmarket matrix coordinate", 0) != 0) {
+    throw std::runtime_error("matrixgen: only Matrix Market 'matrix coordinate' files are supported");
+  }
+  auto banner = MtxBanner {};
+  banner.pattern = lower.find(" pattern") != std::string::npos;
+  if(lower.find(" complex") != std::string::npos || lower.find(" hermitian") != std::string::npos) {
+    throw std::runtime_error("matrixgen: complex and hermitian Matrix Market files are not supported");
+  }
+  banner.skew = lower.find(" skew-symmetric") != std::string::npos;
+  banner.symmetric = !banner.skew && lower.find(" symmetric") != std::string::npos;
+  return banner;
+}
+
+} // namespace matrixgen::implementation
+
+namespace matrixgen
+{
+
+/**
+ * MatrixMarketWriter
+ *
+ * Writes a Matrix Market coordinate file from one or more blocks of
+ * nonzeros. Each block is any compressed Eigen sparse matrix (including
+ * `Eigen::Map`s, e.g. from `as_map`) and is placed at a row (column) offset
+ * within the full matrix, which makes the writer suitable for matrices
+ * produced block by block. Blocks may be written in any order.
+ *
+ * Every block is cut into chunks which are formatted in parallel and
+ * appended to the file in order by a TBB pipeline, so formatting overlaps
+ * with writing and memory is bounded by the number of chunks in flight.
+ * The number of nonzeros in the size line is patched in by `close()`, which
+ * is also called on destruction.
+ */
+template <
+  typename Scalar_t = double
+    >
+class MatrixMarketWriter {
+public:
+  MatrixMarketWriter(const std::string& path, Eigen::Index rows, Eigen::Index cols)
+    : file_(path, std::ios::binary | std::ios::trunc), path_(path) {
+
+    static_assert(std::is_arithmetic<Scalar_t>(), "Only real and integer matrices are supported.");
+    if(!file_) {
+      throw std::runtime_error("matrixgen: cannot open '" + path + "' for writing");
+    }
+
+    const auto field = std::is_integral<Scalar_t>() ? "integer" : "real";
+    const auto banner = std::string("%%MatrixMarket matrix coordinate ") + field + " general\n";
+    const auto size = std::to_string(rows) + " " + std::to_string(cols) + " ";
+    file_ << banner << size;
+    nnzFieldPos_ = file_.tellp();
+    file_ << std::string(implementation::MTX_NNZ_FIELD_WIDTH, ' ') << '\n';
+  }
+
+  MatrixMarketWriter(const MatrixMarketWriter&) = delete;
+  MatrixMarketWriter& operator=(const MatrixMarketWriter&) = delete;
+
+  ~MatrixMarketWriter() {
+    try {
+      close();
+    }
+    catch(...) { // NOLINT(bugprone-empty-catch): destructors must not throw
+    }
+  }
+
+  /**
+   * Appends the nonzeros of `block`, whose entry (i, j) is written as entry
+   * (i + rowOffset, j + colOffset) of the full matrix.
+   */
+  template <typename Block_t>
+  void
+  write(const Block_t& block, Eigen::Index rowOffset = 0, Eigen::Index colOffset = 0) {
+
+    Expects( file_.is_open() );
+    Expects( block.isCompressed() );
+
+    const auto trace = implementation::TraceScope("mtx.write_block", rowOffset, rowOffset + block.rows());
+
+    constexpr bool IS_ROW_MAJOR = Block_t::IsRowMajor;
+    const auto* outerIndex = block.outerIndexPtr();
+    const auto* innerIndex = block.innerIndexPtr();
+    const auto* values = block.valuePtr();
+    const auto outerSize = block.outerSize();
+
+    auto outer = Eigen::Index {0};
+    implementation::ordered_pipeline(static_cast<std::size_t>(4 * implementation::current_concurrency()),
+      // (1) Cut the next chunk of roughly `MTX_CHUNK_NNZ` nonzeros.
+      [&]() -> std::optional<std::pair<Eigen::Index, Eigen::Index>> {
+        if(outer >= outerSize) {
+          return std::nullopt;
+        }
+        const auto begin = outer;
+        const auto* limit = std::upper_bound(outerIndex + begin + 1, outerIndex + outerSize + 1,
+            outerIndex[begin] + implementation::MTX_CHUNK_NNZ);
+        outer = std::max<Eigen::Index>(begin + 1, (limit - outerIndex) - 1);
+        return std::pair {begin, outer};
+      },
+      // (2) Format the chunk.
+      [&](std::pair<Eigen::Index, Eigen::Index> chunk) {
+        const auto trace = implementation::TraceScope("mtx.format", chunk.first, chunk.second);
+        auto buffer = std::vector<char> {};
+        implementation::format_mtx_entries<IS_ROW_MAJOR>(buffer, outerIndex, innerIndex, values,
+            chunk.first, chunk.second, rowOffset, colOffset);
+        return buffer;
+      },
+      // (3) Append it to the file.
+      [&](const std::vector<char>& buffer) {
+        const auto trace = implementation::TraceScope("mtx.write");
+        file_.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+      });
+
+    nonZeros_ += outerIndex[outerSize] - outerIndex[0];
+    if(!file_) {
+      throw std::runtime_error("matrixgen: failed writing '" + path_ + "'");
+    }
+  }
+
+  /**
+   * Patches the total number of nonzeros into the size line and closes the
+   * file.
+   */
+  void
+  close() {
+
+    if(!file_.is_open()) {
+      return;
+    }
+    file_.seekp(nnzFieldPos_);
+    file_ << nonZeros_;
+    file_.close();
+    if(file_.fail()) {
+      throw std::runtime_error("matrixgen: failed writing '" + path_ + "'");
+    }
+  }
+
+  Eigen::Index nonZeros() const { return nonZeros_; }
+
+private:
+  std::ofstream file_;
+  std::string path_;
+  std::streampos nnzFieldPos_ {};
+  Eigen::Index nonZeros_ = 0;
+};
+
+/**
+ * write_matrix_market
+ *
+ * Writes a compressed sparse matrix, or a map onto one, to `path` in Matrix
+ * Market coordinate format. See `MatrixMarketWriter`.
+ */
+template <
+  typename Matrix_t
+    >
+void
+write_matrix_market(const std::string& path, const Matrix_t& matrix) {
+
+  using Scalar_t = std::remove_const_t<typename Matrix_t::Scalar>;
+  auto writer = MatrixMarketWriter<Scalar_t>(path, matrix.rows(), matrix.cols());
+  writer.write(matrix);
+  writer.close();
+}
+
+/**
+ * read_matrix_market
+ *
+ * Reads a Matrix Market coordinate file into a compressed sparse matrix. The
+ * file is memory-mapped and split into chunks at line boundaries which are
+ * parsed in parallel directly into coordinate arrays; the compressed matrix
+ * is then built by `create_coo`. Symmetric and skew-symmetric files are
+ * expanded to general matrices. Pattern files yield ones. Duplicate entries
+ * are summed up. Throws on malformed files.
+ */
+template <
+  typename Matrix_t = Eigen::SparseMatrix<double, Eigen::RowMajor>
+    >
+Matrix_t
+read_matrix_market(const std::string& path) {
+
+  using Scalar_t = typename Matrix_t::Scalar;
+  using Index_t = typename Matrix_t::StorageIndex;
+
+  const auto trace = implementation::TraceScope("read_matrix_market");
+  const auto file = implementation::MappedFile(path);
+  auto text = std::string_view(file.data(), file.size());
+
+  // (1) Banner, comments and the size line.
+  auto next_line = [&text]() {
+    const auto eol = std::min(text.find('\n'), text.size());
+    const auto line = text.substr(0, eol);
+    text.remove_prefix(std::min(eol + 1, text.size()));
+    return line;
+  };
+  const auto banner = implementation::parse_mtx_banner(next_line());
+  auto sizeLine = std::string_view {};
+  while(!text.empty()) {
+    sizeLine = next_line();
+    if(!sizeLine.empty() && sizeLine.front() != '%' &&
+       !implementation::is_blank(sizeLine.data(), sizeLine.data() + sizeLine.size())) {
+      break;
+    }
+    sizeLine = {};
+  }
+  auto rows = Eigen::Index {};
+  auto cols = Eigen::Index {};
+  auto nnz = Eigen::Index {};
+  {
+    const auto* last = sizeLine.data() + sizeLine.size();
+    const auto* pos = implementation::parse_number(sizeLine.data(), last, rows);
+    pos = implementation::parse_number(pos, last, cols);
+    implementation::parse_number(pos, last, nnz);
+  }
+
+  // (2) Count the entries of every chunk.
+  const auto numChunks = std::max<std::size_t>(
+      4 * static_cast<std::size_t>(implementation::current_concurrency()), text.size() >> 23U);
+  const auto bounds = implementation::split_at_lines(text, numChunks);
+  const auto numBounded = bounds.size() - 1;
+
+  auto for_each_line = [&text, &bounds](std::size_t chunk, auto fn) {
+    const char* first = text.data() + bounds[chunk];
+    const char* const last = text.data() + bounds[chunk + 1];
+    while(first < last) {
+      const char* eol = static_cast<const char*>(std::memchr(first, '\n', last - first));
+      eol = eol == nullptr ? last : eol;
+      if(!implementation::is_blank(first, eol) && *first != '%') {
+        fn(first, eol);
+      }
+      first = eol + 1;
+    }
+  };
+
+  auto offsets = std::vector<Eigen::Index>(numBounded + 1, 0);
+  implementation::parallel_for_blocks(0, static_cast<Eigen::Index>(numBounded),
+    [&](const auto& range) {
+      for(auto chunk = static_cast<std::size_t>(range.begin()); chunk != static_cast<std::size_t>(range.end()); ++chunk) {
+        const auto chunkTrace = implementation::TraceScope("mtx.count", bounds[chunk], bounds[chunk + 1]);
+        for_each_line(chunk, [&](const char*, const char*) { ++offsets[chunk + 1]; });
+      }
+    });
+  std::inclusive_scan(offsets.begin(), offsets.end(), offsets.begin());
+  if(offsets.back() != nnz) {
+    throw std::runtime_error("matrixgen: '" + path + "' declares " + std::to_string(nnz) +
+        " entries but contains " + std::to_string(offsets.back()));
+  }
+
+  // (3) Parse entries in parallel. Symmetric files store every entry twice,
+  //     at (i, j) and (j, i); the mirror of a diagonal entry is stored as an
+  //     explicit zero which vanishes when duplicates are summed.
+  const auto mirror = banner.symmetric || banner.skew;
+  const auto stride = mirror ? 2 : 1;
+  auto rowIndices = std::vector<Index_t>(stride * nnz);
+  auto colIndices = std::vector<Index_t>(stride * nnz);
+  auto values = std::vector<Scalar_t>(stride * nnz);
+  implementation::parallel_for_blocks(0, static_cast<Eigen::Index>(numBounded),
+    [&](const auto& range) {
+      for(auto chunk = static_cast<std::size_t>(range.begin()); chunk != static_cast<std::size_t>(range.end()); ++chunk) {
+        const auto chunkTrace = implementation::TraceScope("mtx.parse", offsets[chunk], offsets[chunk + 1]);
+        auto k = offsets[chunk];
+        for_each_line(chunk, [&](const char* first, const char* last) {
+          auto row = Eigen::Index {};
+          auto col = Eigen::Index {};
+          auto value = Scalar_t {1};
+          first = implementation::parse_number(first, last, row);
+          first = implementation::parse_number(first, last, col);
+          if(!banner.pattern) {
+            implementation::parse_number(first, last, value);
+          }
+          if(row < 1 || row > rows || col < 1 || col > cols) {
+            throw std::runtime_error("matrixgen: entry (" + std::to_string(row) + ", " +
+                std::to_string(col) + ") is outside of the matrix in '" + path + "'");
+          }
+          rowIndices[stride * k] = static_cast<Index_t>(row - 1);
+          colIndices[stride * k] = static_cast<Index_t>(col - 1);
+          values[stride * k] = value;
+          if(mirror) {
+            rowIndices[stride * k + 1] = static_cast<Index_t>(col - 1);
+            colIndices[stride * k + 1] = static_cast<Index_t>(row - 1);
+            values[stride * k + 1] = row == col ? Scalar_t {0} : (banner.skew ? -value : value);
+          }
+          ++k;
+        });
+      }
+    });
+
+  // (4) Build the compressed matrix.
+  const auto buildTrace = implementation::TraceScope("mtx.build", 0, stride * nnz);
+  return create_coo<Matrix_t>(rows, cols,
+      rowIndices.cbegin(), rowIndices.cend(), colIndices.cbegin(), values.cbegin());
+}
+
+} // namespace matrixgen
@@ -0,0 +1,188 @@
+/**
+ * Memory resources for the generators' scratch buffers.
+ *
+ * The temporaries of `adjmat`, `perturb`, `central_moving_sum`,
+ * `closed_loop_moving_mean` and `darts_sampling` are allocated from a
+ * `std::pmr::memory_resource` passed as their trailing argument, which
+ * defaults to `std::pmr::get_default_resource()`. The resources below measure
+ * and recycle these allocations. The returned matrices are not affected.
+ *
+ * ****************************************************************************
+ *   auto counter = matrixgen::CountingResource {};
+ *   auto matrix = matrixgen::adjmat(grid, adjfn, weightfn, matrixgen::NoStats {}, &counter);
+ *   std::cout << counter.peak_bytes() << " bytes of scratch space\n";
+ * ****************************************************************************
+ */
+#pragma once
+
+#include <gsl/gsl-lite.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <optional>
+
+namespace matrixgen
+{
+
+/**
+ * CountingResource
+ *
+ * Forwards all requests to `upstream` and records the number of
+ * allocations, the bytes currently in use and their high-water mark. Call
+ * `reset_peak` before a generator call to obtain the call's peak.
+ *
+ * May be shared by concurrent generator calls if `upstream` may.
+ */
+class CountingResource : public std::pmr::memory_resource {
+public:
+  explicit CountingResource(std::pmr::memory_resource* upstream = std::pmr::get_default_resource())
+    : upstream_(upstream) {
+
+    Expects( upstream != nullptr );
+  }
+
+  CountingResource(const CountingResource&) = delete;
+  CountingResource& operator=(const CountingResource&) = delete;
+
+  uint64_t allocations() const { return allocations_; }
+  uint64_t bytes_in_use() const { return inUse_; }
+  uint64_t peak_bytes() const { return peak_; }
+
+  /* Resets the high-water mark to the bytes currently in use. */
+  void reset_peak() {
+    allocations_ = 0;
+    peak_ = inUse_.load();
+  }
+
+private:
+  void* do_allocate(std::size_t bytes, std::size_t alignment) override {
+    auto* p = upstream_->allocate(bytes, alignment);
+    ++allocations_;
+    const auto inUse = inUse_ += bytes;
+    auto peak = peak_.load();
+    while(peak < inUse && !peak_.compare_exchange_weak(peak, inUse)) {}
+    return p;
+  }
+
+  void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override {
+    upstream_->deallocate(p, bytes, alignment);
+    inUse_ -= bytes;
+  }
+
+  bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+    return this == &other;
+  }
+
+  std::pmr::memory_resource* upstream_;
+  std::atomic<uint64_t> allocations_ {0};
+  std::atomic<uint64_t> inUse_ {0};
+  std::atomic<uint64_t> peak_ {0};
+};
+
+/**
+ * ScratchArena
+ *
+ * Monotonic arena for repeated generator calls. Allocations are served from
+ * a single block and deallocations are ignored until `rewind`. Requests
+ * which do not fit into the block are served by `upstream`; the next
+ * `rewind` then grows the block to the observed high-water mark, so that
+ * once the arena has warmed up repeated calls of the same size do not
+ * allocate at all.
+ *
+ * Not thread-safe. Must outlive every container allocated from it.
+ *
+ * ****************************************************************************
+ *   auto arena = matrixgen::ScratchArena {};
+ *   for(auto seed : seeds) {
+ *     auto matrix = matrixgen::perturb(base, first, last, seed, matrixgen::NoStats {}, &arena);
+ *     ...
+ *     arena.rewind();
+ *   }
+ * ****************************************************************************
+ */
+class ScratchArena : public std::pmr::memory_resource {
+public:
+  explicit ScratchArena(
+      std::size_t initialBytes = 0,
+      std::pmr::memory_resource* upstream = std::pmr::get_default_resource())
+    : upstream_(upstream) {
+
+    Expects( upstream != nullptr );
+    reserve(initialBytes);
+  }
+
+  ScratchArena(const ScratchArena&) = delete;
+  ScratchArena& operator=(const ScratchArena&) = delete;
+
+  ~ScratchArena() {
+    monotonic_.reset();
+    if(block_ != nullptr) {
+      upstream_->deallocate(block_, capacity_, alignof(std::max_align_t));
+    }
+  }
+
+  /* Size of the arena's block in bytes. */
+  std::size_t capacity() const { return capacity_; }
+
+  /* Bytes handed out since the last `rewind`, including alignment padding. */
+  std::size_t bytes_used() const { return used_; }
+
+  /* Largest `bytes_used` observed. */
+  std::size_t peak_bytes() const { return peak_; }
+
+  /**
+   * Releases all allocations at once and, if the block overflowed since the
+   * last rewind, replaces it by a block of `peak_bytes` bytes.
+   */
+  void rewind() {
+    if(peak_ > capacity_) {
+      reserve(peak_);
+    }
+    else {
+      monotonic_->release();
+    }
+    used_ = 0;
+  }
+
+private:
+  void reserve(std::size_t bytes) {
+    monotonic_.reset();
+    if(block_ != nullptr) {
+      upstream_->deallocate(block_, capacity_, alignof(std::max_align_t));
+      block_ = nullptr;
+      capacity_ = 0;
+    }
+    if(bytes > 0) {
+      block_ = upstream_->allocate(bytes, alignof(std::max_align_t));
+      capacity_ = bytes;
+      monotonic_.emplace(block_, capacity_, upstream_);
+    }
+    else {
+      monotonic_.emplace(upstream_);
+    }
+  }
+
+  void* do_allocate(std::size_t bytes, std::size_t alignment) override {
+    used_ += bytes + (alignment - used_ % alignment) % alignment;
+    peak_ = std::max(peak_, used_);
+    return monotonic_->allocate(bytes, alignment);
+  }
+
+  void do_deallocate(void*, std::size_t, std::size_t) override {}
+
+  bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+    return this == &other;
+  }
+
+  std::pmr::memory_resource* upstream_;
+  void* block_ = nullptr;
+  std::size_t capacity_ = 0;
+  std::size_t used_ = 0;
+  std::size_t peak_ = 0;
+  std::optional<std::pmr::monotonic_buffer_resource> monotonic_;
+};
+
+} // namespace matrixgen
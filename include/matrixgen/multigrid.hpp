@@ -0,0 +1,439 @@
+/**
+ * Level hierarchies of geometric multigrid: coarse operators and the
+ * transfer matrices between the levels.
+ *
+ * Levels are vertex-centered: with the coarsening factor `f`, the coarse
+ * node `c` coincides with the fine node `f * c` in every dimension, and a
+ * dimension of extent `n` coarsens to `(n - 1) / f + 1` nodes. Grids whose
+ * extents minus one are divisible by `f` on every level nest exactly.
+ *
+ * ****************************************************************************
+ *   auto options = matrixgen::MultigridOptions {};
+ *   options.coarseOperator = matrixgen::CoarseOperator::GALERKIN;
+ *   const auto levels = matrixgen::multigrid_hierarchy(std::array {129, 129, 129},
+ *     matrixgen::stencil7p(), matrixgen::constweight(1.0), options);
+ *   // levels[l].matrix, levels[l].restriction, levels[l].prolongation
+ * ****************************************************************************
+ */
+#pragma once
+
+#include <matrixgen/adjmat.hpp>
+#include <matrixgen/stats.hpp>
+#include <matrixgen/utility.hpp>
+
+#include <Eigen/Sparse>
+
+#include <gsl/gsl-lite.hpp>
+
+#include <tbb/enumerable_thread_specific.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <utility>
+#include <vector>
+
+namespace matrixgen
+{
+
+/**
+ * Transfer
+ *
+ * One-dimensional weights between the fine node `i` and the coarse node `c`,
+ * combined by tensor product across dimensions:
+ *
+ *   - `INJECTION`: 1 if `i == f * c`, otherwise 0,
+ *   - `MULTILINEAR`: `max(0, 1 - |i - f * c| / f)`, i.e. linear, bilinear and
+ *     trilinear interpolation in 1D, 2D and 3D,
+ *   - `FULL_WEIGHTING`: the multilinear weights scaled by `1 / f`, e.g. the
+ *     weights 1/4, 1/2, 1/4 for `f == 2`.
+ */
+enum class Transfer {
+  INJECTION,
+  MULTILINEAR,
+  FULL_WEIGHTING
+};
+
+/**
+ * CoarseOperator
+ *
+ *   - `REDISCRETIZED` coarse operators are generated by `adjmat` on the
+ *     coarse grid with the same adjacency and weight functions, which see the
+ *     coarse grid's coordinates and dimensions,
+ *   - `GALERKIN` coarse operators are the products `R * A * P` of the next
+ *     finer level's operator and transfer matrices.
+ */
+enum class CoarseOperator {
+  REDISCRETIZED,
+  GALERKIN
+};
+
+/**
+ * MultigridOptions
+ *
+ * Coarsening continues until `maxLevels` levels (0 for no limit) are
+ * generated or no dimension can be coarsened any further.
+ */
+struct MultigridOptions {
+  int coarseningFactor = 2;
+  int maxLevels = 0;
+  Transfer restriction = Transfer::FULL_WEIGHTING;
+  Transfer prolongation = Transfer::MULTILINEAR;
+  CoarseOperator coarseOperator = CoarseOperator::GALERKIN;
+};
+
+/**
+ * MultigridLevel
+ *
+ * The operator of a level and the transfer matrices between the level and
+ * the next coarser one. The transfer matrices of the coarsest level are
+ * empty.
+ */
+template <
+  typename Matrix_t,
+  typename Index_t = int,
+  std::size_t RANK = 3
+    >
+struct MultigridLevel {
+  Coords_t<Index_t, RANK> gridDimensions;
+  Matrix_t matrix;
+  Matrix_t restriction;   // to the next coarser level
+  Matrix_t prolongation;  // from the next coarser level
+};
+
+} // namespace matrixgen
+
+namespace matrixgen::implementation
+{
+
+/* The extent of a dimension of extent `extent` after coarsening by `factor`. */
+template <typename Index_t>
+Index_t
+coarse_extent(Index_t extent, int factor) {
+  return (extent - 1) / factor + 1;
+}
+
+/* The weight between the fine node `fine` and the coarse node `coarse`, see `Transfer`. */
+template <typename Scalar_t>
+Scalar_t
+transfer_weight(Transfer transfer, Eigen::Index fine, Eigen::Index coarse, int factor) {
+
+  const auto distance = std::abs(fine - factor * coarse);
+  if(transfer == Transfer::INJECTION) {
+    return distance == 0 ? Scalar_t {1} : Scalar_t {0};
+  }
+  const auto weight = distance < factor ? static_cast<Scalar_t>(factor - distance) / factor : Scalar_t {0};
+  return transfer == Transfer::MULTILINEAR ? weight : weight / factor;
+}
+
+/**
+ * Transfer matrix between two grids given by the tensor product of its
+ * one-dimensional factors: `weights[d][i]` lists the columns and nonzero
+ * weights of the row `i` of the factor of dimension `d` in ascending order.
+ * Rows are never materialized before they are written.
+ */
+template <
+  typename Scalar_t,
+  typename Index_t,
+  std::size_t RANK
+    >
+struct TensorTransfer
+{
+  using Weights_t = std::vector<std::vector<std::pair<Index_t, Scalar_t>>>;
+
+  Coords_t<Index_t, RANK> rowDimensions;
+  Coords_t<Index_t, RANK> colDimensions;
+  std::array<Weights_t, RANK> weights;
+
+  /**
+   * The prolongation (`RESTRICTION` unset) from the coarse grid of
+   * `fineDimensions` by `factor`, or the restriction to it.
+   */
+  template <bool RESTRICTION>
+  static
+  TensorTransfer
+  make(const Coords_t<Index_t, RANK>& fineDimensions, int factor, Transfer transfer) {
+
+    auto result = TensorTransfer {};
+    for(auto dim = std::size_t {0}; dim < RANK; ++dim) {
+      const auto fine = fineDimensions[dim];
+      const auto coarse = coarse_extent(fine, factor);
+      const auto rows = RESTRICTION ? coarse : fine;
+      auto& weights = result.weights[dim];
+      weights.resize(rows);
+      for(auto row = Index_t {0}; row < rows; ++row) {
+        // The candidates of nonzero weights lie within one factor's distance.
+        const auto first = RESTRICTION ? std::max<Index_t>(0, factor * row - factor + 1) : row / factor;
+        const auto last = RESTRICTION ? std::min<Index_t>(fine, factor * row + factor) : std::min<Index_t>(coarse, (row + factor - 1) / factor + 1);
+        for(auto col = first; col < last; ++col) {
+          const auto weight = RESTRICTION ? transfer_weight<Scalar_t>(transfer, col, row, factor) :
+                                            transfer_weight<Scalar_t>(transfer, row, col, factor);
+          if(weight != Scalar_t {0}) {
+            weights[row].emplace_back(col, weight);
+          }
+        }
+      }
+      result.rowDimensions[dim] = rows;
+      result.colDimensions[dim] = RESTRICTION ? fine : coarse;
+    }
+    return result;
+  }
+
+  /* Calls `fn(column, weight)` for the nonzeros of row `row` in ascending column order. */
+  template <typename Fn_t>
+  void
+  for_each_entry(Eigen::Index row, Fn_t&& fn) const {
+
+    const auto coords = get_node_coords(row, rowDimensions);
+    std::array<const std::vector<std::pair<Index_t, Scalar_t>>*, RANK> factors {};
+    for(auto dim = std::size_t {0}; dim < RANK; ++dim) {
+      factors[dim] = &weights[dim][coords[dim]];
+      if(factors[dim]->empty()) {
+        return;
+      }
+    }
+
+    // Odometer over the factors' entries, the first dimension fastest.
+    auto positions = std::array<std::size_t, RANK> {};
+    while(true) {
+      auto column = Index_t {0};
+      auto weight = Scalar_t {1};
+      for(auto dim = RANK; dim-- > 0;) {
+        const auto& [col, value] = (*factors[dim])[positions[dim]];
+        column = column * colDimensions[dim] + col;
+        weight *= value;
+      }
+      fn(column, weight);
+
+      auto dim = std::size_t {0};
+      for(; dim < RANK && ++positions[dim] == factors[dim]->size(); ++dim) {
+        positions[dim] = 0;
+      }
+      if(dim == RANK) {
+        return;
+      }
+    }
+  }
+
+  Eigen::Index
+  row_size(Eigen::Index row) const {
+
+    const auto coords = get_node_coords(row, rowDimensions);
+    auto size = Eigen::Index {1};
+    for(auto dim = std::size_t {0}; dim < RANK; ++dim) {
+      size *= static_cast<Eigen::Index>(weights[dim][coords[dim]].size());
+    }
+    return size;
+  }
+
+  template <typename Matrix_t>
+  Matrix_t
+  to_matrix() const {
+
+    using StorageIndex_t = typename Matrix_t::StorageIndex;
+    using MatrixScalar_t = typename Matrix_t::Scalar;
+
+    auto result = Matrix_t {};
+    fill_compressed(result, num_of_nodes(rowDimensions), num_of_nodes(colDimensions),
+        [&](Eigen::Index row) { return row_size(row); },
+        [&](Eigen::Index row, StorageIndex_t* innerFirst, MatrixScalar_t* valueFirst, StorageIndex_t) {
+          for_each_entry(row, [&](Index_t col, Scalar_t weight) {
+            *innerFirst++ = static_cast<StorageIndex_t>(col);
+            *valueFirst++ = static_cast<MatrixScalar_t>(weight);
+          });
+        });
+    return result;
+  }
+};
+
+/**
+ * Sorts `entries` by column and sums up the values of equal columns in
+ * their order in `entries`.
+ */
+template <
+  typename Index_t,
+  typename Scalar_t
+    >
+void
+merge_entries(std::vector<std::pair<Index_t, Scalar_t>>& entries) {
+
+  std::stable_sort(entries.begin(), entries.end(),
+      [](const auto& a, const auto& b) { return a.first < b.first; });
+  auto out = entries.begin();
+  for(auto it = entries.begin(); it != entries.end(); ++it) {
+    if(out != entries.begin() && std::prev(out)->first == it->first) {
+      std::prev(out)->second += it->second;
+    }
+    else {
+      *out++ = *it;
+    }
+  }
+  entries.erase(out, entries.end());
+}
+
+/**
+ * Galerkin product `R * A * P` for tensor-product transfers, computed row by
+ * row: the rows of `R` and `P` are enumerated from their one-dimensional
+ * factors, the row of `R * A` is merged over the fine columns and the row of
+ * `R * A * P` over the coarse columns. Avoids general sparse products, the
+ * intermediate `A * P` and dense accumulators over the coarse grid.
+ *
+ * Every row is computed once, by the count pass of `fill_compressed`, which
+ * keeps it in its thread's buffer for the fill pass to copy.
+ */
+template <
+  typename Matrix_t,
+  typename Index_t,
+  std::size_t RANK
+    >
+Matrix_t
+galerkin_product(
+    const TensorTransfer<typename Matrix_t::Scalar, Index_t, RANK>& restriction,
+    const Matrix_t& matrix,
+    const TensorTransfer<typename Matrix_t::Scalar, Index_t, RANK>& prolongation) {
+
+  static_assert(Matrix_t::IsRowMajor, "Galerkin products require row-major matrices.");
+
+  using Scalar_t = typename Matrix_t::Scalar;
+  using StorageIndex_t = typename Matrix_t::StorageIndex;
+
+  const auto coarseNodes = num_of_nodes(restriction.rowDimensions);
+
+  Expects( matrix.isCompressed() );
+  Expects( matrix.rows() == num_of_nodes(restriction.colDimensions) );
+  Expects( matrix.cols() == num_of_nodes(prolongation.rowDimensions) );
+
+  // Per-thread scratch space and the rows computed by the thread.
+  struct Local {
+    std::vector<std::pair<Index_t, Scalar_t>> fine;
+    std::vector<std::pair<Index_t, Scalar_t>> coarse;
+    std::vector<std::pair<Index_t, Scalar_t>> rows;
+  };
+  struct RowRef {
+    const Local* local = nullptr;
+    std::size_t offset = 0;
+  };
+  auto locals = tbb::enumerable_thread_specific<Local> {};
+  auto rowRefs = std::vector<RowRef>(coarseNodes);
+
+  const StorageIndex_t* outerIndex = matrix.outerIndexPtr();
+  const StorageIndex_t* innerIndex = matrix.innerIndexPtr();
+  const Scalar_t* values = matrix.valuePtr();
+
+  auto result = Matrix_t {};
+  fill_compressed(result, coarseNodes, coarseNodes,
+      [&](Eigen::Index row) {
+        auto& local = locals.local();
+        local.fine.clear();
+        restriction.for_each_entry(row, [&](Index_t fine, Scalar_t r) {
+          for(auto it = outerIndex[fine]; it != outerIndex[fine + 1]; ++it) {
+            local.fine.emplace_back(static_cast<Index_t>(innerIndex[it]), r * values[it]);
+          }
+        });
+        merge_entries(local.fine);
+
+        local.coarse.clear();
+        for(const auto& [fine, ra] : local.fine) {
+          prolongation.for_each_entry(fine, [&](Index_t coarse, Scalar_t p) {
+            local.coarse.emplace_back(coarse, ra * p);
+          });
+        }
+        merge_entries(local.coarse);
+
+        rowRefs[row] = RowRef {&local, local.rows.size()};
+        local.rows.insert(local.rows.end(), local.coarse.begin(), local.coarse.end());
+        return static_cast<Eigen::Index>(local.coarse.size());
+      },
+      [&](Eigen::Index row, StorageIndex_t* innerFirst, Scalar_t* valueFirst, StorageIndex_t count) {
+        const auto first = std::next(rowRefs[row].local->rows.cbegin(), rowRefs[row].offset);
+        for(auto it = first; it != std::next(first, count); ++it) {
+          *innerFirst++ = static_cast<StorageIndex_t>(it->first);
+          *valueFirst++ = it->second;
+        }
+      });
+  return result;
+}
+
+} // namespace matrixgen::implementation
+
+namespace matrixgen
+{
+
+/**
+ * multigrid_hierarchy
+ *
+ * Generates the levels of a geometric multigrid hierarchy, finest first. The
+ * finest operator is `adjmat(gridDimensions, adjfn, weightfn)`; the coarse
+ * operators and transfer matrices are chosen by `options`, see
+ * `MultigridOptions`. All matrices are built in compressed row storage by
+ * the parallel two-pass construction of `fill_compressed`. Galerkin
+ * operators are computed by a triple product which enumerates the transfer
+ * matrices' rows from their tensor-product structure.
+ *
+ * The phases 'multigrid.operator', 'multigrid.transfer' and
+ * 'multigrid.galerkin' are reported to `stats`.
+ */
+template <
+  typename OutMatrix_t = Eigen::SparseMatrix<double, Eigen::RowMajor>,
+  typename AdjFn_t = void,
+  typename WeightFn_t = void,
+  typename Index_t = int,
+  std::size_t RANK = 3,
+  typename Stats_t = NoStats
+    >
+std::vector<MultigridLevel<OutMatrix_t, Index_t, RANK>>
+multigrid_hierarchy(
+    const Coords_t<Index_t, RANK>& gridDimensions,
+    AdjFn_t adjfn,
+    WeightFn_t weightfn,
+    const MultigridOptions& options = MultigridOptions {},
+    Stats_t&& stats = Stats_t {}) {
+
+  static_assert(OutMatrix_t::IsRowMajor, "Multigrid hierarchies require row-major matrices.");
+
+  using Scalar_t = typename OutMatrix_t::Scalar;
+  using Transfer_t = implementation::TensorTransfer<Scalar_t, Index_t, RANK>;
+
+  Expects( options.coarseningFactor >= 2 );
+  Expects( options.maxLevels >= 0 );
+
+  auto levels = std::vector<MultigridLevel<OutMatrix_t, Index_t, RANK>> {};
+  levels.push_back({gridDimensions, {}, {}, {}});
+  {
+    [[maybe_unused]] const auto phase = implementation::ScopedPhase(stats, "multigrid.operator");
+    levels.back().matrix = implementation::adjmat_compressed<OutMatrix_t>(gridDimensions, adjfn, weightfn);
+  }
+
+  while(options.maxLevels == 0 || static_cast<int>(levels.size()) < options.maxLevels) {
+    const auto fineDimensions = levels.back().gridDimensions;
+    auto coarseDimensions = fineDimensions;
+    for(auto& extent : coarseDimensions) {
+      extent = implementation::coarse_extent(extent, options.coarseningFactor);
+    }
+    if(coarseDimensions == fineDimensions) {
+      break;
+    }
+
+    const auto restriction = Transfer_t::template make<true>(fineDimensions, options.coarseningFactor, options.restriction);
+    const auto prolongation = Transfer_t::template make<false>(fineDimensions, options.coarseningFactor, options.prolongation);
+    {
+      [[maybe_unused]] const auto phase = implementation::ScopedPhase(stats, "multigrid.transfer");
+      levels.back().restriction = restriction.template to_matrix<OutMatrix_t>();
+      levels.back().prolongation = prolongation.template to_matrix<OutMatrix_t>();
+    }
+
+    auto coarse = MultigridLevel<OutMatrix_t, Index_t, RANK> {coarseDimensions, {}, {}, {}};
+    if(options.coarseOperator == CoarseOperator::GALERKIN) {
+      [[maybe_unused]] const auto phase = implementation::ScopedPhase(stats, "multigrid.galerkin");
+      coarse.matrix = implementation::galerkin_product(restriction, levels.back().matrix, prolongation);
+    }
+    else {
+      [[maybe_unused]] const auto phase = implementation::ScopedPhase(stats, "multigrid.operator");
+      coarse.matrix = implementation::adjmat_compressed<OutMatrix_t>(coarseDimensions, adjfn, weightfn);
+    }
+    levels.push_back(std::move(coarse));
+  }
+  return levels;
+}
+
+} // namespace matrixgen
@@ -0,0 +1,961 @@
+/**
+ * Orderings of the rows and columns of matrices: multicolor orderings for
+ * parallel smoothers, bandwidth-reducing (reverse Cuthill-McKee) orderings
+ * and the symmetric permutations which apply them.
+ *
+ * An ordering is given by a `CompactNumbering` over all rows: the original
+ * row (or grid node) `i` becomes the row `rowOfNode[i]` of the reordered
+ * matrix. Reordered matrices are written directly in compressed storage,
+ * either from the grid by `adjmat_multicolor` or from an existing matrix by
+ * `permute_symmetric`, never by a copy and a sort of triplets.
+ *
+ * ****************************************************************************
+ *   // Red-black ordered 7p operator for a parallel Gauss-Seidel smoother.
+ *   const auto colored = matrixgen::adjmat_multicolor<Matrix_t>(grid,
+ *     matrixgen::stencil7p(), matrixgen::constweight(1.0));
+ *   for(auto color = 0; color < colored.coloring.colors(); ++color) {
+ *     const auto first = colored.coloring.colorOffsets[color];
+ *     const auto last = colored.coloring.colorOffsets[color + 1];
+ *     // relax the rows [first, last) in parallel
+ *   }
+ * ****************************************************************************
+ */
+#pragma once
+
+#include <matrixgen/adjmat.hpp>
+#include <matrixgen/execution.hpp>
+#include <matrixgen/mask.hpp>
+#include <matrixgen/presets.hpp>
+#include <matrixgen/stats.hpp>
+#include <matrixgen/utility.hpp>
+
+#include <Eigen/Sparse>
+
+#include <gsl/gsl-lite.hpp>
+
+#include <tbb/enumerable_thread_specific.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace matrixgen
+{
+
+/**
+ * Coloring
+ *
+ * Multicolor ordering: rows of the same color are not coupled, i.e. the
+ * diagonal blocks of the reordered matrix are diagonal. The rows of color
+ * `c` are [colorOffsets[c], colorOffsets[c + 1]) and keep their original
+ * relative order. `numbering` is the permutation, see 'ordering.hpp'.
+ */
+template <typename Index_t = int>
+struct Coloring {
+  CompactNumbering<Index_t> numbering;
+  std::vector<Index_t> colorOffsets;
+
+  Eigen::Index colors() const { return static_cast<Eigen::Index>(colorOffsets.size()) - 1; }
+};
+
+/**
+ * ColoredMatrix
+ *
+ * A matrix in the color-contiguous order of `coloring`.
+ */
+template <
+  typename Matrix_t,
+  typename Index_t = typename Matrix_t::StorageIndex
+    >
+struct ColoredMatrix {
+  Matrix_t matrix;
+  Coloring<Index_t> coloring;
+};
+
+/**
+ * ReorderedMatrix
+ *
+ * A matrix in the order `numbering`, see 'ordering.hpp'.
+ */
+template <
+  typename Matrix_t,
+  typename Index_t = typename Matrix_t::StorageIndex
+    >
+struct ReorderedMatrix {
+  Matrix_t matrix;
+  CompactNumbering<Index_t> numbering;
+};
+
+} // namespace matrixgen
+
+namespace matrixgen::implementation
+{
+
+/**
+ * Color-contiguous ordering of the nodes colored by `colors`, computed by a
+ * stable counting sort: every block of nodes counts its colors in parallel,
+ * the counts are scanned in color-then-block order, and every block
+ * scatters its nodes in parallel. The result does not depend on the number
+ * of threads.
+ */
+template <typename Index_t>
+Coloring<Index_t>
+coloring_from_colors(const std::vector<Index_t>& colors, Eigen::Index numOfColors) {
+
+  constexpr auto BLOCK_SIZE = Eigen::Index {1} << 16;
+  const auto numOfNodes = static_cast<Eigen::Index>(colors.size());
+  const auto numOfBlocks = (numOfNodes + BLOCK_SIZE - 1) / BLOCK_SIZE;
+
+  // offsets[color * numOfBlocks + block] is the first row of the block's nodes of that color.
+  auto offsets = std::vector<Eigen::Index>(numOfColors * numOfBlocks + 1);
+  parallel_for_blocks(0, numOfBlocks,
+    [&](const auto& range) {
+      for(auto block = range.begin(); block != range.end(); ++block) {
+        const auto last = std::min(numOfNodes, (block + 1) * BLOCK_SIZE);
+        for(auto node = block * BLOCK_SIZE; node < last; ++node) {
+          ++offsets[colors[node] * numOfBlocks + block + 1];
+        }
+      }
+    });
+  std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+
+  Ensures( offsets.back() == numOfNodes );
+
+  auto result = Coloring<Index_t> {};
+  result.numbering.rowOfNode.resize(numOfNodes);
+  result.numbering.nodeOfRow.resize(numOfNodes);
+  parallel_for_blocks(0, numOfBlocks,
+    [&](const auto& range) {
+      auto next = std::vector<Eigen::Index>(numOfColors);
+      for(auto block = range.begin(); block != range.end(); ++block) {
+        for(auto color = Eigen::Index {0}; color < numOfColors; ++color) {
+          next[color] = offsets[color * numOfBlocks + block];
+        }
+        const auto last = std::min(numOfNodes, (block + 1) * BLOCK_SIZE);
+        for(auto node = block * BLOCK_SIZE; node < last; ++node) {
+          const auto row = next[colors[node]]++;
+          result.numbering.rowOfNode[node] = static_cast<Index_t>(row);
+          result.numbering.nodeOfRow[row] = static_cast<Index_t>(node);
+        }
+      }
+    });
+
+  result.colorOffsets.resize(numOfColors + 1);
+  for(auto color = Eigen::Index {0}; color <= numOfColors; ++color) {
+    result.colorOffsets[color] = static_cast<Index_t>(offsets[color * numOfBlocks]);
+  }
+  return result;
+}
+
+/* Color function of `red_black_colors`. */
+struct RedBlackColors
+{
+  static constexpr Eigen::Index colors(std::size_t) { return 2; }
+
+  template <
+    typename Index_t,
+    std::size_t RANK
+      >
+  Index_t
+  operator()(const Coords_t<Index_t, RANK>& coords) const {
+    auto sum = Index_t {0};
+    for(auto dim = std::size_t {0}; dim < RANK; ++dim) {
+      sum += coords[dim];
+    }
+    return sum % 2;
+  }
+};
+
+/* Color function of `box_colors`. */
+struct BoxColors
+{
+  int period;
+
+  Eigen::Index
+  colors(std::size_t rank) const {
+    return static_cast<Eigen::Index>(ipow(static_cast<std::size_t>(period), rank));
+  }
+
+  template <
+    typename Index_t,
+    std::size_t RANK
+      >
+  Index_t
+  operator()(const Coords_t<Index_t, RANK>& coords) const {
+    auto color = Index_t {0};
+    for(auto dim = RANK; dim-- > 0;) {
+      color = color * period + coords[dim] % period;
+    }
+    return color;
+  }
+};
+
+/* The shape and boundary conditions of the adjacency functions of `stencil`. */
+template <typename AdjFn_t>
+struct StencilTraits : std::false_type {};
+
+template <
+  typename Shape_t,
+  auto XBC,
+  auto YBC,
+  auto ZBC,
+  typename Index_t
+    >
+struct StencilTraits<Stencil<Shape_t, XBC, YBC, ZBC, Index_t>> : std::true_type
+{
+  using Regions_t = StencilRegions<Shape_t, XBC, YBC, ZBC, Index_t>;
+
+  static constexpr BC bc(std::size_t dim) { return boundary_condition<XBC, YBC, ZBC>(dim); }
+
+  /* True if every offset but the null offset changes the parity of the coordinates' sum. */
+  static constexpr bool RED_BLACK = []() {
+    for(const auto& offset : Shape_t::OFFSETS) {
+      auto sum = 0;
+      auto null = true;
+      for(const auto component : offset) {
+        sum += component;
+        null = null && component == 0;
+      }
+      if(!null && sum % 2 == 0) {
+        return false;
+      }
+    }
+    return true;
+  }();
+};
+
+} // namespace matrixgen::implementation
+
+namespace matrixgen
+{
+
+/**
+ * matrixgen::red_black_colors()
+ *
+ * Color function of the red-black ordering, the parity of the sum of a
+ * node's coordinates. Valid for stencils whose offsets all change this
+ * parity, e.g. the 3p, 5p and 7p stencils.
+ */
+inline
+implementation::RedBlackColors
+red_black_colors() {
+
+  return implementation::RedBlackColors {};
+}
+
+/**
+ * matrixgen::box_colors()
+ *
+ * Color function which colors the nodes of every box of `period^RANK`
+ * nodes differently, e.g. 8 colors for `period == 2` on 3D grids. Valid for
+ * stencils which reach no further than `period - 1` nodes in any
+ * dimension, e.g. the 27p stencil for `period == 2`.
+ */
+inline
+implementation::BoxColors
+box_colors(int period) {
+
+  Expects( period > 0 );
+
+  return implementation::BoxColors {period};
+}
+
+/**
+ * grid_coloring
+ *
+ * Multicolor ordering of the nodes of the grid `gridDimensions` by the color
+ * function `colorFn`, which maps a node's coordinates to its color in
+ * [0, numOfColors). The colors are evaluated in parallel.
+ */
+template <
+  typename Index_t,
+  std::size_t RANK,
+  typename ColorFn_t
+    >
+Coloring<Index_t>
+grid_coloring(
+    const Coords_t<Index_t, RANK>& gridDimensions,
+    const ColorFn_t& colorFn,
+    Eigen::Index numOfColors) {
+
+  const auto numOfNodes = implementation::num_of_nodes(gridDimensions);
+  auto colors = std::vector<Index_t>(numOfNodes);
+  implementation::parallel_for_blocks(0, numOfNodes,
+    [&](const auto& range) {
+      auto coords = implementation::get_node_coords(range.begin(), gridDimensions);
+      for(auto node = range.begin(); node != range.end(); ++node) {
+        colors[node] = colorFn(coords);
+
+        Expects( 0 <= colors[node] && colors[node] < numOfColors );
+
+        for(auto dim = std::size_t {0}; dim < RANK && ++coords[dim] == gridDimensions[dim]; ++dim) {
+          coords[dim] = 0;
+        }
+      }
+    });
+  return implementation::coloring_from_colors(colors, numOfColors);
+}
+
+/**
+ * stencil_coloring
+ *
+ * Multicolor ordering for the adjacency function `adjfn` of `stencil`,
+ * derived from the stencil's offsets: red-black if every offset changes
+ * the parity of the coordinates' sum (e.g. 7p), otherwise `box_colors`
+ * with the period of the stencil's extent plus one (e.g. 8 colors for 27p).
+ * Periodic dimensions must be divisible by the colors' period.
+ */
+template <
+  typename Index_t,
+  std::size_t RANK,
+  typename AdjFn_t
+    >
+Coloring<Index_t>
+stencil_coloring(
+    const Coords_t<Index_t, RANK>& gridDimensions,
+    const AdjFn_t&) {
+
+  using Traits_t = implementation::StencilTraits<AdjFn_t>;
+  static_assert(Traits_t::value,
+      "Analytic colorings require adjacency functions of `stencil`. Use "
+      "`grid_coloring` with a color function instead.");
+  static_assert(Traits_t::Regions_t::RANK == RANK, "The stencil's rank must match the grid's rank.");
+
+  constexpr auto PERIOD = Traits_t::RED_BLACK ? 2 : static_cast<int>(Traits_t::Regions_t::EXTENT) + 1;
+  for(auto dim = std::size_t {0}; dim < RANK; ++dim) {
+    Expects( Traits_t::bc(dim) != BC::PERIODIC || gridDimensions[dim] % PERIOD == 0 );
+  }
+
+  if constexpr (Traits_t::RED_BLACK) {
+    return grid_coloring(gridDimensions, red_black_colors(), 2);
+  }
+  else {
+    const auto colorFn = box_colors(PERIOD);
+    return grid_coloring(gridDimensions, colorFn, colorFn.colors(RANK));
+  }
+}
+
+/**
+ * adjmat_multicolor
+ *
+ * Same as `adjmat(gridDimensions, adjfn, weightfn)` for a row-major matrix
+ * in the color-contiguous order of `coloring`, see `grid_coloring`. The
+ * rows are generated in their final order as in `adjmat_masked`; row and
+ * column indices passed to the weight function are those of the colored
+ * order. The weight function must not be a mutable lambda.
+ */
+template <
+  typename OutMatrix_t = Eigen::SparseMatrix<double, Eigen::RowMajor>,
+  typename AdjFn_t = void,
+  typename WeightFn_t = void,
+  typename Index_t = int,
+  std::size_t RANK = 3,
+  typename Stats_t = NoStats
+    >
+ColoredMatrix<OutMatrix_t, Index_t>
+adjmat_multicolor(
+    const Coords_t<Index_t, RANK>& gridDimensions,
+    Coloring<Index_t> coloring,
+    AdjFn_t adjfn,
+    WeightFn_t weightfn,
+    Stats_t&& stats = Stats_t {}) {
+
+  auto matrix = adjmat_masked<OutMatrix_t>(gridDimensions, coloring.numbering, adjfn, weightfn, stats);
+  return ColoredMatrix<OutMatrix_t, Index_t> {std::move(matrix), std::move(coloring)};
+}
+
+/**
+ * As above with the coloring of `stencil_coloring`.
+ */
+template <
+  typename OutMatrix_t = Eigen::SparseMatrix<double, Eigen::RowMajor>,
+  typename AdjFn_t = void,
+  typename WeightFn_t = void,
+  typename Index_t = int,
+  std::size_t RANK = 3,
+  typename Stats_t = NoStats
+    >
+ColoredMatrix<OutMatrix_t, Index_t>
+adjmat_multicolor(
+    const Coords_t<Index_t, RANK>& gridDimensions,
+    AdjFn_t adjfn,
+    WeightFn_t weightfn,
+    Stats_t&& stats = Stats_t {}) {
+
+  auto coloring = [&]() {
+    [[maybe_unused]] const auto phase = implementation::ScopedPhase(stats, "coloring");
+    return stencil_coloring(gridDimensions, adjfn);
+  }();
+  return adjmat_multicolor<OutMatrix_t>(gridDimensions, std::move(coloring), adjfn, weightfn, stats);
+}
+
+} // namespace matrixgen
+
+namespace matrixgen::implementation
+{
+
+/**
+ * The pattern of the transpose of `matrix` in compressed outer-wise
+ * storage, built in parallel. The inners of an outer are unordered.
+ */
+template <typename Matrix_t>
+std::pair<std::vector<typename Matrix_t::StorageIndex>, std::vector<typename Matrix_t::StorageIndex>>
+transposed_pattern(const Matrix_t& matrix) {
+
+  using StorageIndex_t = typename Matrix_t::StorageIndex;
+
+  const auto outerSize = matrix.outerSize();
+  const auto innerSize = matrix.innerSize();
+  const StorageIndex_t* outerIndex = matrix.outerIndexPtr();
+  const StorageIndex_t* innerIndex = matrix.innerIndexPtr();
+
+  auto transposedOuter = std::vector<StorageIndex_t>(innerSize + 1);
+  parallel_for_blocks(0, outerSize,
+    [&](const auto& range) {
+      for(auto it = outerIndex[range.begin()]; it != outerIndex[range.end()]; ++it) {
+        std::atomic_ref(transposedOuter[innerIndex[it] + 1]).fetch_add(1, std::memory_order_relaxed);
+      }
+    });
+  parallel_inclusive_scan(transposedOuter.begin(), transposedOuter.end());
+
+  auto next = std::vector<StorageIndex_t>(transposedOuter.begin(), transposedOuter.end() - 1);
+  auto transposedInner = std::vector<StorageIndex_t>(transposedOuter.back());
+  parallel_for_blocks(0, outerSize,
+    [&](const auto& range) {
+      for(auto outer = range.begin(); outer != range.end(); ++outer) {
+        for(auto it = outerIndex[outer]; it != outerIndex[outer + 1]; ++it) {
+          const auto pos = std::atomic_ref(next[innerIndex[it]]).fetch_add(1, std::memory_order_relaxed);
+          transposedInner[pos] = static_cast<StorageIndex_t>(outer);
+        }
+      }
+    });
+  return {std::move(transposedOuter), std::move(transposedInner)};
+}
+
+/**
+ * Graph of the symmetrized pattern of a square compressed matrix: the
+ * neighbors of an outer are its inners and the outers it is an inner of,
+ * except for itself. Neighbors in both directions are visited twice, from
+ * either side, and count twice towards the degree.
+ */
+template <typename StorageIndex_t>
+struct SymmetrizedGraph
+{
+  const StorageIndex_t* outerIndex = nullptr;
+  const StorageIndex_t* innerIndex = nullptr;
+  std::vector<StorageIndex_t> transposedOuter;
+  std::vector<StorageIndex_t> transposedInner;
+
+  template <typename Matrix_t>
+  static SymmetrizedGraph
+  make(const Matrix_t& matrix) {
+
+    auto [transposedOuter, transposedInner] = transposed_pattern(matrix);
+    return {matrix.outerIndexPtr(), matrix.innerIndexPtr(), std::move(transposedOuter), std::move(transposedInner)};
+  }
+
+  Eigen::Index size() const { return static_cast<Eigen::Index>(transposedOuter.size()) - 1; }
+
+  /* Calls `fn(neighbor)` for the neighbors of `outer`. */
+  template <typename Fn_t>
+  void
+  for_each_neighbor(Eigen::Index outer, Fn_t&& fn) const {
+
+    for(auto it = outerIndex[outer]; it != outerIndex[outer + 1]; ++it) {
+      if(innerIndex[it] != outer) {
+        fn(innerIndex[it]);
+      }
+    }
+    for(auto it = transposedOuter[outer]; it != transposedOuter[outer + 1]; ++it) {
+      if(transposedInner[it] != outer) {
+        fn(transposedInner[it]);
+      }
+    }
+  }
+
+  /* The degrees of all outers, computed in parallel. */
+  std::vector<StorageIndex_t>
+  degrees() const {
+
+    auto result = std::vector<StorageIndex_t>(size());
+    parallel_for_blocks(0, size(),
+      [&](const auto& range) {
+        for(auto outer = range.begin(); outer != range.end(); ++outer) {
+          auto degree = StorageIndex_t {0};
+          for_each_neighbor(outer, [&](StorageIndex_t) { ++degree; });
+          result[outer] = degree;
+        }
+      });
+    return result;
+  }
+};
+
+/**
+ * Parallel greedy coloring of the graph of the symmetrized pattern of
+ * `matrix` (Jones-Plassmann): every outer gets the smallest color not taken
+ * by its neighbors of higher random priority, as soon as all of these are
+ * colored. Outers wait on a counter of their uncolored neighbors of higher
+ * priority, which is decremented as these are colored, thus every edge is
+ * visited a constant number of times. The colors depend on `seed` only, not
+ * on the order of execution.
+ */
+template <typename Matrix_t>
+std::vector<typename Matrix_t::StorageIndex>
+greedy_colors(const Matrix_t& matrix, uint64_t seed, Eigen::Index& numOfColors) {
+
+  using StorageIndex_t = typename Matrix_t::StorageIndex;
+
+  const auto size = matrix.outerSize();
+  const auto graph = SymmetrizedGraph<StorageIndex_t>::make(matrix);
+  const auto for_each_neighbor = [&](Eigen::Index outer, auto&& fn) { graph.for_each_neighbor(outer, fn); };
+
+  auto priorities = std::vector<uint64_t>(size);
+  auto pending = std::vector<StorageIndex_t>(size);
+  parallel_for_blocks(0, size,
+    [&](const auto& range) {
+      for(auto outer = range.begin(); outer != range.end(); ++outer) {
+        priorities[outer] = mix_seed(seed, static_cast<uint64_t>(outer));
+      }
+    });
+  const auto precedes = [&](Eigen::Index a, Eigen::Index b) {
+    return priorities[a] > priorities[b] || (priorities[a] == priorities[b] && a < b);
+  };
+  parallel_for_blocks(0, size,
+    [&](const auto& range) {
+      for(auto outer = range.begin(); outer != range.end(); ++outer) {
+        auto count = StorageIndex_t {0};
+        for_each_neighbor(outer, [&](StorageIndex_t neighbor) { count += precedes(neighbor, outer) ? 1 : 0; });
+        pending[outer] = count;
+      }
+    });
+
+  // Per-thread marks of the colors taken by the neighbors of an outer.
+  struct Local {
+    std::vector<Eigen::Index> taken;
+    Eigen::Index maxColor = -1;
+  };
+  auto locals = tbb::enumerable_thread_specific<Local>();
+  auto colors = std::vector<StorageIndex_t>(size, -1);
+
+  // Colors `outer` and calls `ready(neighbor)` for the neighbors it was the last to wait for.
+  const auto color_outer = [&](StorageIndex_t outer, auto&& ready) {
+    auto& local = locals.local();
+    for_each_neighbor(outer, [&](StorageIndex_t neighbor) {
+      if(precedes(neighbor, outer)) {
+        const auto color = colors[neighbor];
+        if(static_cast<std::size_t>(color) >= local.taken.size()) {
+          local.taken.resize(2 * color + 1, -1);
+        }
+        local.taken[color] = outer;
+      }
+    });
+    auto color = Eigen::Index {0};
+    while(color < static_cast<Eigen::Index>(local.taken.size()) && local.taken[color] == outer) {
+      ++color;
+    }
+    colors[outer] = static_cast<StorageIndex_t>(color);
+    local.maxColor = std::max(local.maxColor, color);
+
+    for_each_neighbor(outer, [&](StorageIndex_t neighbor) {
+      if(precedes(outer, neighbor) && std::atomic_ref(pending[neighbor]).fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        ready(neighbor);
+      }
+    });
+  };
+
+  auto roots = std::vector<StorageIndex_t> {};
+  for(auto outer = Eigen::Index {0}; outer < size; ++outer) {
+    if(pending[outer] == 0) {
+      roots.push_back(static_cast<StorageIndex_t>(outer));
+    }
+  }
+  parallel_worklist(std::move(roots), color_outer);
+
+  numOfColors = size == 0 ? 0 : 1;
+  for(const auto& local : locals) {
+    numOfColors = std::max(numOfColors, local.maxColor + 1);
+  }
+  return colors;
+}
+
+/**
+ * Implementation of `permute_symmetric`: every outer of the result is the
+ * renumbered outer of the original, sorted by its new inners.
+ */
+template <
+  typename Matrix_t,
+  typename Index_t,
+  typename Stats_t
+    >
+Matrix_t
+permute_symmetric(
+    const Matrix_t& matrix,
+    const CompactNumbering<Index_t>& numbering,
+    Stats_t& stats) {
+
+  using Scalar_t = typename Matrix_t::Scalar;
+  using StorageIndex_t = typename Matrix_t::StorageIndex;
+
+  Expects( matrix.rows() == matrix.cols() );
+  Expects( matrix.isCompressed() );
+  Expects( numbering.rows() == matrix.outerSize() );
+  Expects( static_cast<Eigen::Index>(numbering.rowOfNode.size()) == matrix.outerSize() );
+
+  const StorageIndex_t* outerIndex = matrix.outerIndexPtr();
+  const StorageIndex_t* innerIndex = matrix.innerIndexPtr();
+  const Scalar_t* values = matrix.valuePtr();
+  auto locals = tbb::enumerable_thread_specific<std::vector<std::pair<StorageIndex_t, Scalar_t>>>();
+
+  auto result = Matrix_t {};
+  fill_compressed(result, matrix.rows(), matrix.cols(),
+      [&](Eigen::Index outer) {
+        const auto original = numbering.nodeOfRow[outer];
+        return outerIndex[original + 1] - outerIndex[original];
+      },
+      [&](Eigen::Index outer, StorageIndex_t* innerFirst, Scalar_t* valueFirst, StorageIndex_t) {
+        auto& entries = locals.local();
+        const auto original = numbering.nodeOfRow[outer];
+        entries.clear();
+        for(auto it = outerIndex[original]; it != outerIndex[original + 1]; ++it) {
+          entries.emplace_back(static_cast<StorageIndex_t>(numbering.rowOfNode[innerIndex[it]]), values[it]);
+        }
+        std::sort(entries.begin(), entries.end(),
+            [](const auto& a, const auto& b) { return a.first < b.first; });
+        for(const auto& [inner, value] : entries) {
+          *innerFirst++ = inner;
+          *valueFirst++ = value;
+        }
+      },
+      stats);
+  return result;
+}
+
+/**
+ * Cuthill-McKee order of the outers of `matrix`, i.e. `order[k]` is the
+ * outer numbered `k`. Every connected component of the graph of the
+ * symmetrized pattern is numbered by a breadth-first search from a
+ * pseudo-peripheral node, found by the iteration of George and Liu: restart
+ * from the node of least degree of the last level while the number of
+ * levels grows.
+ *
+ * The levels are expanded in parallel. Every node of the next level records
+ * the first position of its neighbors in the current level by an atomic
+ * minimum, then the level is sorted by this parent, the degree and the
+ * index in linear time. Thus the order is that of the sequential algorithm,
+ * independently of the number of threads.
+ */
+template <typename Matrix_t>
+std::vector<typename Matrix_t::StorageIndex>
+cuthill_mckee_order(const Matrix_t& matrix) {
+
+  using StorageIndex_t = typename Matrix_t::StorageIndex;
+
+  constexpr auto UNVISITED = std::numeric_limits<StorageIndex_t>::max();
+  const auto size = matrix.outerSize();
+  const auto graph = SymmetrizedGraph<StorageIndex_t>::make(matrix);
+  const auto degrees = graph.degrees();
+  auto parents = std::vector<StorageIndex_t>(size, UNVISITED);
+  auto order = std::vector<StorageIndex_t>(size);
+  auto locals = tbb::enumerable_thread_specific<std::vector<StorageIndex_t>>();
+
+  // Sorts the level order[levelLast, nextLast) by parent, degree and index:
+  // a counting sort by parent, which are the positions [levelFirst,
+  // levelLast), followed by a sort of the few children of every parent.
+  auto offsets = std::vector<StorageIndex_t>(size + 1);
+  auto sorted = std::vector<StorageIndex_t>(size);
+  const auto sort_level = [&](Eigen::Index levelFirst, Eigen::Index levelLast, Eigen::Index nextLast) {
+    std::fill(offsets.begin(), offsets.begin() + (levelLast - levelFirst + 1), StorageIndex_t {0});
+    parallel_for_blocks(levelLast, nextLast,
+      [&](const auto& range) {
+        for(auto pos = range.begin(); pos != range.end(); ++pos) {
+          std::atomic_ref(offsets[parents[order[pos]] - levelFirst + 1]).fetch_add(1, std::memory_order_relaxed);
+        }
+      });
+    parallel_inclusive_scan(offsets.begin(), offsets.begin() + (levelLast - levelFirst + 1));
+    parallel_for_blocks(levelLast, nextLast,
+      [&](const auto& range) {
+        for(auto pos = range.begin(); pos != range.end(); ++pos) {
+          const auto node = order[pos];
+          sorted[std::atomic_ref(offsets[parents[node] - levelFirst]).fetch_add(1, std::memory_order_relaxed)] = node;
+        }
+      });
+    // The children of the parent `k` are now sorted[offsets[k - 1], offsets[k]).
+    parallel_for_blocks(0, levelLast - levelFirst,
+      [&](const auto& range) {
+        for(auto k = range.begin(); k != range.end(); ++k) {
+          const auto childFirst = sorted.begin() + (k == 0 ? 0 : offsets[k - 1]);
+          const auto childLast = sorted.begin() + offsets[k];
+          std::sort(childFirst, childLast,
+              [&](StorageIndex_t a, StorageIndex_t b) { return std::tie(degrees[a], a) < std::tie(degrees[b], b); });
+          std::copy(childFirst, childLast, order.begin() + levelLast + (childFirst - sorted.begin()));
+        }
+      });
+  };
+
+  // Numbers the component of `start` from `first` on. Returns the number of
+  // levels and the positions of the last level. The nodes of previous levels
+  // have parents before the current level, those of the next level after.
+  const auto search = [&](StorageIndex_t start, Eigen::Index first) {
+    parents[start] = -1;
+    order[first] = start;
+    auto levels = Eigen::Index {1};
+    auto levelFirst = first;
+    auto levelLast = first + 1;
+    while(true) {
+      for(auto& next : locals) {
+        next.clear();
+      }
+      parallel_for_blocks(levelFirst, levelLast,
+        [&](const auto& range) {
+          auto& next = locals.local();
+          for(auto pos = range.begin(); pos != range.end(); ++pos) {
+            graph.for_each_neighbor(order[pos], [&](StorageIndex_t neighbor) {
+              auto parent = std::atomic_ref(parents[neighbor]);
+              auto current = parent.load(std::memory_order_relaxed);
+              while(current >= levelFirst && pos < current) {
+                if(parent.compare_exchange_weak(current, static_cast<StorageIndex_t>(pos), std::memory_order_relaxed)) {
+                  if(current == UNVISITED) {
+                    next.push_back(neighbor);
+                  }
+                  break;
+                }
+              }
+            });
+          }
+        });
+      auto nextLast = levelLast;
+      for(const auto& next : locals) {
+        std::copy(next.begin(), next.end(), order.begin() + nextLast);
+        nextLast += static_cast<Eigen::Index>(next.size());
+      }
+      if(nextLast == levelLast) {
+        return std::tuple {levels, levelFirst, levelLast};
+      }
+      sort_level(levelFirst, levelLast, nextLast);
+      ++levels;
+      levelFirst = levelLast;
+      levelLast = nextLast;
+    }
+  };
+
+  auto numbered = Eigen::Index {0};
+  for(auto node = StorageIndex_t {0}; node < size; ++node) {
+    if(parents[node] != UNVISITED) {
+      continue;
+    }
+    if(degrees[node] == 0) {
+      parents[node] = -1;
+      order[numbered++] = node;
+      continue;
+    }
+    auto [levels, lastFirst, last] = search(node, numbered);
+    while(true) {
+      const auto start = *std::min_element(order.begin() + lastFirst, order.begin() + last,
+          [&](StorageIndex_t a, StorageIndex_t b) { return std::tie(degrees[a], a) < std::tie(degrees[b], b); });
+      parallel_for_blocks(numbered, last,
+        [&](const auto& range) {
+          for(auto pos = range.begin(); pos != range.end(); ++pos) {
+            parents[order[pos]] = UNVISITED;
+          }
+        });
+      const auto [restartLevels, restartLastFirst, restartLast] = search(start, numbered);
+      lastFirst = restartLastFirst;
+      last = restartLast;
+      if(restartLevels <= levels) {
+        break;
+      }
+      levels = restartLevels;
+    }
+    numbered = last;
+  }
+  return order;
+}
+
+} // namespace matrixgen::implementation
+
+namespace matrixgen
+{
+
+/**
+ * greedy_coloring
+ *
+ * Multicolor ordering of the rows of the square compressed matrix `matrix`
+ * by a parallel greedy coloring of the graph of its symmetrized pattern,
+ * e.g. for matrices from `perturb` and `interleave`. The coloring depends on
+ * `seed` but not on the number of threads. Usually uses a few colors more
+ * than the largest row length.
+ */
+template <
+  typename Scalar_t,
+  int ALIGNMENT,
+  typename Index_t,
+  typename Stats_t = NoStats
+    >
+Coloring<Index_t>
+greedy_coloring(
+    const Eigen::SparseMatrix<Scalar_t, ALIGNMENT, Index_t>& matrix,
+    uint64_t seed = 42,
+    Stats_t&& stats = Stats_t {}) {
+
+  Expects( matrix.rows() == matrix.cols() );
+  Expects( matrix.isCompressed() );
+
+  [[maybe_unused]] const auto phase = implementation::ScopedPhase(stats, "coloring");
+  auto numOfColors = Eigen::Index {0};
+  const auto colors = implementation::greedy_colors(matrix, seed, numOfColors);
+  return implementation::coloring_from_colors(colors, numOfColors);
+}
+
+/**
+ * permute_symmetric
+ *
+ * Returns `P * matrix * P^T` for the permutation `numbering`, i.e. the row
+ * and column `i` of the square compressed matrix become the row and column
+ * `numbering.rowOfNode[i]`. The result is written directly in compressed
+ * storage by `fill_compressed`, in parallel over its outers.
+ *
+ * The phases of `fill_compressed` are reported to `stats`.
+ */
+template <
+  typename Scalar_t,
+  int ALIGNMENT,
+  typename Index_t,
+  typename NumberingIndex_t,
+  typename Stats_t = NoStats
+    >
+Eigen::SparseMatrix<Scalar_t, ALIGNMENT, Index_t>
+permute_symmetric(
+    const Eigen::SparseMatrix<Scalar_t, ALIGNMENT, Index_t>& matrix,
+    const CompactNumbering<NumberingIndex_t>& numbering,
+    Stats_t&& stats = Stats_t {}) {
+
+  return implementation::permute_symmetric(matrix, numbering, stats);
+}
+
+/**
+ * multicolor
+ *
+ * Returns `matrix` in the color-contiguous order of its `greedy_coloring`.
+ */
+template <
+  typename Scalar_t,
+  int ALIGNMENT,
+  typename Index_t,
+  typename Stats_t = NoStats
+    >
+ColoredMatrix<Eigen::SparseMatrix<Scalar_t, ALIGNMENT, Index_t>>
+multicolor(
+    const Eigen::SparseMatrix<Scalar_t, ALIGNMENT, Index_t>& matrix,
+    uint64_t seed = 42,
+    Stats_t&& stats = Stats_t {}) {
+
+  auto coloring = greedy_coloring(matrix, seed, stats);
+  auto permuted = implementation::permute_symmetric(matrix, coloring.numbering, stats);
+  return {std::move(permuted), std::move(coloring)};
+}
+
+/**
+ * rcm_ordering
+ *
+ * Reverse Cuthill-McKee ordering of the rows of the square compressed
+ * matrix `matrix`, which reduces its bandwidth and profile, e.g. after
+ * `perturb` or `interleave`. Only the symmetrized pattern is used, and its
+ * connected components are numbered one after the other. The ordering is
+ * computed in parallel and does not depend on the number of threads.
+ */
+template <
+  typename Scalar_t,
+  int ALIGNMENT,
+  typename Index_t,
+  typename Stats_t = NoStats
+    >
+CompactNumbering<Index_t>
+rcm_ordering(
+    const Eigen::SparseMatrix<Scalar_t, ALIGNMENT, Index_t>& matrix,
+    Stats_t&& stats = Stats_t {}) {
+
+  Expects( matrix.rows() == matrix.cols() );
+  Expects( matrix.isCompressed() );
+
+  [[maybe_unused]] const auto phase = implementation::ScopedPhase(stats, "ordering");
+  const auto order = implementation::cuthill_mckee_order(matrix);
+  const auto size = matrix.outerSize();
+  auto numbering = CompactNumbering<Index_t> {std::vector<Index_t>(size), std::vector<Index_t>(size)};
+  implementation::parallel_for_blocks(0, size,
+    [&](const auto& range) {
+      for(auto row = range.begin(); row != range.end(); ++row) {
+        const auto node = order[size - 1 - row];
+        numbering.nodeOfRow[row] = node;
+        numbering.rowOfNode[node] = static_cast<Index_t>(row);
+      }
+    });
+  return numbering;
+}
+
+/**
+ * reverse_cuthill_mckee
+ *
+ * Returns `matrix` in its `rcm_ordering`. Use with `perturb` or
+ * `interleave` to keep their structure but restore locality.
+ */
+template <
+  typename Scalar_t,
+  int ALIGNMENT,
+  typename Index_t,
+  typename Stats_t = NoStats
+    >
+ReorderedMatrix<Eigen::SparseMatrix<Scalar_t, ALIGNMENT, Index_t>>
+reverse_cuthill_mckee(
+    const Eigen::SparseMatrix<Scalar_t, ALIGNMENT, Index_t>& matrix,
+    Stats_t&& stats = Stats_t {}) {
+
+  auto numbering = rcm_ordering(matrix, stats);
+  auto permuted = implementation::permute_symmetric(matrix, numbering, stats);
+  return {std::move(permuted), std::move(numbering)};
+}
+
+/**
+ * Overloads of the above executed under `context`, see 'execution.hpp'.
+ */
+template <typename... Args_t>
+decltype(auto)
+greedy_coloring(const ExecutionContext& context, Args_t&&... args) {
+
+  return context.execute([&]() { return greedy_coloring(std::forward<Args_t>(args)...); });
+}
+
+template <typename... Args_t>
+decltype(auto)
+permute_symmetric(const ExecutionContext& context, Args_t&&... args) {
+
+  return context.execute([&]() { return permute_symmetric(std::forward<Args_t>(args)...); });
+}
+
+template <typename... Args_t>
+decltype(auto)
+multicolor(const ExecutionContext& context, Args_t&&... args) {
+
+  return context.execute([&]() { return multicolor(std::forward<Args_t>(args)...); });
+}
+
+template <typename... Args_t>
+decltype(auto)
+rcm_ordering(const ExecutionContext& context, Args_t&&... args) {
+
+  return context.execute([&]() { return rcm_ordering(std::forward<Args_t>(args)...); });
+}
+
+template <typename... Args_t>
+decltype(auto)
+reverse_cuthill_mckee(const ExecutionContext& context, Args_t&&... args) {
+
+  return context.execute([&]() { return reverse_cuthill_mckee(std::forward<Args_t>(args)...); });
+}
+
+} // namespace matrixgen
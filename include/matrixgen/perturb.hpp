@@ -3,13 +3,23 @@
 #include <Eigen/Dense>
 #include <Eigen/Sparse>
 #include <gsl/gsl-lite.hpp>
+#include <tbb/enumerable_thread_specific.h>
 
+#include <matrixgen/execution.hpp>
+#include <matrixgen/memory.hpp>
+#include <matrixgen/stats.hpp>
+#include <matrixgen/target.hpp>
 #include <matrixgen/utility.hpp>
 
 #include <algorithm>
+#include <cmath>
 #include <initializer_list>
+#include <memory_resource>
+#include <optional>
 #include <random>
+#include <unordered_set>
 #include <utility>
+#include <vector>
 
 namespace matrixgen::implementation {
 
@@ -49,67 +59,343 @@ struct Perturb<Eigen::SparseMatrix<Scalar_t, ALIGNMENT, Index_t>, InputIter_t> {
 
   using Matrix_t = Eigen::SparseMatrix<Scalar_t, ALIGNMENT, Index_t>;
 
+  /**
+   * Randomizes the inner indices and values of the selected outers of a
+   * compressed matrix given by its raw arrays, in place. The shuffled
+   * inner indices are allocated from `resource`.
+   */
+  static
+  void
+  perturb_outers(
+      const Index_t* outerIndexPtr,
+      Index_t* innerIndexPtr,
+      Scalar_t* valuePtr,
+      Index_t innerSize,
+      InputIter_t outerIndicesFirst,
+      InputIter_t outerIndicesLast,
+      uint64_t seed,
+      std::pmr::memory_resource* resource) {
+
+    auto engine = std::default_random_engine(seed);
+
+    // Generate all possible inner indices. We shuffle this container and
+    // draw the first `outerSize' to randomize the inner indices as we cannot
+    // draw random numbers due to possible duplicates.
+    auto innerIndices = std::pmr::vector<Index_t>(resource);
+    innerIndices.resize(innerSize);
+    std::generate(innerIndices.begin(), innerIndices.end(), [ii = (Index_t)0] () mutable { return ii++; });
+    std::shuffle(innerIndices.begin(), innerIndices.end(), engine);
+    auto innerIndicesIter = innerIndices.begin();
+
+    // Initialize distribution from which values will be drawn
+    auto dist = std::uniform_real_distribution<Scalar_t>((Scalar_t)1.0, (Scalar_t)2.0);
+    auto randval = [&]() { return dist(engine); };
+
+    for (auto it = outerIndicesFirst; it != outerIndicesLast; ++it) {
+
+      const auto outerIndex = *it;
+      const auto outerOffset = *std::next(outerIndexPtr, outerIndex); // Offset into V and CI for this row
+      const auto nnzInOuter = *std::next(outerIndexPtr, outerIndex + 1)
+                              - *std::next(outerIndexPtr, outerIndex);
+
+      // Randomize inner indices. We write out the inner indices in ascending
+      // order which makes the output more predictable.
+      if (std::distance(innerIndicesIter, innerIndices.end()) <= nnzInOuter) {
+        std::shuffle(innerIndices.begin(), innerIndices.end(), engine);
+        innerIndicesIter = innerIndices.begin();
+      }
+      std::sort(innerIndicesIter, std::next(innerIndicesIter, nnzInOuter));
+      std::copy_n(innerIndicesIter, nnzInOuter, innerIndexPtr + outerOffset);
+      std::advance(innerIndicesIter, nnzInOuter);
+
+      // Randomize values.
+      std::generate_n(valuePtr + outerOffset, nnzInOuter, randval);
+    }
+  }
+
+  template <typename Stats_t>
   static
   Matrix_t
   perturb(
       const Matrix_t& matrix,
       InputIter_t outerIndicesFirst,
       InputIter_t outerIndicesLast,
-      uint64_t seed) {
+      uint64_t seed,
+      Stats_t& stats,
+      std::pmr::memory_resource* resource) {
 
     Expects(std::distance(outerIndicesFirst, outerIndicesLast) >= 0);
-    Expects(std::all_of(outerIndicesFirst, outerIndicesLast, [matrix] (auto index) {
+    Expects(std::all_of(outerIndicesFirst, outerIndicesLast, [&matrix] (auto index) {
           return 0 <= index && index < matrix.outerSize();}));
 
     if constexpr (ALIGNMENT == Eigen::RowMajor) {
 
+      auto copyPhase = std::optional<ScopedPhase<Stats_t>>(std::in_place, stats, "perturb.copy");
       Matrix_t result = matrix;
       if (!result.isCompressed()) {
         result.makeCompressed(); // Might be redundant; Copy-ctor seems to create a compressed matrix
       }
+      copyPhase.reset();
+      if constexpr (STATS_ENABLED<Stats_t>) {
+        stats.add_allocation((result.outerSize() + 1) * sizeof(Index_t) +
+                             result.nonZeros() * (sizeof(Index_t) + sizeof(Scalar_t)));
+        stats.add_allocation(result.innerSize() * sizeof(Index_t)); // shuffled inner indices
+        stats.add_work(std::distance(outerIndicesFirst, outerIndicesLast));
+      }
+
+      [[maybe_unused]] const auto phase = ScopedPhase(stats, "perturb.randomize");
+      perturb_outers(result.outerIndexPtr(), result.innerIndexPtr(), result.valuePtr(),
+                     static_cast<Index_t>(result.innerSize()), outerIndicesFirst, outerIndicesLast, seed, resource);
+      return result;
+    }
+    else {
+      static_assert(!std::is_same<Scalar_t, Scalar_t>(), "ColMajor not yet implemented.");
+    }
+  }
+
+  /**
+   * As above, writing the result into caller-provided CSR arrays. The
+   * matrix is copied into the target in parallel and perturbed in place.
+   */
+  template <typename Stats_t>
+  static
+  CsrCapacity
+  perturb(
+      const CsrTarget<Scalar_t, Index_t>& target,
+      const Matrix_t& matrix,
+      InputIter_t outerIndicesFirst,
+      InputIter_t outerIndicesLast,
+      uint64_t seed,
+      Stats_t& stats,
+      std::pmr::memory_resource* resource) {
+
+    static_assert(ALIGNMENT == Eigen::RowMajor, "CSR targets require row-major matrices.");
+    Expects(std::all_of(outerIndicesFirst, outerIndicesLast, [&matrix] (auto index) {
+          return 0 <= index && index < matrix.outerSize();}));
+
+    auto copyPhase = std::optional<ScopedPhase<Stats_t>>(std::in_place, stats, "perturb.copy");
+    const auto capacity = write_csr(target, matrix.outerSize(),
+        [&](Eigen::Index outer) { return num_of_nnz_in_outer(matrix, outer); },
+        [&](Eigen::Index outer, Index_t* innerFirst, Scalar_t* valueFirst, Index_t count) {
+          const auto offset = matrix.outerIndexPtr()[outer];
+          std::copy_n(matrix.innerIndexPtr() + offset, count, innerFirst);
+          std::copy_n(matrix.valuePtr() + offset, count, valueFirst);
+        });
+    copyPhase.reset();
+    if (capacity.complete) {
+      if constexpr (STATS_ENABLED<Stats_t>) {
+        stats.add_allocation(matrix.innerSize() * sizeof(Index_t)); // shuffled inner indices
+        stats.add_work(std::distance(outerIndicesFirst, outerIndicesLast));
+      }
+      [[maybe_unused]] const auto phase = ScopedPhase(stats, "perturb.randomize");
+      perturb_outers(target.outerIndex.data(), target.innerIndex.data(), target.values.data(),
+                     static_cast<Index_t>(matrix.innerSize()), outerIndicesFirst, outerIndicesLast, seed, resource);
+    }
+    return capacity;
+  }
 
-      auto engine = std::default_random_engine(seed);
+};
 
-      // Generate all possible inner indices. We shuffle this container and
-      // draw the first `outerSize' to randomize the inner indices as we cannot
-      // draw random numbers due to possible duplicates.
-      auto innerIndices = std::vector<Index_t> {};
-      innerIndices.resize(matrix.innerSize());
-      std::generate(innerIndices.begin(), innerIndices.end(), [ii = (Index_t)0] () mutable { return ii++; });
-      std::shuffle(innerIndices.begin(), innerIndices.end(), engine);
-      auto innerIndicesIter = innerIndices.begin();
+template <
+  typename Matrix_t,
+  typename RowLengthFn_t
+    >
+struct PerturbRowLengths {};
 
-      // Initialize distribution from which values will be drawn
+/**
+ * Implementation of 'matrixgen::perturb_rowlengths' for 'Eigen::SparseMatrix'
+ * objects.
+ *
+ * The result is built directly in compressed form by `fill_compressed`. Every
+ * outer draws its random numbers from its own engine seeded by
+ * `mix_seed(seed, outer)`, thus the output does not depend on the number of
+ * threads.
+ */
+template <
+  typename Scalar_t,
+  int ALIGNMENT,
+  typename Index_t,
+  typename RowLengthFn_t
+    >
+struct PerturbRowLengths<Eigen::SparseMatrix<Scalar_t, ALIGNMENT, Index_t>, RowLengthFn_t> {
+
+  using Matrix_t = Eigen::SparseMatrix<Scalar_t, ALIGNMENT, Index_t>;
+
+  /**
+   * Returns the half-open window [lo, hi) of inner indices which new
+   * nonzeros of outer `outer` may be placed in.
+   */
+  static
+  std::pair<Index_t, Index_t>
+  window(Index_t outer, Index_t innerSize, int64_t bandwidth) {
+
+    if (bandwidth < 0) {
+      return {0, innerSize};
+    }
+    const auto lo = std::clamp<int64_t>(outer - bandwidth, 0, innerSize);
+    const auto hi = std::clamp<int64_t>(outer + bandwidth + 1, 0, innerSize);
+    return {static_cast<Index_t>(lo), static_cast<Index_t>(std::max(lo, hi))};
+  }
+
+  /**
+   * Computes the perturbed matrix's outers and hands them to
+   * `write(sizeFn, fillFn)`, which stores them in the requested output.
+   */
+  template <typename Write_t>
+  static
+  auto
+  generate(
+      const Matrix_t& matrix,
+      RowLengthFn_t rowLengthFn,
+      uint64_t seed,
+      int64_t bandwidth,
+      Write_t write) {
+
+    Expects( matrix.isCompressed() );
+
+    const auto innerSize = static_cast<Index_t>(matrix.innerSize());
+    const Index_t* srcOuter = matrix.outerIndexPtr();
+    const Index_t* srcInner = matrix.innerIndexPtr();
+    const Scalar_t* srcValues = matrix.valuePtr();
+
+    /**
+     * The number of nonzeros of an outer is the requested length clamped to
+     * what is achievable: an outer can only be filled up to its window plus
+     * whatever existing nonzeros lie outside the window, and the diagonal
+     * element is never removed.
+     */
+    auto targetSize = [&](Eigen::Index outer) -> Index_t {
+      const auto first = srcInner + srcOuter[outer];
+      const auto last = srcInner + srcOuter[outer + 1];
+      const auto nnz = static_cast<Index_t>(last - first);
+      const auto [lo, hi] = window(static_cast<Index_t>(outer), innerSize, bandwidth);
+
+      const auto outside = static_cast<Index_t>(
+          std::count_if(first, last, [lo = lo, hi = hi](auto inner) { return inner < lo || inner >= hi; }));
+      const auto hasDiagonal = std::binary_search(first, last, static_cast<Index_t>(outer));
+      const Index_t requested = rowLengthFn(static_cast<Index_t>(outer), nnz);
+      return std::clamp<Index_t>(requested, hasDiagonal ? 1 : 0, (hi - lo) + outside);
+    };
+
+    // Per-thread scratch space of `fill`, reused across outers.
+    struct Scratch {
+      std::vector<Index_t> kept;
+      std::vector<Index_t> occupied;
+      std::vector<Index_t> ranks;
+      std::vector<Index_t> fresh;
+      std::unordered_set<Index_t> picked;
+    };
+    auto scratches = tbb::enumerable_thread_specific<Scratch> {};
+
+    auto fill = [&](Eigen::Index outer, Index_t* innerFirst, Scalar_t* valueFirst, Index_t count) {
+      auto engine = std::default_random_engine(mix_seed(seed, static_cast<uint64_t>(outer)));
       auto dist = std::uniform_real_distribution<Scalar_t>((Scalar_t)1.0, (Scalar_t)2.0);
-      auto randval = [&]() { return dist(engine); };
+      auto& [kept, occupied, ranks, fresh, picked] = scratches.local();
 
-      for (auto it = outerIndicesFirst; it != outerIndicesLast; ++it) {
+      const auto first = srcOuter[outer];
+      const auto nnz = static_cast<Index_t>(srcOuter[outer + 1] - first);
+      const auto [lo, hi] = window(static_cast<Index_t>(outer), innerSize, bandwidth);
 
-        const auto outerIndex = *it;
-        const auto outerOffset = *std::next(result.outerIndexPtr(), outerIndex); // Offset into V and CI for this row
-        const auto nnzInOuter = *std::next(result.outerIndexPtr(), outerIndex + 1)
-                                - *std::next(result.outerIndexPtr(), outerIndex);
+      // (1) Choose which existing nonzeros to keep. If the outer shrinks a
+      //     random subset is kept, always including the diagonal.
+      kept.resize(nnz); // positions relative to `first`
+      std::iota(kept.begin(), kept.end(), 0);
+      if (count < nnz) {
+        const auto diag = std::find(srcInner + first, srcInner + first + nnz, static_cast<Index_t>(outer));
+        if (diag != srcInner + first + nnz) {
+          std::swap(kept.front(), kept[diag - (srcInner + first)]);
+        }
+        const auto reserved = (diag != srcInner + first + nnz) ? 1 : 0;
+        std::shuffle(std::next(kept.begin(), reserved), kept.end(), engine);
+        kept.resize(count);
+        std::sort(kept.begin(), kept.end());
+      }
 
-        // Randomize inner indices. We write out the inner indices in ascending
-        // order which makes the output more predictable.
-        if (std::distance(innerIndicesIter, innerIndices.end()) <= nnzInOuter) {
-          std::shuffle(innerIndices.begin(), innerIndices.end(), engine);
-          innerIndicesIter = innerIndices.begin();
+      // (2) Draw the missing nonzeros' inner indices without replacement from
+      //     the window's free slots (Floyd's algorithm, membership tested in
+      //     `picked`), then map each slot's rank onto an inner index skipping
+      //     the occupied ones.
+      occupied.clear();
+      for (auto k : kept) {
+        const auto inner = srcInner[first + k];
+        if (lo <= inner && inner < hi) {
+          occupied.push_back(inner);
+        }
+      }
+      const auto numFree = (hi - lo) - static_cast<Index_t>(occupied.size());
+      const auto numNew = count - static_cast<Index_t>(kept.size());
+      ranks.clear();
+      picked.clear();
+      for (auto jj = numFree - numNew; jj < numFree; ++jj) {
+        const auto rr = std::uniform_int_distribution<Index_t>(0, jj)(engine);
+        const auto pick = picked.count(rr) > 0 ? jj : rr;
+        picked.insert(pick);
+        ranks.push_back(pick);
+      }
+      std::sort(ranks.begin(), ranks.end());
+      fresh.resize(ranks.size());
+      auto occ = std::size_t {0};
+      for (std::size_t ii = 0; ii < ranks.size(); ++ii) {
+        while (occ < occupied.size() && occupied[occ] <= lo + ranks[ii] + static_cast<Index_t>(occ)) {
+          ++occ;
         }
-        std::sort(innerIndicesIter, std::next(innerIndicesIter, nnzInOuter));
-        std::copy_n(innerIndicesIter, nnzInOuter, result.innerIndexPtr() + outerOffset);
-        std::advance(innerIndicesIter, nnzInOuter);
+        fresh[ii] = lo + ranks[ii] + static_cast<Index_t>(occ);
+      }
 
-        // Randomize values.
-        std::generate_n(result.valuePtr() + outerOffset, nnzInOuter, randval);
+      // (3) Merge kept and new nonzeros in ascending inner order. New
+      //     nonzeros are drawn from U(1, 2) as in `perturb`.
+      auto k = std::size_t {0};
+      auto f = std::size_t {0};
+      for (Index_t out = 0; out < count; ++out) {
+        if (f == fresh.size() || (k < kept.size() && srcInner[first + kept[k]] < fresh[f])) {
+          innerFirst[out] = srcInner[first + kept[k]];
+          valueFirst[out] = srcValues[first + kept[k]];
+          ++k;
+        }
+        else {
+          innerFirst[out] = fresh[f++];
+          valueFirst[out] = dist(engine);
+        }
       }
-      return result;
-    }
-    else {
-      static_assert(!std::is_same<Scalar_t, Scalar_t>(), "ColMajor not yet implemented.");
-    }
+    };
+
+    return write(targetSize, fill);
   }
 
+  template <typename Stats_t>
+  static
+  Matrix_t
+  invoke(
+      const Matrix_t& matrix,
+      RowLengthFn_t rowLengthFn,
+      uint64_t seed,
+      int64_t bandwidth,
+      Stats_t& stats) {
+
+    Matrix_t result;
+    generate(matrix, rowLengthFn, seed, bandwidth, [&](auto sizeFn, auto fillFn) {
+      fill_compressed(result, matrix.rows(), matrix.cols(), sizeFn, fillFn, stats);
+      return 0;
+    });
+    return result;
+  }
+
+  template <typename Stats_t>
+  static
+  CsrCapacity
+  invoke(
+      const CsrTarget<Scalar_t, Index_t>& target,
+      const Matrix_t& matrix,
+      RowLengthFn_t rowLengthFn,
+      uint64_t seed,
+      int64_t bandwidth,
+      Stats_t& stats) {
+
+    static_assert(ALIGNMENT == Eigen::RowMajor, "CSR targets require row-major matrices.");
+    return generate(matrix, rowLengthFn, seed, bandwidth, [&](auto sizeFn, auto fillFn) {
+      return write_csr(target, matrix.outerSize(), sizeFn, fillFn, true, stats);
+    });
+  }
 };
 
 } // namespace matrixgen::implementation
@@ -118,33 +404,209 @@ namespace matrixgen {
 
 template <
   typename Matrix_t,
-  typename ListElem_t
+  typename ListElem_t,
+  typename Stats_t = NoStats
     >
 Matrix_t perturb(
     const Matrix_t& matrix,
     std::initializer_list<ListElem_t> list,
-    uint64_t seed) {
+    uint64_t seed,
+    Stats_t&& stats = Stats_t {},
+    std::pmr::memory_resource* resource = std::pmr::get_default_resource()) {
 
   using Iter_t = typename std::initializer_list<ListElem_t>::const_iterator;
-  return implementation::Perturb<Matrix_t, decltype(list.begin())>::perturb(matrix, list.begin(), list.end(), seed);
+  return implementation::Perturb<Matrix_t, Iter_t>::perturb(matrix, list.begin(), list.end(), seed, stats, resource);
 }
 
 /**
  * Perturb selected rows of a matrix.
  *
- * Same as above with a range of 0-indexed row numbers.
+ * Same as above with a range of 0-indexed row numbers. An optional
+ * `GenerationStats` sink receives the times of the phases 'perturb.copy' and
+ * 'perturb.randomize'. The shuffled inner indices are allocated from
+ * `resource`, see 'memory.hpp'.
  */
 template <
   typename Matrix_t,
-  typename InputIter_t
+  typename InputIter_t,
+  typename Stats_t = NoStats
     >
 Matrix_t perturb(
     const Matrix_t& matrix,
     InputIter_t outerIndicesFirst,
     InputIter_t outerIndicesLast,
-    uint64_t seed) {
+    uint64_t seed,
+    Stats_t&& stats = Stats_t {},
+    std::pmr::memory_resource* resource = std::pmr::get_default_resource()) {
+
+  return implementation::Perturb<Matrix_t, InputIter_t>::perturb(matrix, outerIndicesFirst, outerIndicesLast, seed, stats, resource);
+}
+
+/**
+ * As above, but writes the perturbed row-major matrix into the
+ * caller-provided CSR arrays of `target`. Returns the required capacities;
+ * see `CsrTarget` and `CsrCapacity` in 'target.hpp'. `stats` receives the
+ * phases 'perturb.copy' and, if the target was large enough,
+ * 'perturb.randomize'. Scratch space is allocated from `resource`.
+ */
+template <
+  typename Scalar_t,
+  int ALIGNMENT,
+  typename Index_t,
+  typename InputIter_t,
+  typename Stats_t = NoStats
+    >
+CsrCapacity perturb(
+    const CsrTarget<Scalar_t, Index_t>& target,
+    const Eigen::SparseMatrix<Scalar_t, ALIGNMENT, Index_t>& matrix,
+    InputIter_t outerIndicesFirst,
+    InputIter_t outerIndicesLast,
+    uint64_t seed,
+    Stats_t&& stats = Stats_t {},
+    std::pmr::memory_resource* resource = std::pmr::get_default_resource()) {
+
+  using Matrix_t = Eigen::SparseMatrix<Scalar_t, ALIGNMENT, Index_t>;
+  return implementation::Perturb<Matrix_t, InputIter_t>::perturb(target, matrix, outerIndicesFirst, outerIndicesLast, seed, stats, resource);
+}
+
+/**
+ * Overload of both of the above executed under `context`, see
+ * 'execution.hpp'.
+ */
+template <typename... Args_t>
+decltype(auto)
+perturb(const ExecutionContext& context, Args_t&&... args) {
+
+  return context.execute([&]() { return perturb(std::forward<Args_t>(args)...); });
+}
+
+/**
+ * Perturb a matrix's row (column) lengths for row-major (col-major) matrices.
+ *
+ * The number of nonzeros of each outer is set to `rowLengthFn(outer, nnz)`,
+ * where `nnz` is the outer's current number of nonzeros. Outers which shrink
+ * keep a random subset of their nonzeros including the diagonal element.
+ * Outers which grow keep all their nonzeros and receive additional ones at
+ * random inner indices with values drawn from U(1, 2). If `bandwidth` is not
+ * negative new nonzeros are restricted to inner indices within `bandwidth`
+ * of the diagonal. Requested lengths are clamped to what is achievable.
+ *
+ * `rowLengthFn` is called concurrently and must be free of mutable state. See
+ * the row-length presets below, e.g. `powerlaw_rowlengths`.
+ *
+ * The returned matrix is compressed. An optional `GenerationStats` sink
+ * receives the phases of `fill_compressed`.
+ */
+template <
+  typename Matrix_t,
+  typename RowLengthFn_t,
+  typename Stats_t = NoStats
+    >
+Matrix_t perturb_rowlengths(
+    const Matrix_t& matrix,
+    RowLengthFn_t rowLengthFn,
+    uint64_t seed,
+    int64_t bandwidth = -1,
+    Stats_t&& stats = Stats_t {}) {
+
+  return implementation::PerturbRowLengths<Matrix_t, RowLengthFn_t>::invoke(matrix, rowLengthFn, seed, bandwidth, stats);
+}
+
+/**
+ * As above, but writes the result into the caller-provided CSR arrays of
+ * `target`. Returns the required capacities; see `CsrTarget` and
+ * `CsrCapacity` in 'target.hpp'.
+ */
+template <
+  typename Scalar_t,
+  int ALIGNMENT,
+  typename Index_t,
+  typename RowLengthFn_t,
+  typename Stats_t = NoStats
+    >
+CsrCapacity perturb_rowlengths(
+    const CsrTarget<Scalar_t, Index_t>& target,
+    const Eigen::SparseMatrix<Scalar_t, ALIGNMENT, Index_t>& matrix,
+    RowLengthFn_t rowLengthFn,
+    uint64_t seed,
+    int64_t bandwidth = -1,
+    Stats_t&& stats = Stats_t {}) {
+
+  using Matrix_t = Eigen::SparseMatrix<Scalar_t, ALIGNMENT, Index_t>;
+  return implementation::PerturbRowLengths<Matrix_t, RowLengthFn_t>::invoke(target, matrix, rowLengthFn, seed, bandwidth, stats);
+}
+
+/*************************************
+ ******* Row-length functions ********
+ *************************************/
+
+/**
+ * matrixgen::powerlaw_rowlengths()
+ *
+ * Row lengths drawn from a discrete Pareto distribution with exponent
+ * `alpha > 1`, i.e. P(len >= x) ~ (minLength / x)^(alpha - 1), truncated to
+ * `maxLength`.
+ */
+template <
+  typename Index_t = int
+    >
+auto powerlaw_rowlengths(double alpha, Index_t minLength, Index_t maxLength, uint64_t seed = 1) {
+
+  Expects( alpha > 1.0 );
+  Expects( 0 < minLength && minLength <= maxLength );
 
-  return implementation::Perturb<Matrix_t, InputIter_t>::perturb(matrix, outerIndicesFirst, outerIndicesLast, seed);
+  return [=](Index_t outer, Index_t) -> Index_t {
+    auto engine = std::default_random_engine(mix_seed(seed, static_cast<uint64_t>(outer)));
+    const auto u = std::uniform_real_distribution<double>(0.0, 1.0)(engine);
+    const auto len = minLength * std::pow(1.0 - u, -1.0 / (alpha - 1.0));
+    return static_cast<Index_t>(std::min<double>(len, maxLength));
+  };
+}
+
+/**
+ * matrixgen::bimodal_rowlengths()
+ *
+ * Rows are long (`longLength`) with probability `longFraction` and short
+ * (`shortLength`) otherwise.
+ */
+template <
+  typename Index_t = int
+    >
+auto bimodal_rowlengths(Index_t shortLength, Index_t longLength, double longFraction, uint64_t seed = 1) {
+
+  Expects( 0.0 <= longFraction && longFraction <= 1.0 );
+
+  return [=](Index_t outer, Index_t) -> Index_t {
+    auto engine = std::default_random_engine(mix_seed(seed, static_cast<uint64_t>(outer)));
+    const auto u = std::uniform_real_distribution<double>(0.0, 1.0)(engine);
+    return u < longFraction ? longLength : shortLength;
+  };
+}
+
+/**
+ * matrixgen::maxmean_rowlengths()
+ *
+ * Imposes a max/mean row length ratio of `ratio` while keeping the expected
+ * row length equal to the source row's length `nnz`. A fraction
+ * `longFraction` of the rows is stretched to `ratio * nnz`; all other rows
+ * are shortened to compensate. Requires `ratio * longFraction < 1`.
+ */
+template <
+  typename Index_t = int
+    >
+auto maxmean_rowlengths(double ratio, double longFraction, uint64_t seed = 1) {
+
+  Expects( ratio >= 1.0 );
+  Expects( 0.0 < longFraction && ratio * longFraction < 1.0 );
+
+  return [=](Index_t outer, Index_t nnz) -> Index_t {
+    auto engine = std::default_random_engine(mix_seed(seed, static_cast<uint64_t>(outer)));
+    const auto u = std::uniform_real_distribution<double>(0.0, 1.0)(engine);
+    if (u < longFraction) {
+      return static_cast<Index_t>(std::lround(ratio * nnz));
+    }
+    return static_cast<Index_t>(std::lround(nnz * (1.0 - ratio * longFraction) / (1.0 - longFraction)));
+  };
 }
 
 } // namespace matrixgen::implementation
@@ -9,21 +9,489 @@
 
 #include <gsl/gsl-lite.hpp>
 
+#include <algorithm>
 #include <array>
 #include <cmath>
 #include <limits>
+#include <memory>
 #include <random>
+#include <tuple>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
 namespace matrixgen {
 
+/**
+ * Offset of a neighbor relative to a node of a grid of rank `RANK`. Used to
+ * describe stencils, see `StencilShape`.
+ */
+template <std::size_t RANK>
+using OffsetNd_t = std::array<int, RANK>;
+
+using Offset_t = OffsetNd_t<3>;
+
+/**
+ * matrixgen::StencilShape
+ *
+ * Compile-time description of a stencil by its offsets. The order of the
+ * offsets is the order in which the adjacency function returns them and
+ * thus the order of the weight function's calls.
+ *
+ * ****************************************************************************
+ *   using Diagonals2d_t = matrixgen::StencilShape<
+ *     matrixgen::OffsetNd_t<2> {0, 0},
+ *     matrixgen::OffsetNd_t<2> {-1, -1}, matrixgen::OffsetNd_t<2> {1, -1},
+ *     matrixgen::OffsetNd_t<2> {-1, 1}, matrixgen::OffsetNd_t<2> {1, 1}>;
+ *   auto adjfn = matrixgen::stencil<Diagonals2d_t, BC::NEUMANN, BC::PERIODIC>();
+ * ****************************************************************************
+ *
+ * The rank of the stencil is the size of its offsets, e.g. offsets of type
+ * `OffsetNd_t<2>` describe a stencil for 2D grids. Any type with a
+ * `static constexpr std::array<OffsetNd_t<RANK>, N> OFFSETS` member may be
+ * used as a shape, e.g. `Stencil19pShape`.
+ */
+template <auto... ELEMS>
+struct StencilShape
+{
+  static constexpr std::array<std::common_type_t<decltype(ELEMS)...>, sizeof...(ELEMS)> OFFSETS {{ELEMS...}};
+};
+
+/* The symmetric 7p stencil in the order of `STENCIL<7>`. */
+using Stencil7pShape = StencilShape<
+  Offset_t { 0,  0,  0},
+  Offset_t {-1,  0,  0}, Offset_t {1, 0, 0},
+  Offset_t { 0, -1,  0}, Offset_t {0, 1, 0},
+  Offset_t { 0,  0, -1}, Offset_t {0, 0, 1}>;
+
+namespace implementation
+{
+
+/* `base` to the power of `exponent`. */
+constexpr
+std::size_t
+ipow(std::size_t base, std::size_t exponent) {
+  auto result = std::size_t {1};
+  for(auto ii = std::size_t {0}; ii < exponent; ++ii) {
+    result *= base;
+  }
+  return result;
+}
+
+/**
+ * Returns the null offset followed by the offsets of the cube of edge length
+ * 3 of rank `RANK`, in x-then-y-then-z order, whose 1-norm does not exceed
+ * `MAX_NORM`.
+ */
+template <
+  std::size_t RANK,
+  std::size_t SIZE,
+  int MAX_NORM
+    >
+constexpr
+std::array<OffsetNd_t<RANK>, SIZE>
+cube_offsets() {
+
+  auto result = std::array<OffsetNd_t<RANK>, SIZE> {};
+  auto count = std::size_t {1};
+  for(auto ii = std::size_t {0}; ii < ipow(3, RANK); ++ii) {
+    auto offset = OffsetNd_t<RANK> {};
+    auto norm = 0;
+    auto rest = ii;
+    for(auto dim = std::size_t {0}; dim < RANK; ++dim) {
+      offset[dim] = static_cast<int>(rest % 3) - 1;
+      norm += offset[dim] < 0 ? -offset[dim] : offset[dim];
+      rest /= 3;
+    }
+    if(norm != 0 && norm <= MAX_NORM) {
+      result[count++] = offset;
+    }
+  }
+  return result;
+}
+
+/**
+ * Returns the null offset followed by the offsets -1 and 1 along each
+ * dimension of rank `RANK`, in the order of `Stencil7pShape`.
+ */
+template <std::size_t RANK>
+constexpr
+std::array<OffsetNd_t<RANK>, 2 * RANK + 1>
+star_offsets() {
+
+  auto result = std::array<OffsetNd_t<RANK>, 2 * RANK + 1> {};
+  for(auto dim = std::size_t {0}; dim < RANK; ++dim) {
+    result[2 * dim + 1][dim] = -1;
+    result[2 * dim + 2][dim] = 1;
+  }
+  return result;
+}
+
+} // namespace implementation
+
+/* The 19p stencil: the 7p stencil plus the twelve edge neighbors. */
+struct Stencil19pShape
+{
+  static constexpr auto OFFSETS = implementation::cube_offsets<3, 19, 2>();
+};
+
+/* The 27p stencil: all neighbors of the 3x3x3 cube. */
+struct Stencil27pShape
+{
+  static constexpr auto OFFSETS = implementation::cube_offsets<3, 27, 3>();
+};
+
+/**
+ * The star stencil of rank `RANK`: a node and its two neighbors along each
+ * dimension, e.g. the 3p, 5p and 7p stencils for ranks 1, 2 and 3.
+ */
+template <std::size_t RANK>
+struct StarStencilShape
+{
+  static constexpr auto OFFSETS = implementation::star_offsets<RANK>();
+};
+
+/**
+ * The box stencil of rank `RANK`: all `3^RANK` nodes of the cube of edge
+ * length 3 around a node, e.g. the 9p stencil for rank 2.
+ */
+template <std::size_t RANK>
+struct BoxStencilShape
+{
+  static constexpr auto OFFSETS = implementation::cube_offsets<RANK, implementation::ipow(3, RANK), static_cast<int>(RANK)>();
+};
+
+namespace implementation
+{
+
+/**
+ * An offset's component in one dimension, resolved against the boundary
+ * conditions: invalid if it leaves a Dirichlet boundary, otherwise the
+ * component to add to the node's coordinate plus `wrap` times the grid's
+ * extent (periodic boundaries).
+ */
+struct ResolvedComponent
+{
+  bool valid;
+  int offset;
+  int wrap;
+};
+
+/**
+ * Resolves the component `offset` for nodes of the class `cls` of a
+ * dimension. For a stencil of extent `EXTENT`, classes 0 to `EXTENT - 1` are
+ * the nodes at this distance from the lower boundary, class `EXTENT` are the
+ * inner nodes and classes `EXTENT + 1` to `2 * EXTENT` are the nodes at
+ * distance `2 * EXTENT - cls` from the upper boundary.
+ *
+ * Neumann boundaries mirror the neighbor at the boundary node, i.e. the
+ * neighbor at -1 becomes the one at 1.
+ */
+constexpr
+ResolvedComponent
+resolve_component(int offset, int cls, int extent, BC bc) {
+
+  const auto distance = cls < extent ? cls : 2 * extent - cls;
+  const auto outside = cls < extent ? (cls + offset < 0) : (cls > extent && offset > distance);
+  if(!outside) {
+    return {true, offset, 0};
+  }
+  const auto sign = cls < extent ? 1 : -1;
+  switch(bc) {
+    case BC::PERIODIC:
+      return {true, offset, sign};
+    case BC::NEUMANN:
+      return {true, -sign * 2 * distance - offset, 0};
+    default:
+      return {false, 0, 0};
+  }
+}
+
+/**
+ * As above for a node at `coord` in a dimension of extent `size` of any
+ * size. Used for grids which are too small for the precomputed regions.
+ */
+template <typename Index_t>
+ResolvedComponent
+resolve_component_per_node(Index_t offset, Index_t coord, Index_t size, BC bc) {
+
+  const auto target = coord + offset;
+  if(0 <= target && target < size) {
+    return {true, static_cast<int>(offset), 0};
+  }
+  switch(bc) {
+    case BC::PERIODIC:
+      return {true, static_cast<int>(mod(target, size) - coord), 0};
+    case BC::NEUMANN: {
+      if(size == 1) {
+        return {true, static_cast<int>(-coord), 0};
+      }
+      const auto period = 2 * (size - 1);
+      const auto folded = mod(target, period);
+      return {true, static_cast<int>((folded < size ? folded : period - folded) - coord), 0};
+    }
+    default:
+      return {false, 0, 0};
+  }
+}
+
+/* The boundary condition of dimension `dim`: `ZBC` applies to all dimensions past y. */
+template <
+  auto XBC,
+  auto YBC,
+  auto ZBC
+    >
+constexpr
+BC
+boundary_condition(std::size_t dim) {
+  return dim == 0 ? XBC : dim == 1 ? YBC : ZBC;
+}
+
+/**
+ * Boundary region tables of a stencil, computed at compile time.
+ *
+ * Every dimension is divided into the `2 * EXTENT + 1` classes of
+ * `resolve_component`, which yields `CLASSES^RANK` regions, e.g. the 27
+ * regions (inner node, 6 faces, 12 edges and 8 corners) of 3D stencils of
+ * extent 1.
+ * All nodes of a region share their offsets, which are stored contiguously
+ * in `TABLES.offsets` starting at `BEGIN[region]`. Offsets across periodic
+ * boundaries are stored along with their `TABLES.wraps`, the multiples of
+ * the grid's dimensions to add at runtime.
+ */
+template <
+  typename Shape_t,
+  auto XBC,
+  auto YBC,
+  auto ZBC,
+  typename Index_t
+    >
+struct StencilRegions
+{
+  using ShapeOffset_t = typename std::decay_t<decltype(Shape_t::OFFSETS)>::value_type;
+
+  static constexpr std::size_t SIZE = Shape_t::OFFSETS.size();
+  static constexpr std::size_t RANK = std::tuple_size<ShapeOffset_t>::value;
+
+  static constexpr int EXTENT = []() {
+    auto extent = 0;
+    for(const auto& offset : Shape_t::OFFSETS) {
+      for(const auto component : offset) {
+        extent = std::max(extent, component < 0 ? -component : component);
+      }
+    }
+    return extent;
+  }();
+
+  static constexpr int CLASSES = 2 * EXTENT + 1;
+  static constexpr std::size_t NUM_OF_REGIONS = ipow(CLASSES, RANK);
+  static constexpr bool ANY_PERIODIC = XBC == BC::PERIODIC ||
+                                       (RANK > 1 && YBC == BC::PERIODIC) ||
+                                       (RANK > 2 && ZBC == BC::PERIODIC);
+
+  /* Resolves `offset` in region `region`. Returns false if the offset is dropped. */
+  static constexpr
+  bool
+  resolve(const ShapeOffset_t& offset, std::size_t region, ShapeOffset_t& resolved, ShapeOffset_t& wrap) {
+
+    auto rest = region;
+    for(auto dim = std::size_t {0}; dim < RANK; ++dim) {
+      const auto cls = static_cast<int>(rest % CLASSES);
+      rest /= CLASSES;
+      const auto component = resolve_component(offset[dim], cls, EXTENT, boundary_condition<XBC, YBC, ZBC>(dim));
+      if(!component.valid) {
+        return false;
+      }
+      resolved[dim] = component.offset;
+      wrap[dim] = component.wrap;
+    }
+    return true;
+  }
+
+  static constexpr std::array<std::size_t, NUM_OF_REGIONS + 1> BEGIN = []() {
+    auto begin = std::array<std::size_t, NUM_OF_REGIONS + 1> {};
+    for(auto region = std::size_t {0}; region < NUM_OF_REGIONS; ++region) {
+      auto count = std::size_t {0};
+      for(const auto& offset : Shape_t::OFFSETS) {
+        auto resolved = ShapeOffset_t {};
+        auto wrap = ShapeOffset_t {};
+        count += resolve(offset, region, resolved, wrap) ? 1 : 0;
+      }
+      begin[region + 1] = begin[region] + count;
+    }
+    return begin;
+  }();
+
+  static constexpr std::size_t TOTAL = BEGIN[NUM_OF_REGIONS];
+
+  struct Tables
+  {
+    std::array<Coords_t<Index_t, RANK>, TOTAL> offsets;
+    std::array<ShapeOffset_t, TOTAL> wraps;
+    std::array<bool, NUM_OF_REGIONS> wrapped;
+  };
+
+  static constexpr Tables TABLES = []() {
+    auto tables = Tables {};
+    auto out = std::size_t {0};
+    for(auto region = std::size_t {0}; region < NUM_OF_REGIONS; ++region) {
+      for(const auto& offset : Shape_t::OFFSETS) {
+        auto resolved = ShapeOffset_t {};
+        auto wrap = ShapeOffset_t {};
+        if(resolve(offset, region, resolved, wrap)) {
+          for(auto dim = std::size_t {0}; dim < RANK; ++dim) {
+            tables.offsets[out][dim] = static_cast<Index_t>(resolved[dim]);
+          }
+          tables.wraps[out] = wrap;
+          tables.wrapped[region] = tables.wrapped[region] || wrap != ShapeOffset_t {};
+          ++out;
+        }
+      }
+    }
+    return tables;
+  }();
+
+  /* Class of the node at `coord` in a dimension of extent `size >= 2 * EXTENT`. */
+  static
+  std::size_t
+  class_of(Index_t coord, Index_t size) {
+    if(coord < EXTENT) {
+      return static_cast<std::size_t>(coord);
+    }
+    if(coord >= size - EXTENT) {
+      return static_cast<std::size_t>(2 * EXTENT - (size - 1 - coord));
+    }
+    return EXTENT;
+  }
+};
+
+/**
+ * Function object of `stencil`. Offsets are looked up in the node's region's
+ * table of `StencilRegions`. Offsets across periodic boundaries, and those of
+ * grids smaller than twice the stencil's extent in any dimension, are
+ * assembled in `offsets`, which is why calls are not const.
+ */
+template <
+  typename Shape_t,
+  auto XBC,
+  auto YBC,
+  auto ZBC,
+  typename Index_t
+    >
+struct Stencil
+{
+  using Regions_t = StencilRegions<Shape_t, XBC, YBC, ZBC, Index_t>;
+  using NodeCoords_t = Coords_t<Index_t, Regions_t::RANK>;
+  using Range_t = std::pair<const NodeCoords_t*, const NodeCoords_t*>;
+
+  std::array<NodeCoords_t, Regions_t::SIZE> offsets {};
+
+  Range_t
+  operator()(
+      const NodeCoords_t& coords,
+      const NodeCoords_t& gridDimensions) {
+
+    Expects( is_inside_grid<Index_t>(coords, gridDimensions) );
+    static_assert( std::is_same<decltype(XBC), BC>() );
+    static_assert( std::is_same<decltype(YBC), BC>() );
+    static_assert( std::is_same<decltype(ZBC), BC>() );
+
+    constexpr auto EXTENT = Regions_t::EXTENT;
+    constexpr auto CLASSES = static_cast<std::size_t>(Regions_t::CLASSES);
+    auto region = std::size_t {0};
+    for(auto dim = Regions_t::RANK; dim-- > 0;) {
+      if(gridDimensions[dim] < 2 * EXTENT) {
+        return resolve_per_node(coords, gridDimensions);
+      }
+      region = CLASSES * region + Regions_t::class_of(coords[dim], gridDimensions[dim]);
+    }
+    const auto* first = Regions_t::TABLES.offsets.data() + Regions_t::BEGIN[region];
+    const auto* last = Regions_t::TABLES.offsets.data() + Regions_t::BEGIN[region + 1];
+
+    if constexpr (Regions_t::ANY_PERIODIC) {
+      if(Regions_t::TABLES.wrapped[region]) {
+        const auto* wrap = Regions_t::TABLES.wraps.data() + Regions_t::BEGIN[region];
+        auto out = offsets.begin();
+        for(auto it = first; it != last; ++it, ++wrap, ++out) {
+          for(auto dim = std::size_t {0}; dim < Regions_t::RANK; ++dim) {
+            (*out)[dim] = (*it)[dim] + (*wrap)[dim] * gridDimensions[dim];
+          }
+        }
+        return {offsets.data(), offsets.data() + std::distance(first, last)};
+      }
+    }
+    return {first, last};
+  }
+
+private:
+  Range_t
+  resolve_per_node(
+      const NodeCoords_t& coords,
+      const NodeCoords_t& gridDimensions) {
+
+    auto end = offsets.begin();
+    for(const auto& offset : Shape_t::OFFSETS) {
+      auto valid = true;
+      for(auto dim = std::size_t {0}; dim < Regions_t::RANK && valid; ++dim) {
+        const auto bc = boundary_condition<XBC, YBC, ZBC>(dim);
+        const auto component = resolve_component_per_node<Index_t>(offset[dim], coords[dim], gridDimensions[dim], bc);
+        valid = component.valid;
+        (*end)[dim] = component.offset;
+      }
+      end += valid ? 1 : 0;
+    }
+    return {offsets.data(), offsets.data() + std::distance(offsets.begin(), end)};
+  }
+};
+
+} // namespace implementation
+
+/**
+ * matrixgen::stencil()
+ *
+ * Returns an adjacency function which implements the stencil `Shape_t`, see
+ * `StencilShape`, on grids of the shape's rank. Boundary conditions may be
+ * chosen independently for the x, y and z dimensions; `ZBC` applies to all
+ * dimensions past y of grids of rank 4 and above:
+ *
+ *   - `BC::DIRICHLET` drops offsets which point outside the grid,
+ *   - `BC::PERIODIC` wraps them around to the opposite side of the grid,
+ *   - `BC::NEUMANN` mirrors them at the boundary node, such that the node at
+ *     -1 becomes the node at 1. The weights of offsets which thereby map
+ *     onto the same neighbor are summed up by `adjmat`.
+ *
+ * The offsets of each of the regions near the boundaries are computed at
+ * compile time, so boundary nodes cost a table lookup instead of a filter
+ * over the stencil.
+ */
+template <
+  typename Shape_t,
+  auto XBC = BC::DIRICHLET, // Boundary conditions for the X, ..
+  auto YBC = BC::DIRICHLET, // .. the Y,
+  auto ZBC = BC::DIRICHLET, // .. and the Z-dimension, respectively.
+  typename Index_t = int
+    >
+auto stencil() {
+
+  return implementation::Stencil<Shape_t, XBC, YBC, ZBC, Index_t> {};
+}
+
+/**
+ * As above for the stencil given by its offsets and Dirichlet boundaries in
+ * every dimension, i.e. `stencil<StencilShape<ELEMS...>>()`.
+ */
+template <auto... ELEMS>
+auto stencil() {
+
+  return stencil<StencilShape<ELEMS...>>();
+}
+
 /**
  * matrixgen::stencil7p()
  *
- * Returns a lambda which implements the symmetric 7p stencil. Boundary
- * conditions may be chosen independently for x, y and z dimensions
- * independent of each other.
+ * Returns a function object which implements the symmetric 7p stencil.
+ * Boundary conditions may be chosen independently for x, y and z dimensions
+ * independent of each other, see `stencil`.
  */
 template <
   auto XBC = BC::DIRICHLET, // Boundary conditions for the X, ..
@@ -33,9 +501,157 @@ template <
     >
 auto stencil7p() {
 
-  return [offsets = std::array<Coords3d_t<Index_t>, 7> {}] (
-    const Coords3d_t<Index_t>& coords,
-    const std::array<int, 3>& gridDimensions) mutable {
+  return stencil<Stencil7pShape, XBC, YBC, ZBC, Index_t>();
+}
+
+/**
+ * matrixgen::stencil19p()
+ *
+ * Returns a function object which implements the symmetric 19p stencil,
+ * i.e. the face and edge neighbors. See `stencil`.
+ */
+template <
+  auto XBC = BC::DIRICHLET,
+  auto YBC = BC::DIRICHLET,
+  auto ZBC = BC::DIRICHLET,
+  typename Index_t = int
+    >
+auto stencil19p() {
+
+  return stencil<Stencil19pShape, XBC, YBC, ZBC, Index_t>();
+}
+
+/**
+ * matrixgen::stencil27p()
+ *
+ * Returns a function object which implements the full 27p stencil. See
+ * `stencil`.
+ */
+template <
+  auto XBC = BC::DIRICHLET,
+  auto YBC = BC::DIRICHLET,
+  auto ZBC = BC::DIRICHLET,
+  typename Index_t = int
+    >
+auto stencil27p() {
+
+  return stencil<Stencil27pShape, XBC, YBC, ZBC, Index_t>();
+}
+
+/**
+ * matrixgen::stencil3p()
+ *
+ * Returns a function object which implements the symmetric 3p stencil on 1D
+ * grids, see `stencil`.
+ */
+template <
+  auto XBC = BC::DIRICHLET,
+  typename Index_t = int
+    >
+auto stencil3p() {
+
+  return stencil<StarStencilShape<1>, XBC, BC::DIRICHLET, BC::DIRICHLET, Index_t>();
+}
+
+/**
+ * matrixgen::stencil5p()
+ *
+ * Returns a function object which implements the symmetric 5p stencil on 2D
+ * grids, see `stencil`.
+ */
+template <
+  auto XBC = BC::DIRICHLET,
+  auto YBC = BC::DIRICHLET,
+  typename Index_t = int
+    >
+auto stencil5p() {
+
+  return stencil<StarStencilShape<2>, XBC, YBC, BC::DIRICHLET, Index_t>();
+}
+
+/**
+ * matrixgen::stencil9p()
+ *
+ * Returns a function object which implements the full 9p stencil on 2D
+ * grids, see `stencil`.
+ */
+template <
+  auto XBC = BC::DIRICHLET,
+  auto YBC = BC::DIRICHLET,
+  typename Index_t = int
+    >
+auto stencil9p() {
+
+  return stencil<BoxStencilShape<2>, XBC, YBC, BC::DIRICHLET, Index_t>();
+}
+
+namespace implementation
+{
+
+/**
+ * Offsets of all neighbors within a Euclidean radius, sorted in z-then-y-then-x
+ * order, i.e. by their nodes' indices. Shared by the copies of a
+ * `RadiusStencil`.
+ */
+template <typename Index_t>
+struct RadiusTable
+{
+  int extent;
+  std::vector<Coords3d_t<Index_t>> offsets;
+};
+
+template <typename Index_t>
+std::shared_ptr<const RadiusTable<Index_t>>
+make_radius_table(double radius) {
+
+  Expects( radius >= 0 );
+
+  auto table = std::make_shared<RadiusTable<Index_t>>();
+  table->extent = static_cast<int>(std::floor(radius));
+  const auto extent = table->extent;
+  const auto radius2 = radius * radius;
+  for(auto zz = -extent; zz <= extent; ++zz) {
+    for(auto yy = -extent; yy <= extent; ++yy) {
+      for(auto xx = -extent; xx <= extent; ++xx) {
+        if(static_cast<double>(xx * xx + yy * yy + zz * zz) <= radius2) {
+          table->offsets.push_back({{xx, yy, zz}});
+        }
+      }
+    }
+  }
+  return table;
+}
+
+/**
+ * Function object of `stencil_radius`. Inner nodes return the shared table.
+ * The offsets of boundary nodes are resolved on the first node of their
+ * boundary region, see `resolve_component`, and appended to `offsets`;
+ * `regionBegin` and `regionSize` locate each region's table for all
+ * following nodes of the region, which is why calls are not const. The
+ * tables are discarded when the grid's dimensions change.
+ */
+template <
+  auto XBC,
+  auto YBC,
+  auto ZBC,
+  typename Index_t
+    >
+struct RadiusStencil
+{
+  using Range_t = std::pair<const Coords3d_t<Index_t>*, const Coords3d_t<Index_t>*>;
+
+  static constexpr auto UNRESOLVED = std::numeric_limits<std::size_t>::max();
+
+  std::shared_ptr<const RadiusTable<Index_t>> table;
+  std::vector<Coords3d_t<Index_t>> offsets {};
+  std::vector<std::size_t> regionBegin {};
+  std::vector<std::size_t> regionSize {};
+  Coords3d_t<Index_t> regionGridDimensions {};
+
+  Range_t
+  operator()(
+      const Coords3d_t<Index_t>& coords,
+      const Coords3d_t<Index_t>& gridDimensions) {
 
     Expects( coords[0] >= 0                );
     Expects( coords[1] >= 0                );
@@ -44,114 +660,197 @@ auto stencil7p() {
     Expects( coords[1] < gridDimensions[1] );
     Expects( coords[2] < gridDimensions[2] );
     static_assert( std::is_same<decltype(XBC), BC>() );
+    static_assert( std::is_same<decltype(YBC), BC>() );
+    static_assert( std::is_same<decltype(ZBC), BC>() );
 
-    /**
-     * Check if we're being called on an inner node in which case the node
-     * exhibits its full adjacency pattern. This will apply to the overwhelming
-     * majority of nodes for most matrices thus we assume this scenario right
-     * away.
-     */
-    if (is_inner_node(coords, gridDimensions)) {
-      return std::pair {STENCIL<7>.cbegin(), STENCIL<7>.cend()};
-    }
+    const std::array<BC, 3> bcs {{XBC, YBC, ZBC}};
+    const auto extent = table->extent;
 
-    /**
-     * For all the outer nodes we start out with the null-offset and add other
-     * offsets according to our position in the grid and the chosen boundary
-     * conditions.
-     */
-    offsets.front() = STENCIL<7>.front();     // add the null offset and ...
-    auto end = std::next(offsets.begin(), 1); // .. keep track of our end ptr.
-    if constexpr (XBC == BC::DIRICHLET) {
-      /**
-       * Add any offset in {(-1, 0, 0), (1, 0, 0)} which points inside the
-       * grid and discard the rest. This implementation is repeated for the
-       * x and y dimensions, respecitvely.
-       */
-      end = std::copy_if(
-          std::next(STENCIL<7>.cbegin(), 1), // Range over the x-offsets in
-          std::next(STENCIL<7>.cbegin(), 3), // `STENICIL<7>`. See declaration.
-          end,
-          [&coords, &gridDimensions](const auto& offset) {
-            return is_inside_grid(coords + offset, gridDimensions);
-          });
-    }
-    if constexpr (XBC == BC::PERIODIC) {
-      /**
-       * Periodic boundary conditions are implemented by performing a simple
-       * (multi-dimensional) modulus addition of the offset to the node's
-       * coordinates which maps to the other side of the grid, in case the
-       * offset points outside the grid.
-       */
-      end = std::transform(
-          std::next(STENCIL<7>.cbegin(), 1),
-          std::next(STENCIL<7>.cbegin(), 3),
-          end,
-          [&coords, &gridDimensions](const auto& offset) {
-            // The stencil is supposed to return offsets, thus we subtract
-            // the coordinates after the modplus to obtain what we need.
-            return modplus(coords, offset, gridDimensions) - coords;
-          });
-    }
-    if constexpr (XBC == BC::NEUMANN) {
-      static_assert(!std::is_same<Index_t, Index_t>(), "TODO: Not yet implemented.");
+    if(gridDimensions[0] < 2 * extent ||
+       gridDimensions[1] < 2 * extent ||
+       gridDimensions[2] < 2 * extent) {
+      regionBegin.clear();
+      offsets.resize(table->offsets.size());
+      auto end = offsets.begin();
+      for(const auto& offset : table->offsets) {
+        auto valid = true;
+        for(auto dim = 0; dim < 3 && valid; ++dim) {
+          const auto component = resolve_component_per_node<Index_t>(offset[dim], coords[dim], gridDimensions[dim], bcs[dim]);
+          valid = component.valid;
+          (*end)[dim] = component.offset;
+        }
+        end += valid ? 1 : 0;
+      }
+      return {offsets.data(), offsets.data() + std::distance(offsets.begin(), end)};
     }
-    if constexpr (YBC == BC::DIRICHLET) {
-      end = std::copy_if(
-          std::next(STENCIL<7>.cbegin(), 3),
-          std::next(STENCIL<7>.cbegin(), 5),
-          end,
-          [&coords, &gridDimensions](const auto& offset) {
-            return is_inside_grid(coords + offset, gridDimensions);
-          });
-    }
-    if constexpr (YBC == BC::PERIODIC) {
-      end = std::transform(
-          std::next(STENCIL<7>.cbegin(), 3),
-          std::next(STENCIL<7>.cbegin(), 5),
-          end,
-          [&coords, &gridDimensions](const auto& offset) {
-            return modplus(coords, offset, gridDimensions) - coords;
-          });
+
+    const auto classes = std::array<int, 3> {{
+      class_of(coords[0], gridDimensions[0], extent),
+      class_of(coords[1], gridDimensions[1], extent),
+      class_of(coords[2], gridDimensions[2], extent)}};
+    if(classes[0] == extent && classes[1] == extent && classes[2] == extent) {
+      return {table->offsets.data(), table->offsets.data() + table->offsets.size()};
     }
-    if constexpr (YBC == BC::NEUMANN) {
-      static_assert(!std::is_same<Index_t, Index_t>(), "TODO: Not yet implemented.");
+
+    const auto numOfClasses = static_cast<std::size_t>(2 * extent + 1);
+    if(regionBegin.empty() || gridDimensions != regionGridDimensions) {
+      offsets.clear();
+      regionBegin.assign(numOfClasses * numOfClasses * numOfClasses, UNRESOLVED);
+      regionSize.assign(regionBegin.size(), 0);
+      regionGridDimensions = gridDimensions;
     }
-    if constexpr (ZBC == BC::DIRICHLET) {
-      end = std::copy_if(
-          std::next(STENCIL<7>.cbegin(), 5),
-          std::next(STENCIL<7>.cbegin(), 7),
-          end,
-          [&coords, &gridDimensions](const auto& offset) {
-            return is_inside_grid(coords + offset, gridDimensions);
-          });
+
+    const auto region = classes[0] + numOfClasses * (classes[1] + numOfClasses * classes[2]);
+    if(regionBegin[region] == UNRESOLVED) {
+      regionBegin[region] = offsets.size();
+      for(const auto& offset : table->offsets) {
+        auto resolved = Coords3d_t<Index_t> {};
+        auto valid = true;
+        for(auto dim = 0; dim < 3 && valid; ++dim) {
+          const auto component = resolve_component(static_cast<int>(offset[dim]), classes[dim], extent, bcs[dim]);
+          valid = component.valid;
+          resolved[dim] = component.offset + component.wrap * gridDimensions[dim];
+        }
+        if(valid) {
+          offsets.push_back(resolved);
+        }
+      }
+      regionSize[region] = offsets.size() - regionBegin[region];
     }
-    if constexpr (ZBC == BC::PERIODIC) {
-      end = std::transform(
-          std::next(STENCIL<7>.cbegin(), 5),
-          std::next(STENCIL<7>.cbegin(), 7),
-          end,
-          [&coords, &gridDimensions](const auto& offset) {
-            return modplus(coords, offset, gridDimensions) - coords;
-          });
+    const auto* first = offsets.data() + regionBegin[region];
+    return {first, first + regionSize[region]};
+  }
+
+private:
+  /* Class of the node at `coord`, see `resolve_component`. Requires `size >= 2 * extent`. */
+  static
+  int
+  class_of(Index_t coord, Index_t size, int extent) {
+    if(coord < extent) {
+      return static_cast<int>(coord);
     }
-    if constexpr (ZBC == BC::NEUMANN) {
-      static_assert(!std::is_same<Index_t, Index_t>(), "TODO: Not yet implemented.");
+    if(coord >= size - extent) {
+      return static_cast<int>(2 * extent - (size - 1 - coord));
     }
+    return extent;
+  }
+};
 
-    using Iter_t = typename decltype(offsets)::const_iterator;
-    return std::pair {offsets.cbegin(), static_cast<Iter_t>(end)};
-  };
+} // namespace implementation
+
+/**
+ * matrixgen::stencil_radius()
+ *
+ * Returns an adjacency function which connects every node to all nodes
+ * within the Euclidean distance `radius`, including itself. Used for
+ * nonlocal operators and kernel matrices, see `radial_weight`. Boundary
+ * conditions are those of `stencil`.
+ *
+ * The offsets are tabulated once, sorted by their nodes' indices. Inner
+ * nodes return the table as is; the offsets of boundary nodes are resolved
+ * once per boundary region, so that a row's cost does not depend on distance
+ * checks.
+ *
+ * ****************************************************************************
+ *   // 123 neighbors per inner node.
+ *   auto matrix = matrixgen::adjmat(grid,
+ *     matrixgen::stencil_radius(3.0),
+ *     matrixgen::radial_weight(3.0, matrixgen::gaussian_kernel(1.5)));
+ * ****************************************************************************
+ */
+template <
+  auto XBC = BC::DIRICHLET, // Boundary conditions for the X, ..
+  auto YBC = BC::DIRICHLET, // .. the Y,
+  auto ZBC = BC::DIRICHLET, // .. and the Z-dimension, respectively.
+  typename Index_t = int
+    >
+auto stencil_radius(double radius) {
+
+  return implementation::RadiusStencil<XBC, YBC, ZBC, Index_t> {
+    implementation::make_radius_table<Index_t>(radius)};
 }
 
 /*************************************
  ********* Weight functions **********
  *************************************/
 
- //TODO: Is this the correct way to implement preset lambdas? Pass them as return
- //      "value"? Do multiple calls return different lambdas or is the data 
- //      shared between call sites in the case of mutable lambdas (as in the
- //      randweight below)?
+// The presets return named function objects instead of lambdas, such that
+// their types can be named in explicit instantiations (see
+// 'instantiations.hpp'). Every call returns an independent object; mutable
+// state, as in `randweight`, is not shared between call sites.
+
+namespace implementation
+{
+
+/* Function object of `constweight`. */
+template <
+  typename Scalar_t
+    >
+struct ConstWeight
+{
+  Scalar_t val;
+
+  Scalar_t operator()() const { return val; }
+};
+
+/* Function object of `randweight`. Calls advance the engine. */
+template <
+  typename Scalar_t,
+  typename Engine_t = std::default_random_engine
+    >
+struct RandWeight
+{
+  Engine_t engine;
+  std::uniform_real_distribution<Scalar_t> dist;
+
+  Scalar_t operator()() { return static_cast<Scalar_t>(dist(engine)); }
+};
+
+/**
+ * Function object of the `sinusoid_*` weight functions: the sum
+ * (`MULTIPLICATIVE` unset) or product of sines over the relative coordinates
+ * of an edge's midpoint with frequencies `nx`, `ny` and `nz`, plus one if
+ * `BIASED`.
+ */
+template <
+  typename Scalar_t,
+  typename Index_t,
+  bool MULTIPLICATIVE,
+  bool BIASED
+    >
+struct SinusoidWeight
+{
+  Scalar_t nx;
+  Scalar_t ny;
+  Scalar_t nz;
+
+  Scalar_t operator()(
+      Coords3d_t<Index_t> coords,
+      Coords3d_t<Index_t> neighborCoords,
+      Coords3d_t<Index_t> gridDimensions) const {
+
+    const auto midpt = midpoint<Scalar_t>(coords, neighborCoords);
+    const Scalar_t xrel = (midpt[0]) / gridDimensions[0];
+    const Scalar_t yrel = (midpt[1]) / gridDimensions[1];
+    const Scalar_t zrel = (midpt[2]) / gridDimensions[2];
+    const Scalar_t sx = std::sin(matrixgen::pi<Scalar_t>() * nx * xrel);
+    const Scalar_t sy = std::sin(matrixgen::pi<Scalar_t>() * ny * yrel);
+    const Scalar_t sz = std::sin(matrixgen::pi<Scalar_t>() * nz * zrel);
+    Scalar_t result;
+    if constexpr (MULTIPLICATIVE) {
+      result = sx * sy * sz;
+    }
+    else {
+      result = sx + sy + sz / 3;
+    }
+    if constexpr (BIASED) {
+      result += 1;
+    }
+    return result;
+  }
+};
+
+} // namespace implementation
 
 /**
  * matrixgen::constweight()
@@ -163,7 +862,7 @@ template <
     >
 auto constweight(Scalar_t val = 1) {
 
-  return [val]() { return static_cast<Scalar_t>(val); };
+  return implementation::ConstWeight<Scalar_t> {static_cast<Scalar_t>(val)};
 }
 
 /**
@@ -180,11 +879,8 @@ auto randweight(Seed_t seed = 1) {
   using Engine_t = std::default_random_engine;
   using Dist_t = std::uniform_real_distribution<Scalar_t>;
 
-  return
-    [engine = Engine_t(seed), dist = Dist_t(static_cast<Scalar_t>(0.0), static_cast<Scalar_t>(1.0))]
-    () mutable {
-      return static_cast<Scalar_t>(dist(engine));
-    };
+  return implementation::RandWeight<Scalar_t, Engine_t> {
+    Engine_t(seed), Dist_t(static_cast<Scalar_t>(0.0), static_cast<Scalar_t>(1.0))};
 }
 
 /**
@@ -198,17 +894,7 @@ template <
   typename Index_t = int32_t
     >
 auto sinusoid_add(Scalar_t nx, Scalar_t ny, Scalar_t nz) {
-  return
-    [nx=static_cast<Scalar_t>(nx), ny=static_cast<Scalar_t>(ny), nz=static_cast<Scalar_t>(nz)]
-    (Coords3d_t<Index_t> coords, Coords3d_t<Index_t> neighborCoords, Coords3d_t<Index_t> gridDimensions) {
-      const auto midpt = midpoint<Scalar_t>(coords, neighborCoords);
-      const Scalar_t xrel = (midpt[0]) / gridDimensions[0];
-      const Scalar_t yrel = (midpt[1]) / gridDimensions[1];
-      const Scalar_t zrel = (midpt[2]) / gridDimensions[2];
-      return ((std::sin(matrixgen::pi<Scalar_t>() * nx * xrel)) +
-              (std::sin(matrixgen::pi<Scalar_t>() * ny * yrel)) +
-              (std::sin(matrixgen::pi<Scalar_t>() * nz * zrel)) / 3);
-    };
+  return implementation::SinusoidWeight<Scalar_t, Index_t, false, false> {nx, ny, nz};
 }
 
 /**
@@ -221,17 +907,7 @@ template <
   typename Index_t = int32_t
     >
 auto sinusoid_add_bias(Scalar_t nx, Scalar_t ny, Scalar_t nz) {
-  return
-    [nx=static_cast<Scalar_t>(nx), ny=static_cast<Scalar_t>(ny), nz=static_cast<Scalar_t>(nz)]
-    (Coords3d_t<Index_t> coords, Coords3d_t<Index_t> neighborCoords, Coords3d_t<Index_t> gridDimensions) {
-      const auto midpt = midpoint<Scalar_t>(coords, neighborCoords);
-      const Scalar_t xrel = (midpt[0]) / gridDimensions[0];
-      const Scalar_t yrel = (midpt[1]) / gridDimensions[1];
-      const Scalar_t zrel = (midpt[2]) / gridDimensions[2];
-      return ((std::sin(matrixgen::pi<Scalar_t>() * nx * xrel)) +
-              (std::sin(matrixgen::pi<Scalar_t>() * ny * yrel)) +
-              (std::sin(matrixgen::pi<Scalar_t>() * nz * zrel)) / 3) + 1;
-    };
+  return implementation::SinusoidWeight<Scalar_t, Index_t, false, true> {nx, ny, nz};
 }
 
 /**
@@ -244,17 +920,7 @@ template <
   typename Index_t = int32_t
     >
 auto sinusoid_mul(Scalar_t nx, Scalar_t ny, Scalar_t nz) {
-  return
-    [nx=static_cast<Scalar_t>(nx), ny=static_cast<Scalar_t>(ny), nz=static_cast<Scalar_t>(nz)]
-    (Coords3d_t<Index_t> coords, Coords3d_t<Index_t> neighborCoords, Coords3d_t<Index_t> gridDimensions) {
-      const auto midpt = midpoint<Scalar_t>(coords, neighborCoords);
-      const Scalar_t xrel = (midpt[0]) / gridDimensions[0];
-      const Scalar_t yrel = (midpt[1]) / gridDimensions[1];
-      const Scalar_t zrel = (midpt[2]) / gridDimensions[2];
-      return ((std::sin(matrixgen::pi<Scalar_t>() * nx * xrel)) *
-              (std::sin(matrixgen::pi<Scalar_t>() * ny * yrel)) *
-              (std::sin(matrixgen::pi<Scalar_t>() * nz * zrel)));
-    };
+  return implementation::SinusoidWeight<Scalar_t, Index_t, true, false> {nx, ny, nz};
 }
 
 /**
@@ -267,46 +933,145 @@ template <
   typename Index_t = int32_t
     >
 auto sinusoid_mul_bias(Scalar_t nx, Scalar_t ny, Scalar_t nz) {
-  return
-    [nx=static_cast<Scalar_t>(nx), ny=static_cast<Scalar_t>(ny), nz=static_cast<Scalar_t>(nz)]
-    (Coords3d_t<Index_t> coords, Coords3d_t<Index_t> neighborCoords, Coords3d_t<Index_t> gridDimensions) {
-      const auto midpt = midpoint<Scalar_t>(coords, neighborCoords);
-      const Scalar_t xrel = (midpt[0]) / gridDimensions[0];
-      const Scalar_t yrel = (midpt[1]) / gridDimensions[1];
-      const Scalar_t zrel = (midpt[2]) / gridDimensions[2];
-      return ((std::sin(matrixgen::pi<Scalar_t>() * nx * xrel)) *
-              (std::sin(matrixgen::pi<Scalar_t>() * ny * yrel)) *
-              (std::sin(matrixgen::pi<Scalar_t>() * nz * zrel))) + 1;
-    };
+  return implementation::SinusoidWeight<Scalar_t, Index_t, true, true> {nx, ny, nz};
+}
+
+/**
+ * Radial kernels for `radial_weight`, functions of the distance between two
+ * nodes.
+ */
+template <typename Scalar_t>
+struct GaussianKernel
+{
+  Scalar_t sigma;
+
+  Scalar_t operator()(Scalar_t distance) const {
+    return std::exp(-(distance * distance) / (2 * sigma * sigma));
+  }
+};
+
+/* 1 / distance, and 0 on the diagonal. */
+template <typename Scalar_t>
+struct InverseDistanceKernel
+{
+  Scalar_t operator()(Scalar_t distance) const {
+    return distance > 0 ? 1 / distance : 0;
+  }
+};
+
+template <
+  typename Scalar_t = double
+    >
+auto gaussian_kernel(Scalar_t sigma) {
+
+  Expects( sigma > 0 );
+
+  return GaussianKernel<Scalar_t> {sigma};
+}
+
+template <
+  typename Scalar_t = double
+    >
+auto inverse_distance_kernel() {
+  return InverseDistanceKernel<Scalar_t> {};
+}
+
+namespace implementation
+{
+
+/**
+ * Function object of `radial_weight`. The kernel's values are tabulated by
+ * the squared distance of the offsets within the radius.
+ */
+template <
+  typename Scalar_t,
+  typename Kernel_t,
+  typename Index_t
+    >
+struct RadialWeight
+{
+  int extent;
+  std::shared_ptr<const std::vector<Scalar_t>> table;
+  Kernel_t kernel;
+
+  Scalar_t operator()(
+      Coords3d_t<Index_t> coords,
+      Coords3d_t<Index_t> neighborCoords,
+      Coords3d_t<Index_t> gridDimensions) const {
+
+    auto distance2 = std::size_t {0};
+    for(auto dim = 0; dim < 3; ++dim) {
+      auto component = neighborCoords[dim] - coords[dim];
+      // Undo the wrap-around of periodic boundaries.
+      if(component > extent) {
+        component -= gridDimensions[dim];
+      }
+      else if(component < -extent) {
+        component += gridDimensions[dim];
+      }
+      distance2 += static_cast<std::size_t>(component * component);
+    }
+    if(distance2 < table->size()) {
+      return (*table)[distance2];
+    }
+    return kernel(std::sqrt(static_cast<Scalar_t>(distance2)));
+  }
+};
+
+} // namespace implementation
+
+/**
+ * matrixgen::radial_weight()
+ *
+ * Weightfunction returning `kernel(distance)` for the Euclidean distance
+ * between a node and its neighbor, for use with `stencil_radius(radius)`.
+ * The kernel is evaluated once per squared distance within `radius`.
+ *
+ * Across periodic boundaries the distance is the one across the boundary,
+ * which requires the grid to exceed twice the radius in these dimensions.
+ * Across Neumann boundaries it is the distance to the mirrored neighbor.
+ */
+template <
+  typename Scalar_t = double,
+  typename Kernel_t = void,
+  typename Index_t = int32_t
+    >
+auto radial_weight(double radius, Kernel_t kernel) {
+
+  Expects( radius >= 0 );
+
+  const auto extent = static_cast<int>(std::floor(radius));
+  auto table = std::make_shared<std::vector<Scalar_t>>();
+  for(auto distance2 = 0; distance2 <= 3 * extent * extent; ++distance2) {
+    table->push_back(static_cast<Scalar_t>(kernel(std::sqrt(static_cast<Scalar_t>(distance2)))));
+  }
+  return implementation::RadialWeight<Scalar_t, Kernel_t, Index_t> {extent, std::move(table), kernel};
 }
 
 /*************************************
  *********** Full Wrappers ***********
  *************************************/
 
+namespace implementation
+{
+
 /**
- * structured_grid_sinusoidal
- *
- * Returns a diagonally dominant matrix whose non-diagonal values are
- * determinated according to the biased multiplicative sinusoid.
+ * Makes `matrix` strictly diagonally dominant by setting the diagonal
+ * elements to the negated sum of their row's absolute values plus one.
+ * Used by `structured_grid_sinusoidal`.
  */
 template <
-  typename AdjFn_t,
-  int ALIGNMENT = Eigen::RowMajor,
-  typename Scalar_t = double,
-  typename Index_t = int
+  typename Scalar_t,
+  int ALIGNMENT,
+  typename Index_t,
+  typename Stats_t
     >
-Eigen::SparseMatrix<Scalar_t, ALIGNMENT, Index_t>
-structured_grid_sinusoidal(
-    const Coords3d_t<Index_t>& gridDimensions,
-    AdjFn_t adjfn,
-    Scalar_t nx,
-    Scalar_t ny,
-    Scalar_t nz){
+void
+make_diagonally_dominant(
+    Eigen::SparseMatrix<Scalar_t, ALIGNMENT, Index_t>& matrix,
+    Stats_t& stats) {
 
-  // Generate the baseline matrix.
-  using OutMatrix_t = Eigen::SparseMatrix<Scalar_t, ALIGNMENT, Index_t>;
-  auto matrix = adjmat<OutMatrix_t>(gridDimensions, adjfn, matrixgen::sinusoid_add_bias(nx, ny, nz));
+  [[maybe_unused]] const auto phase = ScopedPhase(stats, "structured_grid_sinusoidal.diagonal");
 
   // Make matrix diagonally dominant by setting the diagonal elements to their
   // row's sum over the other elements' absolute values.
@@ -321,10 +1086,40 @@ structured_grid_sinusoidal(
         });
     matrix.coeffRef(ii, ii) = -(std::abs(rowSum) + 1);
   }
+}
+
+} // namespace implementation
+
+/**
+ * structured_grid_sinusoidal
+ *
+ * Returns a diagonally dominant matrix whose non-diagonal values are
+ * determinated according to the biased multiplicative sinusoid.
+ *
+ * An optional `GenerationStats` sink receives `adjmat`'s statistics and the
+ * time of the phase 'structured_grid_sinusoidal.diagonal'.
+ */
+template <
+  typename AdjFn_t,
+  int ALIGNMENT = Eigen::RowMajor,
+  typename Scalar_t = double,
+  typename Index_t = int,
+  typename Stats_t = NoStats
+    >
+Eigen::SparseMatrix<Scalar_t, ALIGNMENT, Index_t>
+structured_grid_sinusoidal(
+    const Coords3d_t<Index_t>& gridDimensions,
+    AdjFn_t adjfn,
+    Scalar_t nx,
+    Scalar_t ny,
+    Scalar_t nz,
+    Stats_t&& stats = Stats_t {}){
 
+  // Generate the baseline matrix.
+  using OutMatrix_t = Eigen::SparseMatrix<Scalar_t, ALIGNMENT, Index_t>;
+  auto matrix = adjmat<OutMatrix_t>(gridDimensions, adjfn, matrixgen::sinusoid_add_bias(nx, ny, nz), stats);
+  implementation::make_diagonally_dominant(matrix, stats);
   return matrix;
 }
 
 } // namespace matrixgen
-
-// TODO: Implement 19p & 27p stencils
@@ -0,0 +1,392 @@
+/**
+ * Asynchronous generation of large matrices in blocks of rows.
+ *
+ * A `RowBlockProducer` computes the rows of a matrix on a background thread
+ * and hands them out in order as compressed row blocks, so that consumers
+ * can write, compress or send a block while the following blocks are still
+ * being generated. The number of blocks in flight is bounded; once the
+ * consumer falls behind the producer waits.
+ *
+ * ****************************************************************************
+ *   auto producer = matrixgen::adjmat_blocks(grid, adjfn, weightfn);
+ *   auto writer = matrixgen::MatrixMarketWriter<double>(path, producer.rows(), producer.cols());
+ *   while(const auto block = producer.next()) {
+ *     writer.write(block->map(), block->rowOffset);
+ *   }
+ * ****************************************************************************
+ */
+#pragma once
+
+#include <matrixgen/adjmat.hpp>
+#include <matrixgen/interleave.hpp>
+#include <matrixgen/trace.hpp>
+
+#include <Eigen/Sparse>
+
+#include <gsl/gsl-lite.hpp>
+
+#include <tbb/concurrent_queue.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <iterator>
+#include <memory>
+#include <memory_resource>
+#include <numeric>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace matrixgen
+{
+
+/**
+ * RowBlock
+ *
+ * The rows [rowOffset, rowOffset + rows) of a matrix with `cols` columns in
+ * compressed row storage. `outerIndex` starts at 0.
+ */
+template <
+  typename Scalar_t = double,
+  typename Index_t = int
+    >
+struct RowBlock {
+  Eigen::Index rowOffset = 0;
+  Eigen::Index rows = 0;
+  Eigen::Index cols = 0;
+  std::vector<Index_t> outerIndex;
+  std::vector<Index_t> innerIndex;
+  std::vector<Scalar_t> values;
+
+  Eigen::Index nonZeros() const { return static_cast<Eigen::Index>(values.size()); }
+
+  /* Views the block as a row-major sparse matrix without copying. */
+  Eigen::Map<const Eigen::SparseMatrix<Scalar_t, Eigen::RowMajor, Index_t>>
+  map() const {
+    return Eigen::Map<const Eigen::SparseMatrix<Scalar_t, Eigen::RowMajor, Index_t>>(
+        rows, cols, nonZeros(), outerIndex.data(), innerIndex.data(), values.data());
+  }
+};
+
+/**
+ * RowBlockOptions
+ *
+ * `rowsPerBlock` is the number of rows per block. At most `maxBlocksInFlight`
+ * blocks are computed concurrently and at most as many finished blocks wait
+ * for the consumer, which bounds the producer's memory use.
+ */
+struct RowBlockOptions {
+  Eigen::Index rowsPerBlock = Eigen::Index {1} << 14U;
+  std::size_t maxBlocksInFlight = 4;
+};
+
+/**
+ * RowBlockProducer
+ *
+ * Generates a matrix with `rows` rows block by block on a background thread
+ * using the two-pass scheme of `fill_compressed`: `sizeFn(row)` returns a
+ * row's number of nonzeros and `fillFn(row, innerFirst, valueFirst, count)`
+ * writes them. Blocks are computed in parallel unless `parallelFill` is
+ * unset, in which case `fillFn` is called in ascending row order. The
+ * background thread runs under the execution context current at the
+ * producer's construction, see 'execution.hpp'.
+ *
+ * `next()` returns the blocks in row order and an empty optional once all
+ * rows have been produced. Exceptions thrown by `sizeFn` or `fillFn` are
+ * rethrown by `next()`. Destroying the producer early cancels the remaining
+ * blocks.
+ *
+ * Usually created by `adjmat_blocks`, `assemble_blocks` or
+ * `interleave_blocks`.
+ */
+template <
+  typename Scalar_t = double,
+  typename Index_t = int
+    >
+class RowBlockProducer {
+public:
+  using Block_t = RowBlock<Scalar_t, Index_t>;
+
+  template <
+    typename SizeFn_t,
+    typename FillFn_t
+      >
+  RowBlockProducer(
+      Eigen::Index rows,
+      Eigen::Index cols,
+      SizeFn_t sizeFn,
+      FillFn_t fillFn,
+      RowBlockOptions options = {},
+      bool parallelFill = true)
+    : rows_(rows), cols_(cols) {
+
+    Expects( rows >= 0 && cols >= 0 );
+    Expects( options.rowsPerBlock > 0 );
+    Expects( options.maxBlocksInFlight > 0 );
+
+    queue_.set_capacity(static_cast<std::ptrdiff_t>(options.maxBlocksInFlight));
+    thread_ = std::thread([this, options, parallelFill, context = implementation::current_execution(),
+                           sizeFn = std::move(sizeFn), fillFn = std::move(fillFn)]() mutable {
+      context.execute([&]() { produce(sizeFn, fillFn, options, parallelFill); });
+    });
+  }
+
+  RowBlockProducer(const RowBlockProducer&) = delete;
+  RowBlockProducer& operator=(const RowBlockProducer&) = delete;
+
+  ~RowBlockProducer() {
+    cancelled_ = true;
+    queue_.abort(); // wakes up the producer if it waits for the consumer
+    auto block = std::optional<Block_t> {};
+    while(!done_) { // make room for a block which was about to be queued
+      while(queue_.try_pop(block)) {}
+      std::this_thread::yield();
+    }
+    thread_.join();
+  }
+
+  Eigen::Index rows() const { return rows_; }
+  Eigen::Index cols() const { return cols_; }
+
+  /* Waits for and returns the next block, or nothing after the last one. */
+  std::optional<Block_t>
+  next() {
+
+    if(finished_) {
+      return std::nullopt;
+    }
+    auto block = std::optional<Block_t> {};
+    queue_.pop(block);
+    if(!block) {
+      finished_ = true;
+      if(error_) {
+        std::rethrow_exception(error_);
+      }
+    }
+    return block;
+  }
+
+private:
+  template <
+    typename SizeFn_t,
+    typename FillFn_t
+      >
+  void
+  produce(SizeFn_t& sizeFn, FillFn_t& fillFn, RowBlockOptions options, bool parallelFill) {
+
+    auto first = Eigen::Index {0};
+    try {
+      implementation::ordered_pipeline(options.maxBlocksInFlight,
+        // (1) Cut the next block of rows.
+        [&]() -> std::optional<Block_t> {
+          if(first >= rows_ || cancelled_) {
+            return std::nullopt;
+          }
+          auto block = Block_t {};
+          block.rowOffset = first;
+          block.rows = std::min(options.rowsPerBlock, rows_ - first);
+          block.cols = cols_;
+          first += block.rows;
+          return block;
+        },
+        // (2) Count and fill its rows.
+        [&](Block_t block) {
+          const auto trace = implementation::TraceScope("blocks.produce", block.rowOffset, block.rowOffset + block.rows);
+          block.outerIndex.resize(block.rows + 1);
+          block.outerIndex[0] = 0;
+          for(auto ii = Eigen::Index {0}; ii < block.rows; ++ii) {
+            block.outerIndex[ii + 1] = static_cast<Index_t>(sizeFn(block.rowOffset + ii));
+          }
+          std::partial_sum(block.outerIndex.begin(), block.outerIndex.end(), block.outerIndex.begin());
+          block.innerIndex.resize(block.outerIndex.back());
+          block.values.resize(block.outerIndex.back());
+          for(auto ii = Eigen::Index {0}; ii < block.rows; ++ii) {
+            const auto offset = block.outerIndex[ii];
+            fillFn(block.rowOffset + ii, block.innerIndex.data() + offset, block.values.data() + offset,
+                   block.outerIndex[ii + 1] - offset);
+          }
+          return block;
+        },
+        // (3) Hand it to the consumer, waiting while the queue is full.
+        [&](Block_t block) {
+          if(!cancelled_) {
+            const auto trace = implementation::TraceScope("blocks.wait");
+            queue_.push(std::optional<Block_t>(std::move(block)));
+          }
+        },
+        parallelFill);
+    }
+    catch(const tbb::user_abort&) { // cancelled by the destructor
+    }
+    catch(...) {
+      error_ = std::current_exception();
+    }
+
+    try {
+      if(!cancelled_) {
+        queue_.push(std::nullopt);
+      }
+    }
+    catch(const tbb::user_abort&) {
+    }
+    done_ = true;
+  }
+
+  Eigen::Index rows_;
+  Eigen::Index cols_;
+  tbb::concurrent_bounded_queue<std::optional<Block_t>> queue_;
+  std::atomic<bool> cancelled_ {false};
+  std::atomic<bool> done_ {false};
+  std::exception_ptr error_; // set before the final empty block is queued
+  bool finished_ = false;
+  std::thread thread_;
+};
+
+/**
+ * adjmat_blocks
+ *
+ * Produces the row-major adjacency matrix of `adjmat(gridDimensions, adjfn,
+ * weightfn)` as row blocks; see `RowBlockProducer`. Blocks are filled in
+ * parallel unless the weight function is a mutable lambda (e.g.
+ * `randweight`), in which case they are filled in order to reproduce
+ * `adjmat`'s values. The functors are copied per thread.
+ */
+template <
+  typename Scalar_t = double,
+  typename StorageIndex_t = int,
+  typename AdjFn_t = void,
+  typename WeightFn_t = void,
+  typename Index_t = int
+    >
+RowBlockProducer<Scalar_t, StorageIndex_t>
+adjmat_blocks(
+    const implementation::Coords3d_t<Index_t>& gridDimensions,
+    AdjFn_t adjfn,
+    WeightFn_t weightfn,
+    RowBlockOptions options = {}) {
+
+  using Generator_t = implementation::AdjmatRowGenerator<
+    Scalar_t, AdjFn_t, WeightFn_t, implementation::Coords3d_t<Index_t>>;
+
+  auto generator = std::make_shared<Generator_t>(gridDimensions, adjfn, weightfn);
+
+  const auto matrixHeight = static_cast<Eigen::Index>(gridDimensions[0]) *
+                            gridDimensions[1] *
+                            gridDimensions[2];
+  return RowBlockProducer<Scalar_t, StorageIndex_t>(matrixHeight, matrixHeight,
+      [generator](Eigen::Index row) { return generator->count(row); },
+      [generator](Eigen::Index row, StorageIndex_t* innerFirst, Scalar_t* valueFirst, StorageIndex_t count) {
+        generator->fill(row, innerFirst, valueFirst, count);
+      },
+      options,
+      Generator_t::PARALLEL_FILL);
+}
+
+/**
+ * assemble_blocks
+ *
+ * Produces `assemble(matFirst, matLast, indexFirst, indexLast)` as row
+ * blocks; see `RowBlockProducer`. The source matrices must be row-major and
+ * compressed, and must outlive the producer, as must the index range. The
+ * iterators must be random-access.
+ */
+template <
+  typename InMatrixIter_t,
+  typename IndexIter_t
+    >
+auto
+assemble_blocks(
+    InMatrixIter_t matFirst,
+    InMatrixIter_t matLast,
+    IndexIter_t indexFirst,
+    IndexIter_t indexLast,
+    RowBlockOptions options = {}) {
+
+  using InMatrix_t = typename std::iterator_traits<InMatrixIter_t>::value_type;
+  using Scalar_t = typename InMatrix_t::Scalar;
+  using StorageIndex_t = typename InMatrix_t::StorageIndex;
+  static_assert(InMatrix_t::IsRowMajor, "Row blocks require row-major source matrices.");
+
+  const auto numOfMatrices = std::distance(matFirst, matLast);
+
+  // Indices may be unsigned; compare them as the matrices' distance type.
+  using Distance_t = typename std::iterator_traits<InMatrixIter_t>::difference_type;
+  Expects( std::all_of(indexFirst, indexLast,
+              [numOfMatrices](auto idx) {
+                const auto index = static_cast<Distance_t>(idx);
+                return (0 <= index && index < numOfMatrices);
+              }) );
+  Expects( std::all_of(matFirst, matLast, [](const auto& mat) { return mat.isCompressed(); }) );
+
+  auto cols = Eigen::Index {0};
+  for(auto it = matFirst; it != matLast; ++it) {
+    cols = std::max<Eigen::Index>(cols, it->innerSize());
+  }
+  const auto rows = numOfMatrices == 0 ? 0 : std::distance(indexFirst, indexLast);
+
+  auto source = [matFirst, indexFirst](Eigen::Index ii) { return std::next(matFirst, *std::next(indexFirst, ii)); };
+  return RowBlockProducer<Scalar_t, StorageIndex_t>(rows, cols,
+      [source](Eigen::Index ii) {
+        return num_of_nnz_in_outer(*source(ii), ii);
+      },
+      [source](Eigen::Index ii, StorageIndex_t* innerFirst, Scalar_t* valueFirst, StorageIndex_t count) {
+        const auto pMatrix = source(ii);
+        const auto innerIndexStart = pMatrix->outerIndexPtr()[ii];
+        std::copy_n(pMatrix->innerIndexPtr() + innerIndexStart, count, innerFirst);
+        std::copy_n(pMatrix->valuePtr() + innerIndexStart, count, valueFirst);
+      },
+      options);
+}
+
+/**
+ * interleave_blocks
+ *
+ * Produces `interleave(matFirst, matLast, propFirst, propLast, coupling,
+ * seed)` as row blocks; see `assemble_blocks`. The interleaving indices are
+ * drawn before the producer starts and are owned by it.
+ */
+template <
+  typename InMatrixIter_t,
+  typename PropIter_t
+    >
+auto
+interleave_blocks(
+    InMatrixIter_t matFirst,
+    InMatrixIter_t matLast,
+    PropIter_t propFirst,
+    PropIter_t propLast,
+    int32_t coupling = 0,
+    int64_t seed = 42,
+    RowBlockOptions options = {}) {
+
+  using InMatrix_t = typename std::iterator_traits<InMatrixIter_t>::value_type;
+  using Scalar_t = typename InMatrix_t::Scalar;
+  using StorageIndex_t = typename InMatrix_t::StorageIndex;
+  static_assert(InMatrix_t::IsRowMajor, "Row blocks require row-major source matrices.");
+  Expects( std::all_of(matFirst, matLast, [](const auto& mat) { return mat.isCompressed(); }) );
+
+  const auto indices = std::make_shared<const std::pmr::vector<std::size_t>>(
+      implementation::interleave_indices(matFirst, matLast, propFirst, propLast, coupling, seed));
+  auto cols = Eigen::Index {0};
+  for(auto it = matFirst; it != matLast; ++it) {
+    cols = std::max<Eigen::Index>(cols, it->innerSize());
+  }
+
+  auto source = [matFirst, indices](Eigen::Index ii) { return std::next(matFirst, (*indices)[ii]); };
+  return RowBlockProducer<Scalar_t, StorageIndex_t>(static_cast<Eigen::Index>(indices->size()), cols,
+      [source](Eigen::Index ii) {
+        return num_of_nnz_in_outer(*source(ii), ii);
+      },
+      [source](Eigen::Index ii, StorageIndex_t* innerFirst, Scalar_t* valueFirst, StorageIndex_t count) {
+        const auto pMatrix = source(ii);
+        const auto innerIndexStart = pMatrix->outerIndexPtr()[ii];
+        std::copy_n(pMatrix->innerIndexPtr() + innerIndexStart, count, innerFirst);
+        std::copy_n(pMatrix->valuePtr() + innerIndexStart, count, valueFirst);
+      },
+      options);
+}
+
+} // namespace matrixgen
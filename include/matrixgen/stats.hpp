@@ -0,0 +1,206 @@
+/**
+ * Optional statistics sinks for the generators.
+ *
+ * The generation entry points take a trailing `stats` argument which
+ * defaults to `NoStats`. Passing a `GenerationStats` collects phase wall
+ * times, numbers of adjacency and weight function calls, merged duplicates,
+ * allocations and the work done per thread. With `NoStats` all hooks are
+ * discarded at compile time.
+ */
+#pragma once
+
+#include <matrixgen/trace.hpp>
+
+#include <tbb/enumerable_thread_specific.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <numeric>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace matrixgen
+{
+
+/**
+ * NoStats
+ *
+ * Disabled statistics sink. Default of every `stats` argument.
+ */
+struct NoStats {
+  static constexpr bool ENABLED = false;
+};
+
+/**
+ * GenerationStats
+ *
+ * Statistics sink collecting
+ *
+ *   - the accumulated wall time per phase, in order of first occurrence,
+ *   - the number of adjacency and weight function calls,
+ *   - the number of duplicate entries merged into a single nonzero,
+ *   - the number and total size in bytes of the generators' allocations and
+ *   - the number of items (rows, nonzeros) processed by every worker thread.
+ *
+ * May be shared by concurrent generator calls. Sinks accumulate over
+ * repeated calls until `reset`.
+ *
+ * ****************************************************************************
+ *   auto stats = matrixgen::GenerationStats {};
+ *   auto matrix = matrixgen::adjmat(grid, adjfn, weightfn, stats);
+ *   stats.report(std::cerr);
+ * ****************************************************************************
+ */
+class GenerationStats {
+public:
+  static constexpr bool ENABLED = true;
+
+  struct Phase {
+    std::string name;
+    double seconds = 0;
+  };
+
+  void add_phase(std::string_view name, double seconds) {
+    const auto lock = std::lock_guard<std::mutex>(mutex_);
+    auto it = std::find_if(phases_.begin(), phases_.end(), [name](const auto& p) { return p.name == name; });
+    if(it == phases_.end()) {
+      phases_.push_back(Phase {std::string(name), seconds});
+    }
+    else {
+      it->seconds += seconds;
+    }
+  }
+
+  void add_adjfn_calls(uint64_t n) { adjfnCalls_ += n; }
+  void add_weightfn_calls(uint64_t n) { weightfnCalls_ += n; }
+  void add_duplicates_merged(uint64_t n) { duplicatesMerged_ += n; }
+
+  void add_allocation(uint64_t bytes) {
+    ++allocations_;
+    allocatedBytes_ += bytes;
+  }
+
+  /* Attributes `items` of work to the calling thread. */
+  void add_work(uint64_t items) { work_.local() += items; }
+
+  std::vector<Phase> phases() const {
+    const auto lock = std::lock_guard<std::mutex>(mutex_);
+    return phases_;
+  }
+
+  uint64_t adjfn_calls() const { return adjfnCalls_; }
+  uint64_t weightfn_calls() const { return weightfnCalls_; }
+  uint64_t duplicates_merged() const { return duplicatesMerged_; }
+  uint64_t allocations() const { return allocations_; }
+  uint64_t allocated_bytes() const { return allocatedBytes_; }
+
+  /* Work items per thread which did any work, in no particular order. */
+  std::vector<uint64_t> thread_work() const {
+    auto result = std::vector<uint64_t> {};
+    for(const auto items : work_) {
+      if(items > 0) {
+        result.push_back(items);
+      }
+    }
+    return result;
+  }
+
+  /**
+   * Ratio of the busiest thread's work to the mean work per thread. 1 is
+   * perfectly balanced.
+   */
+  double load_imbalance() const {
+    const auto work = thread_work();
+    if(work.empty()) {
+      return 1.0;
+    }
+    const auto sum = std::accumulate(work.begin(), work.end(), 0.0);
+    return static_cast<double>(*std::max_element(work.begin(), work.end())) * work.size() / sum;
+  }
+
+  void reset() {
+    const auto lock = std::lock_guard<std::mutex>(mutex_);
+    phases_.clear();
+    adjfnCalls_ = weightfnCalls_ = duplicatesMerged_ = allocations_ = allocatedBytes_ = 0;
+    work_.clear();
+  }
+
+  void report(std::ostream& os) const {
+    for(const auto& phase : phases()) {
+      os << "phase " << phase.name << ": " << phase.seconds << " s\n";
+    }
+    os << "adjfn calls: " << adjfn_calls() << '\n'
+       << "weightfn calls: " << weightfn_calls() << '\n'
+       << "duplicates merged: " << duplicates_merged() << '\n'
+       << "allocations: " << allocations() << " (" << allocated_bytes() << " bytes)\n"
+       << "threads: " << thread_work().size() << ", load imbalance: " << load_imbalance() << '\n';
+  }
+
+private:
+  mutable std::mutex mutex_;
+  std::vector<Phase> phases_;
+  std::atomic<uint64_t> adjfnCalls_ {0};
+  std::atomic<uint64_t> weightfnCalls_ {0};
+  std::atomic<uint64_t> duplicatesMerged_ {0};
+  std::atomic<uint64_t> allocations_ {0};
+  std::atomic<uint64_t> allocatedBytes_ {0};
+  mutable tbb::enumerable_thread_specific<uint64_t> work_ {0};
+};
+
+} // namespace matrixgen
+
+namespace matrixgen::implementation
+{
+
+/**
+ * True if `Stats_t` (possibly a reference) collects statistics.
+ */
+template <typename Stats_t>
+constexpr bool STATS_ENABLED = std::remove_cv_t<std::remove_reference_t<Stats_t>>::ENABLED;
+
+/**
+ * Adds the wall time between construction and destruction to the phase
+ * `name` of an enabled statistics sink. The phase is traced as well (see
+ * 'trace.hpp'); with `NoStats` this is all it does.
+ */
+template <
+  typename Stats_t,
+  bool ENABLED = STATS_ENABLED<Stats_t>
+    >
+class ScopedPhase {
+public:
+  ScopedPhase(Stats_t& stats, const char* name)
+    : stats_(stats), name_(name), start_(std::chrono::steady_clock::now()), trace_(name) {}
+
+  ScopedPhase(const ScopedPhase&) = delete;
+  ScopedPhase& operator=(const ScopedPhase&) = delete;
+
+  ~ScopedPhase() {
+    const auto stop = std::chrono::steady_clock::now();
+    stats_.add_phase(name_, std::chrono::duration<double>(stop - start_).count());
+  }
+
+private:
+  Stats_t& stats_;
+  const char* name_;
+  std::chrono::steady_clock::time_point start_;
+  TraceScope trace_;
+};
+
+template <typename Stats_t>
+class ScopedPhase<Stats_t, false> {
+public:
+  ScopedPhase(Stats_t&, const char* name) : trace_(name) {}
+
+private:
+  TraceScope trace_;
+};
+
+} // namespace matrixgen::implementation
@@ -0,0 +1,189 @@
+/**
+ * Output targets which let the generators write into caller-provided
+ * compressed sparse row (CSR) arrays instead of returning an owning
+ * `Eigen::SparseMatrix`.
+ */
+#pragma once
+
+#include <matrixgen/execution.hpp>
+#include <matrixgen/utility.hpp>
+
+#include <Eigen/Sparse>
+
+#include <gsl/gsl-lite.hpp>
+
+#include <tbb/blocked_range.h>
+
+namespace matrixgen
+{
+
+/**
+ * CsrTarget
+ *
+ * Non-owning view of caller-provided CSR arrays: the row pointers
+ * `outerIndex` (one entry per row plus one), the column indices `innerIndex`
+ * and the values `values`. The arrays may live anywhere (huge pages, pinned
+ * memory, a solver's own storage).
+ */
+template <
+  typename Scalar_t = double,
+  typename Index_t = int
+    >
+struct CsrTarget {
+  gsl::span<Index_t> outerIndex;
+  gsl::span<Index_t> innerIndex;
+  gsl::span<Scalar_t> values;
+};
+
+/**
+ * CsrCapacity
+ *
+ * Returned by the generators' `CsrTarget` overloads. `outerIndexSize` and
+ * `nonZeros` are the array lengths required to hold the result. `complete`
+ * is set if the target was large enough and the result has been written.
+ *
+ * A first call with an empty target only reports the required capacities:
+ *
+ * ****************************************************************************
+ *   auto target = matrixgen::CsrTarget<double, int> {};
+ *   const auto cap = matrixgen::adjmat(target, grid, adjfn, weightfn);
+ *   rowPtr.resize(cap.outerIndexSize);
+ *   colIdx.resize(cap.nonZeros);
+ *   vals.resize(cap.nonZeros);
+ *   target = {rowPtr, colIdx, vals};
+ *   matrixgen::adjmat(target, grid, adjfn, weightfn); // .complete == true
+ * ****************************************************************************
+ */
+struct CsrCapacity {
+  Eigen::Index outerIndexSize = 0;
+  Eigen::Index nonZeros = 0;
+  bool complete = false;
+};
+
+/**
+ * as_map
+ *
+ * Views a completely written `CsrTarget` as a row-major
+ * `Eigen::Map<Eigen::SparseMatrix>` without copying.
+ */
+template <
+  typename Scalar_t,
+  typename Index_t
+    >
+Eigen::Map<Eigen::SparseMatrix<Scalar_t, Eigen::RowMajor, Index_t>>
+as_map(
+    const CsrTarget<Scalar_t, Index_t>& target,
+    Eigen::Index rows,
+    Eigen::Index cols) {
+
+  Expects( static_cast<Eigen::Index>(target.outerIndex.size()) == rows + 1 );
+
+  const auto nnz = static_cast<Eigen::Index>(target.outerIndex[rows]);
+  Expects( static_cast<Eigen::Index>(target.innerIndex.size()) >= nnz );
+  Expects( static_cast<Eigen::Index>(target.values.size()) >= nnz );
+
+  return Eigen::Map<Eigen::SparseMatrix<Scalar_t, Eigen::RowMajor, Index_t>>(
+      rows, cols, nnz,
+      target.outerIndex.data(),
+      target.innerIndex.data(),
+      target.values.data());
+}
+
+} // namespace matrixgen
+
+namespace matrixgen::implementation
+{
+
+/**
+ * Writes a CSR matrix with `outerSize` rows into `target` using the same
+ * two-pass scheme as `fill_compressed`: `sizeFn(row)` returns a row's number
+ * of nonzeros and `fillFn(row, innerFirst, valueFirst, count)` writes them.
+ *
+ * If `target.outerIndex` is too small only the total number of nonzeros is
+ * computed. If the inner index or value arrays are too small the row
+ * pointers are written but the rows are not filled. `fillFn` is called
+ * concurrently if `parallelFill` is set and in ascending row order otherwise.
+ * Phases and per-thread work are reported to `stats` as in
+ * `fill_compressed`.
+ */
+template <
+  typename Scalar_t,
+  typename Index_t,
+  typename SizeFn_t,
+  typename FillFn_t,
+  typename Stats_t = NoStats
+    >
+CsrCapacity
+write_csr(
+    const CsrTarget<Scalar_t, Index_t>& target,
+    Eigen::Index outerSize,
+    SizeFn_t sizeFn,
+    FillFn_t fillFn,
+    bool parallelFill = true,
+    Stats_t&& stats = Stats_t {}) {
+
+  auto capacity = CsrCapacity {outerSize + 1, 0, false};
+
+  if (static_cast<Eigen::Index>(target.outerIndex.size()) < outerSize + 1) {
+    [[maybe_unused]] const auto phase = ScopedPhase(stats, "rows.count");
+    capacity.nonZeros = parallel_sum_blocks(0, outerSize, Eigen::Index {0},
+        [&](const auto& range, Eigen::Index sum) {
+          const auto trace = TraceScope("rows.count.block", range.begin(), range.end());
+          for(auto outer = range.begin(); outer != range.end(); ++outer) {
+            sum += static_cast<Eigen::Index>(sizeFn(outer));
+          }
+          return sum;
+        });
+    return capacity;
+  }
+
+  Index_t* outerIndex = target.outerIndex.data();
+  outerIndex[0] = 0;
+  {
+    [[maybe_unused]] const auto phase = ScopedPhase(stats, "rows.count");
+    parallel_for_blocks(0, outerSize,
+      [&](const auto& range) {
+        const auto trace = TraceScope("rows.count.block", range.begin(), range.end());
+        for(auto outer = range.begin(); outer != range.end(); ++outer) {
+          outerIndex[outer + 1] = static_cast<Index_t>(sizeFn(outer));
+        }
+      });
+  }
+  {
+    [[maybe_unused]] const auto phase = ScopedPhase(stats, "rows.scan");
+    parallel_inclusive_scan(outerIndex + 1, outerIndex + outerSize + 1);
+  }
+  capacity.nonZeros = outerIndex[outerSize];
+
+  if (static_cast<Eigen::Index>(target.innerIndex.size()) < capacity.nonZeros ||
+      static_cast<Eigen::Index>(target.values.size()) < capacity.nonZeros) {
+    return capacity;
+  }
+
+  Index_t* innerIndex = target.innerIndex.data();
+  Scalar_t* values = target.values.data();
+  auto fillRange = [&](const tbb::blocked_range<Eigen::Index>& range) {
+    const auto trace = TraceScope("rows.fill.block", range.begin(), range.end());
+    for(auto outer = range.begin(); outer != range.end(); ++outer) {
+      const auto offset = outerIndex[outer];
+      fillFn(outer, innerIndex + offset, values + offset, outerIndex[outer + 1] - offset);
+    }
+    if constexpr (STATS_ENABLED<Stats_t>) {
+      stats.add_work(outerIndex[range.end()] - outerIndex[range.begin()]);
+    }
+  };
+  {
+    [[maybe_unused]] const auto phase = ScopedPhase(stats, "rows.fill");
+    if (parallelFill) {
+      parallel_for_blocks(0, outerSize, fillRange);
+    }
+    else {
+      fillRange(tbb::blocked_range<Eigen::Index>(0, outerSize));
+    }
+  }
+
+  capacity.complete = true;
+  return capacity;
+}
+
+} // namespace matrixgen::implementation
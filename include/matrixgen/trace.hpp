@@ -0,0 +1,266 @@
+/**
+ * Low-overhead timeline tracing of the generators.
+ *
+ * While tracing is enabled every thread records the spans of the phases and
+ * work chunks it executes into a ring buffer of its own. The buffers are
+ * exported as Chrome trace-event JSON which can be opened in Perfetto or
+ * chrome://tracing.
+ *
+ * ****************************************************************************
+ *   matrixgen::start_tracing();
+ *   auto matrix = matrixgen::adjmat(grid, adjfn, weightfn);
+ *   matrixgen::stop_tracing();
+ *   matrixgen::write_chrome_trace("adjmat.json");
+ * ****************************************************************************
+ *
+ * Disabled tracing costs a relaxed atomic load per span. Define
+ * `MATRIXGEN_DISABLE_TRACING` to remove the trace points entirely.
+ */
+#pragma once
+
+#include <gsl/gsl-lite.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <ios>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace matrixgen::implementation
+{
+
+/* A completed span. `name` must be a string literal. */
+struct TraceEvent {
+  const char* name = nullptr;
+  uint64_t startNs = 0;
+  uint64_t durationNs = 0;
+  int64_t first = -1; // optional work range [first, last)
+  int64_t last = -1;
+};
+
+/**
+ * Fixed-capacity ring buffer of a single thread's events. Only the owning
+ * thread writes; the oldest events are overwritten once the buffer is full.
+ */
+class TraceBuffer {
+public:
+  TraceBuffer(std::size_t capacity, std::size_t threadIndex)
+    : events_(capacity), threadIndex_(threadIndex) {}
+
+  void record(const TraceEvent& event) {
+    const auto index = count_.load(std::memory_order_relaxed);
+    events_[index % events_.size()] = event;
+    count_.store(index + 1, std::memory_order_release);
+  }
+
+  /* The retained events, oldest first. */
+  std::vector<TraceEvent> events() const {
+    const auto count = count_.load(std::memory_order_acquire);
+    const auto first = count > events_.size() ? count - events_.size() : 0;
+    auto result = std::vector<TraceEvent> {};
+    result.reserve(count - first);
+    for(auto ii = first; ii < count; ++ii) {
+      result.push_back(events_[ii % events_.size()]);
+    }
+    return result;
+  }
+
+  std::size_t thread_index() const { return threadIndex_; }
+
+private:
+  std::vector<TraceEvent> events_;
+  std::atomic<std::size_t> count_ {0};
+  std::size_t threadIndex_;
+};
+
+/**
+ * Process-wide tracing state. Each call of `start_tracing` begins a new
+ * epoch; threads lazily register a fresh buffer when they first record in an
+ * epoch.
+ */
+struct TraceRegistry {
+  std::atomic<bool> enabled {false};
+  std::atomic<uint64_t> epoch {0};
+  std::size_t capacity = 0;
+  std::chrono::steady_clock::time_point origin;
+  std::mutex mutex;
+  std::vector<std::shared_ptr<TraceBuffer>> buffers;
+};
+
+inline
+TraceRegistry&
+trace_registry() {
+  static TraceRegistry registry;
+  return registry;
+}
+
+inline
+bool
+tracing_enabled() noexcept {
+  return trace_registry().enabled.load(std::memory_order_relaxed);
+}
+
+inline
+uint64_t
+trace_now() noexcept {
+  const auto elapsed = std::chrono::steady_clock::now() - trace_registry().origin;
+  return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+}
+
+/* The calling thread's buffer for the current epoch. */
+inline
+TraceBuffer&
+local_trace_buffer() {
+  thread_local auto buffer = std::shared_ptr<TraceBuffer> {};
+  thread_local auto epoch = uint64_t {0};
+
+  auto& registry = trace_registry();
+  const auto current = registry.epoch.load(std::memory_order_acquire);
+  if(!buffer || epoch != current) {
+    const auto lock = std::lock_guard<std::mutex>(registry.mutex);
+    buffer = std::make_shared<TraceBuffer>(registry.capacity, registry.buffers.size());
+    registry.buffers.push_back(buffer);
+    epoch = current;
+  }
+  return *buffer;
+}
+
+/**
+ * Records the span between construction and destruction as an event named
+ * `name`, optionally annotated with the work range [first, last). Does
+ * nothing unless tracing is enabled.
+ */
+class TraceScope {
+public:
+#ifndef MATRIXGEN_DISABLE_TRACING
+  explicit TraceScope(const char* name, int64_t first = -1, int64_t last = -1) noexcept {
+    if(tracing_enabled()) {
+      event_ = TraceEvent {name, trace_now(), 0, first, last};
+    }
+  }
+
+  ~TraceScope() {
+    if(event_.name != nullptr && tracing_enabled()) {
+      event_.durationNs = trace_now() - event_.startNs;
+      local_trace_buffer().record(event_);
+    }
+  }
+#else
+  explicit TraceScope(const char*, int64_t = -1, int64_t = -1) noexcept {}
+#endif
+
+  TraceScope(const TraceScope&) = delete;
+  TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+#ifndef MATRIXGEN_DISABLE_TRACING
+  TraceEvent event_;
+#endif
+};
+
+} // namespace matrixgen::implementation
+
+namespace matrixgen
+{
+
+/**
+ * start_tracing
+ *
+ * Discards all recorded events and enables tracing. Every thread retains
+ * its most recent `eventsPerThread` events. Must not be called while
+ * generators are running.
+ */
+inline
+void
+start_tracing(std::size_t eventsPerThread = std::size_t {1} << 16U) {
+
+  Expects( eventsPerThread > 0 );
+
+  auto& registry = implementation::trace_registry();
+  const auto lock = std::lock_guard<std::mutex>(registry.mutex);
+  registry.buffers.clear();
+  registry.capacity = eventsPerThread;
+  registry.origin = std::chrono::steady_clock::now();
+  registry.epoch.fetch_add(1, std::memory_order_release);
+  registry.enabled.store(true, std::memory_order_release);
+}
+
+/**
+ * stop_tracing
+ *
+ * Disables tracing. Recorded events are kept until the next call of
+ * `start_tracing`.
+ */
+inline
+void
+stop_tracing() {
+  implementation::trace_registry().enabled.store(false, std::memory_order_release);
+}
+
+/**
+ * write_chrome_trace
+ *
+ * Writes the recorded events as Chrome trace-event JSON. Each thread
+ * appears as a track 'worker <n>'; work ranges are attached to the events as
+ * the arguments 'first' and 'last'. Should be called after `stop_tracing`.
+ */
+inline
+void
+write_chrome_trace(std::ostream& os) {
+
+  auto& registry = implementation::trace_registry();
+  auto buffers = std::vector<std::shared_ptr<implementation::TraceBuffer>> {};
+  {
+    const auto lock = std::lock_guard<std::mutex>(registry.mutex);
+    buffers = registry.buffers;
+  }
+
+  const auto flags = os.flags();
+  const auto precision = os.precision();
+  os << std::fixed << std::setprecision(3);
+
+  os << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+  auto separator = "";
+  for(const auto& buffer : buffers) {
+    const auto tid = buffer->thread_index();
+    os << separator << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << tid
+       << ",\"args\":{\"name\":\"worker " << tid << "\"}}";
+    separator = ",";
+    for(const auto& event : buffer->events()) {
+      os << ",{\"name\":\"" << event.name << "\",\"cat\":\"matrixgen\",\"ph\":\"X\",\"pid\":1,\"tid\":" << tid
+         << ",\"ts\":" << static_cast<double>(event.startNs) / 1000.0
+         << ",\"dur\":" << static_cast<double>(event.durationNs) / 1000.0;
+      if(event.first >= 0) {
+        os << ",\"args\":{\"first\":" << event.first << ",\"last\":" << event.last << "}";
+      }
+      os << "}";
+    }
+  }
+  os << "]}\n";
+
+  os.flags(flags);
+  os.precision(precision);
+}
+
+/**
+ * As above, writing to the file at `path`.
+ */
+inline
+void
+write_chrome_trace(const std::string& path) {
+
+  auto file = std::ofstream(path);
+  if(!file) {
+    throw std::runtime_error("matrixgen: cannot open '" + path + "' for writing");
+  }
+  write_chrome_trace(file);
+}
+
+} // namespace matrixgen
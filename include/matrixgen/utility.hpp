@@ -4,8 +4,15 @@
 
 #include <gsl/gsl-lite.hpp>
 
+#include <matrixgen/execution.hpp>
+#include <matrixgen/memory.hpp>
+#include <matrixgen/stats.hpp>
+
+#include <tbb/blocked_range.h>
+
 #include <chrono>
 #include <execution>
+#include <memory_resource>
 #include <numeric>
 
 namespace matrixgen
@@ -69,7 +76,7 @@ num_of_nnz_in_outer(
  * elements {0, 1, 2, 3}, whereas the value for the element at index 2 is the
  * accumulate of the elements {0, 1, 2, 3, 4}.
  *
- * Can be used in-place.
+ * Can be used in-place. The scan buffer is allocated from `resource`.
  */
 template <
   typename RandAccIter_t,
@@ -80,7 +87,8 @@ central_moving_sum(
     RandAccIter_t first,
     RandAccIter_t last,
     OutputIter_t outFirst,
-    int32_t radius) {
+    int32_t radius,
+    std::pmr::memory_resource* resource = std::pmr::get_default_resource()) {
 
   const auto numOfElements = std::distance(first, last);
 
@@ -105,18 +113,40 @@ central_moving_sum(
 
   // Generate the exclusive scan
   // TODO: Can be parallelized
-  std::vector<Input_t> xscan(numOfElements + 1);
+  auto xscan = std::pmr::vector<Input_t>(numOfElements + 1, resource);
   std::exclusive_scan(std::execution::seq, first, last, std::begin(xscan), static_cast<Input_t>(0));
   xscan.back() = xscan[xscan.size() - 2] + *std::prev(last);
 
   // Compute the moving sum via the elements to the left and right. Stop at
-  // the array's boundaries.
-  // TODO: Can be parallelized
-  for(auto ii = 0; ii < numOfElements; ++ii) {
+  // the array's boundaries. Outputs which cannot be advanced in constant
+  // time, e.g. inserters, are written in order.
+  const auto moving_sum = [&](Eigen::Index ii) {
     const int64_t left = std::max<int64_t>(0, ii - radius);
     const int64_t right = std::min<int64_t>(ii + radius + 1, xscan.size() - 1);
-    *std::next(outFirst, ii) = *std::next(std::cbegin(xscan), right) - *std::next(std::cbegin(xscan), left);
+    return *std::next(std::cbegin(xscan), right) - *std::next(std::cbegin(xscan), left);
   };
+  if constexpr (implementation::IS_RANDOM_ACCESS<OutputIter_t>) {
+    implementation::parallel_for_blocks(0, numOfElements, [&](const auto& range) {
+      for(auto ii = range.begin(); ii != range.end(); ++ii) {
+        *std::next(outFirst, ii) = moving_sum(ii);
+      }
+    });
+  }
+  else {
+    for(auto ii = Eigen::Index {0}; ii < numOfElements; ++ii) {
+      *outFirst++ = moving_sum(ii);
+    }
+  }
+}
+
+/**
+ * Overload of `central_moving_sum` executed under `context`.
+ */
+template <typename... Args_t>
+void
+central_moving_sum(const ExecutionContext& context, Args_t&&... args) {
+
+  context.execute([&]() { central_moving_sum(std::forward<Args_t>(args)...); });
 }
 
 /**
@@ -138,7 +168,8 @@ central_moving_sum(
  * unit vectors of a window which correspond to the unit vectors of the sphere
  * whose angle spans [loopMin, loop_mmax) and then normalizing the input.
  *
- * Can be used in-place.
+ * Can be used in-place. The five scratch vectors, including the one of
+ * 'central_moving_sum', are allocated from `resource`.
  */
 template <
   typename InputIter_t,
@@ -151,7 +182,8 @@ closed_loop_moving_mean(
     OutputIter_t outFirst,
     typename std::iterator_traits<InputIter_t>::value_type loopMin,
     typename std::iterator_traits<InputIter_t>::value_type loopMax,
-    std::size_t radius) {
+    std::size_t radius,
+    std::pmr::memory_resource* resource = std::pmr::get_default_resource()) {
 
   const auto numOfElements = std::distance(first, last);
 
@@ -169,7 +201,7 @@ closed_loop_moving_mean(
   //
 
   // (1.1) Create phase angles in [0; 2*pi) from inputs
-  auto angles = std::vector<double>(numOfElements);
+  auto angles = std::pmr::vector<double>(numOfElements, resource);
   const auto rangeWidth = loopMax - loopMin;
   std::transform(
       first,
@@ -179,7 +211,7 @@ closed_loop_moving_mean(
       });
 
   // (1.2) Generate complex doubles from phase angles to perform vector arithmetic on
-  auto cplx = std::vector<std::complex<double>>(angles.size());
+  auto cplx = std::pmr::vector<std::complex<double>>(angles.size(), resource);
   std::transform(
       angles.cbegin(),
       angles.cend(),
@@ -200,7 +232,7 @@ closed_loop_moving_mean(
   //
   // (2.1) Set up integer complex
   const auto scale = static_cast<double>(std::pow(2, 50));
-  auto cplxInt = std::vector<std::complex<int64_t>>(cplx.size());
+  auto cplxInt = std::pmr::vector<std::complex<int64_t>>(cplx.size(), resource);
   std::transform(
       std::cbegin(cplx),
       std::cend(cplx),
@@ -210,8 +242,8 @@ closed_loop_moving_mean(
       });
 
   // (2.2) Compute central moving sum (vector addition)
-  auto smoothedCplxInt = std::vector<std::complex<int64_t>>(cplxInt.size());
-  central_moving_sum(std::cbegin(cplxInt), std::cend(cplxInt), std::begin(smoothedCplxInt), radius);
+  auto smoothedCplxInt = std::pmr::vector<std::complex<int64_t>>(cplxInt.size(), resource);
+  central_moving_sum(std::cbegin(cplxInt), std::cend(cplxInt), std::begin(smoothedCplxInt), radius, resource);
 
   // (3) Revert to phase angles
   std::transform(
@@ -244,6 +276,8 @@ closed_loop_moving_mean(
  * darts_sampling
  *
  * TODO: Documentation
+ *
+ * The bins are allocated from `resource`.
  */
 template <
   typename InputIter1_t,
@@ -256,25 +290,46 @@ darts_sampling(
     InputIter1_t quotaLast,
     InputIter2_t bulletsFirst,
     InputIter2_t bulletsLast,
-    OutputIter_t outFirst) {
+    OutputIter_t outFirst,
+    std::pmr::memory_resource* resource = std::pmr::get_default_resource()) {
 
   // (1) Create target bins (set up 'dartboard')
-  std::vector<double> ratios(std::distance(quotaFirst, quotaLast));
+  auto ratios = std::pmr::vector<double>(std::distance(quotaFirst, quotaLast), resource);
   const double sum = std::accumulate(quotaFirst, quotaLast, static_cast<double>(0));
   std::transform(quotaFirst, quotaLast, std::begin(ratios), [sum](auto val) -> double {return val/sum;});
 
   // (2) Generate indices ('Evaluate hits')
-  std::vector<double> ratiosIncScan(ratios.size());
+  auto ratiosIncScan = std::pmr::vector<double>(ratios.size(), resource);
   std::inclusive_scan(std::execution::seq, std::cbegin(ratios), std::cend(ratios), std::begin(ratiosIncScan));
-  const auto nbullet = std::distance(bulletsFirst, bulletsLast);
-  for(auto loopIndex = 0; loopIndex < nbullet; ++loopIndex) {
-    auto it = std::next(bulletsFirst, loopIndex);
-    auto resultIter = std::lower_bound(std::cbegin(ratiosIncScan), std::cend(ratiosIncScan), *it);
-    auto index = std::distance(std::cbegin(ratiosIncScan), resultIter);
-
-    auto offset = std::distance(bulletsFirst, it);
-    *std::next(outFirst, offset) = index;
+  const auto hit = [&](const auto& bullet) {
+    auto resultIter = std::lower_bound(std::cbegin(ratiosIncScan), std::cend(ratiosIncScan), bullet);
+    return std::distance(std::cbegin(ratiosIncScan), resultIter);
   };
+  // Bullets or outputs which cannot be advanced in constant time, e.g.
+  // stream iterators, are processed in order.
+  if constexpr (implementation::IS_RANDOM_ACCESS<InputIter2_t> && implementation::IS_RANDOM_ACCESS<OutputIter_t>) {
+    const auto nbullet = std::distance(bulletsFirst, bulletsLast);
+    implementation::parallel_for_blocks(0, nbullet, [&](const auto& range) {
+      for(auto loopIndex = range.begin(); loopIndex != range.end(); ++loopIndex) {
+        *std::next(outFirst, loopIndex) = hit(*std::next(bulletsFirst, loopIndex));
+      }
+    });
+  }
+  else {
+    for(auto it = bulletsFirst; it != bulletsLast; ++it) {
+      *outFirst++ = hit(*it);
+    }
+  }
+}
+
+/**
+ * Overload of `darts_sampling` executed under `context`.
+ */
+template <typename... Args_t>
+void
+darts_sampling(const ExecutionContext& context, Args_t&&... args) {
+
+  context.execute([&]() { darts_sampling(std::forward<Args_t>(args)...); });
 }
 
 template <
@@ -384,46 +439,63 @@ void insert(
   Insert<InMatrix_t, CoordIndex_t, Filler_t>::invoke(smat, row, col, object);
 }
 
+/**
+ * Coordinates of a node in a grid of rank `RANK`, or the grid's extents.
+ * Dimensions are ordered from the fastest to the slowest varying one, i.e.
+ * x, y, z, ...
+ */
+template <typename Scalar_t, std::size_t RANK>
+using Coords_t = std::array<Scalar_t, RANK>;
+
 // TODO: Unify into Coords3d_t<T>. No need to have two types here.
 template <typename Scalar_t>
-using Coords3d_t = std::array<Scalar_t, 3>;
+using Coords3d_t = Coords_t<Scalar_t, 3>;
 
 /**
  * Element-wise addition of arrays.
  */
-template <typename Scalar_t>
-Coords3d_t<Scalar_t> 
+template <typename Scalar_t, std::size_t RANK>
+Coords_t<Scalar_t, RANK>
 operator+(
-    const Coords3d_t<Scalar_t>& a,
-    const Coords3d_t<Scalar_t>& b) {
+    const Coords_t<Scalar_t, RANK>& a,
+    const Coords_t<Scalar_t, RANK>& b) {
 
-  return {a[0] + b[0], a[1] + b[1], a[2] + b[2]};
+  auto result = Coords_t<Scalar_t, RANK> {};
+  for(auto dim = std::size_t {0}; dim < RANK; ++dim) {
+    result[dim] = a[dim] + b[dim];
+  }
+  return result;
 }
 
 /**
  * Element-wise subtraction of arrays.
  */
-template <typename Scalar_t>
-Coords3d_t<Scalar_t> 
+template <typename Scalar_t, std::size_t RANK>
+Coords_t<Scalar_t, RANK>
 operator-(
-    const Coords3d_t<Scalar_t>& a,
-    const Coords3d_t<Scalar_t>& b) {
+    const Coords_t<Scalar_t, RANK>& a,
+    const Coords_t<Scalar_t, RANK>& b) {
 
-  return {a[0] - b[0], a[1] - b[1], a[2] - b[2]};
+  auto result = Coords_t<Scalar_t, RANK> {};
+  for(auto dim = std::size_t {0}; dim < RANK; ++dim) {
+    result[dim] = a[dim] - b[dim];
+  }
+  return result;
 }
 
 /**
  * Geometric midpoint
  */
-template <typename OutScalar_t, typename InScalar_t = void>
-Coords3d_t<OutScalar_t>
-midpoint(const Coords3d_t<InScalar_t>& a, const Coords3d_t<InScalar_t>& b) {
+template <typename OutScalar_t, typename InScalar_t = void, std::size_t RANK = 3>
+Coords_t<OutScalar_t, RANK>
+midpoint(const Coords_t<InScalar_t, RANK>& a, const Coords_t<InScalar_t, RANK>& b) {
   static_assert(std::is_floating_point<OutScalar_t>(), "Output type must be real.");
 
-  return Coords3d_t<OutScalar_t> {
-    a[0] + (static_cast<OutScalar_t>((b[0] - a[0])) / 2),
-    a[1] + (static_cast<OutScalar_t>((b[1] - a[1])) / 2),
-    a[2] + (static_cast<OutScalar_t>((b[2] - a[2])) / 2)};
+  auto result = Coords_t<OutScalar_t, RANK> {};
+  for(auto dim = std::size_t {0}; dim < RANK; ++dim) {
+    result[dim] = a[dim] + (static_cast<OutScalar_t>((b[dim] - a[dim])) / 2);
+  }
+  return result;
 }
 
 /**
@@ -447,16 +519,18 @@ mod(Scalar_t n, Scalar_t mod) {
   return mod + m;
 }
 
-template <typename Index_t>
-Coords3d_t<Index_t>
+template <typename Index_t, std::size_t RANK>
+Coords_t<Index_t, RANK>
 modplus(
-    const Coords3d_t<Index_t>& a,
-    const Coords3d_t<Index_t>& b,
-    const Coords3d_t<Index_t>& modulus) {
+    const Coords_t<Index_t, RANK>& a,
+    const Coords_t<Index_t, RANK>& b,
+    const Coords_t<Index_t, RANK>& modulus) {
 
-  return {mod((a[0] + b[0]), modulus[0]),
-          mod((a[1] + b[1]), modulus[1]),
-          mod((a[2] + b[2]), modulus[2])};
+  auto result = Coords_t<Index_t, RANK> {};
+  for(auto dim = std::size_t {0}; dim < RANK; ++dim) {
+    result[dim] = mod((a[dim] + b[dim]), modulus[dim]);
+  }
+  return result;
 }
 
 /**
@@ -465,46 +539,44 @@ modplus(
  */
 template <
   typename Index_t = int,
-  uint32_t EXTENT = 1
+  uint32_t EXTENT = 1,
+  std::size_t RANK = 3
     >
 bool is_inner_node(
-    const Coords3d_t<Index_t>& coords,
-    const Coords3d_t<Index_t>& gridDimensions) {
-
-  Expects( coords[0] >= 0                );
-  Expects( coords[1] >= 0                );
-  Expects( coords[2] >= 0                );
-  Expects( coords[0] < gridDimensions[0] );
-  Expects( coords[1] < gridDimensions[1] );
-  Expects( coords[2] < gridDimensions[2] );
-
-  return (coords[0] >= EXTENT && coords[0] < gridDimensions[0] - EXTENT &&
-          coords[1] >= EXTENT && coords[1] < gridDimensions[1] - EXTENT &&
-          coords[2] >= EXTENT && coords[2] < gridDimensions[2] - EXTENT);
+    const Coords_t<Index_t, RANK>& coords,
+    const Coords_t<Index_t, RANK>& gridDimensions) {
+
+  auto inner = true;
+  for(auto dim = std::size_t {0}; dim < RANK; ++dim) {
+    Expects( coords[dim] >= 0                  );
+    Expects( coords[dim] < gridDimensions[dim] );
+    inner = inner && coords[dim] >= static_cast<Index_t>(EXTENT) &&
+                     coords[dim] < gridDimensions[dim] - static_cast<Index_t>(EXTENT);
+  }
+  return inner;
 }
 
 /**
  * Return true if node at 'myCoords' is contained by the grid.
  */
-template <typename Index_t = int>
+template <typename Index_t = int, std::size_t RANK = 3>
 bool
 is_inside_grid(
-  const Coords3d_t<Index_t>& coords,
-  const Coords3d_t<Index_t>& gridDimensions) {
+  const Coords_t<Index_t, RANK>& coords,
+  const Coords_t<Index_t, RANK>& gridDimensions) {
 
-  Expects( 0 < gridDimensions[0] );
-  Expects( 0 < gridDimensions[1] );
-  Expects( 0 < gridDimensions[2] );
-
-  return (0 <= coords[0] && coords[0] < gridDimensions[0] &&
-          0 <= coords[1] && coords[1] < gridDimensions[1] &&
-          0 <= coords[2] && coords[2] < gridDimensions[2]);
+  auto inside = true;
+  for(auto dim = std::size_t {0}; dim < RANK; ++dim) {
+    Expects( 0 < gridDimensions[dim] );
+    inside = inside && 0 <= coords[dim] && coords[dim] < gridDimensions[dim];
+  }
+  return inside;
 }
 
 /**
  * Compile-time boundary conditions
  *
- * Used in the implementation of `matrixgen::stencil7p`.
+ * Used in the implementation of `matrixgen::stencil` and its presets.
  */
 enum class BC {
   DIRICHLET,
@@ -527,6 +599,134 @@ const std::array<Coords3d_t<Index_t>, 7> STENCIL<7, Index_t> =
     { 0, -1,  0}, {0, 1, 0},   // Y
     { 0,  0, -1}, {0, 0, 1}}}; // Z
 
+/**
+ * mix_seed
+ *
+ * Derives an independent seed for the `stream`-th substream from a user seed
+ * (splitmix64 finalizer). Used to give each row its own deterministic random
+ * engine, such that parallel generation does not depend on the order in which
+ * rows are processed.
+ */
+inline
+uint64_t
+mix_seed(uint64_t seed, uint64_t stream) {
+
+  uint64_t z = seed + (stream + 1) * 0x9E3779B97F4A7C15ULL;
+  z = (z ^ (z >> 30U)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27U)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31U);
+}
+
+/**
+ * count_compressed
+ *
+ * The first pass of `fill_compressed`: resizes `result` to `rows` x `cols`,
+ * scans the counts `sizeFn(outer)` into its outer index array and allocates
+ * the inner index and value arrays. These are left uninitialized; their
+ * pages are not touched before they are filled.
+ */
+template <
+  typename Scalar_t,
+  int ALIGNMENT,
+  typename Index_t,
+  typename SizeFn_t,
+  typename Stats_t = NoStats
+    >
+void
+count_compressed(
+    Eigen::SparseMatrix<Scalar_t, ALIGNMENT, Index_t>& result,
+    Eigen::Index rows,
+    Eigen::Index cols,
+    SizeFn_t sizeFn,
+    Stats_t&& stats = Stats_t {}) {
+
+  Expects( rows >= 0 );
+  Expects( cols >= 0 );
+
+  result.resize(rows, cols); // leaves the matrix compressed and empty
+  const auto outerSize = result.outerSize();
+  Index_t* outerIndex = result.outerIndexPtr();
+
+  outerIndex[0] = 0;
+  {
+    [[maybe_unused]] const auto phase = implementation::ScopedPhase(stats, "rows.count");
+    implementation::parallel_for_blocks(0, outerSize,
+      [&](const auto& range) {
+        const auto trace = implementation::TraceScope("rows.count.block", range.begin(), range.end());
+        for(auto outer = range.begin(); outer != range.end(); ++outer) {
+          outerIndex[outer + 1] = static_cast<Index_t>(sizeFn(outer));
+        }
+      });
+  }
+  {
+    [[maybe_unused]] const auto phase = implementation::ScopedPhase(stats, "rows.scan");
+    implementation::parallel_inclusive_scan(outerIndex + 1, outerIndex + outerSize + 1);
+    result.resizeNonZeros(outerIndex[outerSize]);
+  }
+  if constexpr (implementation::STATS_ENABLED<Stats_t>) {
+    stats.add_allocation((outerSize + 1) * sizeof(Index_t));
+    stats.add_allocation(outerIndex[outerSize] * (sizeof(Index_t) + sizeof(Scalar_t)));
+  }
+}
+
+/**
+ * fill_compressed
+ *
+ * Builds a compressed `Eigen::SparseMatrix` of size `rows` x `cols` directly
+ * in its compressed storage without triplets or intermediate insertions. The
+ * construction runs in two parallel passes over the outers:
+ *
+ * (1) `sizeFn(outer)` returns the number of nonzeros of each outer. The
+ *     counts are scanned into the matrix's outer index array and the inner
+ *     index and value arrays are allocated once.
+ * (2) `fillFn(outer, innerFirst, valueFirst, count)` writes exactly `count`
+ *     inner indices and values of the outer, in ascending inner order.
+ *
+ * Both functions are called concurrently for different outers and must not
+ * share mutable state.
+ *
+ * The phases 'rows.count', 'rows.scan' and 'rows.fill' are reported to
+ * `stats`, and the nonzeros written by each thread as its work.
+ */
+template <
+  typename Scalar_t,
+  int ALIGNMENT,
+  typename Index_t,
+  typename SizeFn_t,
+  typename FillFn_t,
+  typename Stats_t = NoStats
+    >
+void
+fill_compressed(
+    Eigen::SparseMatrix<Scalar_t, ALIGNMENT, Index_t>& result,
+    Eigen::Index rows,
+    Eigen::Index cols,
+    SizeFn_t sizeFn,
+    FillFn_t fillFn,
+    Stats_t&& stats = Stats_t {}) {
+
+  // (1) Count nonzeros per outer and scan them into the outer index array.
+  count_compressed(result, rows, cols, sizeFn, stats);
+
+  // (2) Fill every outer's slice of the inner index and value arrays.
+  const auto outerSize = result.outerSize();
+  const Index_t* outerIndex = result.outerIndexPtr();
+  Index_t* innerIndex = result.innerIndexPtr();
+  Scalar_t* values = result.valuePtr();
+  [[maybe_unused]] const auto phase = implementation::ScopedPhase(stats, "rows.fill");
+  implementation::parallel_for_blocks(0, outerSize,
+    [&](const auto& range) {
+      const auto trace = implementation::TraceScope("rows.fill.block", range.begin(), range.end());
+      for(auto outer = range.begin(); outer != range.end(); ++outer) {
+        const auto offset = outerIndex[outer];
+        fillFn(outer, innerIndex + offset, values + offset, outerIndex[outer + 1] - offset);
+      }
+      if constexpr (implementation::STATS_ENABLED<Stats_t>) {
+        stats.add_work(outerIndex[range.end()] - outerIndex[range.begin()]);
+      }
+    });
+}
+
 /**
  * Generates a uin64_t seed from the system time.
  */
@@ -0,0 +1,214 @@
+/**
+ * Reusable state for generating many matrices in a loop.
+ */
+#pragma once
+
+#include <matrixgen/adjmat.hpp>
+#include <matrixgen/assemble.hpp>
+#include <matrixgen/interleave.hpp>
+#include <matrixgen/memory.hpp>
+#include <matrixgen/stats.hpp>
+#include <matrixgen/target.hpp>
+
+#include <Eigen/Sparse>
+
+#include <gsl/gsl-lite.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <optional>
+#include <type_traits>
+
+namespace matrixgen
+{
+
+/**
+ * Workspace
+ *
+ * Keeps the buffers of `adjmat`, `assemble` and `interleave` between calls.
+ * Its member functions compute the same matrices as the free functions but
+ * refill an existing row-major output matrix instead of returning a new one:
+ *
+ *   - The output is written directly into its compressed storage (see
+ *     `CsrTarget`). Its arrays are only reallocated if the result does not
+ *     fit into their capacity, which then grows to the result's size.
+ *   - Scratch space (random numbers, scan buffers, interleaving indices) is
+ *     taken from an arena which is rewound on every call; see `ScratchArena`.
+ *
+ * Once the output and the arena have grown to the largest matrix of a loop,
+ * subsequent calls do not allocate. The refilled matrices are compressed.
+ *
+ * Calls which have to grow the output count its rows twice, which shows up
+ * twice in a `GenerationStats` sink. A workspace must not be used by more
+ * than one thread at a time.
+ *
+ * ****************************************************************************
+ *   auto workspace = matrixgen::Workspace {};
+ *   auto matrix = Eigen::SparseMatrix<double, Eigen::RowMajor> {};
+ *   for(auto seed : seeds) {
+ *     workspace.interleave(matrix, mats.begin(), mats.end(), props.begin(), props.end(), 4, seed);
+ *     ...
+ *   }
+ * ****************************************************************************
+ */
+class Workspace {
+public:
+  explicit Workspace(std::size_t scratchBytes = 0)
+    : arena_(scratchBytes) {}
+
+  Workspace(const Workspace&) = delete;
+  Workspace& operator=(const Workspace&) = delete;
+
+  /* The arena holding the scratch space. */
+  ScratchArena& arena() { return arena_; }
+
+  /**
+   * Refills `result` with the adjacency matrix of `adjmat(gridDimensions,
+   * adjfn, weightfn)`.
+   */
+  template <
+    typename Scalar_t,
+    int ALIGNMENT,
+    typename Index_t,
+    typename AdjFn_t,
+    typename WeightFn_t,
+    typename GridIndex_t = int,
+    typename Stats_t = NoStats
+      >
+  void
+  adjmat(
+      Eigen::SparseMatrix<Scalar_t, ALIGNMENT, Index_t>& result,
+      const implementation::Coords3d_t<GridIndex_t>& gridDimensions,
+      AdjFn_t adjfn,
+      WeightFn_t weightfn,
+      Stats_t&& stats = Stats_t {}) {
+
+    const auto matrixHeight = static_cast<Eigen::Index>(gridDimensions[0]) *
+                              gridDimensions[1] *
+                              gridDimensions[2];
+    refill(result, matrixHeight, matrixHeight, [&](const auto& target) {
+      return matrixgen::adjmat(target, gridDimensions, adjfn, weightfn, stats);
+    });
+  }
+
+  /**
+   * Refills `result` with `assemble(matFirst, matLast, indexFirst,
+   * indexLast)`. The source matrices must be row-major.
+   */
+  template <
+    typename Scalar_t,
+    int ALIGNMENT,
+    typename Index_t,
+    typename InMatrixIter_t,
+    typename IndexIter_t,
+    typename Stats_t = NoStats
+      >
+  void
+  assemble(
+      Eigen::SparseMatrix<Scalar_t, ALIGNMENT, Index_t>& result,
+      InMatrixIter_t matFirst,
+      InMatrixIter_t matLast,
+      IndexIter_t indexFirst,
+      IndexIter_t indexLast,
+      Stats_t&& stats = Stats_t {}) {
+
+    const auto rows = matFirst == matLast ? 0 : std::distance(indexFirst, indexLast);
+    refill(result, rows, max_inner_size(matFirst, matLast), [&](const auto& target) {
+      return matrixgen::assemble(target, matFirst, matLast, indexFirst, indexLast, stats);
+    });
+  }
+
+  /**
+   * Refills `result` with `interleave(matFirst, matLast, propFirst, propLast,
+   * coupling, seed)`. The source matrices must be row-major.
+   */
+  template <
+    typename Scalar_t,
+    int ALIGNMENT,
+    typename Index_t,
+    typename InMatrixIter_t,
+    typename PropIter_t,
+    typename Stats_t = NoStats
+      >
+  void
+  interleave(
+      Eigen::SparseMatrix<Scalar_t, ALIGNMENT, Index_t>& result,
+      InMatrixIter_t matFirst,
+      InMatrixIter_t matLast,
+      PropIter_t propFirst,
+      PropIter_t propLast,
+      int32_t coupling = 0,
+      int64_t seed = 42,
+      Stats_t&& stats = Stats_t {}) {
+
+    arena_.rewind();
+    auto indicesPhase = std::optional<implementation::ScopedPhase<std::remove_reference_t<Stats_t>>>(
+        std::in_place, stats, "interleave.indices");
+    const auto indices = implementation::interleave_indices(
+        matFirst, matLast, propFirst, propLast, coupling, seed, &arena_);
+    indicesPhase.reset();
+
+    refill(result, static_cast<Eigen::Index>(indices.size()), max_inner_size(matFirst, matLast),
+        [&](const auto& target) {
+          return matrixgen::assemble(target, matFirst, matLast, indices.cbegin(), indices.cend(), stats);
+        });
+  }
+
+private:
+  template <typename InMatrixIter_t>
+  static
+  Eigen::Index
+  max_inner_size(InMatrixIter_t matFirst, InMatrixIter_t matLast) {
+
+    auto result = Eigen::Index {0};
+    for(auto it = matFirst; it != matLast; ++it) {
+      result = std::max<Eigen::Index>(result, it->innerSize());
+    }
+    return result;
+  }
+
+  /**
+   * Resizes `result` keeping its storage and lets `write(target)` fill it
+   * through a `CsrTarget` spanning the storage's capacity. The storage is
+   * grown and the write repeated if the result does not fit.
+   */
+  template <
+    typename Scalar_t,
+    int ALIGNMENT,
+    typename Index_t,
+    typename Write_t
+      >
+  static
+  void
+  refill(
+      Eigen::SparseMatrix<Scalar_t, ALIGNMENT, Index_t>& result,
+      Eigen::Index rows,
+      Eigen::Index cols,
+      Write_t write) {
+
+    static_assert(ALIGNMENT == Eigen::RowMajor, "Workspaces require row-major matrices.");
+
+    result.resize(rows, cols); // compressed and empty, keeps the allocated storage
+    auto target = [&result, rows]() {
+      const auto capacity = static_cast<std::size_t>(result.data().allocatedSize());
+      return CsrTarget<Scalar_t, Index_t> {
+        {result.outerIndexPtr(), static_cast<std::size_t>(rows + 1)},
+        {result.innerIndexPtr(), capacity},
+        {result.valuePtr(), capacity}};
+    };
+
+    auto capacity = write(target());
+    if(!capacity.complete) {
+      result.resizeNonZeros(capacity.nonZeros);
+      capacity = write(target());
+    }
+
+    Ensures( capacity.complete );
+    result.resizeNonZeros(capacity.nonZeros);
+  }
+
+  ScratchArena arena_;
+};
+
+} // namespace matrixgen
@@ -0,0 +1,8 @@
+/**
+ * Explicit instantiations for `double` matrices in `Eigen::RowMajor` storage order.
+ * See 'matrixgen/instantiations.hpp'.
+ */
+#include <matrixgen/instantiations.hpp>
+
+MATRIXGEN_INSTANTIATE_LAYOUT(, double, Eigen::RowMajor)
+MATRIXGEN_INSTANTIATE_ROW_MAJOR(, double)
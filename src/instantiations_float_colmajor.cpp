@@ -0,0 +1,7 @@
+/**
+ * Explicit instantiations for `float` matrices in `Eigen::ColMajor` storage order.
+ * See 'matrixgen/instantiations.hpp'.
+ */
+#include <matrixgen/instantiations.hpp>
+
+MATRIXGEN_INSTANTIATE_LAYOUT(, float, Eigen::ColMajor)
@@ -0,0 +1,8 @@
+/**
+ * Explicit instantiations for `float` matrices in `Eigen::RowMajor` storage order.
+ * See 'matrixgen/instantiations.hpp'.
+ */
+#include <matrixgen/instantiations.hpp>
+
+MATRIXGEN_INSTANTIATE_LAYOUT(, float, Eigen::RowMajor)
+MATRIXGEN_INSTANTIATE_ROW_MAJOR(, float)
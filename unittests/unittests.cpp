@@ -7,7 +7,17 @@
 #include <Eigen/Dense>
 #include <Eigen/Sparse>
 
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <iterator>
+#include <list>
+#include <map>
+#include <numeric>
+#include <random>
+#include <set>
+#include <sstream>
+#include <thread>
 
 using Scalar_t = double;
 using DenseRowMajMat_t  = Eigen::Matrix<Scalar_t, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
@@ -83,9 +93,59 @@ TEST_CASE_TEMPLATE("create", OutMatrix_t,
          9, 4});
   }
 
+  SUBCASE("Elements by single-pass input iterator") {
+    auto stream = std::istringstream("3 0 0 1 9 4");
+    subject = create<OutMatrix_t>(rows, cols,
+        std::istream_iterator<Scalar_t>(stream),
+        std::istream_iterator<Scalar_t>());
+  }
+
   CHECK(m == DenseRowMajMat_t(subject));
 }
 
+TEST_CASE_TEMPLATE("create_coo", OutMatrix_t,
+  Eigen::SparseMatrix<Scalar_t, Eigen::RowMajor>,
+  Eigen::SparseMatrix<Scalar_t, Eigen::ColMajor>,
+  Eigen::SparseMatrix<Scalar_t, Eigen::ColMajor, int64_t>
+    ) {
+
+  // Unordered entries with a duplicate at (2, 0).
+  const auto rows = std::vector {2, 0, 1, 2, 2};
+  const auto cols = std::vector {0, 0, 1, 1, 0};
+  const auto values = std::vector {5.0, 3.0, 1.0, 4.0, 4.0};
+
+  const auto subject = matrixgen::create_coo<OutMatrix_t>(3, 2,
+      rows.begin(), rows.end(), cols.begin(), values.begin());
+
+  const auto target = create<DenseRowMajMat_t>(3, 2,
+      {3, 0,
+       0, 1,
+       9, 4});
+
+  REQUIRE(subject.isCompressed());
+  REQUIRE(subject.nonZeros() == 4);
+  REQUIRE(target == DenseRowMajMat_t(subject));
+
+  // Duplicates are summed in input order, as by `setFromTriplets`.
+  const auto numOfEntries = 4000;
+  auto dupRows = std::vector<int>(numOfEntries);
+  auto dupCols = std::vector<int>(numOfEntries);
+  auto dupValues = std::vector<Scalar_t>(numOfEntries);
+  auto triplets = std::vector<Eigen::Triplet<Scalar_t>> {};
+  for(auto k = 0; k < numOfEntries; ++k) {
+    dupRows[k] = k % 3;
+    dupCols[k] = (k / 3) % 2;
+    dupValues[k] = (k % 7 == 0) ? Scalar_t(1e16) * (k % 2 == 0 ? 1 : -1) : Scalar_t(1) / (k + 1);
+    triplets.emplace_back(dupRows[k], dupCols[k], dupValues[k]);
+  }
+  auto reference = OutMatrix_t(3, 2);
+  reference.setFromTriplets(triplets.begin(), triplets.end());
+  const auto summed = matrixgen::ExecutionContext::threads(4).execute([&]() {
+    return matrixgen::create_coo<OutMatrix_t>(3, 2, dupRows.begin(), dupRows.end(), dupCols.begin(), dupValues.begin());
+  });
+  CHECK(DenseRowMajMat_t(summed) == DenseRowMajMat_t(reference));
+}
+
 TEST_CASE("assemble") {
 
   using SparseMatRowMaj_t = Eigen::SparseMatrix<double, Eigen::RowMajor>;
@@ -230,6 +290,1519 @@ TEST_CASE("perturb") {
   // ??
 }
 
+TEST_CASE("perturb_rowlengths") {
+
+  using Matrix_t = Eigen::SparseMatrix<double, Eigen::RowMajor>;
+  const auto matrix = matrixgen::adjmat<Matrix_t>({8, 8, 4}, matrixgen::stencil7p(), matrixgen::constweight(3.0));
+
+  // Inner indices of every outer are strictly ascending and within bounds.
+  auto is_well_formed = [](const Matrix_t& mat) {
+    for (auto ii = 0; ii < mat.outerSize(); ++ii) {
+      for (auto kk = mat.outerIndexPtr()[ii]; kk < mat.outerIndexPtr()[ii + 1]; ++kk) {
+        const auto inner = mat.innerIndexPtr()[kk];
+        if (inner < 0 || inner >= mat.innerSize() ||
+            (kk > mat.outerIndexPtr()[ii] && mat.innerIndexPtr()[kk - 1] >= inner)) {
+          return false;
+        }
+      }
+    }
+    return true;
+  };
+
+  SUBCASE("Row lengths follow the row-length function") {
+    const auto result = matrixgen::perturb_rowlengths(matrix,
+        [](int outer, int nnz) { return outer % 2 == 0 ? nnz + 5 : 2; }, 42);
+
+    REQUIRE(result.isCompressed());
+    REQUIRE(is_well_formed(result));
+    for (auto ii = 0; ii < result.outerSize(); ++ii) {
+      const auto target = ii % 2 == 0 ? matrix.row(ii).nonZeros() + 5 : 2;
+      REQUIRE(result.row(ii).nonZeros() == target);
+      REQUIRE(result.coeff(ii, ii) == 3.0); // diagonal is always kept
+    }
+  }
+
+  SUBCASE("New nonzeros respect the bandwidth") {
+    const auto bandwidth = 10;
+    const auto result = matrixgen::perturb_rowlengths(matrix,
+        matrixgen::bimodal_rowlengths(7, 18, 0.2), 7, bandwidth);
+
+    REQUIRE(is_well_formed(result));
+    for (auto ii = 0; ii < result.outerSize(); ++ii) {
+      for (Matrix_t::InnerIterator it(result, ii); it; ++it) {
+        const auto isOriginal = matrix.coeff(ii, it.col()) != 0.0;
+        REQUIRE((isOriginal || std::abs(it.col() - ii) <= bandwidth));
+      }
+    }
+  }
+
+  SUBCASE("Max/mean ratio is imposed while the total is roughly preserved") {
+    const auto result = matrixgen::perturb_rowlengths(matrix,
+        matrixgen::maxmean_rowlengths(4.0, 0.1), 3);
+
+    auto maxLen = Eigen::Index {0};
+    for (auto ii = 0; ii < result.outerSize(); ++ii) {
+      maxLen = std::max(maxLen, result.row(ii).nonZeros());
+    }
+    REQUIRE(maxLen == 28);
+    REQUIRE(result.nonZeros() == doctest::Approx(matrix.nonZeros()).epsilon(0.2));
+  }
+
+  SUBCASE("Output is deterministic for a given seed") {
+    const auto a = matrixgen::perturb_rowlengths(matrix, matrixgen::powerlaw_rowlengths(2.5, 3, 64), 11);
+    const auto b = matrixgen::perturb_rowlengths(matrix, matrixgen::powerlaw_rowlengths(2.5, 3, 64), 11);
+
+    REQUIRE(Eigen::MatrixXd(a) == Eigen::MatrixXd(b));
+  }
+}
+
+TEST_CASE("csr target") {
+
+  using Matrix_t = Eigen::SparseMatrix<double, Eigen::RowMajor>;
+  using Target_t = matrixgen::CsrTarget<double, int>;
+
+  auto outerIndex = std::vector<int>{};
+  auto innerIndex = std::vector<int>{};
+  auto values = std::vector<double>{};
+
+  // Query the capacities with an empty target, allocate and generate. Returns
+  // the result viewed as an `Eigen::Map`.
+  auto generate = [&](auto generator, Eigen::Index rows, Eigen::Index cols) {
+    const auto capacity = generator(Target_t {});
+    CHECK(!capacity.complete);
+    outerIndex.assign(capacity.outerIndexSize, -1);
+    innerIndex.assign(capacity.nonZeros, -1);
+    values.assign(capacity.nonZeros, 0.0);
+    const auto result = generator(Target_t {outerIndex, innerIndex, values});
+    CHECK(result.complete);
+    CHECK(result.nonZeros == capacity.nonZeros);
+    return matrixgen::as_map(Target_t {outerIndex, innerIndex, values}, rows, cols);
+  };
+
+  SUBCASE("adjmat") {
+    const auto grid = std::array {4, 3, 2};
+    const auto target = matrixgen::adjmat<Matrix_t>(grid,
+        matrixgen::stencil7p<matrixgen::BC::PERIODIC>(), matrixgen::sinusoid_mul_bias(1.0, 2.0, 3.0));
+    const auto subject = generate([&](const Target_t& t) {
+      return matrixgen::adjmat(t, grid,
+          matrixgen::stencil7p<matrixgen::BC::PERIODIC>(), matrixgen::sinusoid_mul_bias(1.0, 2.0, 3.0));
+    }, 24, 24);
+
+    REQUIRE(Eigen::MatrixXd(subject) == Eigen::MatrixXd(target));
+  }
+
+  SUBCASE("adjmat with mutable weight function") {
+    const auto grid = std::array {3, 3, 3};
+    const auto target = matrixgen::adjmat<Matrix_t>(grid, matrixgen::stencil7p(), matrixgen::randweight(5));
+    const auto subject = generate([&](const Target_t& t) {
+      return matrixgen::adjmat(t, grid, matrixgen::stencil7p(), matrixgen::randweight(5));
+    }, 27, 27);
+
+    REQUIRE(Eigen::MatrixXd(subject) == Eigen::MatrixXd(target));
+  }
+
+  const auto matrices = std::vector {
+    matrixgen::create<Matrix_t>(3, 4,
+      {1, 0, 0, 1,
+       1, 0, 1, 0,
+       1, 1, 0, 0}),
+    matrixgen::create<Matrix_t>(3, 4,
+      {0, 0, 2, 2,
+       2, 0, 0, 2,
+       0, 2, 0, 0})
+  };
+
+  SUBCASE("assemble") {
+    const auto indices = std::vector {1, 0, 1};
+    const auto target = matrixgen::assemble(matrices.begin(), matrices.end(), indices.begin(), indices.end());
+    const auto subject = generate([&](const Target_t& t) {
+      return matrixgen::assemble(t, matrices.begin(), matrices.end(), indices.begin(), indices.end());
+    }, 3, 4);
+
+    REQUIRE(Eigen::MatrixXd(subject) == Eigen::MatrixXd(target));
+  }
+
+  SUBCASE("interleave") {
+    const auto proportions = std::vector {1.0, 2.0};
+    const auto target = matrixgen::interleave(matrices.begin(), matrices.end(),
+        proportions.begin(), proportions.end(), 1, 3);
+    const auto subject = generate([&](const Target_t& t) {
+      return matrixgen::interleave(t, matrices.begin(), matrices.end(),
+          proportions.begin(), proportions.end(), 1, 3);
+    }, 3, 4);
+
+    REQUIRE(Eigen::MatrixXd(subject) == Eigen::MatrixXd(target));
+  }
+
+  SUBCASE("perturb") {
+    const auto rows = std::vector {0, 2};
+    const auto target = matrixgen::perturb(matrices.front(), rows.begin(), rows.end(), 9);
+    const auto subject = generate([&](const Target_t& t) {
+      return matrixgen::perturb(t, matrices.front(), rows.begin(), rows.end(), 9);
+    }, 3, 4);
+
+    REQUIRE(Eigen::MatrixXd(subject) == Eigen::MatrixXd(target));
+  }
+
+  SUBCASE("perturb_rowlengths") {
+    const auto matrix = matrixgen::adjmat<Matrix_t>({5, 5, 1}, matrixgen::stencil7p(), matrixgen::constweight());
+    const auto target = matrixgen::perturb_rowlengths(matrix, matrixgen::bimodal_rowlengths(2, 9, 0.3), 4);
+    const auto subject = generate([&](const Target_t& t) {
+      return matrixgen::perturb_rowlengths(t, matrix, matrixgen::bimodal_rowlengths(2, 9, 0.3), 4);
+    }, 25, 25);
+
+    REQUIRE(Eigen::MatrixXd(subject) == Eigen::MatrixXd(target));
+  }
+}
+
+TEST_CASE_TEMPLATE("binary", Matrix_t,
+  Eigen::SparseMatrix<double, Eigen::RowMajor>,
+  Eigen::SparseMatrix<float, Eigen::ColMajor, int64_t>
+    ) {
+
+  using Scalar_t = typename Matrix_t::Scalar;
+  using Index_t = typename Matrix_t::StorageIndex;
+  constexpr int ALIGNMENT = Matrix_t::IsRowMajor ? Eigen::RowMajor : Eigen::ColMajor;
+
+  const auto path = (std::filesystem::temp_directory_path() / "matrixgen-unittest.bin").string();
+  const auto matrix = matrixgen::adjmat<Matrix_t>({5, 4, 3}, matrixgen::stencil7p(), matrixgen::randweight(3));
+
+  SUBCASE("Round trip through a memory mapping") {
+    matrixgen::write_binary(path, matrix);
+    const auto mapped = matrixgen::map_binary<Scalar_t, ALIGNMENT, Index_t>(path);
+
+    REQUIRE(mapped.header().nonZeros == matrix.nonZeros());
+    REQUIRE(reinterpret_cast<std::uintptr_t>(mapped.map().valuePtr()) % matrixgen::BINARY_ALIGNMENT == 0);
+    REQUIRE(Eigen::MatrixXd(Matrix_t(mapped.map()).template cast<double>()) ==
+            Eigen::MatrixXd(matrix.template cast<double>()));
+  }
+
+  SUBCASE("Mismatching types are rejected") {
+    matrixgen::write_binary(path, matrix);
+    constexpr int OTHER_ALIGNMENT = Matrix_t::IsRowMajor ? Eigen::ColMajor : Eigen::RowMajor;
+    auto map_as_int16 = [&]() { return matrixgen::map_binary<Scalar_t, ALIGNMENT, int16_t>(path); };
+    auto map_transposed = [&]() { return matrixgen::map_binary<Scalar_t, OTHER_ALIGNMENT, Index_t>(path); };
+    CHECK_THROWS(map_as_int16());
+    CHECK_THROWS(map_transposed());
+  }
+
+  std::filesystem::remove(path);
+}
+
+TEST_CASE("matrix market") {
+
+  using Matrix_t = Eigen::SparseMatrix<double, Eigen::RowMajor>;
+  const auto path = (std::filesystem::temp_directory_path() / "matrixgen-unittest.mtx").string();
+
+  SUBCASE("Round trip preserves values exactly") {
+    const auto matrix = matrixgen::adjmat<Matrix_t>({6, 5, 4}, matrixgen::stencil7p(), matrixgen::randweight(8));
+    matrixgen::write_matrix_market(path, matrix);
+
+    const auto rowMajor = matrixgen::read_matrix_market<Matrix_t>(path);
+    const auto colMajor = matrixgen::read_matrix_market<Eigen::SparseMatrix<double, Eigen::ColMajor, int64_t>>(path);
+
+    REQUIRE(Eigen::MatrixXd(rowMajor) == Eigen::MatrixXd(matrix));
+    REQUIRE(Eigen::MatrixXd(colMajor) == Eigen::MatrixXd(matrix));
+  }
+
+  SUBCASE("Row blocks are written at their offsets") {
+    const auto top = matrixgen::create<Matrix_t>(1, 3, {1, 0, 2});
+    const auto bottom = matrixgen::create<Matrix_t>(2, 3,
+        {0, 3, 0,
+         4, 0, 5});
+    {
+      auto writer = matrixgen::MatrixMarketWriter<double>(path, 3, 3);
+      writer.write(bottom, 1);
+      writer.write(top, 0);
+      REQUIRE(writer.nonZeros() == 5);
+    }
+    const auto target = matrixgen::create<DenseRowMajMat_t>(3, 3,
+        {1, 0, 2,
+         0, 3, 0,
+         4, 0, 5});
+
+    REQUIRE(DenseRowMajMat_t(matrixgen::read_matrix_market<Matrix_t>(path)) == target);
+  }
+
+  SUBCASE("Symmetric files are expanded") {
+    {
+      auto file = std::ofstream(path);
+      file << "%%MatrixMarket matrix coordinate real symmetric\n"
+           << "% comment\n"
+           << "3 3 4\n"
+           << "1 1 2.5\n"
+           << "2 1 -1\n"
+           << "\n"
+           << "3 2 4e-1\n"
+           << "3 3 1\n";
+    }
+    const auto target = matrixgen::create<DenseRowMajMat_t>(3, 3,
+        { 2.5, -1.0, 0.0,
+         -1.0,  0.0, 0.4,
+          0.0,  0.4, 1.0});
+
+    REQUIRE(DenseRowMajMat_t(matrixgen::read_matrix_market<Matrix_t>(path)) == target);
+  }
+
+  SUBCASE("Entry count mismatch is rejected") {
+    {
+      auto file = std::ofstream(path);
+      file << "%%MatrixMarket matrix coordinate pattern general\n"
+           << "2 2 3\n"
+           << "1 1\n"
+           << "2 2\n";
+    }
+    CHECK_THROWS(matrixgen::read_matrix_market<Matrix_t>(path));
+  }
+
+  std::filesystem::remove(path);
+}
+
+TEST_CASE("cache") {
+
+  using Matrix_t = Eigen::SparseMatrix<double, Eigen::RowMajor>;
+  const auto directory = std::filesystem::temp_directory_path() / "matrixgen-unittest-cache";
+  std::filesystem::remove_all(directory);
+
+  SUBCASE("Fingerprints distinguish structure and values") {
+    auto matrix = matrixgen::adjmat<Matrix_t>({4, 3, 2}, matrixgen::stencil7p(), matrixgen::constweight(1.0));
+    const auto fp = matrixgen::fingerprint(matrix);
+    REQUIRE(matrixgen::fingerprint(Matrix_t(matrix)) == fp);
+
+    matrix.valuePtr()[3] = 2.0;
+    const auto changedValue = matrixgen::fingerprint(matrix);
+    CHECK(changedValue.structure == fp.structure);
+    CHECK(changedValue.values != fp.values);
+
+    const auto other = matrixgen::adjmat<Matrix_t>({3, 4, 2}, matrixgen::stencil7p(), matrixgen::constweight(1.0));
+    CHECK(matrixgen::fingerprint(other).structure != fp.structure);
+  }
+
+  SUBCASE("Hits are served without regeneration") {
+    auto cache = matrixgen::GenerationCache(directory, true);
+    auto calls = 0;
+    auto generate = [&]() {
+      ++calls;
+      return matrixgen::adjmat<Matrix_t>({5, 4, 3}, matrixgen::stencil7p(), matrixgen::randweight(3));
+    };
+    auto key = matrixgen::CacheKey("unittest");
+    key.add(std::array<int, 3> {5, 4, 3}).add(3).add_matrix_type<Matrix_t>();
+
+    const auto first = cache.get_or_generate<Matrix_t>(key, generate);
+    const auto second = cache.get_or_generate<Matrix_t>(key, generate);
+    REQUIRE(calls == 1);
+    REQUIRE(Eigen::MatrixXd(Matrix_t(second.map())) == Eigen::MatrixXd(generate()));
+
+    // Corrupted entries fail verification and are regenerated.
+    {
+      auto file = std::fstream(cache.path_of(key), std::ios::in | std::ios::out | std::ios::binary);
+      file.seekp(static_cast<std::streamoff>(second.header().valueOffset));
+      file.write("garbage!", 8);
+    }
+    calls = 0;
+    const auto third = cache.get_or_generate<Matrix_t>(key, generate);
+    REQUIRE(calls == 1);
+    REQUIRE(matrixgen::fingerprint(third.map()) == matrixgen::fingerprint(generate()));
+  }
+
+  SUBCASE("Keys depend on all parameters") {
+    auto cache = matrixgen::GenerationCache(directory);
+    const auto matrix = matrixgen::cached_structured_grid_sinusoidal(cache, {4, 4, 4}, 1.0, 2.0, 3.0);
+    const auto target = matrixgen::structured_grid_sinusoidal({4, 4, 4}, matrixgen::stencil7p(), 1.0, 2.0, 3.0);
+    REQUIRE(Eigen::MatrixXd(Matrix_t(matrix.map())) == Eigen::MatrixXd(target));
+
+    const auto periodic = matrixgen::cached_structured_grid_sinusoidal<matrixgen::BC::PERIODIC>(cache, {4, 4, 4}, 1.0, 2.0, 3.0);
+    CHECK(periodic.header().nonZeros != matrix.header().nonZeros);
+
+    auto key = [](int seed) { return matrixgen::CacheKey("unittest").add(seed).hex(); };
+    CHECK(key(1) == key(1));
+    CHECK(key(1) != key(2));
+    CHECK(matrixgen::CacheKey("unittest", 1).hex() != matrixgen::CacheKey("unittest", 2).hex());
+  }
+
+  SUBCASE("Uncompressed sources are identified by their compressed form") {
+    auto cache = matrixgen::GenerationCache(directory / "perturb");
+    auto source = matrixgen::adjmat<Matrix_t>({4, 3, 2}, matrixgen::stencil7p(), matrixgen::constweight(1.0));
+    const auto rows = std::vector<int> {0, 5, 7};
+    const auto perturbed = matrixgen::cached_perturb(cache, source, rows.begin(), rows.end(), 3);
+    source.uncompress();
+    const auto uncompressed = matrixgen::cached_perturb(cache, source, rows.begin(), rows.end(), 3);
+    CHECK(matrixgen::fingerprint(uncompressed.map()) == matrixgen::fingerprint(perturbed.map()));
+    CHECK(std::distance(std::filesystem::directory_iterator(directory / "perturb"), std::filesystem::directory_iterator()) == 2);
+  }
+
+  std::filesystem::remove_all(directory);
+}
+
+TEST_CASE("generation stats") {
+
+  using Matrix_t = Eigen::SparseMatrix<double, Eigen::RowMajor>;
+  const auto grid = std::array {4, 3, 2};
+  const auto numOfNodes = 24u;
+  const auto periodic = matrixgen::stencil7p<matrixgen::BC::PERIODIC, matrixgen::BC::PERIODIC, matrixgen::BC::PERIODIC>();
+
+  SUBCASE("adjmat counts calls and merged duplicates") {
+    auto stats = matrixgen::GenerationStats {};
+    // Periodic boundaries of extent 2 map both z-neighbors onto the same node.
+    const auto matrix = matrixgen::adjmat<Matrix_t>(grid,
+        periodic, matrixgen::constweight(1.0), stats);
+
+    CHECK(stats.adjfn_calls() == numOfNodes);
+    CHECK(stats.weightfn_calls() == 7 * numOfNodes);
+    CHECK(stats.duplicates_merged() == 7 * numOfNodes - static_cast<uint64_t>(matrix.nonZeros()));
+    CHECK(stats.duplicates_merged() > 0);
+    CHECK(stats.allocations() > 0);
+
+    auto names = std::vector<std::string> {};
+    for(const auto& phase : stats.phases()) {
+      names.push_back(phase.name);
+    }
+    const auto expectedNames = std::vector<std::string> {"adjmat.triplets", "adjmat.setFromTriplets"};
+    CHECK(names == expectedNames);
+  }
+
+  SUBCASE("CSR targets report the same counts") {
+    auto owning = matrixgen::GenerationStats {};
+    matrixgen::adjmat<Matrix_t>(grid,
+        periodic, matrixgen::constweight(1.0), owning);
+
+    auto stats = matrixgen::GenerationStats {};
+    auto outerIndex = std::vector<int>(numOfNodes + 1);
+    auto innerIndex = std::vector<int>(7 * numOfNodes);
+    auto values = std::vector<double>(7 * numOfNodes);
+    const auto capacity = matrixgen::adjmat(matrixgen::CsrTarget<double, int> {outerIndex, innerIndex, values},
+        grid, periodic, matrixgen::constweight(1.0), stats);
+
+    REQUIRE(capacity.complete);
+    CHECK(stats.weightfn_calls() == owning.weightfn_calls());
+    CHECK(stats.duplicates_merged() == owning.duplicates_merged());
+    CHECK(stats.adjfn_calls() == 2 * numOfNodes); // counted and filled
+    const auto work = stats.thread_work();
+    CHECK(std::accumulate(work.begin(), work.end(), Eigen::Index {0}) == capacity.nonZeros);
+    CHECK(stats.load_imbalance() >= 1.0);
+  }
+
+  SUBCASE("Patterns count every weight function call") {
+    const auto pattern = matrixgen::adjmat<Matrix_t>(grid, periodic, matrixgen::constweight(1.0));
+    auto stats = matrixgen::GenerationStats {};
+    matrixgen::adjmat_with_pattern(pattern, grid, periodic, matrixgen::constweight(2.0), stats);
+
+    CHECK(stats.adjfn_calls() == numOfNodes);
+    CHECK(stats.weightfn_calls() == 7 * numOfNodes);
+    CHECK(stats.duplicates_merged() == 7 * numOfNodes - static_cast<uint64_t>(pattern.nonZeros()));
+  }
+
+  SUBCASE("Sinks accumulate until reset") {
+    auto stats = matrixgen::GenerationStats {};
+    const auto matrices = std::vector {
+      matrixgen::adjmat<Matrix_t>(grid, matrixgen::stencil7p(), matrixgen::constweight(1.0), stats),
+      matrixgen::adjmat<Matrix_t>(grid, matrixgen::stencil7p(), matrixgen::constweight(2.0), stats)};
+    CHECK(stats.adjfn_calls() == 2 * numOfNodes);
+
+    stats.reset();
+    const auto proportions = std::vector {1.0, 1.0};
+    matrixgen::interleave(matrices.begin(), matrices.end(), proportions.begin(), proportions.end(), 0, 42, stats);
+    CHECK(stats.adjfn_calls() == 0);
+    CHECK(stats.phases().front().name == "interleave.indices");
+  }
+
+  SUBCASE("perturb reports its phases into CSR targets") {
+    const auto matrix = matrixgen::adjmat<Matrix_t>(grid, matrixgen::stencil7p(), matrixgen::constweight(1.0));
+    const auto rows = std::vector {0, 5, 9};
+    auto outerIndex = std::vector<int>(numOfNodes + 1);
+    auto innerIndex = std::vector<int>(matrix.nonZeros());
+    auto values = std::vector<double>(matrix.nonZeros());
+    auto stats = matrixgen::GenerationStats {};
+    const auto capacity = matrixgen::perturb(matrixgen::CsrTarget<double, int> {outerIndex, innerIndex, values},
+        matrix, rows.begin(), rows.end(), 3, stats);
+
+    REQUIRE(capacity.complete);
+    auto names = std::vector<std::string> {};
+    for(const auto& phase : stats.phases()) {
+      names.push_back(phase.name);
+    }
+    const auto expectedNames = std::vector<std::string> {"perturb.copy", "perturb.randomize"};
+    CHECK(names == expectedNames);
+    CHECK(stats.allocations() > 0);
+  }
+}
+
+TEST_CASE("memory resources") {
+
+  using Matrix_t = Eigen::SparseMatrix<double, Eigen::RowMajor>;
+  const auto grid = std::array {6, 5, 4};
+  const auto reference = matrixgen::adjmat<Matrix_t>(grid, matrixgen::stencil7p(), matrixgen::constweight(1.0));
+
+  SUBCASE("Counting resources report the high-water mark") {
+    auto counter = matrixgen::CountingResource {};
+    const auto matrix = matrixgen::adjmat<Matrix_t>(grid,
+        matrixgen::stencil7p(), matrixgen::constweight(1.0), matrixgen::NoStats {}, &counter);
+
+    CHECK(matrix.isApprox(reference));
+    CHECK(counter.allocations() > 0);
+    CHECK(counter.bytes_in_use() == 0);
+    CHECK(counter.peak_bytes() >= reference.nonZeros() * sizeof(Eigen::Triplet<double>));
+
+    counter.reset_peak();
+    auto values = std::vector<double>(100, 0.5);
+    matrixgen::closed_loop_moving_mean(values.begin(), values.end(), values.begin(), 0.0, 1.0, 3, &counter);
+    CHECK(counter.allocations() == 5);
+    CHECK(counter.peak_bytes() >= 100 * (sizeof(double) + 3 * sizeof(std::complex<double>)));
+  }
+
+  SUBCASE("Row lists allocate from the given resource") {
+    auto counter = matrixgen::CountingResource {};
+    const auto perturbed = matrixgen::perturb(reference, {1, 7, 20}, 5, matrixgen::NoStats {}, &counter);
+    const auto rows = std::vector {1, 7, 20};
+    CHECK(perturbed.isApprox(matrixgen::perturb(reference, rows.begin(), rows.end(), 5)));
+    CHECK(counter.allocations() > 0);
+    CHECK(counter.bytes_in_use() == 0);
+  }
+
+  SUBCASE("interleave draws its indices from the given resource") {
+    const auto matrices = std::vector {reference, Matrix_t(2 * reference)};
+    const auto proportions = std::vector {1.0, 3.0};
+    const auto expected = matrixgen::interleave(matrices.begin(), matrices.end(), proportions.begin(), proportions.end(), 2, 7);
+
+    auto counter = matrixgen::CountingResource {};
+    const auto matrix = matrixgen::interleave(matrices.begin(), matrices.end(),
+        proportions.begin(), proportions.end(), 2, 7, matrixgen::NoStats {}, &counter);
+    CHECK(matrix.isApprox(expected));
+    CHECK(counter.peak_bytes() >= reference.outerSize() * (sizeof(double) + sizeof(std::size_t)));
+    CHECK(counter.bytes_in_use() == 0);
+
+    counter.reset_peak();
+    const auto allocations = counter.allocations();
+    auto outerIndex = std::vector<int>(reference.outerSize() + 1);
+    auto innerIndex = std::vector<int>(reference.nonZeros());
+    auto values = std::vector<double>(reference.nonZeros());
+    matrixgen::interleave(matrixgen::CsrTarget<double, int> {outerIndex, innerIndex, values}, matrices.begin(), matrices.end(),
+        proportions.begin(), proportions.end(), 2, 7, matrixgen::NoStats {}, &counter);
+    CHECK(counter.allocations() > allocations);
+    CHECK(values == std::vector<double>(expected.valuePtr(), expected.valuePtr() + expected.nonZeros()));
+  }
+
+  SUBCASE("Warm arenas do not allocate") {
+    auto counter = matrixgen::CountingResource {};
+    auto arena = matrixgen::ScratchArena(0, &counter);
+    const auto rows = std::vector {1, 7, 20};
+
+    const auto first = matrixgen::perturb(reference, rows.begin(), rows.end(), 5, matrixgen::NoStats {}, &arena);
+    matrixgen::adjmat<Matrix_t>(grid, matrixgen::stencil7p(), matrixgen::constweight(1.0), matrixgen::NoStats {}, &arena);
+    arena.rewind();
+    CHECK(arena.capacity() == arena.peak_bytes());
+
+    counter.reset_peak();
+    const auto second = matrixgen::perturb(reference, rows.begin(), rows.end(), 5, matrixgen::NoStats {}, &arena);
+    const auto matrix = matrixgen::adjmat<Matrix_t>(grid,
+        matrixgen::stencil7p(), matrixgen::constweight(1.0), matrixgen::NoStats {}, &arena);
+    arena.rewind();
+
+    CHECK(counter.allocations() == 0);
+    CHECK(second.isApprox(first));
+    CHECK(matrix.isApprox(reference));
+  }
+}
+
+TEST_CASE("batch") {
+
+  using Matrix_t = Eigen::SparseMatrix<double, Eigen::RowMajor>;
+  const auto grid = std::array {5, 4, 3};
+
+  SUBCASE("adjmat_with_pattern equals adjmat") {
+    const auto pattern = matrixgen::adjmat<Matrix_t>(grid, matrixgen::stencil7p<matrixgen::BC::PERIODIC>(), matrixgen::constweight(1.0));
+    const auto weightfn = matrixgen::sinusoid_mul_bias(1.0, 2.0, 3.0);
+    const auto matrix = matrixgen::adjmat_with_pattern(pattern, grid, matrixgen::stencil7p<matrixgen::BC::PERIODIC>(), weightfn);
+    CHECK(matrix.isApprox(matrixgen::adjmat<Matrix_t>(grid, matrixgen::stencil7p<matrixgen::BC::PERIODIC>(), weightfn)));
+  }
+
+  SUBCASE("Specs share their inputs and deliver every result once") {
+    auto batch = matrixgen::Batch<Matrix_t> {};
+    auto sourceCalls = std::atomic<int> {0};
+    const auto a = batch.add([&]() {
+      ++sourceCalls;
+      return matrixgen::adjmat<Matrix_t>(grid, matrixgen::stencil7p(), matrixgen::constweight(1.0));
+    }, false);
+    const auto b = batch.add([&]() {
+      ++sourceCalls;
+      return matrixgen::adjmat<Matrix_t>(grid, matrixgen::stencil7p(), matrixgen::constweight(2.0));
+    });
+    const auto proportions = std::vector {1.0, 2.0};
+    for(auto seed = 0; seed < 8; ++seed) {
+      batch.add({a, b}, [&proportions, seed](const auto& inputs) {
+        return matrixgen::interleave(inputs.begin(), inputs.end(), proportions.begin(), proportions.end(), 1, seed);
+      });
+    }
+
+    auto delivered = std::vector<matrixgen::Batch<Matrix_t>::Handle> {};
+    auto results = std::map<std::size_t, Matrix_t> {};
+    batch.run([&](auto handle, const Matrix_t& matrix) {
+      delivered.push_back(handle);
+      results[handle] = matrix;
+    });
+
+    CHECK(sourceCalls == 2);
+    CHECK(delivered.size() == batch.size() - 1); // 'a' is not delivered
+    CHECK(results.count(a) == 0);
+    const auto sources = std::vector {
+      matrixgen::adjmat<Matrix_t>(grid, matrixgen::stencil7p(), matrixgen::constweight(1.0)),
+      matrixgen::adjmat<Matrix_t>(grid, matrixgen::stencil7p(), matrixgen::constweight(2.0))};
+    CHECK(results[b].isApprox(sources[1]));
+    const auto expected = matrixgen::interleave(sources.begin(), sources.end(), proportions.begin(), proportions.end(), 1, 5);
+    CHECK(results[b + 6].isApprox(expected));
+  }
+
+  SUBCASE("Exceptions are rethrown by run") {
+    auto batch = matrixgen::Batch<Matrix_t> {};
+    batch.add([]() -> Matrix_t { throw std::runtime_error("failed spec"); });
+    CHECK_THROWS_AS(batch.run([](auto, const Matrix_t&) {}), std::runtime_error);
+  }
+
+  SUBCASE("structured_grid_sinusoidal sweeps share their pattern") {
+    const auto frequencies = std::vector<std::array<double, 3>> {{1.0, 2.0, 3.0}, {0.5, 0.5, 0.5}, {4.0, 1.0, 2.0}};
+    auto results = std::vector<Matrix_t>(frequencies.size());
+    matrixgen::structured_grid_sinusoidal_sweep(grid, matrixgen::stencil7p(), frequencies,
+        [&](std::size_t index, const Matrix_t& matrix) { results[index] = matrix; });
+    for(std::size_t ii = 0; ii < frequencies.size(); ++ii) {
+      const auto [nx, ny, nz] = frequencies[ii];
+      CHECK(results[ii].isApprox(matrixgen::structured_grid_sinusoidal(grid, matrixgen::stencil7p(), nx, ny, nz)));
+    }
+  }
+}
+
+TEST_CASE("row block producer") {
+
+  using Matrix_t = Eigen::SparseMatrix<double, Eigen::RowMajor>;
+  const auto grid = std::array {6, 5, 4};
+  const auto options = matrixgen::RowBlockOptions {7, 2};
+
+  // Stacks the produced blocks into a single matrix.
+  auto collect = [](auto& producer) -> Matrix_t {
+    auto triplets = std::vector<Eigen::Triplet<double>> {};
+    auto nextRow = Eigen::Index {0};
+    while(const auto block = producer.next()) {
+      CHECK(block->rowOffset == nextRow);
+      nextRow += block->rows;
+      const auto map = block->map();
+      for(Eigen::Index row = 0; row < map.outerSize(); ++row) {
+        for(typename decltype(map)::InnerIterator it(map, row); it; ++it) {
+          triplets.emplace_back(block->rowOffset + row, it.col(), it.value());
+        }
+      }
+    }
+    CHECK(nextRow == producer.rows());
+    auto result = Matrix_t(producer.rows(), producer.cols());
+    result.setFromTriplets(triplets.begin(), triplets.end());
+    return result;
+  };
+
+  SUBCASE("adjmat blocks are written to Matrix Market files") {
+    const auto path = (std::filesystem::temp_directory_path() / "matrixgen-unittest-blocks.mtx").string();
+    auto producer = matrixgen::adjmat_blocks(grid, matrixgen::stencil7p(), matrixgen::randweight(3), options);
+    {
+      auto writer = matrixgen::MatrixMarketWriter<double>(path, producer.rows(), producer.cols());
+      while(const auto block = producer.next()) {
+        writer.write(block->map(), block->rowOffset);
+      }
+    }
+    const auto matrix = matrixgen::adjmat<Matrix_t>(grid, matrixgen::stencil7p(), matrixgen::randweight(3));
+    CHECK(Eigen::MatrixXd(matrixgen::read_matrix_market<Matrix_t>(path)) == Eigen::MatrixXd(matrix));
+    CHECK(!producer.next());
+    std::filesystem::remove(path);
+  }
+
+  SUBCASE("assemble and interleave blocks match the owning overloads") {
+    const auto matrices = std::vector {
+      matrixgen::adjmat<Matrix_t>(grid, matrixgen::stencil7p(), matrixgen::constweight(1.0)),
+      matrixgen::adjmat<Matrix_t>(grid, matrixgen::stencil7p<matrixgen::BC::PERIODIC>(), matrixgen::constweight(2.0))};
+    auto indices = std::vector<int>(matrices.front().rows());
+    for(std::size_t ii = 0; ii < indices.size(); ++ii) {
+      indices[ii] = static_cast<int>(ii % 3 == 0);
+    }
+    auto assembled = matrixgen::assemble_blocks(matrices.begin(), matrices.end(), indices.begin(), indices.end(), options);
+    CHECK(collect(assembled).isApprox(matrixgen::assemble(matrices.begin(), matrices.end(), indices.begin(), indices.end())));
+
+    const auto proportions = std::vector {1.0, 2.0};
+    auto interleaved = matrixgen::interleave_blocks(matrices.begin(), matrices.end(),
+        proportions.begin(), proportions.end(), 2, 11, options);
+    CHECK(collect(interleaved).isApprox(matrixgen::interleave(matrices.begin(), matrices.end(),
+        proportions.begin(), proportions.end(), 2, 11)));
+  }
+
+  SUBCASE("Producers can be abandoned and report errors") {
+    {
+      auto producer = matrixgen::adjmat_blocks(grid, matrixgen::stencil7p(), matrixgen::constweight(1.0), options);
+      CHECK(producer.next().has_value());
+    } // cancels the remaining blocks
+
+    auto failing = matrixgen::RowBlockProducer<double, int>(100, 100,
+        [](Eigen::Index row) -> int {
+          if(row == 50) {
+            throw std::runtime_error("failed row");
+          }
+          return 1;
+        },
+        [](Eigen::Index row, int* inner, double* value, int) { *inner = static_cast<int>(row); *value = 1.0; },
+        options);
+    auto drain = [&failing]() { while(failing.next()) {} };
+    CHECK_THROWS_AS(drain(), std::runtime_error);
+  }
+}
+
+TEST_CASE("execution context") {
+
+  using Matrix_t = Eigen::SparseMatrix<double, Eigen::RowMajor>;
+  const auto grid = std::array {8, 7, 6};
+  const auto reference = matrixgen::adjmat<Matrix_t>(grid, matrixgen::stencil7p(), matrixgen::constweight(1.0));
+  auto arena = tbb::task_arena(2);
+
+  const auto contexts = std::vector {
+    matrixgen::ExecutionContext::sequential(),
+    matrixgen::ExecutionContext::threads(3),
+    matrixgen::ExecutionContext::arena(arena).with_grain_size(16)};
+
+  SUBCASE("Generators compute the same results under every context") {
+    const auto matrices = std::vector<Matrix_t> {reference, 2.0 * reference};
+    const auto proportions = std::vector {1.0, 2.0};
+    const auto rows = std::vector {0, 5, 17};
+    const auto interleaved = matrixgen::interleave(
+        matrices.begin(), matrices.end(), proportions.begin(), proportions.end(), 2, 3);
+    const auto perturbed = matrixgen::perturb(reference, rows.begin(), rows.end(), 4);
+
+    for(const auto& context : contexts) {
+      CHECK(matrixgen::adjmat<Matrix_t>(context, grid, matrixgen::stencil7p(), matrixgen::constweight(1.0)).isApprox(reference));
+      CHECK(matrixgen::interleave(
+          context, matrices.begin(), matrices.end(), proportions.begin(), proportions.end(), 2, 3).isApprox(interleaved));
+      CHECK(matrixgen::perturb(context, reference, rows.begin(), rows.end(), 4).isApprox(perturbed));
+
+      auto input = std::vector<int>(100);
+      std::iota(input.begin(), input.end(), 0);
+      auto sums = std::vector<int>(input.size());
+      auto expected = std::vector<int>(input.size());
+      matrixgen::central_moving_sum(input.begin(), input.end(), expected.begin(), 3);
+      matrixgen::central_moving_sum(context, input.begin(), input.end(), sums.begin(), 3);
+      CHECK(sums == expected);
+    }
+  }
+
+  SUBCASE("Sequential contexts run on the calling thread") {
+    const auto numOfNodes = grid[0] * grid[1] * grid[2];
+    auto outerIndex = std::vector<int>(numOfNodes + 1);
+    auto innerIndex = std::vector<int>(7 * numOfNodes);
+    auto values = std::vector<double>(7 * numOfNodes);
+    auto stats = matrixgen::GenerationStats {};
+    const auto capacity = matrixgen::adjmat(matrixgen::ExecutionContext::sequential(),
+        matrixgen::CsrTarget<double, int> {outerIndex, innerIndex, values},
+        grid, matrixgen::stencil7p(), matrixgen::constweight(1.0), stats);
+
+    REQUIRE(capacity.complete);
+    CHECK(stats.thread_work().size() == 1);
+    CHECK(capacity.nonZeros == reference.nonZeros());
+
+    auto owningStats = matrixgen::GenerationStats {};
+    const auto owning = matrixgen::adjmat<Matrix_t>(matrixgen::ExecutionContext::sequential(),
+        grid, matrixgen::stencil7p(), matrixgen::constweight(1.0), owningStats);
+    CHECK(owning.isApprox(reference));
+    CHECK(owningStats.thread_work().size() == 1);
+    CHECK(owningStats.phases().front().name == "rows.count");
+
+    const auto matrices = std::vector<Matrix_t> {reference, 2.0 * reference};
+    const auto indices = std::vector<std::size_t>(reference.rows(), 1);
+    auto assembleStats = matrixgen::GenerationStats {};
+    const auto assembled = matrixgen::assemble(matrixgen::ExecutionContext::sequential(),
+        matrices.begin(), matrices.end(), indices.begin(), indices.end(), assembleStats);
+    CHECK(assembled.isApprox(matrices[1]));
+    CHECK(assembleStats.thread_work().size() == 1);
+  }
+
+  SUBCASE("Owning overloads match the sequential construction") {
+    using ColMajor_t = Eigen::SparseMatrix<double, Eigen::ColMajor>;
+    const auto randomReference = matrixgen::adjmat<Matrix_t>(grid, matrixgen::stencil7p(), matrixgen::randweight(5));
+    for(const auto& context : contexts) {
+      CHECK(matrixgen::adjmat<ColMajor_t>(context, grid, matrixgen::stencil7p(), matrixgen::constweight(1.0))
+              .isApprox(ColMajor_t(reference)));
+      CHECK(matrixgen::adjmat<Matrix_t>(context, grid, matrixgen::stencil7p(), matrixgen::randweight(5))
+              .isApprox(randomReference));
+    }
+  }
+
+  SUBCASE("Row block producers and writers run under the current context") {
+    auto threadIds = std::set<std::thread::id> {};
+    const auto weightfn = [&threadIds](std::array<int, 3>, std::array<int, 3>) {
+      threadIds.insert(std::this_thread::get_id());
+      return 1.0;
+    };
+    matrixgen::ExecutionContext::sequential().execute([&]() {
+      auto producer = matrixgen::adjmat_blocks(grid, matrixgen::stencil7p(), weightfn, {64, 4});
+      while(const auto block = producer.next()) {
+        CHECK(block->map().isApprox(reference.middleRows(block->rowOffset, block->rows)));
+      }
+    });
+    CHECK(threadIds.size() == 1);
+  }
+
+  SUBCASE("Thread counts limit the concurrency") {
+    const auto concurrency = matrixgen::ExecutionContext::threads(2).execute([]() {
+      return tbb::this_task_arena::max_concurrency();
+    });
+    CHECK(concurrency == 2);
+  }
+}
+
+TEST_CASE("first touch") {
+
+  using Matrix_t = Eigen::SparseMatrix<double, Eigen::RowMajor>;
+  const auto grid = std::array {9, 8, 7};
+  const auto reference = matrixgen::adjmat<Matrix_t>(grid,
+      matrixgen::stencil7p(), matrixgen::sinusoid_mul_bias(1.0, 2.0, 3.0));
+
+  SUBCASE("Partitions are balanced by nonzeros and rows") {
+    const auto partition = matrixgen::balanced_row_partition(reference, 5);
+    REQUIRE(partition.parts() == 5);
+    CHECK(partition.first(0) == 0);
+    CHECK(partition.last(4) == reference.rows());
+    const auto share = (reference.nonZeros() + reference.rows()) / 5;
+    for(auto part = 0; part < partition.parts(); ++part) {
+      const auto rows = partition.last(part) - partition.first(part);
+      const auto nnz = reference.outerIndexPtr()[partition.last(part)] - reference.outerIndexPtr()[partition.first(part)];
+      CHECK(std::abs(nnz + rows - share) <= 8);
+    }
+  }
+
+  SUBCASE("Generators fill along the partition") {
+    auto partition = matrixgen::RowPartition {};
+    const auto matrix = matrixgen::adjmat_first_touch<Matrix_t>(grid,
+        matrixgen::stencil7p(), matrixgen::sinusoid_mul_bias(1.0, 2.0, 3.0), partition, 3);
+    CHECK(matrix.isApprox(reference));
+    CHECK(matrix.isCompressed());
+    CHECK(partition.boundaries == matrixgen::balanced_row_partition(reference, 3).boundaries);
+
+    const auto matrices = std::vector {reference, reference};
+    const auto proportions = std::vector {1.0, 1.0};
+    const auto interleaved = matrixgen::interleave(
+        matrices.begin(), matrices.end(), proportions.begin(), proportions.end(), 2, 6);
+    const auto copy = matrixgen::first_touch_copy(interleaved, partition);
+    CHECK(copy.isApprox(interleaved));
+    CHECK(copy.isCompressed());
+    CHECK(partition.parts() == tbb::this_task_arena::max_concurrency());
+  }
+
+  SUBCASE("SpMV along the partition") {
+    auto partition = matrixgen::RowPartition {};
+    const auto matrix = matrixgen::adjmat_first_touch<Matrix_t>(grid,
+        matrixgen::stencil7p(), matrixgen::constweight(1.0), partition);
+    const auto x = Eigen::VectorXd::Ones(matrix.cols()).eval();
+    auto y = Eigen::VectorXd(matrix.rows());
+    matrixgen::for_each_part(partition, [&](int, Eigen::Index first, Eigen::Index last) {
+      y.segment(first, last - first) = matrix.middleRows(first, last - first) * x;
+    });
+    CHECK(y.isApprox(matrix * x));
+  }
+}
+
+/**
+ * Adjacency matrix of the stencil `offsets` with unit weights, computed by
+ * resolving every offset of every node against the boundary conditions.
+ */
+template <typename Offsets_t>
+Eigen::SparseMatrix<double, Eigen::RowMajor>
+reference_stencil_matrix(
+    const Offsets_t& offsets,
+    const std::array<int, 3>& grid,
+    const std::array<matrixgen::BC, 3>& bcs) {
+
+  const auto numOfNodes = grid[0] * grid[1] * grid[2];
+  auto triplets = std::vector<Eigen::Triplet<double>> {};
+  for(auto node = 0; node < numOfNodes; ++node) {
+    const auto coords = std::array {node % grid[0], (node / grid[0]) % grid[1], node / (grid[0] * grid[1])};
+    for(const auto& offset : offsets) {
+      auto neighbor = std::array<int, 3> {};
+      auto valid = true;
+      for(auto dim = 0; dim < 3; ++dim) {
+        const auto size = grid[dim];
+        auto coord = coords[dim] + offset[dim];
+        if(bcs[dim] == matrixgen::BC::PERIODIC) {
+          coord = ((coord % size) + size) % size;
+        }
+        while(bcs[dim] == matrixgen::BC::NEUMANN && (coord < 0 || coord >= size)) {
+          coord = size == 1 ? 0 : (coord < 0 ? -coord : 2 * (size - 1) - coord);
+        }
+        valid = valid && 0 <= coord && coord < size;
+        neighbor[dim] = coord;
+      }
+      if(valid) {
+        triplets.emplace_back(node, neighbor[0] + grid[0] * (neighbor[1] + grid[1] * neighbor[2]), 1.0);
+      }
+    }
+  }
+  auto matrix = Eigen::SparseMatrix<double, Eigen::RowMajor>(numOfNodes, numOfNodes);
+  matrix.setFromTriplets(triplets.begin(), triplets.end());
+  return matrix;
+}
+
+TEST_CASE("stencils") {
+
+  using Matrix_t = Eigen::SparseMatrix<double, Eigen::RowMajor>;
+  using matrixgen::BC;
+
+  const auto check = [](auto adjfn, const auto& offsets, std::array<BC, 3> bcs) {
+    // Grids large enough for the precomputed regions and grids too small for them.
+    for(const auto& grid : {std::array {6, 5, 4}, std::array {1, 2, 3}}) {
+      const auto matrix = matrixgen::adjmat<Matrix_t>(grid, adjfn, matrixgen::constweight(1.0));
+      CHECK(matrix.isApprox(reference_stencil_matrix(offsets, grid, bcs)));
+    }
+  };
+
+  SUBCASE("Shapes") {
+    CHECK(matrixgen::Stencil7pShape::OFFSETS.size() == 7);
+    CHECK(matrixgen::Stencil19pShape::OFFSETS.size() == 19);
+    CHECK(matrixgen::Stencil27pShape::OFFSETS.size() == 27);
+    const auto nullOffset = matrixgen::Offset_t {0, 0, 0};
+    CHECK(matrixgen::Stencil27pShape::OFFSETS.front() == nullOffset);
+
+    // Full 27p stencil on a 4^3 grid with Dirichlet boundaries: 2 + 3 + 3 + 2 neighbors per dimension.
+    const auto matrix = matrixgen::adjmat<Matrix_t>(std::array {4, 4, 4}, matrixgen::stencil27p(), matrixgen::constweight(1.0));
+    CHECK(matrix.nonZeros() == 1000);
+  }
+
+  SUBCASE("7p, 19p and 27p stencils under mixed boundary conditions") {
+    check(matrixgen::stencil7p<BC::NEUMANN, BC::PERIODIC, BC::DIRICHLET>(),
+          matrixgen::Stencil7pShape::OFFSETS, {BC::NEUMANN, BC::PERIODIC, BC::DIRICHLET});
+    check(matrixgen::stencil19p<BC::PERIODIC, BC::NEUMANN, BC::NEUMANN>(),
+          matrixgen::Stencil19pShape::OFFSETS, {BC::PERIODIC, BC::NEUMANN, BC::NEUMANN});
+    check(matrixgen::stencil27p<BC::DIRICHLET, BC::DIRICHLET, BC::PERIODIC>(),
+          matrixgen::Stencil27pShape::OFFSETS, {BC::DIRICHLET, BC::DIRICHLET, BC::PERIODIC});
+    check(matrixgen::stencil27p<BC::NEUMANN, BC::NEUMANN, BC::NEUMANN>(),
+          matrixgen::Stencil27pShape::OFFSETS, {BC::NEUMANN, BC::NEUMANN, BC::NEUMANN});
+  }
+
+  SUBCASE("Asymmetric stencils of extent 2") {
+    using Shape_t = matrixgen::StencilShape<
+      matrixgen::Offset_t {0, 0, 0}, matrixgen::Offset_t {2, 0, 0},
+      matrixgen::Offset_t {-1, 1, 0}, matrixgen::Offset_t {0, -2, -2}>;
+    check(matrixgen::stencil<Shape_t, BC::NEUMANN, BC::DIRICHLET, BC::PERIODIC>(),
+          Shape_t::OFFSETS, {BC::NEUMANN, BC::DIRICHLET, BC::PERIODIC});
+    check(matrixgen::stencil<Shape_t, BC::PERIODIC, BC::NEUMANN, BC::NEUMANN>(),
+          Shape_t::OFFSETS, {BC::PERIODIC, BC::NEUMANN, BC::NEUMANN});
+    check(matrixgen::stencil<matrixgen::Offset_t {0, 0, 0}, matrixgen::Offset_t {2, 0, 0},
+                             matrixgen::Offset_t {-1, 1, 0}, matrixgen::Offset_t {0, -2, -2}>(),
+          Shape_t::OFFSETS, {BC::DIRICHLET, BC::DIRICHLET, BC::DIRICHLET});
+  }
+}
+
+TEST_CASE("radius stencils") {
+
+  using Matrix_t = Eigen::SparseMatrix<double, Eigen::RowMajor>;
+  using matrixgen::BC;
+
+  const auto ball = [](double radius) {
+    auto offsets = std::vector<std::array<int, 3>> {};
+    for(auto zz = -4; zz <= 4; ++zz) {
+      for(auto yy = -4; yy <= 4; ++yy) {
+        for(auto xx = -4; xx <= 4; ++xx) {
+          if(xx * xx + yy * yy + zz * zz <= radius * radius) {
+            offsets.push_back({xx, yy, zz});
+          }
+        }
+      }
+    }
+    return offsets;
+  };
+
+  SUBCASE("Adjacency matches the offsets within the radius") {
+    for(const auto& grid : {std::array {9, 8, 7}, std::array {3, 2, 5}}) {
+      auto matrix = matrixgen::adjmat<Matrix_t>(grid,
+          matrixgen::stencil_radius<BC::DIRICHLET, BC::PERIODIC, BC::NEUMANN>(2.5), matrixgen::constweight(1.0));
+      CHECK(matrix.isApprox(reference_stencil_matrix(ball(2.5), grid, {BC::DIRICHLET, BC::PERIODIC, BC::NEUMANN})));
+      matrix = matrixgen::adjmat<Matrix_t>(grid, matrixgen::stencil_radius(1.0), matrixgen::constweight(1.0));
+      CHECK(matrix.isApprox(matrixgen::adjmat<Matrix_t>(grid, matrixgen::stencil7p(), matrixgen::constweight(1.0))));
+    }
+    const auto full = matrixgen::adjmat<Matrix_t>(std::array {5, 5, 5}, matrixgen::stencil_radius(1.75), matrixgen::constweight(1.0));
+    CHECK(full.isApprox(matrixgen::adjmat<Matrix_t>(std::array {5, 5, 5}, matrixgen::stencil27p(), matrixgen::constweight(1.0))));
+  }
+
+  SUBCASE("Region tables are kept per region and grid") {
+    auto adjfn = matrixgen::stencil_radius<BC::PERIODIC, BC::NEUMANN, BC::DIRICHLET>(2.0);
+    for(const auto& grid : {std::array {6, 7, 5}, std::array {9, 5, 6}, std::array {6, 7, 5}}) {
+      for(const auto& coords : {std::array {0, 0, 0}, std::array {3, 3, 2}, std::array {grid[0] - 1, 1, 4},
+                                std::array {0, 0, 0}, std::array {grid[0] - 1, 1, 4}}) {
+        const auto [first, last] = adjfn(coords, grid);
+        auto fresh = matrixgen::stencil_radius<BC::PERIODIC, BC::NEUMANN, BC::DIRICHLET>(2.0);
+        const auto [freshFirst, freshLast] = fresh(coords, grid);
+        CHECK(std::equal(first, last, freshFirst, freshLast));
+      }
+    }
+  }
+
+  SUBCASE("Kernel weights") {
+    const auto grid = std::array {10, 10, 10};
+    const auto gaussian = matrixgen::adjmat<Matrix_t>(grid,
+        matrixgen::stencil_radius<BC::PERIODIC, BC::PERIODIC, BC::PERIODIC>(3.0),
+        matrixgen::radial_weight(3.0, matrixgen::gaussian_kernel(1.5)));
+    CHECK(gaussian.nonZeros() == 123 * 1000);
+    CHECK(gaussian.coeff(0, 0) == doctest::Approx(1.0));
+    CHECK(gaussian.coeff(0, 2) == doctest::Approx(std::exp(-4.0 / 4.5)));
+    CHECK(gaussian.coeff(0, 8) == doctest::Approx(std::exp(-4.0 / 4.5)));  // (-2, 0, 0) across the boundary
+    CHECK(gaussian.coeff(0, 111) == doctest::Approx(std::exp(-3.0 / 4.5))); // (1, 1, 1)
+
+    const auto inverse = matrixgen::adjmat<Matrix_t>(grid,
+        matrixgen::stencil_radius(3.0), matrixgen::radial_weight(3.0, matrixgen::inverse_distance_kernel()));
+    CHECK(inverse.coeff(555, 555) == 0.0);
+    CHECK(inverse.coeff(555, 558) == doctest::Approx(1.0 / 3.0));
+    CHECK(inverse.coeff(555, 666) == doctest::Approx(1.0 / std::sqrt(3.0)));
+  }
+}
+
+TEST_CASE("grids of any rank") {
+
+  using Matrix_t = Eigen::SparseMatrix<double, Eigen::RowMajor>;
+  using Target_t = matrixgen::CsrTarget<double, int>;
+  using matrixgen::BC;
+
+  SUBCASE("2D stencils equal 3D stencils on flat grids") {
+    const auto star = matrixgen::adjmat<Matrix_t>(std::array {5, 4},
+        matrixgen::stencil5p<BC::NEUMANN, BC::PERIODIC>(), matrixgen::constweight(1.0));
+    const auto flatStar = matrixgen::adjmat<Matrix_t>(std::array {5, 4, 1},
+        matrixgen::stencil7p<BC::NEUMANN, BC::PERIODIC>(), matrixgen::constweight(1.0));
+    CHECK(star.isApprox(flatStar));
+
+    const auto box = matrixgen::adjmat<Matrix_t>(std::array {5, 4},
+        matrixgen::stencil9p<BC::PERIODIC, BC::NEUMANN>(), matrixgen::constweight(1.0));
+    const auto flatBox = matrixgen::adjmat<Matrix_t>(std::array {5, 4, 1},
+        matrixgen::stencil27p<BC::PERIODIC, BC::NEUMANN>(), matrixgen::constweight(1.0));
+    CHECK(box.isApprox(flatBox));
+  }
+
+  SUBCASE("Weight functions receive coordinates of the grid's rank") {
+    const auto weightfn = [](std::array<int, 2> coords, std::array<int, 2> neighborCoords) {
+      return 1.0 + coords[0] + 10.0 * neighborCoords[1];
+    };
+    const auto matrix = matrixgen::adjmat<Matrix_t>(std::array {5, 4}, matrixgen::stencil5p(), weightfn);
+    CHECK(matrix.coeff(6, 11) == 22.0);  // (1, 1) -> (1, 2)
+    CHECK(matrix.coeff(19, 18) == 35.0); // (4, 3) -> (3, 3)
+  }
+
+  SUBCASE("Geometric and entry weight functions on 2D grids") {
+    // Geometric: (coords, neighborCoords, gridDimensions), not the entry's position.
+    const auto geometric = [](std::array<int, 2> coords, std::array<int, 2> neighborCoords, std::array<int, 2> gridDimensions) {
+      return 1.0 + coords[0] + gridDimensions[0] * coords[1] + 100.0 * neighborCoords[0];
+    };
+    const auto matrix = matrixgen::adjmat<Matrix_t>(std::array {5, 4}, matrixgen::stencil5p(), geometric);
+    CHECK(matrix.coeff(6, 11) == 107.0);  // (1, 1) -> (1, 2)
+    CHECK(matrix.coeff(19, 18) == 320.0); // (4, 3) -> (3, 3)
+
+    const auto entry = [](matrixgen::MatrixEntry position, std::array<int, 2>, std::array<int, 2>) {
+      return 100.0 * position[0] + position[1];
+    };
+    const auto entries = matrixgen::adjmat<Matrix_t>(std::array {5, 4}, matrixgen::stencil5p(), entry);
+    CHECK(entries.coeff(6, 11) == 611.0);
+    CHECK(entries.coeff(19, 18) == 1918.0);
+  }
+
+  SUBCASE("1D and 4D star stencils") {
+    const auto ring = matrixgen::adjmat<Matrix_t>(std::array {6}, matrixgen::stencil3p<BC::PERIODIC>(), matrixgen::constweight(1.0));
+    CHECK(ring.nonZeros() == 18);
+    CHECK(ring.coeff(0, 5) == 1.0);
+
+    // 81 nodes, and 2 * 27 edges in either direction of each of the 4 dimensions.
+    const auto tesseract = matrixgen::adjmat<Matrix_t>(std::array {3, 3, 3, 3},
+        matrixgen::stencil<matrixgen::StarStencilShape<4>>(), matrixgen::constweight(1.0));
+    CHECK(tesseract.nonZeros() == 513);
+    CHECK(tesseract.isApprox(Matrix_t(tesseract.transpose())));
+  }
+
+  SUBCASE("Static extents equal dynamic extents") {
+    const auto dynamic = matrixgen::adjmat<Matrix_t>(std::array {8, 4},
+        matrixgen::stencil9p<BC::PERIODIC, BC::PERIODIC>(), matrixgen::constweight(1.0));
+    const auto fixed = matrixgen::adjmat<Matrix_t>(matrixgen::StaticExtents<8, 4> {},
+        matrixgen::stencil9p<BC::PERIODIC, BC::PERIODIC>(), matrixgen::constweight(1.0));
+    CHECK(fixed.isApprox(dynamic));
+
+    const auto capacity = matrixgen::adjmat(Target_t {}, matrixgen::StaticExtents<8, 4> {},
+        matrixgen::stencil9p<BC::PERIODIC, BC::PERIODIC>(), matrixgen::constweight(1.0));
+    auto outerIndex = std::vector<int>(capacity.outerIndexSize);
+    auto innerIndex = std::vector<int>(capacity.nonZeros);
+    auto values = std::vector<double>(capacity.nonZeros);
+    const auto target = Target_t {outerIndex, innerIndex, values};
+    CHECK(matrixgen::adjmat(target, matrixgen::StaticExtents<8, 4> {},
+        matrixgen::stencil9p<BC::PERIODIC, BC::PERIODIC>(), matrixgen::constweight(1.0)).complete);
+    CHECK(Eigen::MatrixXd(matrixgen::as_map(target, 32, 32)) == Eigen::MatrixXd(dynamic));
+  }
+}
+
+TEST_CASE("masked domains") {
+
+  using Matrix_t = Eigen::SparseMatrix<double, Eigen::RowMajor>;
+  using matrixgen::BC;
+
+  // A 6 x 5 grid with a hole at (2, 2), i.e. node 14.
+  const auto grid = std::array {6, 5};
+  const auto mask = [](const std::array<int, 2>& coords) { return coords[0] != 2 || coords[1] != 2; };
+
+  SUBCASE("Inactive nodes get neither rows nor columns") {
+    const auto numbering = matrixgen::compact_numbering(grid, mask);
+    CHECK(numbering.rows() == 29);
+    CHECK(numbering.rowOfNode[14] == -1);
+    CHECK(numbering.rowOfNode[15] == 14);
+    CHECK(numbering.nodeOfRow[14] == 15);
+
+    const auto full = Eigen::MatrixXd(matrixgen::adjmat<Matrix_t>(grid,
+        matrixgen::stencil5p<BC::PERIODIC, BC::NEUMANN>(), matrixgen::constweight(1.0)));
+    const auto masked = Eigen::MatrixXd(matrixgen::adjmat_masked<Matrix_t>(grid, numbering,
+        matrixgen::stencil5p<BC::PERIODIC, BC::NEUMANN>(), matrixgen::constweight(1.0)));
+    REQUIRE(masked.rows() == 29);
+    for(auto ii = 0; ii < 29; ++ii) {
+      for(auto jj = 0; jj < 29; ++jj) {
+        CHECK(masked(ii, jj) == full(numbering.nodeOfRow[ii], numbering.nodeOfRow[jj]));
+      }
+    }
+  }
+
+  SUBCASE("Masks by container equal masks by predicate") {
+    auto flags = std::vector<uint8_t>(30, 1);
+    flags[14] = 0;
+    const auto byPredicate = matrixgen::adjmat_masked<Matrix_t>(grid, mask,
+        matrixgen::stencil9p(), matrixgen::constweight(1.0));
+    const auto byContainer = matrixgen::adjmat_masked<Matrix_t>(grid, flags,
+        matrixgen::stencil9p(), matrixgen::constweight(1.0));
+    CHECK(byContainer.isApprox(byPredicate));
+    CHECK(byContainer.nonZeros() == matrixgen::adjmat<Matrix_t>(grid,
+        matrixgen::stencil9p(), matrixgen::constweight(1.0)).nonZeros() - 17);
+  }
+
+  SUBCASE("Neumann holes mirror their neighbors") {
+    const auto matrix = matrixgen::adjmat_masked<Matrix_t, BC::NEUMANN>(grid, mask,
+        matrixgen::stencil5p(), matrixgen::constweight(1.0));
+    // Rows of nodes past the hole are shifted by one.
+    CHECK(matrix.coeff(8, 2) == 2.0);   // (2, 1): (2, 2) is mirrored onto (2, 0)
+    CHECK(matrix.coeff(13, 12) == 2.0); // (1, 2): (2, 2) is mirrored onto (0, 2)
+    CHECK(matrix.coeff(14, 15) == 2.0); // (3, 2): (2, 2) is mirrored onto (4, 2)
+    CHECK(matrix.coeff(8, 8) == 1.0);
+  }
+}
+
+TEST_CASE("coefficient fields") {
+
+  using Matrix_t = Eigen::SparseMatrix<double, Eigen::RowMajor>;
+  using matrixgen::Averaging;
+
+  const auto path = (std::filesystem::temp_directory_path() / "matrixgen-unittest.raw").string();
+  const auto grid = std::array {4, 3};
+
+  // A header of 16 bytes followed by the coefficients: node + 1 for the
+  // scalar field, (node + 1, 2) for the tensor field.
+  const auto write = [&](const std::vector<float>& coefficients) {
+    auto file = std::ofstream(path, std::ios::binary | std::ios::trunc);
+    const char header[16] = {};
+    file.write(header, sizeof(header));
+    file.write(reinterpret_cast<const char*>(coefficients.data()),
+        static_cast<std::streamsize>(coefficients.size() * sizeof(float)));
+  };
+
+  SUBCASE("Scalar fields") {
+    auto coefficients = std::vector<float>(12);
+    std::iota(coefficients.begin(), coefficients.end(), 1.0f);
+    write(coefficients);
+    const auto field = matrixgen::map_coefficient_field<float>(path, grid, 16);
+
+    const auto harmonic = matrixgen::adjmat<Matrix_t>(grid, matrixgen::stencil5p(),
+        matrixgen::coefficient_weight<Averaging::HARMONIC>(field));
+    CHECK(harmonic.coeff(0, 1) == doctest::Approx(4.0 / 3.0));
+    CHECK(harmonic.coeff(5, 9) == doctest::Approx(120.0 / 16.0));
+    CHECK(harmonic.coeff(5, 5) == doctest::Approx(6.0));
+    const auto geometric = matrixgen::adjmat<Matrix_t>(grid, matrixgen::stencil5p(),
+        matrixgen::coefficient_weight<Averaging::GEOMETRIC>(field));
+    CHECK(geometric.coeff(5, 6) == doctest::Approx(std::sqrt(42.0)));
+    const auto arithmetic = matrixgen::adjmat<Matrix_t>(grid, matrixgen::stencil5p(),
+        matrixgen::coefficient_weight<Averaging::ARITHMETIC>(field));
+    CHECK(arithmetic.coeff(6, 2) == doctest::Approx(5.0));
+
+    // Batched evaluation along y equals the weight function's values.
+    auto weights = std::vector<double>(8);
+    field.face_weights<Averaging::HARMONIC>(1, 0, 8, weights.data());
+    for(auto node = 0; node < 8; ++node) {
+      CHECK(weights[node] == doctest::Approx(harmonic.coeff(node, node + 4)));
+    }
+  }
+
+  SUBCASE("Tensor fields use the component of the face's dimension") {
+    auto coefficients = std::vector<float>(24, 2.0f);
+    for(auto node = 0; node < 12; ++node) {
+      coefficients[2 * node] = static_cast<float>(node + 1);
+    }
+    write(coefficients);
+    const auto field = matrixgen::map_coefficient_field<float, 2>(path, grid, 16);
+    const auto matrix = matrixgen::adjmat<Matrix_t>(grid, matrixgen::stencil9p(),
+        matrixgen::coefficient_weight<Averaging::ARITHMETIC>(field));
+    CHECK(matrix.coeff(5, 6) == doctest::Approx(6.5));
+    CHECK(matrix.coeff(5, 9) == doctest::Approx(2.0));
+    CHECK(matrix.coeff(5, 10) == doctest::Approx((8.5 + 2.0) / 2));
+    CHECK(matrix.coeff(5, 5) == doctest::Approx((6.0 + 2.0) / 2));
+
+    auto weights = std::vector<double>(11);
+    field.face_weights<Averaging::ARITHMETIC>(0, 0, 11, weights.data());
+    CHECK(weights[5] == doctest::Approx(6.5));
+  }
+
+  SUBCASE("Files too small for the grid are rejected") {
+    write(std::vector<float>(11));
+    CHECK_THROWS(matrixgen::map_coefficient_field<float>(path, grid, 16));
+  }
+
+  std::filesystem::remove(path);
+}
+
+TEST_CASE("multigrid") {
+
+  using Matrix_t = Eigen::SparseMatrix<double, Eigen::RowMajor>;
+
+  SUBCASE("Levels and transfer matrices") {
+    const auto levels = matrixgen::multigrid_hierarchy(std::array {9},
+        matrixgen::stencil3p(), matrixgen::constweight(1.0));
+    REQUIRE(levels.size() == 5);
+    CHECK(levels[1].gridDimensions[0] == 5);
+    CHECK(levels[4].gridDimensions[0] == 1);
+    CHECK(levels[4].restriction.size() == 0);
+
+    const auto& prolongation = levels[0].prolongation;
+    const auto& restriction = levels[0].restriction;
+    REQUIRE(prolongation.rows() == 9);
+    REQUIRE(prolongation.cols() == 5);
+    CHECK(prolongation.coeff(1, 0) == 0.5);
+    CHECK(prolongation.coeff(1, 1) == 0.5);
+    CHECK(prolongation.coeff(2, 1) == 1.0);
+    CHECK(restriction.coeff(1, 1) == 0.25);
+    CHECK(restriction.coeff(1, 2) == 0.5);
+    CHECK(restriction.coeff(1, 3) == 0.25);
+    CHECK(restriction.row(1).sum() == 1.0);
+  }
+
+  SUBCASE("Galerkin operators equal R * A * P") {
+    const auto check = [](const auto& levels) {
+      for(auto level = std::size_t {1}; level < levels.size(); ++level) {
+        const auto& fine = levels[level - 1];
+        const Eigen::MatrixXd product = Eigen::MatrixXd(fine.restriction) *
+                                        Eigen::MatrixXd(fine.matrix) * Eigen::MatrixXd(fine.prolongation);
+        CHECK(Eigen::MatrixXd(levels[level].matrix).isApprox(product));
+      }
+    };
+    check(matrixgen::multigrid_hierarchy(std::array {9, 7},
+        matrixgen::stencil9p<matrixgen::BC::PERIODIC>(),
+        [](std::array<int, 2> coords, std::array<int, 2> neighborCoords) { return 1.0 + coords[0] + 2.0 * neighborCoords[1]; }));
+
+    auto options = matrixgen::MultigridOptions {};
+    options.coarseningFactor = 3;
+    options.restriction = matrixgen::Transfer::INJECTION;
+    options.prolongation = matrixgen::Transfer::MULTILINEAR;
+    check(matrixgen::multigrid_hierarchy(std::array {10, 7, 4},
+        matrixgen::stencil7p(), matrixgen::constweight(1.0), options));
+  }
+
+  SUBCASE("Rediscretized operators") {
+    auto options = matrixgen::MultigridOptions {};
+    options.coarseOperator = matrixgen::CoarseOperator::REDISCRETIZED;
+    options.maxLevels = 2;
+    const auto levels = matrixgen::multigrid_hierarchy(std::array {9, 9, 5},
+        matrixgen::stencil27p(), matrixgen::constweight(1.0), options);
+    REQUIRE(levels.size() == 2);
+    const auto coarse = matrixgen::adjmat<Matrix_t>(std::array {5, 5, 3},
+        matrixgen::stencil27p(), matrixgen::constweight(1.0));
+    CHECK(levels[1].matrix.isApprox(coarse));
+  }
+}
+
+TEST_CASE("kronecker") {
+
+  using Matrix_t = Eigen::SparseMatrix<double, Eigen::RowMajor>;
+
+  // Dense Kronecker product of `a` and `b`.
+  const auto dense_kron = [](const Eigen::MatrixXd& a, const Eigen::MatrixXd& b) {
+    auto result = Eigen::MatrixXd(a.rows() * b.rows(), a.cols() * b.cols());
+    for(auto ii = 0; ii < a.rows(); ++ii) {
+      for(auto jj = 0; jj < a.cols(); ++jj) {
+        result.block(ii * b.rows(), jj * b.cols(), b.rows(), b.cols()) = a(ii, jj) * b;
+      }
+    }
+    return result;
+  };
+  const auto a = Eigen::MatrixXd {{1, 0, 2}, {0, 0, 0}, {3, 4, 0}};
+  const auto b = Eigen::MatrixXd {{0, 5}, {6, 7}};
+
+  SUBCASE("Products equal the dense Kronecker product") {
+    const auto product = matrixgen::kron(Matrix_t(a.sparseView()), Matrix_t(b.sparseView()));
+    CHECK(product.isCompressed());
+    CHECK(product.nonZeros() == 12);
+    CHECK(Eigen::MatrixXd(product) == dense_kron(a, b));
+
+    using ColMatrix_t = Eigen::SparseMatrix<double>;
+    const auto factors = std::vector<ColMatrix_t> {b.sparseView(), a.sparseView(), b.sparseView()};
+    const auto triple = matrixgen::kron(factors.begin(), factors.end());
+    CHECK(Eigen::MatrixXd(triple) == dense_kron(dense_kron(b, a), b));
+  }
+
+  SUBCASE("Sums of 1D Laplacians equal the 7p Laplacian") {
+    // The diagonal of the sum is the sum of the factors' diagonals.
+    const auto laplacian = [](double diagonal) {
+      return [diagonal](auto coords, auto neighborCoords) { return coords == neighborCoords ? diagonal : -1.0; };
+    };
+    const auto factors = std::vector<Matrix_t> {
+      matrixgen::adjmat<Matrix_t>(std::array {4}, matrixgen::stencil3p(), laplacian(2.0)),
+      matrixgen::adjmat<Matrix_t>(std::array {3}, matrixgen::stencil3p(), laplacian(2.0)),
+      matrixgen::adjmat<Matrix_t>(std::array {5}, matrixgen::stencil3p(), laplacian(2.0))};
+    const auto sum = matrixgen::kron_sum(factors.begin(), factors.end());
+    const auto expected = matrixgen::adjmat<Matrix_t>(std::array {5, 3, 4}, matrixgen::stencil7p(), laplacian(6.0));
+    CHECK(sum.nonZeros() == expected.nonZeros());
+    CHECK(Eigen::MatrixXd(sum) == Eigen::MatrixXd(expected));
+
+    const auto asymmetric = matrixgen::kron_sum(Matrix_t(a.sparseView()), Matrix_t(b.sparseView()));
+    const auto identity = [](Eigen::Index size) { return Eigen::MatrixXd::Identity(size, size).eval(); };
+    CHECK(Eigen::MatrixXd(asymmetric) == dense_kron(a, identity(2)) + dense_kron(identity(3), b));
+  }
+
+  SUBCASE("Matrix-free operators") {
+    const auto factors = std::vector<Matrix_t> {a.sparseView(), b.sparseView(), a.sparseView()};
+    const auto x = Eigen::VectorXd::LinSpaced(18, 1.0, 18.0).eval();
+    for(const auto kronecker : {matrixgen::Kronecker::PRODUCT, matrixgen::Kronecker::SUM}) {
+      const auto op = matrixgen::KroneckerOperator(factors.begin(), factors.end(), kronecker);
+      const auto matrix = op.to_matrix();
+      REQUIRE(op.rows() == 18);
+      const Eigen::VectorXd y = op * x;
+      CHECK(y.isApprox(matrix * x));
+    }
+  }
+}
+
+TEST_CASE("multicolor") {
+
+  using Matrix_t = Eigen::SparseMatrix<double, Eigen::RowMajor>;
+
+  // True if no two rows of the same color are coupled and the colors partition the rows.
+  const auto is_valid = [](const auto& matrix, const auto& coloring) {
+    if(coloring.colorOffsets.front() != 0 || coloring.colorOffsets.back() != matrix.rows()) {
+      return false;
+    }
+    for(auto color = Eigen::Index {0}; color < coloring.colors(); ++color) {
+      const auto first = coloring.colorOffsets[color];
+      const auto size = coloring.colorOffsets[color + 1] - first;
+      const auto block = Eigen::MatrixXd(matrix.block(first, first, size, size));
+      if(!block.isApprox(Eigen::MatrixXd(block.diagonal().asDiagonal()))) {
+        return false;
+      }
+    }
+    return true;
+  };
+  // True if `colored` is `matrix` reordered by `numbering`.
+  const auto is_permuted = [](const auto& matrix, const auto& colored, const auto& numbering) {
+    const auto dense = Eigen::MatrixXd(matrix);
+    const auto denseColored = Eigen::MatrixXd(colored);
+    for(auto row = 0; row < dense.rows(); ++row) {
+      for(auto col = 0; col < dense.cols(); ++col) {
+        if(dense(row, col) != denseColored(numbering.rowOfNode[row], numbering.rowOfNode[col])) {
+          return false;
+        }
+      }
+    }
+    return true;
+  };
+  const auto weightfn = [](std::array<int, 3> coords, std::array<int, 3> neighborCoords) {
+    return 1.0 + coords[0] + 10.0 * neighborCoords[1] + 100.0 * neighborCoords[2];
+  };
+
+  SUBCASE("Red-black ordering of the 7p stencil") {
+    const auto grid = std::array {6, 5, 3};
+    const auto colored = matrixgen::adjmat_multicolor<Matrix_t>(grid, matrixgen::stencil7p(), weightfn);
+    const auto matrix = matrixgen::adjmat<Matrix_t>(grid, matrixgen::stencil7p(), weightfn);
+    REQUIRE(colored.coloring.colors() == 2);
+    CHECK(colored.coloring.colorOffsets[1] == 45);
+    CHECK(colored.coloring.numbering.nodeOfRow[1] == 2);
+    CHECK(is_valid(colored.matrix, colored.coloring));
+    CHECK(is_permuted(matrix, colored.matrix, colored.coloring.numbering));
+    CHECK(matrixgen::permute_symmetric(matrix, colored.coloring.numbering).isApprox(colored.matrix));
+  }
+
+  SUBCASE("8 colors for the 27p stencil") {
+    const auto grid = std::array {4, 5, 2};
+    const auto adjfn = matrixgen::stencil27p<matrixgen::BC::PERIODIC, matrixgen::BC::NEUMANN, matrixgen::BC::PERIODIC>();
+    const auto colored = matrixgen::adjmat_multicolor<Matrix_t>(grid, adjfn, weightfn);
+    REQUIRE(colored.coloring.colors() == 8);
+    CHECK(is_valid(colored.matrix, colored.coloring));
+    CHECK(is_permuted(matrixgen::adjmat<Matrix_t>(grid, adjfn, weightfn), colored.matrix, colored.coloring.numbering));
+  }
+
+  SUBCASE("Greedy coloring of perturbed matrices") {
+    const auto matrix = matrixgen::adjmat<Matrix_t>(std::array {8, 6, 5}, matrixgen::stencil7p(), weightfn);
+    auto rows = std::vector<int>(matrix.rows());
+    std::iota(rows.begin(), rows.end(), 0);
+    const auto perturbed = matrixgen::perturb(matrix, rows.begin(), rows.end(), 7);
+    const auto colored = matrixgen::multicolor(perturbed);
+    CHECK(colored.coloring.colors() > 1);
+    CHECK(is_valid(colored.matrix, colored.coloring));
+    CHECK(is_valid(Matrix_t(colored.matrix.transpose()), colored.coloring));
+    CHECK(is_permuted(perturbed, colored.matrix, colored.coloring.numbering));
+
+    const auto sequential = matrixgen::greedy_coloring(matrixgen::ExecutionContext::sequential(), perturbed);
+    CHECK(sequential.numbering.nodeOfRow == colored.coloring.numbering.nodeOfRow);
+  }
+}
+
+TEST_CASE("rcm") {
+
+  using Matrix_t = Eigen::SparseMatrix<double, Eigen::RowMajor>;
+
+  const auto bandwidth = [](const Matrix_t& matrix) {
+    auto result = Eigen::Index {0};
+    for(auto row = 0; row < matrix.outerSize(); ++row) {
+      for(Matrix_t::InnerIterator it(matrix, row); it; ++it) {
+        result = std::max<Eigen::Index>(result, std::abs(it.col() - row));
+      }
+    }
+    return result;
+  };
+  // True if `reordered` is `matrix` reordered by `numbering`.
+  const auto is_permuted = [](const auto& matrix, const auto& reordered, const auto& numbering) {
+    const auto dense = Eigen::MatrixXd(matrix);
+    const auto denseReordered = Eigen::MatrixXd(reordered);
+    for(auto row = 0; row < dense.rows(); ++row) {
+      for(auto col = 0; col < dense.cols(); ++col) {
+        if(dense(row, col) != denseReordered(numbering.rowOfNode[row], numbering.rowOfNode[col])) {
+          return false;
+        }
+      }
+    }
+    return true;
+  };
+
+  SUBCASE("Shuffled paths are restored to tridiagonal matrices") {
+    // Two paths of 20 and 9 nodes and an isolated node, shuffled.
+    auto triplets = std::vector<Eigen::Triplet<double>> {};
+    for(auto node = 0; node < 30; ++node) {
+      triplets.emplace_back(node, node, 2.0);
+      if(node + 1 < 30 && node != 19 && node != 28) {
+        triplets.emplace_back(node, node + 1, -1.0);
+        triplets.emplace_back(node + 1, node, -1.0);
+      }
+    }
+    auto path = Matrix_t(30, 30);
+    path.setFromTriplets(triplets.begin(), triplets.end());
+    auto numbering = matrixgen::CompactNumbering<int> {std::vector<int>(30), std::vector<int>(30)};
+    std::iota(numbering.nodeOfRow.begin(), numbering.nodeOfRow.end(), 0);
+    std::shuffle(numbering.nodeOfRow.begin(), numbering.nodeOfRow.end(), std::mt19937(7));
+    for(auto row = 0; row < 30; ++row) {
+      numbering.rowOfNode[numbering.nodeOfRow[row]] = row;
+    }
+    const auto shuffled = matrixgen::permute_symmetric(path, numbering);
+    REQUIRE(bandwidth(shuffled) > 1);
+
+    const auto reordered = matrixgen::reverse_cuthill_mckee(shuffled);
+    CHECK(bandwidth(reordered.matrix) == 1);
+    CHECK(is_permuted(shuffled, reordered.matrix, reordered.numbering));
+  }
+
+  SUBCASE("Perturbed matrices") {
+    const auto matrix = matrixgen::adjmat<Matrix_t>(std::array {8, 6, 5}, matrixgen::stencil7p(), matrixgen::constweight(1.0));
+    auto rows = std::vector<int>(matrix.rows());
+    std::iota(rows.begin(), rows.end(), 0);
+    const auto perturbed = matrixgen::perturb(matrix, rows.begin(), rows.end(), 7);
+    const auto reordered = matrixgen::reverse_cuthill_mckee(perturbed);
+    CHECK(bandwidth(reordered.matrix) < bandwidth(perturbed));
+    CHECK(is_permuted(perturbed, reordered.matrix, reordered.numbering));
+
+    const auto sequential = matrixgen::rcm_ordering(matrixgen::ExecutionContext::sequential(), perturbed);
+    CHECK(sequential.nodeOfRow == reordered.numbering.nodeOfRow);
+  }
+}
+
+TEST_CASE("workspace") {
+
+  using Matrix_t = Eigen::SparseMatrix<double, Eigen::RowMajor>;
+  const auto grid = std::array {5, 4, 3};
+  auto workspace = matrixgen::Workspace {};
+  auto matrix = Matrix_t {};
+
+  SUBCASE("adjmat refills the output in place") {
+    workspace.adjmat(matrix, grid, matrixgen::stencil7p(), matrixgen::constweight(1.0));
+    CHECK(matrix.isApprox(matrixgen::adjmat<Matrix_t>(grid, matrixgen::stencil7p(), matrixgen::constweight(1.0))));
+    CHECK(matrix.isCompressed());
+
+    // Smaller or equally sized outputs reuse the storage.
+    const auto* storage = matrix.valuePtr();
+    const auto smaller = std::array {4, 4, 3};
+    workspace.adjmat(matrix, smaller, matrixgen::stencil7p(), matrixgen::constweight(2.0));
+    CHECK(matrix.valuePtr() == storage);
+    CHECK(matrix.isApprox(matrixgen::adjmat<Matrix_t>(smaller, matrixgen::stencil7p(), matrixgen::constweight(2.0))));
+
+    // Larger outputs grow the storage.
+    const auto larger = std::array {6, 5, 4};
+    workspace.adjmat(matrix, larger, matrixgen::stencil7p(), matrixgen::randweight(7));
+    CHECK(matrix.isApprox(matrixgen::adjmat<Matrix_t>(larger, matrixgen::stencil7p(), matrixgen::randweight(7))));
+  }
+
+  SUBCASE("assemble and interleave match the free functions") {
+    const auto matrices = std::vector {
+      matrixgen::adjmat<Matrix_t>(grid, matrixgen::stencil7p(), matrixgen::constweight(1.0)),
+      matrixgen::adjmat<Matrix_t>(grid, matrixgen::stencil7p(), matrixgen::constweight(2.0))};
+    const auto indices = std::vector {0, 1, 1, 0, 1};
+    workspace.assemble(matrix, matrices.begin(), matrices.end(), indices.begin(), indices.end());
+    CHECK(matrix.isApprox(matrixgen::assemble(matrices.begin(), matrices.end(), indices.begin(), indices.end())));
+
+    const auto proportions = std::vector {1.0, 3.0};
+    for(auto seed : {1, 2, 3}) {
+      workspace.interleave(matrix, matrices.begin(), matrices.end(), proportions.begin(), proportions.end(), 2, seed);
+      CHECK(matrix.isApprox(matrixgen::interleave(
+          matrices.begin(), matrices.end(), proportions.begin(), proportions.end(), 2, seed)));
+    }
+  }
+}
+
+TEST_CASE("tracing") {
+
+  using Matrix_t = Eigen::SparseMatrix<double, Eigen::RowMajor>;
+  const auto grid = std::array {6, 5, 4};
+
+  auto trace_of = [](auto generate, std::size_t eventsPerThread = 1024) {
+    matrixgen::start_tracing(eventsPerThread);
+    generate();
+    matrixgen::stop_tracing();
+    auto os = std::ostringstream {};
+    matrixgen::write_chrome_trace(os);
+    return os.str();
+  };
+
+  SUBCASE("Phases and blocks are exported as complete events") {
+    const auto json = trace_of([&]() {
+      matrixgen::adjmat<Matrix_t>(grid, matrixgen::stencil7p(), matrixgen::constweight(1.0));
+      matrixgen::perturb_rowlengths(
+          matrixgen::adjmat<Matrix_t>(grid, matrixgen::stencil7p(), matrixgen::constweight(1.0)),
+          matrixgen::bimodal_rowlengths(2, 9, 0.3), 4);
+    });
+
+    CHECK(json.rfind("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", 0) == 0);
+    CHECK(json.find("\"name\":\"adjmat.triplets\",\"cat\":\"matrixgen\",\"ph\":\"X\"") != std::string::npos);
+    CHECK(json.find("\"name\":\"rows.fill.block\"") != std::string::npos);
+    CHECK(json.find("\"args\":{\"first\":") != std::string::npos);
+    CHECK(json.find("\"name\":\"thread_name\"") != std::string::npos);
+  }
+
+  SUBCASE("Ring buffers keep the most recent events") {
+    const auto json = trace_of([&]() {
+      for(auto ii = 0; ii < 20; ++ii) {
+        const auto scope = matrixgen::implementation::TraceScope("unittest", ii, ii + 1);
+      }
+    }, 8);
+    CHECK(json.find("\"first\":11,") == std::string::npos);
+    CHECK(json.find("\"first\":12,") != std::string::npos);
+    CHECK(json.find("\"first\":19,") != std::string::npos);
+  }
+
+  SUBCASE("Nothing is recorded while tracing is stopped") {
+    trace_of([]() {});
+    matrixgen::adjmat<Matrix_t>(grid, matrixgen::stencil7p(), matrixgen::constweight(1.0));
+    auto os = std::ostringstream {};
+    matrixgen::write_chrome_trace(os);
+    CHECK(os.str().find("adjmat") == std::string::npos);
+  }
+}
+
 TEST_CASE("utility") {
 
   SUBCASE("Central Moving Sum") {
@@ -289,6 +1862,10 @@ TEST_CASE("utility") {
       target.back() = 2;
 
       REQUIRE(result == target);
+
+      auto inserted = std::vector<int32_t> {};
+      matrixgen::central_moving_sum(input.begin(), input.end(), std::back_inserter(inserted), 1);
+      REQUIRE(inserted == target);
     }
   }
 
@@ -365,6 +1942,12 @@ TEST_CASE("utility") {
     std::vector<int> indices(bullets.size());
     matrixgen::darts_sampling(quota.begin(), quota.end(), bullets.begin(), bullets.end(), indices.begin());
     REQUIRE(indices == std::vector<int>({0, 0, 0, 1, 1, 1, 2, 2, 2, 2}));
+
+    // Bullets and outputs without random access are processed in order.
+    const auto bulletList = std::list<double>(bullets.begin(), bullets.end());
+    auto inserted = std::vector<int> {};
+    matrixgen::darts_sampling(quota.begin(), quota.end(), bulletList.begin(), bulletList.end(), std::back_inserter(inserted));
+    REQUIRE(inserted == indices);
   }
 
   SUBCASE("Insert") {